@@ -0,0 +1,26 @@
+struct InstanceData {
+    float4x4 mvp_matrix;
+    float4 color;
+};
+
+StructuredBuffer<InstanceData> instances : register(t0, space0);
+
+struct VertexInput {
+    float4 position : POSITION;
+    float4 color : COLOR;
+    uint instance_id : SV_InstanceID;
+};
+
+struct VertexOutput {
+    float4 color : TEXCOORD0;
+    float4 position : SV_Position;
+};
+
+VertexOutput main(VertexInput input) {
+    InstanceData instance = instances[input.instance_id];
+
+    VertexOutput output;
+    output.position = mul(instance.mvp_matrix, input.position);
+    output.color = input.color * instance.color;
+    return output;
+}
@@ -8,6 +8,7 @@ set BUILD_DIR=%PROJECT_ROOT%build
 set ASSETS_DIR=%PROJECT_ROOT%assets
 set SHADER_SOURCE_DIR=%ASSETS_DIR%\shaders\source
 set SHADER_OUT_DIR=%ASSETS_DIR%\shaders\compiled
+set SHADER_ARCHIVE=%ASSETS_DIR%\shaders.pak
 
 :: Set SDL3 paths
 set SDL3_DIR=C:\SDKs\SDL3
@@ -94,5 +95,31 @@ if errorlevel 1 (
     exit /b 1
 )
 
+:: Build the asset packer and pack the compiled shaders
+echo Compiling packer...
+
+clang++ -std=c++23 ^
+    -g ^
+    -Wall ^
+    -Wextra ^
+    -Wpedantic ^
+    -Wno-c99-extensions ^
+    -Wno-dangling ^
+    -Wno-address-of-temporary ^
+    -Wno-missing-designated-field-initializers ^
+    -Wno-nested-anon-types ^
+    -Wno-gnu-anonymous-struct ^
+    -Wno-reorder-init-list ^
+    -Wno-deprecated-declarations ^
+    -o "%BUILD_DIR%\packer.exe" ^
+    "%PROJECT_ROOT%tools\packer.cpp"
+
+if errorlevel 1 (
+    echo Packer compilation failed
+    exit /b 1
+)
+
+"%BUILD_DIR%\packer.exe" "%SHADER_OUT_DIR%" "%SHADER_ARCHIVE%"
+
 echo Build completed successfully!
 echo Executable: %BUILD_DIR%\main.exe
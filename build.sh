@@ -21,6 +21,7 @@ BUILD_DIR="$PROJECT_ROOT/build"
 ASSETS_DIR="$PROJECT_ROOT/assets"
 SHADER_SOURCE_DIR="$ASSETS_DIR/shaders/source"
 SHADER_OUT_DIR="$ASSETS_DIR/shaders/compiled"
+SHADER_ARCHIVE="$ASSETS_DIR/shaders.pak"
 
 # Create build directory if it doesn't exist
 mkdir -p "$BUILD_DIR"
@@ -106,5 +107,21 @@ if [ $? -ne 0 ]; then
     exit 1
 fi
 
+# Build the asset packer and pack the compiled shaders
+echo "Compiling packer..."
+
+$CC $CFLAGS \
+    -o "$BUILD_DIR/packer" \
+    "$PROJECT_ROOT/tools/packer.cpp"
+
+if [ $? -ne 0 ]; then
+    echo "Packer compilation failed"
+    exit 1
+fi
+
+if [ -d "$SHADER_OUT_DIR" ] && [ -n "$(ls -A "$SHADER_OUT_DIR")" ]; then
+    "$BUILD_DIR/packer" "$SHADER_OUT_DIR" "$SHADER_ARCHIVE"
+fi
+
 echo "Build completed successfully!"
 echo "Executable: $BUILD_DIR/main"
@@ -0,0 +1,711 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/def.h"
+#include "profiler.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+constexpr u32 ASYNC_IO_MAX_REQUESTS = 256;
+constexpr u32 ASYNC_IO_RING_ENTRIES = 64;
+constexpr u32 ASYNC_IO_THREADS = 4;
+// Thread pool reads are split so a cancelled request stops within one chunk.
+constexpr usize ASYNC_IO_THREAD_CHUNK_SIZE = MB(1);
+// IORING_OP_READ takes a 32-bit length.
+constexpr usize ASYNC_IO_RING_CHUNK_SIZE = GB(1);
+// user_data of io_uring cancel entries, never a request index.
+constexpr u64 ASYNC_IO_CANCEL_TAG = ~(u64)0;
+
+enum AsyncIOPriority {
+    ASYNC_IO_PRIORITY_HIGH,
+    ASYNC_IO_PRIORITY_NORMAL,
+    ASYNC_IO_PRIORITY_LOW,
+    ASYNC_IO_PRIORITY_COUNT,
+};
+
+enum AsyncIOStatus {
+    ASYNC_IO_COMPLETE,
+    ASYNC_IO_FAILED,
+    ASYNC_IO_CANCELLED,
+};
+
+constexpr string to_string(AsyncIOStatus status) {
+    switch (status) {
+        case ASYNC_IO_COMPLETE:
+            return "ASYNC_IO_COMPLETE";
+        case ASYNC_IO_FAILED:
+            return "ASYNC_IO_FAILED";
+        case ASYNC_IO_CANCELLED:
+            return "ASYNC_IO_CANCELLED";
+        default:
+            return "UNKNOWN_STATUS";
+    }
+}
+
+enum AsyncIOBackend {
+    ASYNC_IO_BACKEND_IO_URING,
+    ASYNC_IO_BACKEND_THREAD_POOL,
+};
+
+struct AsyncIOHandle {
+    u32 index;
+    u32 generation;
+};
+
+struct AsyncIOResult {
+    AsyncIOHandle handle;
+    AsyncIOStatus status;
+    // Only set when `status` is ASYNC_IO_COMPLETE. Owned by the callback from then on and
+    // freed with `allocator.free_array(data, size)` on the allocator passed to `read`.
+    u8* data;
+    usize size;
+    void* user_data;
+};
+
+typedef void (*AsyncIOCallback)(const AsyncIOResult& result);
+
+#ifdef __linux__
+/// @brief Minimal io_uring wrapper over the raw syscalls: one submission and one completion
+/// ring mapped from the kernel.
+struct IOUring {
+    int fd;
+    u32 entries;
+
+    void* sq_ring;
+    usize sq_ring_size;
+    void* cq_ring;
+    usize cq_ring_size;
+    io_uring_sqe* sqes;
+    usize sqes_size;
+
+    u32* sq_head;
+    u32* sq_tail;
+    u32* sq_array;
+    u32 sq_mask;
+    u32 to_submit;
+
+    u32* cq_head;
+    u32* cq_tail;
+    io_uring_cqe* cqes;
+    u32 cq_mask;
+
+    static std::optional<IOUring> init(u32 entries) {
+        io_uring_params params = {};
+        int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0) return std::nullopt;
+
+        // IORING_OP_READ arrived in the same kernel release as this feature bit.
+        if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+            close(fd);
+            return std::nullopt;
+        }
+
+        IOUring ring = {};
+        ring.fd = fd;
+        ring.entries = params.sq_entries;
+        ring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+        ring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            if (ring.cq_ring_size > ring.sq_ring_size) ring.sq_ring_size = ring.cq_ring_size;
+            ring.cq_ring_size = ring.sq_ring_size;
+        }
+
+        ring.sq_ring = mmap(
+            nullptr,
+            ring.sq_ring_size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            fd,
+            IORING_OFF_SQ_RING
+        );
+        if (ring.sq_ring == MAP_FAILED) {
+            close(fd);
+            return std::nullopt;
+        }
+
+        ring.cq_ring = ring.sq_ring;
+        if (!single_mmap) {
+            ring.cq_ring = mmap(
+                nullptr,
+                ring.cq_ring_size,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE,
+                fd,
+                IORING_OFF_CQ_RING
+            );
+            if (ring.cq_ring == MAP_FAILED) {
+                munmap(ring.sq_ring, ring.sq_ring_size);
+                close(fd);
+                return std::nullopt;
+            }
+        }
+
+        ring.sqes = (io_uring_sqe*)mmap(
+            nullptr,
+            ring.sqes_size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            fd,
+            IORING_OFF_SQES
+        );
+        if (ring.sqes == MAP_FAILED) {
+            if (!single_mmap) munmap(ring.cq_ring, ring.cq_ring_size);
+            munmap(ring.sq_ring, ring.sq_ring_size);
+            close(fd);
+            return std::nullopt;
+        }
+
+        u8* sq = (u8*)ring.sq_ring;
+        ring.sq_head = (u32*)(sq + params.sq_off.head);
+        ring.sq_tail = (u32*)(sq + params.sq_off.tail);
+        ring.sq_array = (u32*)(sq + params.sq_off.array);
+        ring.sq_mask = *(u32*)(sq + params.sq_off.ring_mask);
+        ring.to_submit = 0;
+
+        u8* cq = (u8*)ring.cq_ring;
+        ring.cq_head = (u32*)(cq + params.cq_off.head);
+        ring.cq_tail = (u32*)(cq + params.cq_off.tail);
+        ring.cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        ring.cq_mask = *(u32*)(cq + params.cq_off.ring_mask);
+
+        return ring;
+    }
+
+    void deinit() {
+        munmap(sqes, sqes_size);
+        if (cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+        munmap(sq_ring, sq_ring_size);
+        close(fd);
+    }
+
+    /// @brief Returns a zeroed submission entry, or null if the ring is full. The entry is
+    /// handed to the kernel on the next `submit`.
+    io_uring_sqe* next_sqe() {
+        u32 head = std::atomic_ref<u32>(*sq_head).load(std::memory_order_acquire);
+        u32 tail = *sq_tail;
+        if (tail - head >= entries) return nullptr;
+
+        u32 index = tail & sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+
+        std::atomic_ref<u32>(*sq_tail).store(tail + 1, std::memory_order_release);
+        to_submit++;
+        return sqe;
+    }
+
+    /// @brief Submits queued entries and optionally blocks until `wait_for` completions exist.
+    bool submit(u32 wait_for = 0) {
+        if (to_submit == 0 && wait_for == 0) return true;
+
+        u32 flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+        long result = syscall(__NR_io_uring_enter, fd, to_submit, wait_for, flags, nullptr, 0);
+        if (result < 0) return false;
+
+        to_submit -= (u32)result < to_submit ? (u32)result : to_submit;
+        return true;
+    }
+
+    /// @brief Pops the next completion into `out`.
+    /// @return False if the completion queue is empty.
+    bool next_cqe(io_uring_cqe* out) {
+        u32 head = *cq_head;
+        u32 tail = std::atomic_ref<u32>(*cq_tail).load(std::memory_order_acquire);
+        if (head == tail) return false;
+
+        *out = cqes[head & cq_mask];
+        std::atomic_ref<u32>(*cq_head).store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
+#endif
+
+/// @brief Asynchronous whole-file reads. Requests are queued by priority and read by io_uring
+/// where the kernel allows it, otherwise by a small thread pool. `poll` is called once per
+/// frame and runs the callbacks of finished requests on the calling thread.
+///
+/// `read`, `cancel` and `poll` must be called from one thread. The file is opened and sized on
+/// that thread so the buffer can come from the caller's allocator; only the read itself is
+/// asynchronous.
+struct AsyncIO {
+    enum RequestState {
+        REQUEST_FREE,
+        REQUEST_QUEUED,
+        REQUEST_IN_FLIGHT,
+        REQUEST_DONE,
+    };
+
+    struct Request {
+        u32 generation;
+        RequestState state;
+        AsyncIOPriority priority;
+        AsyncIOStatus status;
+        bool cancelled;
+
+        FILE* file;
+        u8* data;
+        usize size;
+        usize bytes_read;
+
+        Allocator allocator;
+        AsyncIOCallback callback;
+        void* user_data;
+        u32 next_free;
+    };
+
+    struct Queue {
+        u32 items[ASYNC_IO_MAX_REQUESTS];
+        u32 head;
+        u32 len;
+    };
+
+    AsyncIOBackend backend;
+    Request requests[ASYNC_IO_MAX_REQUESTS];
+    u32 first_free;
+
+    // Protects request state, the queues and `completed` against the worker threads.
+    SDL_Mutex* mutex;
+    SDL_Condition* condition;
+    Queue queues[ASYNC_IO_PRIORITY_COUNT];
+    u32 completed[ASYNC_IO_MAX_REQUESTS];
+    u32 completed_count;
+
+    SDL_Thread* threads[ASYNC_IO_THREADS];
+    std::atomic<bool> running;
+
+#ifdef __linux__
+    IOUring ring;
+    u32 ring_in_flight;
+#endif
+
+    // Workers keep a pointer to the engine, so it is initialized in place.
+    bool init(bool allow_io_uring = true) {
+        for (u32 i = 0; i < ASYNC_IO_MAX_REQUESTS; i++) {
+            requests[i] = Request{};
+            requests[i].state = REQUEST_FREE;
+            requests[i].next_free = i + 1;
+        }
+        first_free = 0;
+
+        for (auto& queue : queues) {
+            queue.head = 0;
+            queue.len = 0;
+        }
+        completed_count = 0;
+
+        for (auto& thread : threads) {
+            thread = nullptr;
+        }
+
+        mutex = SDL_CreateMutex();
+        condition = SDL_CreateCondition();
+        if (!mutex || !condition) return false;
+        running = true;
+
+#ifdef __linux__
+        ring_in_flight = 0;
+        if (allow_io_uring) {
+            auto io_uring = IOUring::init(ASYNC_IO_RING_ENTRIES);
+            if (io_uring.has_value()) {
+                ring = io_uring.value();
+                backend = ASYNC_IO_BACKEND_IO_URING;
+                return true;
+            }
+            SDL_Log("io_uring unavailable, async I/O falls back to a thread pool\n");
+        }
+#else
+        (void)allow_io_uring;
+#endif
+
+        backend = ASYNC_IO_BACKEND_THREAD_POOL;
+        u32 spawned = 0;
+        for (auto& thread : threads) {
+            thread = SDL_CreateThread(worker_thread, "async-io", this);
+            if (thread) spawned++;
+        }
+
+        return spawned > 0;
+    }
+
+    /// @brief Cancels every outstanding request and waits for the backend to let go of them.
+    /// Callbacks are not run.
+    void deinit() {
+        // Set under the lock so a worker cannot miss the wake-up below.
+        SDL_LockMutex(mutex);
+        running = false;
+        SDL_UnlockMutex(mutex);
+
+        if (backend == ASYNC_IO_BACKEND_THREAD_POOL) {
+            SDL_BroadcastCondition(condition);
+            for (auto& thread : threads) {
+                if (thread) SDL_WaitThread(thread, nullptr);
+                thread = nullptr;
+            }
+        }
+
+#ifdef __linux__
+        if (backend == ASYNC_IO_BACKEND_IO_URING) {
+            for (u32 i = 0; i < ASYNC_IO_MAX_REQUESTS; i++) {
+                if (requests[i].state == REQUEST_IN_FLIGHT) submit_ring_cancel(i);
+            }
+
+            // The kernel may still be writing into the buffers until their completions arrive.
+            while (ring_in_flight > 0) {
+                if (!ring.submit(1)) break;
+                reap_ring();
+            }
+            ring.deinit();
+        }
+#endif
+
+        for (auto& request : requests) {
+            if (request.state == REQUEST_FREE) continue;
+            if (request.file) fclose(request.file);
+            request.allocator.free_array(request.data, request.size);
+            request = Request{};
+            request.state = REQUEST_FREE;
+        }
+
+        SDL_DestroyCondition(condition);
+        SDL_DestroyMutex(mutex);
+    }
+
+    /// @brief Queues a read of the whole file at `path` into a buffer from `allocator`.
+    /// @param callback Runs from `poll` once the request completes, fails or is cancelled.
+    /// @return A handle for `cancel`, or nullopt if the file cannot be opened or too many
+    /// requests are outstanding.
+    std::optional<AsyncIOHandle> read(
+        string path,
+        Allocator allocator,
+        AsyncIOCallback callback,
+        void* user_data = nullptr,
+        AsyncIOPriority priority = ASYNC_IO_PRIORITY_NORMAL
+    ) {
+        if (first_free >= ASYNC_IO_MAX_REQUESTS) return std::nullopt;
+
+        FILE* file = fopen(path, "rb");
+        if (!file) return std::nullopt;
+
+        fseek(file, 0, SEEK_END);
+        long file_size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (file_size <= 0) {
+            fclose(file);
+            return std::nullopt;
+        }
+
+        u8* data = allocator.alloc_array<u8>((usize)file_size);
+        if (!data) {
+            fclose(file);
+            return std::nullopt;
+        }
+
+        u32 index = first_free;
+        Request& request = requests[index];
+        first_free = request.next_free;
+
+        SDL_LockMutex(mutex);
+        request.generation++;
+        request.state = REQUEST_QUEUED;
+        request.priority = priority;
+        request.status = ASYNC_IO_COMPLETE;
+        request.cancelled = false;
+        request.file = file;
+        request.data = data;
+        request.size = (usize)file_size;
+        request.bytes_read = 0;
+        request.allocator = allocator;
+        request.callback = callback;
+        request.user_data = user_data;
+
+        Queue& queue = queues[priority];
+        queue.items[(queue.head + queue.len) % ASYNC_IO_MAX_REQUESTS] = index;
+        queue.len++;
+        SDL_UnlockMutex(mutex);
+
+        SDL_SignalCondition(condition);
+
+        return AsyncIOHandle{.index = index, .generation = request.generation};
+    }
+
+    /// @brief Cancels a request. Its callback still runs from the next `poll`, with
+    /// ASYNC_IO_CANCELLED unless the read already finished.
+    /// @return False if the handle no longer refers to an outstanding request.
+    bool cancel(AsyncIOHandle handle) {
+        if (handle.index >= ASYNC_IO_MAX_REQUESTS) return false;
+        Request& request = requests[handle.index];
+
+        SDL_LockMutex(mutex);
+        defer { SDL_UnlockMutex(mutex); };
+
+        if (request.generation != handle.generation || request.state == REQUEST_FREE) {
+            return false;
+        }
+        if (request.state == REQUEST_DONE || request.cancelled) return true;
+
+        request.cancelled = true;
+        if (request.state == REQUEST_QUEUED) {
+            remove_queued(request.priority, handle.index);
+            finish(handle.index, ASYNC_IO_CANCELLED);
+            return true;
+        }
+
+#ifdef __linux__
+        if (backend == ASYNC_IO_BACKEND_IO_URING) submit_ring_cancel(handle.index);
+#endif
+        // Thread pool workers notice the flag between chunks.
+        return true;
+    }
+
+    /// @brief Advances the backend and runs the callbacks of finished requests. Call once per
+    /// frame; it never blocks on I/O.
+    /// @return Number of callbacks run.
+    u32 poll() {
+#ifdef __linux__
+        if (backend == ASYNC_IO_BACKEND_IO_URING) {
+            reap_ring();
+            submit_ring_reads();
+        }
+#endif
+
+        u32 done[ASYNC_IO_MAX_REQUESTS];
+        SDL_LockMutex(mutex);
+        u32 done_count = completed_count;
+        memcpy(done, completed, done_count * sizeof(u32));
+        completed_count = 0;
+        SDL_UnlockMutex(mutex);
+
+        for (u32 i = 0; i < done_count; i++) {
+            Request& request = requests[done[i]];
+            fclose(request.file);
+
+            AsyncIOResult result = {
+                .handle = AsyncIOHandle{.index = done[i], .generation = request.generation},
+                .status = request.status,
+                .data = nullptr,
+                .size = 0,
+                .user_data = request.user_data,
+            };
+            if (request.status == ASYNC_IO_COMPLETE) {
+                result.data = request.data;
+                result.size = request.size;
+            } else {
+                request.allocator.free_array(request.data, request.size);
+            }
+
+            AsyncIOCallback callback = request.callback;
+
+            SDL_LockMutex(mutex);
+            u32 generation = request.generation;
+            request = Request{};
+            request.generation = generation;
+            request.state = REQUEST_FREE;
+            request.next_free = first_free;
+            first_free = done[i];
+            SDL_UnlockMutex(mutex);
+
+            if (callback) callback(result);
+        }
+
+        return done_count;
+    }
+
+    /// @brief True while every request slot is taken and `read` would fail.
+    bool is_full() const { return first_free >= ASYNC_IO_MAX_REQUESTS; }
+
+    /// @brief Number of requests that were issued and have not been delivered by `poll` yet.
+    u32 outstanding() {
+        u32 count = 0;
+        for (auto& request : requests) {
+            if (request.state != REQUEST_FREE) count++;
+        }
+        return count;
+    }
+
+  private:
+    // Caller holds the mutex.
+    void finish(u32 index, AsyncIOStatus status) {
+        requests[index].state = REQUEST_DONE;
+        requests[index].status = status;
+        completed[completed_count++] = index;
+    }
+
+    // Caller holds the mutex. Takes the highest priority queued request.
+    std::optional<u32> dequeue() {
+        for (auto& queue : queues) {
+            if (queue.len == 0) continue;
+
+            u32 index = queue.items[queue.head];
+            queue.head = (queue.head + 1) % ASYNC_IO_MAX_REQUESTS;
+            queue.len--;
+            return index;
+        }
+        return std::nullopt;
+    }
+
+    // Caller holds the mutex.
+    void remove_queued(AsyncIOPriority priority, u32 index) {
+        Queue& queue = queues[priority];
+        u32 kept = 0;
+        for (u32 i = 0; i < queue.len; i++) {
+            u32 item = queue.items[(queue.head + i) % ASYNC_IO_MAX_REQUESTS];
+            if (item == index) continue;
+            queue.items[(queue.head + kept) % ASYNC_IO_MAX_REQUESTS] = item;
+            kept++;
+        }
+        queue.len = kept;
+    }
+
+#ifdef __linux__
+    // Leaves room in the submission ring for cancellations.
+    u32 max_ring_reads() const { return ring.entries / 2; }
+
+    static u16 ring_priority(AsyncIOPriority priority) {
+        // Best-effort class (2), levels 0 (highest) to 7.
+        constexpr u16 levels[ASYNC_IO_PRIORITY_COUNT] = {0, 4, 7};
+        return (u16)((2 << 13) | levels[priority]);
+    }
+
+    bool submit_ring_read(u32 index) {
+        io_uring_sqe* sqe = ring.next_sqe();
+        if (!sqe) return false;
+
+        Request& request = requests[index];
+        usize remaining = request.size - request.bytes_read;
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fileno(request.file);
+        sqe->addr = (u64)(request.data + request.bytes_read);
+        sqe->len = (u32)(remaining < ASYNC_IO_RING_CHUNK_SIZE ? remaining
+                                                               : ASYNC_IO_RING_CHUNK_SIZE);
+        sqe->off = request.bytes_read;
+        sqe->ioprio = ring_priority(request.priority);
+        sqe->user_data = index;
+        return true;
+    }
+
+    void submit_ring_cancel(u32 index) {
+        io_uring_sqe* sqe = ring.next_sqe();
+        if (!sqe) return;
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = index;
+        sqe->user_data = ASYNC_IO_CANCEL_TAG;
+        ring_in_flight++;
+    }
+
+    void submit_ring_reads() {
+        SDL_LockMutex(mutex);
+        while (ring_in_flight < max_ring_reads()) {
+            auto index = dequeue();
+            if (!index.has_value()) break;
+
+            if (!submit_ring_read(index.value())) {
+                // Ring full, put it back in front of its queue.
+                Queue& queue = queues[requests[index.value()].priority];
+                queue.head = (queue.head + ASYNC_IO_MAX_REQUESTS - 1) % ASYNC_IO_MAX_REQUESTS;
+                queue.items[queue.head] = index.value();
+                queue.len++;
+                break;
+            }
+
+            requests[index.value()].state = REQUEST_IN_FLIGHT;
+            ring_in_flight++;
+        }
+        SDL_UnlockMutex(mutex);
+
+        ring.submit();
+    }
+
+    void reap_ring() {
+        SDL_LockMutex(mutex);
+        defer { SDL_UnlockMutex(mutex); };
+
+        io_uring_cqe cqe;
+        while (ring.next_cqe(&cqe)) {
+            ring_in_flight--;
+            if (cqe.user_data == ASYNC_IO_CANCEL_TAG) continue;
+
+            u32 index = (u32)cqe.user_data;
+            Request& request = requests[index];
+            if (request.cancelled) {
+                finish(index, ASYNC_IO_CANCELLED);
+            } else if (cqe.res <= 0) {
+                // Zero means the file shrank since it was opened.
+                finish(index, ASYNC_IO_FAILED);
+            } else {
+                request.bytes_read += (usize)cqe.res;
+                if (request.bytes_read == request.size) {
+                    finish(index, ASYNC_IO_COMPLETE);
+                } else if (submit_ring_read(index)) {
+                    // Short read, continue where it stopped.
+                    ring_in_flight++;
+                } else {
+                    finish(index, ASYNC_IO_FAILED);
+                }
+            }
+        }
+    }
+#endif
+
+    static int worker_thread(void* data) {
+        AsyncIO* io = (AsyncIO*)data;
+        PROFILE_THREAD_NAME("async-io");
+
+        SDL_LockMutex(io->mutex);
+        while (io->running) {
+            auto next = io->dequeue();
+            if (!next.has_value()) {
+                SDL_WaitCondition(io->condition, io->mutex);
+                continue;
+            }
+
+            u32 index = next.value();
+            Request& request = io->requests[index];
+            request.state = REQUEST_IN_FLIGHT;
+
+            AsyncIOStatus status = ASYNC_IO_COMPLETE;
+            while (request.bytes_read < request.size) {
+                if (request.cancelled || !io->running) {
+                    status = ASYNC_IO_CANCELLED;
+                    break;
+                }
+                SDL_UnlockMutex(io->mutex);
+
+                usize remaining = request.size - request.bytes_read;
+                usize chunk = remaining < ASYNC_IO_THREAD_CHUNK_SIZE ? remaining
+                                                                     : ASYNC_IO_THREAD_CHUNK_SIZE;
+                usize bytes;
+                {
+                    PROFILE_SCOPE("read chunk");
+                    bytes = fread(request.data + request.bytes_read, 1, chunk, request.file);
+                }
+
+                SDL_LockMutex(io->mutex);
+                request.bytes_read += bytes;
+                if (bytes != chunk) {
+                    status = ASYNC_IO_FAILED;
+                    break;
+                }
+            }
+
+            io->finish(index, status);
+        }
+        SDL_UnlockMutex(io->mutex);
+
+        return 0;
+    }
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "frame_stats.h"
+#include "lib/allocator.h"
+#include "lib/def.h"
+#include "lib/file.h"
+#include "lib/string_builder.h"
+#include "renderer.h"
+#include <SDL3/SDL.h>
+
+/// @brief One measured frame of `main bench`.
+struct BenchFrame {
+    FrameSample timing;
+    // Allocator calls (allocations and reallocations) and bytes requested during the frame.
+    u64 allocations;
+    u64 allocated_bytes;
+    RenderStats render;
+};
+
+/// @brief Per-frame results of a benchmark run, written as JSON so scripts can compare runs.
+struct BenchResults {
+    Allocator allocator;
+    BenchFrame* frames;
+    u32 frame_count;
+    u32 capacity;
+
+    string scene;
+    bool headless;
+    u32 warmup;
+
+    // Filled in once the run finishes.
+    FrameSummary summary;
+
+    static BenchResults
+    init(Allocator allocator, u32 frames, u32 warmup, string scene, bool headless) {
+        return BenchResults{
+            .allocator = allocator,
+            .frames = allocator.alloc_array<BenchFrame>(frames),
+            .frame_count = 0,
+            .capacity = frames,
+            .scene = scene,
+            .headless = headless,
+            .warmup = warmup,
+            .summary = {},
+        };
+    }
+
+    void deinit() {
+        allocator.free_array(frames, capacity);
+        frames = nullptr;
+        frame_count = 0;
+    }
+
+    void record(BenchFrame frame) {
+        if (frames && frame_count < capacity) {
+            frames[frame_count++] = frame;
+        }
+    }
+
+    void log_summary() const {
+        SDL_Log(
+            "Bench %s%s: %llu frames, avg %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, "
+            "max %.3f ms, 1%% low %.1f FPS\n",
+            scene,
+            headless ? " (headless)" : "",
+            (unsigned long long)summary.frames,
+            summary.avg_ms,
+            summary.p50_ms,
+            summary.p95_ms,
+            summary.p99_ms,
+            summary.max_ms,
+            summary.low_1_percent_fps
+        );
+        for (u32 i = 0; i < FRAME_PHASE_COUNT; i++) {
+            SDL_Log("  %-16s avg %.3f ms\n", to_string((FramePhase)i), summary.phase_avg_ms[i]);
+        }
+    }
+
+    /// @brief Writes the run settings and every frame to `filepath` as JSON.
+    /// @param temp_allocator Holds the text while it is built.
+    bool write_json(string filepath, Allocator temp_allocator) const {
+        // Roughly 200 bytes per frame, the builder grows if that is short.
+        StringBuilder json = StringBuilder::init(temp_allocator, 1024 + (usize)frame_count * 200);
+        defer { json.deinit(); };
+
+        json.format(
+            "{{\n  \"scene\": \"{}\",\n  \"headless\": {},\n  \"warmup\": {},\n",
+            scene,
+            headless,
+            warmup
+        );
+        json.format(
+            "  \"summary\": {{\"frames\": {}, \"min_ms\": {:.4}, \"avg_ms\": {:.4}, ",
+            summary.frames,
+            summary.min_ms,
+            summary.avg_ms
+        );
+        json.format(
+            "\"p50_ms\": {:.4}, \"p95_ms\": {:.4}, \"p99_ms\": {:.4}, \"max_ms\": {:.4}, ",
+            summary.p50_ms,
+            summary.p95_ms,
+            summary.p99_ms,
+            summary.max_ms
+        );
+        json.format("\"low_1_percent_fps\": {:.2}, \"phase_avg_ms\": ", summary.low_1_percent_fps);
+        append_phases(json, summary.phase_avg_ms);
+        json.append("},\n");
+
+        // Names of the entries in every `phase_avg_ms` and `phases_ms` array.
+        json.append("  \"phases\": [");
+        for (u32 i = 0; i < FRAME_PHASE_COUNT; i++) {
+            json.format("{}\"{}\"", i > 0 ? ", " : "", to_string((FramePhase)i));
+        }
+        json.append("],\n");
+
+        json.append("  \"frames\": [\n");
+        for (u32 i = 0; i < frame_count; i++) {
+            const BenchFrame& frame = frames[i];
+            f64 phases_ms[FRAME_PHASE_COUNT];
+            for (u32 phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+                phases_ms[phase] = (f64)frame.timing.phase_ns[phase] / 1e6;
+            }
+
+            json.format(
+                "    {{\"cpu_ms\": {:.4}, \"phases_ms\": ",
+                (f64)frame.timing.total_ns / 1e6
+            );
+            append_phases(json, phases_ms);
+            json.format(
+                ", \"allocations\": {}, \"allocated_bytes\": {}, ",
+                frame.allocations,
+                frame.allocated_bytes
+            );
+            json.format(
+                "\"draw_calls\": {}, \"instances\": {}, \"vertices\": {}}}{}\n",
+                frame.render.draw_calls,
+                frame.render.instances,
+                frame.render.vertices,
+                i + 1 < frame_count ? "," : ""
+            );
+        }
+        json.append("  ]\n}\n");
+
+        if (json.overflowed) return false;
+        Str text = json.finish();
+        return File::write_all(filepath, text.data, text.len);
+    }
+
+  private:
+    static void append_phases(StringBuilder& json, const f64 (&phases_ms)[FRAME_PHASE_COUNT]) {
+        json.append('[');
+        for (u32 i = 0; i < FRAME_PHASE_COUNT; i++) {
+            json.format("{}{:.4}", i > 0 ? ", " : "", phases_ms[i]);
+        }
+        json.append(']');
+    }
+};
@@ -0,0 +1,656 @@
+#pragma once
+
+#include "jobs.h"
+#include "lib/allocator.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+// Entities with the same set of components (an archetype) are stored together in fixed-size
+// chunks. A chunk holds the entity handles followed by one tightly packed column per
+// component, so a query streams through exactly the arrays it reads.
+constexpr usize ECS_CHUNK_SIZE = KB(16);
+constexpr usize ECS_CHUNK_ALIGNMENT = 64;
+// Component types per program, one bit each in a signature.
+constexpr u32 ECS_MAX_COMPONENTS = 64;
+
+typedef u64 EcsSignature;
+
+/// @brief Handle to an entity. The generation changes when the index is reused, so handles to
+/// destroyed entities stay invalid.
+struct Entity {
+    u32 index;
+    u32 generation;
+
+    bool operator==(const Entity& other) const = default;
+};
+
+constexpr Entity ENTITY_NULL = {.index = ~0u, .generation = 0};
+
+struct EcsComponentInfo {
+    u32 size;
+    u32 alignment;
+};
+
+inline std::atomic<u32> ecs_component_count = 0;
+inline EcsComponentInfo ecs_components[ECS_MAX_COMPONENTS];
+
+inline u32 ecs_register_component(u32 size, u32 alignment) {
+    u32 id = ecs_component_count.fetch_add(1);
+    if (id >= ECS_MAX_COMPONENTS) {
+        SDL_Log("Too many component types, at most %u are supported\n", ECS_MAX_COMPONENTS);
+        abort();
+    }
+    ecs_components[id] = EcsComponentInfo{.size = size, .alignment = alignment};
+    return id;
+}
+
+/// @brief Id of component type `T`, assigned on first use and shared by every World.
+template <typename T> u32 ecs_component_id() {
+    // Rows are moved between chunks with memcpy and never constructed or destroyed.
+    static_assert(std::is_trivially_copyable_v<T>, "Components must be trivially copyable");
+    static_assert(alignof(T) <= ECS_CHUNK_ALIGNMENT, "Component alignment exceeds a chunk's");
+
+    static const u32 id = ecs_register_component(sizeof(T), alignof(T));
+    return id;
+}
+
+template <typename... Ts> EcsSignature ecs_signature() {
+    return (EcsSignature{0} | ... | (EcsSignature{1} << ecs_component_id<Ts>()));
+}
+
+struct EcsChunk {
+    u8* data;
+    u32 count;
+};
+
+/// @brief Storage for every entity with one exact signature. All chunks but the last are
+/// full, so row `r` lives in chunk `r / chunk_capacity`.
+struct EcsArchetype {
+    EcsSignature signature;
+    u32 component_ids[ECS_MAX_COMPONENTS];
+    u32 component_count;
+    // Byte offset of each column in a chunk, indexed by component id. The entity handles are
+    // at offset 0.
+    u16 column_offsets[ECS_MAX_COMPONENTS];
+    u32 chunk_capacity;
+
+    ArrayList<EcsChunk> chunks;
+    u32 count;
+
+    // Archetypes one component away, filled in as entities move between them.
+    EcsArchetype* add_edges[ECS_MAX_COMPONENTS];
+    EcsArchetype* remove_edges[ECS_MAX_COMPONENTS];
+
+    bool has(u32 component) const { return (signature >> component) & 1; }
+
+    Entity* entities(const EcsChunk& chunk) const { return (Entity*)chunk.data; }
+
+    u8* column(const EcsChunk& chunk, u32 component) const {
+        return chunk.data + column_offsets[component];
+    }
+
+    /// @brief Address of `component` in row `row`.
+    u8* get(u32 row, u32 component) const {
+        const EcsChunk& chunk = chunks.items[row / chunk_capacity];
+        return column(chunk, component) + (row % chunk_capacity) * ecs_components[component].size;
+    }
+
+    Entity& entity(u32 row) const {
+        return entities(chunks.items[row / chunk_capacity])[row % chunk_capacity];
+    }
+};
+
+/// @brief The rows of one chunk that matched a query.
+struct EcsChunkView {
+    const EcsArchetype* archetype;
+    const Entity* entities;
+    u8* data;
+    u32 count;
+    // Index of the first row among every row the query visits, so parallel iteration can
+    // write its output to fixed positions.
+    u32 first;
+
+    template <typename T> T* column() const {
+        return (T*)(data + archetype->column_offsets[ecs_component_id<T>()]);
+    }
+
+    /// @brief Whether the chunk has `T`, for components a query does not require.
+    template <typename T> bool has() const { return archetype->has(ecs_component_id<T>()); }
+};
+
+enum EcsCommandType : u32 {
+    ECS_COMMAND_SPAWN,
+    // Sets a component of the entity created by the preceding spawn.
+    ECS_COMMAND_SET_SPAWNED,
+    ECS_COMMAND_DESTROY,
+    ECS_COMMAND_ADD,
+    ECS_COMMAND_REMOVE,
+};
+
+// Followed by `size` bytes of component value.
+struct EcsCommand {
+    EcsCommandType type;
+    u32 component;
+    Entity entity;
+    EcsSignature signature;
+    u32 size;
+    u32 padding;
+};
+
+/// @brief Structural changes recorded while the world must not change, during queries or in
+/// jobs, and applied later by `World::flush`. Commands are packed back to back, each header
+/// followed by its component value.
+struct EcsCommandBuffer {
+    ArrayList<u8> bytes;
+
+    static EcsCommandBuffer init() {
+        // Jobs record concurrently, each into its own buffer, so the bytes come from the
+        // page allocator rather than a shared arena.
+        return EcsCommandBuffer{.bytes = ArrayList<u8>::init(PageAllocator::init())};
+    }
+
+    void deinit() { bytes.deinit(); }
+
+    template <typename... Ts> void spawn(const Ts&... values) {
+        write(
+            EcsCommand{.type = ECS_COMMAND_SPAWN, .signature = ecs_signature<Ts...>()},
+            nullptr
+        );
+        (write_value(ECS_COMMAND_SET_SPAWNED, ENTITY_NULL, values), ...);
+    }
+
+    void destroy(Entity entity) {
+        write(EcsCommand{.type = ECS_COMMAND_DESTROY, .entity = entity}, nullptr);
+    }
+
+    template <typename T> void add(Entity entity, const T& value) {
+        write_value(ECS_COMMAND_ADD, entity, value);
+    }
+
+    template <typename T> void remove(Entity entity) {
+        write(
+            EcsCommand{
+                .type = ECS_COMMAND_REMOVE,
+                .component = ecs_component_id<T>(),
+                .entity = entity,
+            },
+            nullptr
+        );
+    }
+
+    bool is_empty() const { return bytes.len == 0; }
+
+  private:
+    template <typename T> void write_value(EcsCommandType type, Entity entity, const T& value) {
+        write(
+            EcsCommand{
+                .type = type,
+                .component = ecs_component_id<T>(),
+                .entity = entity,
+                .size = sizeof(T),
+            },
+            &value
+        );
+    }
+
+    // The bytes are not aligned for either part, both are copied in and out with memcpy.
+    void write(EcsCommand command, const void* value) {
+        usize at = bytes.len;
+        if (!bytes.resize(at + sizeof(command) + command.size)) {
+            SDL_Log("Out of memory recording an entity command\n");
+            return;
+        }
+        memcpy(bytes.items + at, &command, sizeof(command));
+        if (command.size > 0) memcpy(bytes.items + at + sizeof(command), value, command.size);
+    }
+};
+
+struct World;
+
+/// @brief Iterates every entity that has all of `Ts` and none of the excluded components.
+/// The world must not change structurally while a query runs; record changes in
+/// `World::commands` instead.
+template <typename... Ts> struct EcsQuery {
+    World* world;
+    EcsSignature include;
+    EcsSignature exclude;
+
+    template <typename T> EcsQuery without() const {
+        return EcsQuery{world, include, exclude | ecs_signature<T>()};
+    }
+
+    bool matches(const EcsArchetype* archetype) const {
+        return archetype->count > 0 && (archetype->signature & include) == include &&
+               (archetype->signature & exclude) == 0;
+    }
+
+    /// @brief Number of matching entities.
+    u32 count() const;
+
+    /// @brief Calls `fn(view)` for every matching chunk.
+    template <typename Fn> void each_chunk(Fn&& fn) const;
+
+    /// @brief Calls `fn(entity, components...)` for every matching entity.
+    template <typename Fn> void each(Fn&& fn) const {
+        each_chunk([&](const EcsChunkView& view) {
+            each_row(view, fn, view.template column<Ts>()...);
+        });
+    }
+
+    /// @brief Calls `fn(view, worker)` for every matching chunk, on the job workers.
+    template <typename Fn> void parallel_each_chunk(JobSystem& jobs, Fn&& fn) const;
+
+    /// @brief Calls `fn(entity, components..., worker)` for every matching entity, a chunk per
+    /// job.
+    template <typename Fn> void parallel_each(JobSystem& jobs, Fn&& fn) const {
+        parallel_each_chunk(jobs, [&](const EcsChunkView& view, JobWorker& worker) {
+            each_row(view, fn, worker, view.template column<Ts>()...);
+        });
+    }
+
+  private:
+    template <typename Fn> static void each_row(const EcsChunkView& view, Fn& fn, Ts*... columns) {
+        for (u32 i = 0; i < view.count; i++) {
+            fn(view.entities[i], columns[i]...);
+        }
+    }
+
+    template <typename Fn>
+    static void each_row(const EcsChunkView& view, Fn& fn, JobWorker& worker, Ts*... columns) {
+        for (u32 i = 0; i < view.count; i++) {
+            fn(view.entities[i], columns[i]..., worker);
+        }
+    }
+};
+
+struct EcsEntityRecord {
+    EcsArchetype* archetype;
+    u32 row;
+    u32 generation;
+};
+
+/// @brief Archetype-based entity-component store. Components are plain structs; entities
+/// with the same component set share an archetype, whose rows are packed into
+/// ECS_CHUNK_SIZE chunks of structure-of-arrays columns. Adding or removing a component moves
+/// the entity's row to the neighbouring archetype.
+///
+/// Structural changes (spawn, destroy, add, remove) are made on the main thread between
+/// queries, either directly or through the per-worker command buffers that `flush` applies.
+struct World {
+    Allocator allocator;
+
+    ArrayList<EcsEntityRecord> records;
+    ArrayList<u32> free_indices;
+    ArrayList<EcsArchetype*> archetypes;
+    // Emptied chunks, reused by any archetype.
+    ArrayList<u8*> free_chunks;
+    // Chunks matched by the running parallel query.
+    ArrayList<EcsChunkView> matched;
+
+    // One per job worker, indexed like JobSystem::workers.
+    EcsCommandBuffer command_buffers[JOB_MAX_WORKERS];
+
+    static World init(Allocator allocator) {
+        World world = {
+            .allocator = allocator,
+            .records = ArrayList<EcsEntityRecord>::init(allocator),
+            .free_indices = ArrayList<u32>::init(allocator),
+            .archetypes = ArrayList<EcsArchetype*>::init(allocator),
+            .free_chunks = ArrayList<u8*>::init(allocator),
+            .matched = ArrayList<EcsChunkView>::init(allocator),
+            .command_buffers = {},
+        };
+        for (auto& buffer : world.command_buffers) {
+            buffer = EcsCommandBuffer::init();
+        }
+        return world;
+    }
+
+    void deinit() {
+        for (usize i = 0; i < archetypes.len; i++) {
+            EcsArchetype* archetype = archetypes.items[i];
+            for (usize c = 0; c < archetype->chunks.len; c++) {
+                free_chunk(archetype->chunks.items[c].data);
+            }
+            archetype->chunks.deinit();
+            allocator.destroy(archetype);
+        }
+        for (usize i = 0; i < free_chunks.len; i++) {
+            allocator.free(free_chunks.items[i], ECS_CHUNK_SIZE, ECS_CHUNK_ALIGNMENT);
+        }
+        for (auto& buffer : command_buffers) {
+            buffer.deinit();
+        }
+        records.deinit();
+        free_indices.deinit();
+        archetypes.deinit();
+        free_chunks.deinit();
+        matched.deinit();
+    }
+
+    /// @brief Number of live entities.
+    u32 entity_count() const { return (u32)(records.len - free_indices.len); }
+
+    bool is_alive(Entity entity) const {
+        return entity.index < records.len && records.items[entity.index].archetype &&
+               records.items[entity.index].generation == entity.generation;
+    }
+
+    /// @brief Creates an entity with `values` as its components.
+    template <typename... Ts> Entity spawn(const Ts&... values) {
+        Entity entity = spawn_empty(ecs_signature<Ts...>());
+        if (entity == ENTITY_NULL) return entity;
+
+        const EcsEntityRecord& record = records.items[entity.index];
+        ((memcpy(
+             record.archetype->get(record.row, ecs_component_id<Ts>()),
+             &values,
+             sizeof(Ts)
+         )),
+         ...);
+        return entity;
+    }
+
+    void destroy(Entity entity) {
+        if (!is_alive(entity)) return;
+
+        EcsEntityRecord& record = records.items[entity.index];
+        remove_row(record.archetype, record.row);
+        record.archetype = nullptr;
+        record.generation++;
+        free_indices.append(entity.index);
+    }
+
+    template <typename T> T* get(Entity entity) {
+        return (T*)get_component(entity, ecs_component_id<T>());
+    }
+
+    template <typename T> bool has(Entity entity) const {
+        return is_alive(entity) &&
+               records.items[entity.index].archetype->has(ecs_component_id<T>());
+    }
+
+    /// @brief Adds `value` to `entity`, or overwrites the component it already has.
+    template <typename T> void add(Entity entity, const T& value) {
+        add_component(entity, ecs_component_id<T>(), &value);
+    }
+
+    template <typename T> void remove(Entity entity) {
+        remove_component(entity, ecs_component_id<T>());
+    }
+
+    template <typename... Ts> EcsQuery<Ts...> query() {
+        return EcsQuery<Ts...>{this, ecs_signature<Ts...>(), 0};
+    }
+
+    /// @brief Command buffer of the calling job worker, or of the main thread outside jobs.
+    EcsCommandBuffer& commands() { return command_buffers[job_worker ? job_worker->index : 0]; }
+
+    /// @brief Applies every recorded command, worker by worker in recording order. Commands on
+    /// entities destroyed meanwhile are dropped. Main thread only, while no query runs.
+    void flush() {
+        for (auto& buffer : command_buffers) {
+            if (buffer.is_empty()) continue;
+
+            Entity spawned = ENTITY_NULL;
+            usize at = 0;
+            while (at < buffer.bytes.len) {
+                EcsCommand command;
+                memcpy(&command, buffer.bytes.items + at, sizeof(command));
+                const u8* value = buffer.bytes.items + at + sizeof(command);
+                at += sizeof(command) + command.size;
+
+                switch (command.type) {
+                    case ECS_COMMAND_SPAWN:
+                        spawned = spawn_empty(command.signature);
+                        break;
+                    case ECS_COMMAND_SET_SPAWNED:
+                        add_component(spawned, command.component, value);
+                        break;
+                    case ECS_COMMAND_DESTROY:
+                        destroy(command.entity);
+                        break;
+                    case ECS_COMMAND_ADD:
+                        add_component(command.entity, command.component, value);
+                        break;
+                    case ECS_COMMAND_REMOVE:
+                        remove_component(command.entity, command.component);
+                        break;
+                }
+            }
+            buffer.bytes.len = 0;
+        }
+    }
+
+    void* get_component(Entity entity, u32 component) {
+        if (!is_alive(entity)) return nullptr;
+
+        const EcsEntityRecord& record = records.items[entity.index];
+        if (!record.archetype->has(component)) return nullptr;
+        return record.archetype->get(record.row, component);
+    }
+
+    void add_component(Entity entity, u32 component, const void* value) {
+        if (!is_alive(entity)) return;
+
+        EcsEntityRecord& record = records.items[entity.index];
+        if (!record.archetype->has(component)) {
+            EcsArchetype* from = record.archetype;
+            EcsArchetype* to = from->add_edges[component];
+            if (!to) {
+                to = find_archetype(from->signature | (EcsSignature{1} << component));
+                if (!to) return;
+                from->add_edges[component] = to;
+            }
+            if (!move_entity(entity, to)) return;
+        }
+        memcpy(
+            record.archetype->get(record.row, component),
+            value,
+            ecs_components[component].size
+        );
+    }
+
+    void remove_component(Entity entity, u32 component) {
+        if (!is_alive(entity)) return;
+
+        EcsEntityRecord& record = records.items[entity.index];
+        EcsArchetype* from = record.archetype;
+        if (!from->has(component)) return;
+
+        EcsArchetype* to = from->remove_edges[component];
+        if (!to) {
+            to = find_archetype(from->signature & ~(EcsSignature{1} << component));
+            if (!to) return;
+            from->remove_edges[component] = to;
+        }
+        move_entity(entity, to);
+    }
+
+    /// @brief Creates an entity with the components of `signature`, left uninitialized.
+    Entity spawn_empty(EcsSignature signature) {
+        EcsArchetype* archetype = find_archetype(signature);
+        if (!archetype) return ENTITY_NULL;
+
+        u32 index;
+        if (free_indices.len > 0) {
+            index = free_indices.items[--free_indices.len];
+        } else {
+            index = (u32)records.len;
+            if (!records.append(EcsEntityRecord{.archetype = nullptr, .row = 0, .generation = 0})) {
+                return ENTITY_NULL;
+            }
+        }
+
+        EcsEntityRecord& record = records.items[index];
+        Entity entity = {.index = index, .generation = record.generation};
+        if (!push_row(archetype, entity, &record.row)) {
+            free_indices.append(index);
+            return ENTITY_NULL;
+        }
+        record.archetype = archetype;
+        return entity;
+    }
+
+  private:
+    EcsArchetype* find_archetype(EcsSignature signature) {
+        // Few archetypes exist and lookups are cached in the edges, a scan is enough.
+        for (usize i = 0; i < archetypes.len; i++) {
+            if (archetypes.items[i]->signature == signature) return archetypes.items[i];
+        }
+
+        EcsArchetype* archetype = allocator.create<EcsArchetype>();
+        if (!archetype) return nullptr;
+        *archetype = {};
+        archetype->signature = signature;
+        archetype->chunks = ArrayList<EcsChunk>::init(allocator);
+
+        usize row_size = sizeof(Entity);
+        for (u32 id = 0; id < ECS_MAX_COMPONENTS; id++) {
+            if (!archetype->has(id)) continue;
+            archetype->component_ids[archetype->component_count++] = id;
+            row_size += ecs_components[id].size;
+        }
+
+        // Columns are aligned, so padding may push the last one out of the chunk; shrink
+        // until everything fits.
+        u32 capacity = (u32)(ECS_CHUNK_SIZE / row_size);
+        while (true) {
+            usize offset = sizeof(Entity) * capacity;
+            for (u32 i = 0; i < archetype->component_count; i++) {
+                const EcsComponentInfo& info = ecs_components[archetype->component_ids[i]];
+                offset = (offset + info.alignment - 1) & ~((usize)info.alignment - 1);
+                archetype->column_offsets[archetype->component_ids[i]] = (u16)offset;
+                offset += (usize)info.size * capacity;
+            }
+            if (offset <= ECS_CHUNK_SIZE) break;
+            capacity--;
+        }
+        archetype->chunk_capacity = capacity;
+
+        if (capacity == 0 || !archetypes.append(archetype)) {
+            SDL_Log("Components %llx do not fit a chunk\n", (unsigned long long)signature);
+            archetype->chunks.deinit();
+            allocator.destroy(archetype);
+            return nullptr;
+        }
+        return archetype;
+    }
+
+    u8* alloc_chunk() {
+        if (free_chunks.len > 0) return free_chunks.items[--free_chunks.len];
+        return (u8*)allocator.alloc(ECS_CHUNK_SIZE, ECS_CHUNK_ALIGNMENT);
+    }
+
+    void free_chunk(u8* data) {
+        if (!free_chunks.append(data)) allocator.free(data, ECS_CHUNK_SIZE, ECS_CHUNK_ALIGNMENT);
+    }
+
+    bool push_row(EcsArchetype* archetype, Entity entity, u32* row) {
+        if (archetype->count == archetype->chunks.len * archetype->chunk_capacity) {
+            u8* data = alloc_chunk();
+            if (!data) return false;
+            if (!archetype->chunks.append(EcsChunk{.data = data, .count = 0})) {
+                free_chunk(data);
+                return false;
+            }
+        }
+
+        *row = archetype->count++;
+        archetype->chunks.items[archetype->chunks.len - 1].count++;
+        archetype->entity(*row) = entity;
+        return true;
+    }
+
+    /// @brief Fills the hole at `row` with the archetype's last row.
+    void remove_row(EcsArchetype* archetype, u32 row) {
+        u32 last = archetype->count - 1;
+        if (row != last) {
+            Entity moved = archetype->entity(last);
+            archetype->entity(row) = moved;
+            for (u32 i = 0; i < archetype->component_count; i++) {
+                u32 id = archetype->component_ids[i];
+                memcpy(archetype->get(row, id), archetype->get(last, id), ecs_components[id].size);
+            }
+            records.items[moved.index].row = row;
+        }
+
+        archetype->count--;
+        EcsChunk& chunk = archetype->chunks.items[archetype->chunks.len - 1];
+        if (--chunk.count == 0) {
+            free_chunk(chunk.data);
+            archetype->chunks.len--;
+        }
+    }
+
+    /// @brief Moves `entity` to archetype `to`, keeping the components both have.
+    bool move_entity(Entity entity, EcsArchetype* to) {
+        EcsEntityRecord& record = records.items[entity.index];
+        EcsArchetype* from = record.archetype;
+
+        u32 row;
+        if (!push_row(to, entity, &row)) return false;
+        for (u32 i = 0; i < from->component_count; i++) {
+            u32 id = from->component_ids[i];
+            if (to->has(id)) {
+                memcpy(to->get(row, id), from->get(record.row, id), ecs_components[id].size);
+            }
+        }
+
+        remove_row(from, record.row);
+        record.archetype = to;
+        record.row = row;
+        return true;
+    }
+};
+
+template <typename... Ts> u32 EcsQuery<Ts...>::count() const {
+    u32 total = 0;
+    for (usize i = 0; i < world->archetypes.len; i++) {
+        const EcsArchetype* archetype = world->archetypes.items[i];
+        if (matches(archetype)) total += archetype->count;
+    }
+    return total;
+}
+
+template <typename... Ts>
+template <typename Fn>
+void EcsQuery<Ts...>::each_chunk(Fn&& fn) const {
+    u32 first = 0;
+    for (usize i = 0; i < world->archetypes.len; i++) {
+        const EcsArchetype* archetype = world->archetypes.items[i];
+        if (!matches(archetype)) continue;
+
+        for (usize c = 0; c < archetype->chunks.len; c++) {
+            const EcsChunk& chunk = archetype->chunks.items[c];
+            EcsChunkView view = {
+                .archetype = archetype,
+                .entities = archetype->entities(chunk),
+                .data = chunk.data,
+                .count = chunk.count,
+                .first = first,
+            };
+            fn(view);
+            first += chunk.count;
+        }
+    }
+}
+
+template <typename... Ts>
+template <typename Fn>
+void EcsQuery<Ts...>::parallel_each_chunk(JobSystem& jobs, Fn&& fn) const {
+    // Not reentrant: one parallel query at a time, started from the main thread.
+    ArrayList<EcsChunkView>& matched = world->matched;
+    matched.len = 0;
+    each_chunk([&](const EcsChunkView& view) { matched.append(view); });
+
+    jobs.parallel_for(matched, 1, [&](std::span<EcsChunkView> views, JobWorker& worker) {
+        for (const EcsChunkView& view : views) {
+            fn(view, worker);
+        }
+    });
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "lib/def.h"
+#include "profiler.h"
+#include <SDL3/SDL.h>
+#include <optional>
+
+constexpr u32 FRAMES_IN_FLIGHT = 3;
+
+/// @brief A sub-range of the current frame's transfer buffer, mapped for writing.
+struct FrameUpload {
+    SDL_GPUTransferBuffer* transfer_buffer;
+    u32 offset;
+    void* data;
+};
+
+/// @brief Resources owned by one frame slot. They are only reused once the fence of the
+/// frame that last used them has signalled.
+struct FrameResources {
+    SDL_GPUFence* fence;
+    SDL_GPUTransferBuffer* transfer_buffer;
+    u8* mapped;
+    u32 upload_offset;
+};
+
+/// @brief Ring of FRAMES_IN_FLIGHT frames so the CPU can record frame N+1 while the GPU is
+/// still executing frame N. Each frame is `begin_frame` -> `acquire_swapchain` / `upload`
+/// -> `submit`.
+struct FrameRing {
+    SDL_GPUDevice* device;
+    FrameResources frames[FRAMES_IN_FLIGHT];
+    u32 transfer_buffer_size;
+
+    // Slot of the frame being recorded, use it to index per-frame resources.
+    u32 frame_index;
+    // Number of frames submitted so far, also the number of the frame being recorded.
+    u64 frame_number;
+    // Every frame numbered below this has finished executing on the GPU.
+    u64 frames_completed;
+
+    static std::optional<FrameRing> init(SDL_GPUDevice* device, u32 transfer_buffer_size) {
+        FrameRing ring = {
+            .device = device,
+            .frames = {},
+            .transfer_buffer_size = transfer_buffer_size,
+            .frame_index = 0,
+            .frame_number = 0,
+            .frames_completed = 0,
+        };
+
+        for (u32 i = 0; i < FRAMES_IN_FLIGHT; i++) {
+            ring.frames[i].transfer_buffer = SDL_CreateGPUTransferBuffer(
+                device,
+                &(SDL_GPUTransferBufferCreateInfo){
+                    .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+                    .size = transfer_buffer_size,
+                }
+            );
+
+            if (!ring.frames[i].transfer_buffer) {
+                SDL_Log("Failed to create frame transfer buffer %s\n", SDL_GetError());
+                ring.deinit();
+                return std::nullopt;
+            }
+        }
+
+        if (!SDL_SetGPUAllowedFramesInFlight(device, FRAMES_IN_FLIGHT)) {
+            SDL_Log("Failed to set frames in flight %s\n", SDL_GetError());
+        }
+
+        return ring;
+    }
+
+    void deinit() {
+        for (u32 i = 0; i < FRAMES_IN_FLIGHT; i++) {
+            FrameResources& frame = frames[i];
+
+            if (frame.fence) {
+                SDL_WaitForGPUFences(device, true, &frame.fence, 1);
+                SDL_ReleaseGPUFence(device, frame.fence);
+                frame.fence = nullptr;
+            }
+
+            if (frame.mapped) {
+                SDL_UnmapGPUTransferBuffer(device, frame.transfer_buffer);
+                frame.mapped = nullptr;
+            }
+
+            if (frame.transfer_buffer) {
+                SDL_ReleaseGPUTransferBuffer(device, frame.transfer_buffer);
+                frame.transfer_buffer = nullptr;
+            }
+        }
+    }
+
+    FrameResources& current() { return frames[frame_index]; }
+
+    /// @brief Blocks until the GPU is done with the frame that last used this slot, which is
+    /// FRAMES_IN_FLIGHT frames ago, then recycles the slot's resources.
+    void begin_frame() {
+        PROFILE_SCOPE("wait frame fence");
+        FrameResources& frame = current();
+
+        if (frame.fence) {
+            SDL_WaitForGPUFences(device, true, &frame.fence, 1);
+            SDL_ReleaseGPUFence(device, frame.fence);
+            frame.fence = nullptr;
+
+            // Submissions complete in order, so everything up to the slot's last frame is done.
+            frames_completed = frame_number - FRAMES_IN_FLIGHT + 1;
+        }
+
+        frame.upload_offset = 0;
+    }
+
+    /// @brief True when a previously submitted frame has not finished on the GPU yet.
+    bool cpu_ahead() {
+        for (u32 i = 0; i < FRAMES_IN_FLIGHT; i++) {
+            if (i == frame_index) continue;
+            if (frames[i].fence && !SDL_QueryGPUFence(device, frames[i].fence)) return true;
+        }
+
+        return false;
+    }
+
+    /// @brief Acquires the swapchain texture. When the CPU is ahead of the GPU the non-blocking
+    /// acquire is used, so `texture` may be null and the frame should skip drawing.
+    bool acquire_swapchain(
+        SDL_GPUCommandBuffer* cmdbuf,
+        SDL_Window* window,
+        SDL_GPUTexture** texture
+    ) {
+        PROFILE_SCOPE("acquire swapchain");
+        if (cpu_ahead()) {
+            return SDL_AcquireGPUSwapchainTexture(cmdbuf, window, texture, nullptr, nullptr);
+        }
+
+        return SDL_WaitAndAcquireGPUSwapchainTexture(cmdbuf, window, texture, nullptr, nullptr);
+    }
+
+    /// @brief Sub-allocates `size` bytes from this frame's transfer buffer. The memory stays
+    /// valid for writing until `submit`.
+    std::optional<FrameUpload> upload(u32 size, u32 alignment = 16) {
+        FrameResources& frame = current();
+
+        u32 offset = (frame.upload_offset + alignment - 1) & ~(alignment - 1);
+        if (offset + size > transfer_buffer_size) {
+            SDL_Log("Frame transfer buffer exhausted (%u bytes requested)\n", size);
+            return std::nullopt;
+        }
+
+        if (!frame.mapped) {
+            // The slot's fence has signalled, so there is no need to cycle.
+            frame.mapped = (u8*)SDL_MapGPUTransferBuffer(device, frame.transfer_buffer, false);
+            if (!frame.mapped) {
+                SDL_Log("Failed to map frame transfer buffer %s\n", SDL_GetError());
+                return std::nullopt;
+            }
+        }
+
+        frame.upload_offset = offset + size;
+
+        return FrameUpload{
+            .transfer_buffer = frame.transfer_buffer,
+            .offset = offset,
+            .data = frame.mapped + offset,
+        };
+    }
+
+    /// @brief Submits the frame with a fence guarding its resources and advances the ring.
+    bool submit(SDL_GPUCommandBuffer* cmdbuf) {
+        PROFILE_SCOPE("submit");
+        FrameResources& frame = current();
+
+        if (frame.mapped) {
+            SDL_UnmapGPUTransferBuffer(device, frame.transfer_buffer);
+            frame.mapped = nullptr;
+        }
+
+        frame.fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdbuf);
+        frame_index = (frame_index + 1) % FRAMES_IN_FLIGHT;
+        frame_number++;
+
+        if (!frame.fence) {
+            SDL_Log("Failed to submit command buffer %s\n", SDL_GetError());
+            return false;
+        }
+
+        return true;
+    }
+};
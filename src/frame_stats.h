@@ -0,0 +1,292 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/def.h"
+#include <SDL3/SDL.h>
+
+/// @brief Parts of a frame, in the order the main loop runs them.
+enum FramePhase {
+    FRAME_PHASE_EVENTS,
+    FRAME_PHASE_UPDATE,
+    // Waiting for a frame slot and a swapchain image.
+    FRAME_PHASE_PRESENT_WAIT,
+    FRAME_PHASE_RENDER_RECORD,
+    FRAME_PHASE_SUBMIT,
+    FRAME_PHASE_COUNT,
+};
+
+constexpr string to_string(FramePhase phase) {
+    switch (phase) {
+        case FRAME_PHASE_EVENTS:
+            return "events";
+        case FRAME_PHASE_UPDATE:
+            return "update";
+        case FRAME_PHASE_PRESENT_WAIT:
+            return "present_wait";
+        case FRAME_PHASE_RENDER_RECORD:
+            return "render_record";
+        case FRAME_PHASE_SUBMIT:
+            return "submit";
+        default:
+            return "unknown";
+    }
+}
+
+// Log-linear buckets like HdrHistogram: values below 2^FRAME_HISTOGRAM_SUB_BITS get a bucket
+// each, every power of two above that is split into 2^(SUB_BITS - 1) equal buckets. With 6
+// bits the bucket width stays under 1/32 of the value, so percentiles are within ~3%.
+constexpr u32 FRAME_HISTOGRAM_SUB_BITS = 6;
+constexpr u32 FRAME_HISTOGRAM_HALF = 1u << (FRAME_HISTOGRAM_SUB_BITS - 1);
+// Nanosecond values up to 2^40 (about 18 minutes), longer frames land in the last bucket.
+constexpr u32 FRAME_HISTOGRAM_MAX_BITS = 40;
+constexpr u32 FRAME_HISTOGRAM_BUCKETS =
+    (FRAME_HISTOGRAM_MAX_BITS - FRAME_HISTOGRAM_SUB_BITS + 2) * FRAME_HISTOGRAM_HALF;
+
+/// @brief Fixed-size histogram of frame times in nanoseconds. Recording is a couple of bit
+/// operations and an increment, percentiles walk the buckets.
+struct FrameHistogram {
+    u32 counts[FRAME_HISTOGRAM_BUCKETS];
+    u64 count;
+    u64 sum_ns;
+    u64 min_ns;
+    u64 max_ns;
+
+    void reset() {
+        memset(counts, 0, sizeof(counts));
+        count = 0;
+        sum_ns = 0;
+        min_ns = 0;
+        max_ns = 0;
+    }
+
+    void record(u64 value_ns) {
+        counts[bucket_index(value_ns)]++;
+        min_ns = count == 0 || value_ns < min_ns ? value_ns : min_ns;
+        max_ns = value_ns > max_ns ? value_ns : max_ns;
+        sum_ns += value_ns;
+        count++;
+    }
+
+    /// @brief Smallest recorded value that `percentile` percent of the values are at or below,
+    /// up to the bucket width. Reported as the bucket's upper edge so it never understates.
+    u64 percentile_ns(f64 percentile) const {
+        if (count == 0) return 0;
+
+        u64 target = (u64)(percentile / 100.0 * (f64)count + 0.5);
+        if (target < 1) target = 1;
+
+        u64 seen = 0;
+        for (u32 i = 0; i < FRAME_HISTOGRAM_BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= target) {
+                u64 upper = bucket_upper(i);
+                return upper < max_ns ? upper : max_ns;
+            }
+        }
+        return max_ns;
+    }
+
+    /// @brief Mean of the slowest `percent` percent of the values, from bucket midpoints.
+    f64 slowest_mean_ns(f64 percent) const {
+        if (count == 0) return 0.0;
+
+        u64 wanted = (u64)(percent / 100.0 * (f64)count);
+        if (wanted < 1) wanted = 1;
+
+        u64 taken = 0;
+        f64 sum = 0.0;
+        for (u32 i = FRAME_HISTOGRAM_BUCKETS; i > 0 && taken < wanted; i--) {
+            u64 take = counts[i - 1] < wanted - taken ? counts[i - 1] : wanted - taken;
+            sum += (f64)take * 0.5 * (f64)(bucket_lower(i - 1) + bucket_upper(i - 1));
+            taken += take;
+        }
+        return sum / (f64)taken;
+    }
+
+    static u32 bucket_index(u64 value) {
+        if (value < 2 * FRAME_HISTOGRAM_HALF) return (u32)value;
+
+        u32 msb = 63 - (u32)__builtin_clzll(value);
+        if (msb >= FRAME_HISTOGRAM_MAX_BITS) return FRAME_HISTOGRAM_BUCKETS - 1;
+
+        u32 shift = msb - FRAME_HISTOGRAM_SUB_BITS + 1;
+        u32 sub = (u32)(value >> shift);
+        return (shift + 1) * FRAME_HISTOGRAM_HALF + (sub - FRAME_HISTOGRAM_HALF);
+    }
+
+    static u64 bucket_lower(u32 index) {
+        if (index < 2 * FRAME_HISTOGRAM_HALF) return index;
+
+        u32 shift = index / FRAME_HISTOGRAM_HALF - 1;
+        u64 sub = index % FRAME_HISTOGRAM_HALF + FRAME_HISTOGRAM_HALF;
+        return sub << shift;
+    }
+
+    static u64 bucket_upper(u32 index) {
+        if (index < 2 * FRAME_HISTOGRAM_HALF) return index;
+
+        u32 shift = index / FRAME_HISTOGRAM_HALF - 1;
+        return bucket_lower(index) + ((u64)1 << shift) - 1;
+    }
+};
+
+/// @brief Time of one frame, total and per phase.
+struct FrameSample {
+    u64 total_ns;
+    u64 phase_ns[FRAME_PHASE_COUNT];
+};
+
+struct FrameSummary {
+    u64 frames;
+    f64 min_ms;
+    f64 avg_ms;
+    f64 p50_ms;
+    f64 p95_ms;
+    f64 p99_ms;
+    f64 max_ms;
+    // Frame rate over the slowest 1% of frames.
+    f64 low_1_percent_fps;
+    f64 phase_avg_ms[FRAME_PHASE_COUNT];
+};
+
+/// @brief Per-frame CPU timing. The last `capacity` frames are kept in a ring for rolling
+/// windows, and every frame since `reset` goes into a histogram for whole-run percentiles.
+///
+/// Each frame is `begin_frame`, then `end_phase` at every phase boundary, then `end_frame`.
+/// A phase gets the time since the previous boundary, so phases need no begin call and
+/// skipped phases simply read zero.
+struct FrameStats {
+    Allocator allocator;
+
+    FrameSample* samples;
+    u32 capacity;
+    u32 count;
+    u32 next;
+
+    FrameHistogram* histogram;
+    u64 phase_total_ns[FRAME_PHASE_COUNT];
+
+    f64 ns_per_tick;
+    u64 frame_start;
+    u64 phase_start;
+    FrameSample current;
+    bool in_frame;
+
+    static FrameStats init(Allocator allocator, u32 capacity = 1024) {
+        FrameStats stats = {
+            .allocator = allocator,
+            .samples = allocator.alloc_array<FrameSample>(capacity),
+            .capacity = capacity,
+            .count = 0,
+            .next = 0,
+            .histogram = allocator.create<FrameHistogram>(),
+            .phase_total_ns = {},
+            .ns_per_tick = 1e9 / (f64)SDL_GetPerformanceFrequency(),
+            .frame_start = 0,
+            .phase_start = 0,
+            .current = {},
+            .in_frame = false,
+        };
+        stats.reset();
+        return stats;
+    }
+
+    void deinit() {
+        allocator.free_array(samples, capacity);
+        allocator.destroy(histogram);
+        samples = nullptr;
+        histogram = nullptr;
+    }
+
+    /// @brief Forgets every recorded frame, e.g. after warm-up.
+    void reset() {
+        count = 0;
+        next = 0;
+        histogram->reset();
+        for (u32 i = 0; i < FRAME_PHASE_COUNT; i++) {
+            phase_total_ns[i] = 0;
+        }
+    }
+
+    void begin_frame() {
+        frame_start = SDL_GetPerformanceCounter();
+        phase_start = frame_start;
+        current = {};
+        in_frame = true;
+    }
+
+    /// @brief Adds the time since the previous boundary to `phase`.
+    void end_phase(FramePhase phase) {
+        if (!in_frame) return;
+
+        u64 now = SDL_GetPerformanceCounter();
+        current.phase_ns[phase] += to_ns(now - phase_start);
+        phase_start = now;
+    }
+
+    /// @brief Records the frame. Time after the last phase boundary counts towards the total
+    /// but no phase.
+    const FrameSample& end_frame() {
+        u64 now = SDL_GetPerformanceCounter();
+        current.total_ns = to_ns(now - frame_start);
+        in_frame = false;
+
+        samples[next] = current;
+        next = (next + 1) % capacity;
+        count = count < capacity ? count + 1 : capacity;
+
+        histogram->record(current.total_ns);
+        for (u32 i = 0; i < FRAME_PHASE_COUNT; i++) {
+            phase_total_ns[i] += current.phase_ns[i];
+        }
+
+        return current;
+    }
+
+    /// @brief Statistics over the last `frames` frames of the ring.
+    FrameSummary summarize(u32 frames) const {
+        if (frames > count) frames = count;
+
+        FrameHistogram window;
+        window.reset();
+        u64 phase_ns[FRAME_PHASE_COUNT] = {};
+        for (u32 i = 0; i < frames; i++) {
+            const FrameSample& sample = samples[(next + capacity - 1 - i) % capacity];
+            window.record(sample.total_ns);
+            for (u32 phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+                phase_ns[phase] += sample.phase_ns[phase];
+            }
+        }
+
+        return summary_of(window, phase_ns);
+    }
+
+    /// @brief Statistics over every frame since the last `reset`.
+    FrameSummary summarize_all() const { return summary_of(*histogram, phase_total_ns); }
+
+  private:
+    u64 to_ns(u64 ticks) const { return (u64)((f64)ticks * ns_per_tick); }
+
+    static FrameSummary
+    summary_of(const FrameHistogram& histogram, const u64 (&phase_ns)[FRAME_PHASE_COUNT]) {
+        FrameSummary summary = {};
+        summary.frames = histogram.count;
+        if (histogram.count == 0) return summary;
+
+        auto ms = [](f64 ns) { return ns / 1e6; };
+        summary.min_ms = ms((f64)histogram.min_ns);
+        summary.avg_ms = ms((f64)histogram.sum_ns / (f64)histogram.count);
+        summary.p50_ms = ms((f64)histogram.percentile_ns(50.0));
+        summary.p95_ms = ms((f64)histogram.percentile_ns(95.0));
+        summary.p99_ms = ms((f64)histogram.percentile_ns(99.0));
+        summary.max_ms = ms((f64)histogram.max_ns);
+
+        f64 slowest_ms = ms(histogram.slowest_mean_ns(1.0));
+        summary.low_1_percent_fps = slowest_ms > 0.0 ? 1000.0 / slowest_ms : 0.0;
+
+        for (u32 i = 0; i < FRAME_PHASE_COUNT; i++) {
+            summary.phase_avg_ms[i] = ms((f64)phase_ns[i] / (f64)histogram.count);
+        }
+        return summary;
+    }
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/def.h"
+#include "lib/offset_allocator.h"
+#include <SDL3/SDL.h>
+#include <optional>
+
+/// @brief A range inside a GPUBufferHeap. Offsets and sizes are in bytes.
+struct GPUBufferRange {
+    SDL_GPUBuffer* buffer;
+    u32 offset;
+    u32 size;
+    OffsetAllocation allocation;
+};
+
+/// @brief Free space of a GPUBufferHeap, in bytes. Wider than OffsetAllocatorReport, whose
+/// counts are in units of the granularity.
+struct GPUBufferHeapReport {
+    u64 total_free;
+    u64 largest_free;
+    u32 free_regions;
+    f32 fragmentation;
+};
+
+/// @brief One large SDL_GPUBuffer shared by many meshes. Ranges are handed out by an
+/// OffsetAllocator in units of `granularity` bytes, so every range is aligned to it.
+/// Everything in the heap can be drawn with a single buffer binding.
+struct GPUBufferHeap {
+    SDL_GPUDevice* device;
+    SDL_GPUBuffer* buffer;
+    u32 granularity;
+    OffsetAllocator ranges;
+
+    static std::optional<GPUBufferHeap> init(
+        Allocator allocator,
+        SDL_GPUDevice* device,
+        SDL_GPUBufferUsageFlags usage,
+        u32 size,
+        u32 granularity,
+        u32 max_allocations = 16 * 1024
+    ) {
+        OffsetAllocator ranges =
+            OffsetAllocator::init(allocator, size / granularity, max_allocations);
+        if (!ranges.nodes || !ranges.free_nodes) {
+            SDL_Log("Failed to allocate heap bookkeeping for %u ranges\n", max_allocations);
+            ranges.deinit();
+            return std::nullopt;
+        }
+
+        SDL_GPUBuffer* buffer = SDL_CreateGPUBuffer(
+            device,
+            &(SDL_GPUBufferCreateInfo){
+                .usage = usage,
+                .size = size,
+            }
+        );
+        if (!buffer) {
+            SDL_Log("Failed to create heap buffer %s\n", SDL_GetError());
+            ranges.deinit();
+            return std::nullopt;
+        }
+
+        return GPUBufferHeap{
+            .device = device,
+            .buffer = buffer,
+            .granularity = granularity,
+            .ranges = ranges,
+        };
+    }
+
+    void deinit() {
+        ranges.deinit();
+        SDL_ReleaseGPUBuffer(device, buffer);
+        buffer = nullptr;
+    }
+
+    std::optional<GPUBufferRange> allocate(u32 size) {
+        u32 units = (size + granularity - 1) / granularity;
+
+        auto allocation = ranges.allocate(units);
+        if (!allocation.has_value()) {
+            SDL_Log("GPU heap out of space (%u bytes requested)\n", size);
+            return std::nullopt;
+        }
+
+        return GPUBufferRange{
+            .buffer = buffer,
+            .offset = allocation->offset * granularity,
+            .size = size,
+            .allocation = allocation.value(),
+        };
+    }
+
+    void free(GPUBufferRange range) { ranges.free(range.allocation); }
+
+    /// @brief Free space in bytes. A high `fragmentation` means a defragmenting copy would
+    /// recover large contiguous ranges.
+    GPUBufferHeapReport report() const {
+        OffsetAllocatorReport units = ranges.storage_report();
+        return GPUBufferHeapReport{
+            .total_free = (u64)units.total_free * granularity,
+            .largest_free = (u64)units.largest_free * granularity,
+            .free_regions = units.free_regions,
+            .fragmentation = units.fragmentation,
+        };
+    }
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include "lib/file.h"
+#include <SDL3/SDL.h>
+#include <bit>
+#include <cstring>
+#include <optional>
+
+// Input log layout, all integers little endian:
+//
+//   InputLogHeader
+//   InputLogRecord[record_count]   in frame order, events of one frame in the order they came
+//
+// Only the events the game reacts to are kept, so a log replays the same frames exactly.
+
+constexpr u32 INPUT_LOG_MAGIC = 0x31474C49; // "ILG1"
+constexpr u32 INPUT_LOG_VERSION = 1;
+
+enum InputEventType : u8 {
+    INPUT_EVENT_QUIT,
+    INPUT_EVENT_KEY_DOWN,
+    INPUT_EVENT_KEY_UP,
+    INPUT_EVENT_WINDOW_RESIZED,
+    INPUT_EVENT_TYPE_COUNT,
+};
+
+enum InputEventFlags : u8 {
+    INPUT_EVENT_REPEAT = 1 << 0,
+};
+
+struct InputLogHeader {
+    u32 magic;
+    u32 version;
+    u32 record_count;
+    // Frames the recording ran for, replay stops after the last one.
+    u32 frame_count;
+};
+
+struct InputLogRecord {
+    u32 frame;
+    InputEventType type;
+    u8 flags;
+    u16 modifiers;
+    // Keycode and scancode for keys, the new size for resizes.
+    i32 data1;
+    i32 data2;
+};
+
+static_assert(sizeof(InputLogHeader) == 16, "InputLogHeader layout is part of the file format");
+static_assert(sizeof(InputLogRecord) == 16, "InputLogRecord layout is part of the file format");
+// Headers and records are copied to and from the file as they are in memory.
+static_assert(std::endian::native == std::endian::little, "Input logs are little endian");
+
+/// @brief SDL events tagged with the frame they were handled on. Recorded while playing and
+/// replayed into the same frames later, so perf runs do not depend on who is playing.
+struct InputLog {
+    ArrayList<InputLogRecord> records;
+    u32 frame_count;
+    // Next record to replay.
+    usize cursor;
+
+    static InputLog init(Allocator allocator) {
+        return InputLog{
+            .records = ArrayList<InputLogRecord>::init(allocator),
+            .frame_count = 0,
+            .cursor = 0,
+        };
+    }
+
+    void deinit() { records.deinit(); }
+
+    /// @brief Reads and validates the log at `filepath`
+    /// @return The log, ready to replay, or nullopt if the file is missing or malformed,
+    /// including records of a type this build does not know
+    static std::optional<InputLog> load(Allocator allocator, string filepath) {
+        auto file = File::read_all(allocator, filepath);
+        if (!file.has_value()) return std::nullopt;
+        defer { file->deinit(); };
+
+        if (file->size < sizeof(InputLogHeader)) return std::nullopt;
+        InputLogHeader header;
+        memcpy(&header, file->data, sizeof(header));
+        if (header.magic != INPUT_LOG_MAGIC || header.version != INPUT_LOG_VERSION) {
+            return std::nullopt;
+        }
+        if (file->size != sizeof(header) + (usize)header.record_count * sizeof(InputLogRecord)) {
+            return std::nullopt;
+        }
+
+        InputLog log = init(allocator);
+        log.frame_count = header.frame_count;
+        if (!log.records.resize(header.record_count)) {
+            log.deinit();
+            return std::nullopt;
+        }
+        if (header.record_count > 0) {
+            memcpy(
+                log.records.items,
+                file->data + sizeof(header),
+                header.record_count * sizeof(InputLogRecord)
+            );
+        }
+        for (const InputLogRecord& record : log.records) {
+            if (record.type >= INPUT_EVENT_TYPE_COUNT) {
+                SDL_Log("Unknown input log record type %u\n", (u32)record.type);
+                log.deinit();
+                return std::nullopt;
+            }
+        }
+
+        return log;
+    }
+
+    /// @brief Writes the log to `filepath`, covering `frame_count` frames.
+    bool save(string filepath, u32 frame_count, Allocator temp_allocator) {
+        this->frame_count = frame_count;
+
+        usize size = sizeof(InputLogHeader) + records.len * sizeof(InputLogRecord);
+        u8* data = temp_allocator.alloc_array<u8>(size);
+        if (!data) return false;
+        defer { temp_allocator.free_array(data, size); };
+
+        InputLogHeader header = {
+            .magic = INPUT_LOG_MAGIC,
+            .version = INPUT_LOG_VERSION,
+            .record_count = (u32)records.len,
+            .frame_count = frame_count,
+        };
+        memcpy(data, &header, sizeof(header));
+        if (records.len > 0) {
+            memcpy(data + sizeof(header), records.items, records.len * sizeof(InputLogRecord));
+        }
+
+        return File::write_all(filepath, data, size);
+    }
+
+    /// @brief Appends `event` if it is one the game handles.
+    void record(u32 frame, const SDL_Event& event) {
+        InputLogRecord record = {.frame = frame};
+        switch (event.type) {
+            case SDL_EVENT_QUIT:
+                record.type = INPUT_EVENT_QUIT;
+                break;
+            case SDL_EVENT_KEY_DOWN:
+            case SDL_EVENT_KEY_UP:
+                record.type = event.key.down ? INPUT_EVENT_KEY_DOWN : INPUT_EVENT_KEY_UP;
+                record.flags = event.key.repeat ? INPUT_EVENT_REPEAT : 0;
+                record.modifiers = event.key.mod;
+                record.data1 = (i32)event.key.key;
+                record.data2 = (i32)event.key.scancode;
+                break;
+            case SDL_EVENT_WINDOW_RESIZED:
+                record.type = INPUT_EVENT_WINDOW_RESIZED;
+                record.data1 = event.window.data1;
+                record.data2 = event.window.data2;
+                break;
+            default:
+                return;
+        }
+        records.append(record);
+    }
+
+    /// @brief Pops the next event recorded on `frame`.
+    /// @return False once every event of `frame` has been replayed
+    bool next(u32 frame, SDL_Event* event) {
+        // Records of frames already passed can only come from a log that is out of order.
+        while (cursor < records.len && records.items[cursor].frame < frame) {
+            cursor++;
+        }
+        if (cursor == records.len || records.items[cursor].frame != frame) return false;
+
+        const InputLogRecord& record = records.items[cursor++];
+        *event = {};
+        switch (record.type) {
+            case INPUT_EVENT_QUIT:
+                event->type = SDL_EVENT_QUIT;
+                break;
+            case INPUT_EVENT_KEY_DOWN:
+            case INPUT_EVENT_KEY_UP:
+                event->type = record.type == INPUT_EVENT_KEY_DOWN ? SDL_EVENT_KEY_DOWN
+                                                                  : SDL_EVENT_KEY_UP;
+                event->key.down = record.type == INPUT_EVENT_KEY_DOWN;
+                event->key.repeat = (record.flags & INPUT_EVENT_REPEAT) != 0;
+                event->key.mod = record.modifiers;
+                event->key.key = (SDL_Keycode)record.data1;
+                event->key.scancode = (SDL_Scancode)record.data2;
+                break;
+            case INPUT_EVENT_WINDOW_RESIZED:
+                event->type = SDL_EVENT_WINDOW_RESIZED;
+                event->window.data1 = record.data1;
+                event->window.data2 = record.data2;
+                break;
+            case INPUT_EVENT_TYPE_COUNT:
+                // Rejected by `load`.
+                break;
+        }
+        return true;
+    }
+
+    /// @brief Whether a replay has run every recorded frame.
+    bool finished(u32 frame) const { return frame >= frame_count; }
+};
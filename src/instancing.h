@@ -0,0 +1,92 @@
+#pragma once
+
+#include "jobs.h"
+#include "lib/allocator.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include "math.h"
+#include <span>
+
+// Layout must match `InstanceData` in assets/shaders/source/instanced.vert.hlsl.
+// 80 bytes, no padding, so it can be copied straight into a StructuredBuffer.
+struct InstanceData {
+    Mat4x4 mvp_matrix;
+    Vec4 color;
+};
+
+static_assert(sizeof(InstanceData) == 80, "InstanceData must match the HLSL layout");
+
+// Instances per job when packing in parallel, tens of microseconds of work.
+constexpr u32 INSTANCE_PACK_GRAIN = 1024;
+
+struct Instance {
+    Mat4x4 model;
+    Vec4 color;
+};
+
+/// @brief Per-frame list of instances that share a single mesh and pipeline.
+/// Instances are pushed during the frame and packed into GPU layout with `pack`,
+/// so everything in the batch is drawn with one instanced draw call.
+struct InstanceBatch {
+    ArrayList<Instance> instances;
+
+    static InstanceBatch init(Allocator allocator, usize max_instances) {
+        auto instances =
+            ArrayList<Instance>::init_capacity(allocator, max_instances, max_instances);
+
+        return InstanceBatch{.instances = instances};
+    }
+
+    void deinit() { instances.deinit(); }
+
+    bool push(Mat4x4 model, Vec4 color) {
+        return instances.append(Instance{.model = model, .color = color});
+    }
+
+    /// @brief Appends `count` instances for the caller to fill in, e.g. from parallel jobs.
+    /// @return The new instances, empty if the batch has no room for all of them.
+    std::span<Instance> push_uninitialized(u32 count) {
+        usize first = instances.len;
+        if (!instances.resize(first + count)) return {};
+
+        return std::span<Instance>(instances.items + first, count);
+    }
+
+    void clear() { instances.clear(); }
+
+    u32 count() const { return (u32)instances.len; }
+
+    /// @brief Packs the batch into GPU layout, premultiplying each model matrix.
+    /// @param out Destination with room for at least `max_count` instances, usually a mapped
+    /// transfer buffer.
+    /// @param max_count Capacity of `out` in instances.
+    /// @param view_projection Matrix applied to every instance.
+    /// @param jobs Splits the work across the job system's workers when given.
+    /// @return Number of instances written.
+    u32 pack(
+        InstanceData* out,
+        u32 max_count,
+        Mat4x4 view_projection,
+        JobSystem* jobs = nullptr
+    ) const {
+        u32 count = instances.len < max_count ? (u32)instances.len : max_count;
+
+        if (!jobs || count <= INSTANCE_PACK_GRAIN) {
+            pack_range(out, 0, count, view_projection);
+            return count;
+        }
+
+        jobs->parallel_for(count, INSTANCE_PACK_GRAIN, [&](u32 begin, u32 end, JobWorker&) {
+            pack_range(out, begin, end, view_projection);
+        });
+        return count;
+    }
+
+  private:
+    void pack_range(InstanceData* out, u32 begin, u32 end, const Mat4x4& view_projection) const {
+        for (u32 i = begin; i < end; i++) {
+            out[i].mvp_matrix = view_projection * instances.items[i].model;
+            out[i].color = instances.items[i].color;
+        }
+    }
+};
@@ -0,0 +1,479 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include "profiler.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <span>
+#include <type_traits>
+
+constexpr u32 JOB_MAX_WORKERS = 64;
+static_assert(JOB_MAX_WORKERS <= PROFILER_MAX_POOL_THREADS, "Workers need profiler rings");
+// Per worker, a power of two. Jobs spawned while the deque is full run inline instead.
+constexpr u32 JOB_DEQUE_CAPACITY = 4096;
+// Per worker, a power of two. A job's slot is only reused once the job has been popped or
+// stolen. Jobs can sit queued for any number of later spawns, so slots are searched for rather
+// than taken in turn; twice the deque capacity keeps that search short.
+constexpr u32 JOB_POOL_SIZE = 2 * JOB_DEQUE_CAPACITY;
+constexpr u32 JOB_MAIN_QUEUE_CAPACITY = 256;
+// Idle workers look for work this many times before going to sleep.
+constexpr u32 JOB_SPIN_COUNT = 512;
+constexpr usize JOB_SCRATCH_BLOCK_SIZE = KB(256);
+
+struct Job;
+struct JobWorker;
+struct JobSystem;
+
+typedef void (*JobFn)(Job& job, JobWorker& worker);
+
+/// @brief Number of unfinished jobs. Submitting a job with a counter increments it, the job
+/// decrements it once it has finished. Waiting on a counter joins every job submitted with it,
+/// which is also how one batch of jobs is made to depend on another.
+struct JobCounter {
+    std::atomic<u32> pending;
+
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job {
+    JobFn fn;
+    void* data;
+    JobCounter* counter;
+    // Index range for `parallel_for`, free for other jobs to use.
+    u32 begin;
+    u32 end;
+};
+
+/// @brief Chase-Lev work-stealing deque. The owning worker pushes and pops at the bottom
+/// without contention; other workers steal from the top with a single CAS.
+struct JobDeque {
+    std::atomic<i64> top;
+    std::atomic<i64> bottom;
+    std::atomic<Job*>* buffer;
+    i64 mask;
+
+    /// @brief Owner only. Fails when the deque is full.
+    bool push(Job* job) {
+        i64 b = bottom.load(std::memory_order_relaxed);
+        i64 t = top.load(std::memory_order_acquire);
+        if (b - t > mask) return false;
+
+        // Release on the slot as well as the fence, so a thief that reads the pointer also
+        // sees the job it points to, and race detectors can tell.
+        buffer[b & mask].store(job, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// @brief Owner only. Takes the most recently pushed job.
+    Job* pop() {
+        i64 b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        i64 t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job* job = buffer[b & mask].load(std::memory_order_acquire);
+        if (t == b) {
+            // Last job, race the thieves for it.
+            if (!top.compare_exchange_strong(
+                    t,
+                    t + 1,
+                    std::memory_order_seq_cst,
+                    std::memory_order_relaxed
+                )) {
+                job = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    /// @brief Any thread. Takes the oldest job, or null if the deque is empty or another
+    /// thread won the race for it.
+    Job* steal() {
+        i64 t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        i64 b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+
+        Job* job = buffer[t & mask].load(std::memory_order_acquire);
+        if (!top.compare_exchange_strong(
+                t,
+                t + 1,
+                std::memory_order_seq_cst,
+                std::memory_order_relaxed
+            )) {
+            return nullptr;
+        }
+        return job;
+    }
+};
+
+/// @brief One thread of the job system. Worker 0 is the main thread.
+struct JobWorker {
+    JobSystem* system;
+    u32 index;
+    JobDeque deque;
+    Job* pool;
+    // Set while the pool slot's job is queued, cleared by whoever takes it once copied out.
+    std::atomic<bool>* pool_queued;
+    u32 pool_next;
+    // Frame-lifetime memory for jobs running on this worker, see `JobSystem::reset_scratch`.
+    ArenaAllocator scratch;
+    u32 steal_seed;
+    SDL_Thread* thread;
+
+    Allocator scratch_allocator() { return scratch.allocator(); }
+};
+
+inline thread_local JobWorker* job_worker = nullptr;
+
+/// @brief Fork-join job system with one worker per logical core. Every worker owns a
+/// work-stealing deque: jobs are pushed to and popped from the submitting worker's own deque,
+/// and idle workers steal from the others. Waiting on a counter runs other jobs meanwhile, so
+/// jobs may submit and wait on jobs of their own.
+///
+/// The thread that calls `init` becomes worker 0. Jobs can only be submitted from it or from
+/// inside a job. Work that must stay on that thread, like SDL window and GPU calls, goes
+/// through `submit_main` and runs in `run_main_jobs` or while the main thread waits.
+struct JobSystem {
+    Allocator allocator;
+    JobWorker* workers;
+    u32 worker_count;
+    std::atomic<bool> running;
+
+    // Idle workers sleep on the semaphore. Submitters only signal it when a worker sleeps.
+    SDL_Semaphore* wake;
+    std::atomic<u32> sleeping;
+
+    // Protects the main thread queue, a ring of `main_count` jobs starting at `main_head`.
+    SDL_Mutex* main_mutex;
+    Job main_jobs[JOB_MAIN_QUEUE_CAPACITY];
+    u32 main_head;
+    u32 main_count;
+
+    /// @brief Starts the workers. Initialized in place, since they keep a pointer to it.
+    /// @param worker_count Workers including the main thread, 0 for one per logical core.
+    bool init(Allocator allocator, u32 worker_count = 0) {
+        if (worker_count == 0) worker_count = (u32)SDL_GetNumLogicalCPUCores();
+        if (worker_count == 0) worker_count = 1;
+        if (worker_count > JOB_MAX_WORKERS) worker_count = JOB_MAX_WORKERS;
+
+        this->allocator = allocator;
+        this->worker_count = worker_count;
+        sleeping.store(0);
+        main_head = 0;
+        main_count = 0;
+
+        wake = SDL_CreateSemaphore(0);
+        main_mutex = SDL_CreateMutex();
+        workers = allocator.alloc_array<JobWorker>(worker_count);
+        if (!wake || !main_mutex || !workers) return false;
+
+        for (u32 i = 0; i < worker_count; i++) {
+            JobWorker& worker = workers[i];
+            worker.system = this;
+            worker.index = i;
+            worker.deque.top.store(0);
+            worker.deque.bottom.store(0);
+            worker.deque.buffer = allocator.alloc_array<std::atomic<Job*>>(JOB_DEQUE_CAPACITY);
+            worker.deque.mask = JOB_DEQUE_CAPACITY - 1;
+            worker.pool = allocator.alloc_array<Job>(JOB_POOL_SIZE);
+            worker.pool_queued = allocator.alloc_array<std::atomic<bool>>(JOB_POOL_SIZE);
+            worker.pool_next = 0;
+            // Workers grow their arenas concurrently, so the blocks come from the page allocator.
+            worker.scratch = ArenaAllocator::init(PageAllocator::init(), JOB_SCRATCH_BLOCK_SIZE);
+            worker.steal_seed = i * 2654435761u + 1;
+            worker.thread = nullptr;
+            if (!worker.deque.buffer || !worker.pool || !worker.pool_queued) return false;
+            for (u32 slot = 0; slot < JOB_POOL_SIZE; slot++) {
+                worker.pool_queued[slot].store(false, std::memory_order_relaxed);
+            }
+        }
+
+        job_worker = &workers[0];
+        running.store(true);
+
+        for (u32 i = 1; i < worker_count; i++) {
+            workers[i].thread = SDL_CreateThread(worker_thread, "job-worker", &workers[i]);
+            if (!workers[i].thread) {
+                SDL_Log("Failed to start job worker %u %s\n", i, SDL_GetError());
+            }
+        }
+
+        return true;
+    }
+
+    /// @brief Stops the workers. No jobs may be in flight.
+    void deinit() {
+        running.store(false);
+        for (u32 i = 1; i < worker_count; i++) {
+            SDL_SignalSemaphore(wake);
+        }
+        for (u32 i = 1; i < worker_count; i++) {
+            if (workers[i].thread) SDL_WaitThread(workers[i].thread, nullptr);
+        }
+
+        for (u32 i = 0; i < worker_count; i++) {
+            allocator.free_array(workers[i].deque.buffer, JOB_DEQUE_CAPACITY);
+            allocator.free_array(workers[i].pool, JOB_POOL_SIZE);
+            allocator.free_array(workers[i].pool_queued, JOB_POOL_SIZE);
+            workers[i].scratch.deinit();
+        }
+        allocator.free_array(workers, worker_count);
+        workers = nullptr;
+        job_worker = nullptr;
+
+        SDL_DestroyMutex(main_mutex);
+        SDL_DestroySemaphore(wake);
+    }
+
+    bool is_main_thread() const { return job_worker == &workers[0]; }
+
+    /// @brief Queues `fn` on the calling worker's deque. Runs it right away if the deque or
+    /// the worker's job pool is full.
+    void submit(JobFn fn, void* data, JobCounter* counter = nullptr, u32 begin = 0, u32 end = 0) {
+        JobWorker& worker = *job_worker;
+        if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+        Job job = {.fn = fn, .data = data, .counter = counter, .begin = begin, .end = end};
+        u32 slot = find_free_slot(worker);
+        if (slot == JOB_POOL_SIZE) {
+            execute(job, worker);
+            return;
+        }
+
+        worker.pool[slot] = job;
+        // Published to thieves by the push.
+        worker.pool_queued[slot].store(true, std::memory_order_relaxed);
+        if (!worker.deque.push(&worker.pool[slot])) {
+            worker.pool_queued[slot].store(false, std::memory_order_relaxed);
+            execute(job, worker);
+            return;
+        }
+
+        // Pairs with the fence in `worker_thread`: either the sleeper sees the job or this
+        // sees the sleeper.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) > 0) SDL_SignalSemaphore(wake);
+    }
+
+    /// @brief Queues `fn` to run on the main thread. Safe from any thread.
+    /// @return False if the main thread queue is full; the counter is left untouched.
+    bool submit_main(JobFn fn, void* data, JobCounter* counter = nullptr) {
+        SDL_LockMutex(main_mutex);
+        defer { SDL_UnlockMutex(main_mutex); };
+
+        if (main_count == JOB_MAIN_QUEUE_CAPACITY) return false;
+        if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+        u32 index = (main_head + main_count) % JOB_MAIN_QUEUE_CAPACITY;
+        main_jobs[index] = Job{.fn = fn, .data = data, .counter = counter, .begin = 0, .end = 0};
+        main_count++;
+        return true;
+    }
+
+    /// @brief Main thread only. Runs the queued main thread jobs.
+    /// @return Number of jobs run.
+    u32 run_main_jobs() {
+        u32 ran = 0;
+        Job job;
+        while (pop_main(&job)) {
+            execute(job, workers[0]);
+            ran++;
+        }
+        return ran;
+    }
+
+    /// @brief Runs other jobs until every job submitted with `counter` has finished.
+    void wait(JobCounter* counter) {
+        JobWorker& worker = *job_worker;
+        bool main = is_main_thread();
+
+        while (!counter->done()) {
+            Job main_job;
+            if (main && pop_main(&main_job)) {
+                execute(main_job, worker);
+                continue;
+            }
+
+            Job job;
+            if (find_job(worker, &job)) {
+                execute(job, worker);
+                continue;
+            }
+
+            SDL_CPUPauseInstruction();
+        }
+    }
+
+    /// @brief Calls `fn(begin, end, worker)` over sub-ranges of [0, count) in parallel and
+    /// returns once all of them are done. Ranges are split in half until they are at most
+    /// `grain` long, the upper halves are left for other workers to steal.
+    template <typename Fn> void parallel_for(u32 count, u32 grain, Fn&& fn) {
+        if (count == 0) return;
+
+        ParallelFor<std::remove_reference_t<Fn>> state = {
+            .fn = &fn,
+            .grain = grain > 0 ? grain : 1,
+        };
+        JobCounter counter = {};
+        Job root = {
+            .fn = ParallelFor<std::remove_reference_t<Fn>>::run,
+            .data = &state,
+            .counter = &counter,
+            .begin = 0,
+            .end = count,
+        };
+
+        root.fn(root, *job_worker);
+        wait(&counter);
+    }
+
+    /// @brief Calls `fn(chunk, worker)` over consecutive chunks of `items` in parallel, each at
+    /// most `grain` items long.
+    template <typename T, typename Fn> void parallel_for(std::span<T> items, u32 grain, Fn&& fn) {
+        parallel_for((u32)items.size(), grain, [&](u32 begin, u32 end, JobWorker& worker) {
+            fn(items.subspan(begin, end - begin), worker);
+        });
+    }
+
+    template <typename T, typename Fn> void parallel_for(ArrayList<T>& list, u32 grain, Fn&& fn) {
+        parallel_for(std::span<T>(list.items, list.len), grain, fn);
+    }
+
+    /// @brief Frees everything jobs allocated from the workers' scratch arenas. Call between
+    /// frames, while no jobs are running.
+    void reset_scratch() {
+        for (u32 i = 0; i < worker_count; i++) {
+            workers[i].scratch.reset();
+        }
+    }
+
+  private:
+    template <typename Fn> struct ParallelFor {
+        Fn* fn;
+        u32 grain;
+
+        static void run(Job& job, JobWorker& worker) {
+            ParallelFor* state = (ParallelFor*)job.data;
+            JobCounter* counter = job.counter;
+            u32 begin = job.begin;
+            u32 end = job.end;
+
+            while (end - begin > state->grain) {
+                u32 middle = begin + (end - begin) / 2;
+                worker.system->submit(run, state, counter, middle, end);
+                end = middle;
+            }
+            (*state->fn)(begin, end, worker);
+        }
+    };
+
+    static void execute(Job& job, JobWorker& worker) {
+        job.fn(job, worker);
+        if (job.counter) job.counter->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    bool pop_main(Job* out) {
+        SDL_LockMutex(main_mutex);
+        defer { SDL_UnlockMutex(main_mutex); };
+
+        if (main_count == 0) return false;
+        *out = main_jobs[main_head];
+        main_head = (main_head + 1) % JOB_MAIN_QUEUE_CAPACITY;
+        main_count--;
+        return true;
+    }
+
+    /// @brief First slot of the worker's pool whose job is no longer queued, starting after
+    /// the one handed out last.
+    /// @return JOB_POOL_SIZE if every slot is still queued.
+    static u32 find_free_slot(JobWorker& worker) {
+        for (u32 i = 0; i < JOB_POOL_SIZE; i++) {
+            u32 slot = worker.pool_next++ & (JOB_POOL_SIZE - 1);
+            // Pairs with the release in `take`, so the previous job was copied out before this
+            // overwrites it.
+            if (!worker.pool_queued[slot].load(std::memory_order_acquire)) return slot;
+        }
+        return JOB_POOL_SIZE;
+    }
+
+    /// @brief Copies a popped or stolen job out of its owner's pool and frees the slot.
+    static void take(JobWorker& owner, Job* job, Job* out) {
+        *out = *job;
+        owner.pool_queued[job - owner.pool].store(false, std::memory_order_release);
+    }
+
+    /// @brief Takes the worker's own newest job, otherwise the oldest job of another worker.
+    bool find_job(JobWorker& worker, Job* out) {
+        Job* job = worker.deque.pop();
+        if (job) {
+            take(worker, job, out);
+            return true;
+        }
+
+        // Xorshift, so workers do not all start stealing from the same victim.
+        worker.steal_seed ^= worker.steal_seed << 13;
+        worker.steal_seed ^= worker.steal_seed >> 17;
+        worker.steal_seed ^= worker.steal_seed << 5;
+        u32 start = worker.steal_seed % worker_count;
+
+        for (u32 i = 0; i < worker_count; i++) {
+            u32 victim = (start + i) % worker_count;
+            if (victim == worker.index) continue;
+
+            job = workers[victim].deque.steal();
+            if (job) {
+                take(workers[victim], job, out);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static int worker_thread(void* data) {
+        JobWorker* worker = (JobWorker*)data;
+        JobSystem* system = worker->system;
+        job_worker = worker;
+        PROFILE_THREAD_NAME("job-worker");
+
+        u32 idle = 0;
+        while (system->running.load(std::memory_order_relaxed)) {
+            Job job;
+            if (system->find_job(*worker, &job)) {
+                execute(job, *worker);
+                idle = 0;
+                continue;
+            }
+
+            if (++idle < JOB_SPIN_COUNT) {
+                SDL_CPUPauseInstruction();
+                continue;
+            }
+            idle = 0;
+
+            system->sleeping.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (system->find_job(*worker, &job)) {
+                system->sleeping.fetch_sub(1, std::memory_order_relaxed);
+                execute(job, *worker);
+                continue;
+            }
+
+            PROFILE_SCOPE("sleep");
+            SDL_WaitSemaphore(system->wake);
+            system->sleeping.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        return 0;
+    }
+};
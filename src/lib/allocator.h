@@ -1,6 +1,10 @@
 #pragma once
 
 #include "def.h"
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
 #include <optional>
 
 // TODO: Use these values
@@ -158,7 +162,9 @@ struct FixedBufferAllocator {
     static void* alloc_impl(void* context, usize size, usize alignment) {
         FixedBufferAllocator* fba = (FixedBufferAllocator*)(context);
 
-        usize aligned_offset = fba->align_forward(fba->offset, alignment);
+        // Aligns the address, the buffer itself may be less aligned than the request.
+        usize base = (usize)fba->buffer;
+        usize aligned_offset = fba->align_forward(base + fba->offset, alignment) - base;
 
         if (aligned_offset + size > fba->buffer_size) {
             // TODO: Better handling of this path here.
@@ -214,6 +220,13 @@ struct ArenaAllocator {
         Block* next;
         usize size;
         usize offset;
+
+        // The data starts right after the header, so the offset alone says nothing about the
+        // address's alignment.
+        usize aligned_offset(usize alignment) const {
+            usize base = (usize)(this + 1);
+            return ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+        }
     };
 
     Block* current_block;
@@ -264,7 +277,7 @@ struct ArenaAllocator {
             return nullptr; // Out of memory
         }
 
-        usize aligned_offset = arena->align_forward(arena->current_block->offset, alignment);
+        usize aligned_offset = arena->current_block->aligned_offset(alignment);
         void* ptr = (u8*)(arena->current_block + 1) + aligned_offset;
         arena->current_block->offset = aligned_offset + size;
 
@@ -273,6 +286,19 @@ struct ArenaAllocator {
 
     static void*
     realloc_impl(void* context, void* ptr, usize old_size, usize new_size, usize alignment) {
+        ArenaAllocator* arena = (ArenaAllocator*)(context);
+
+        // Grow the last allocation in place when the block has room, like FixedBufferAllocator
+        if (ptr && arena->current_block) {
+            u8* base = (u8*)(arena->current_block + 1);
+            u8* byte_ptr = (u8*)(ptr);
+            bool is_last = byte_ptr + old_size == base + arena->current_block->offset;
+            if (is_last && (usize)(byte_ptr - base) + new_size <= arena->current_block->size) {
+                arena->current_block->offset = (usize)(byte_ptr - base) + new_size;
+                return ptr;
+            }
+        }
+
         void* new_ptr = alloc_impl(context, new_size, alignment);
 
         if (new_ptr && ptr) {
@@ -292,8 +318,10 @@ struct ArenaAllocator {
 
     bool ensure_capacity(usize size, usize alignment) {
         if (!current_block ||
-            align_forward(current_block->offset, alignment) + size > current_block->size) {
-            usize new_block_size = size > block_size ? size : block_size;
+            current_block->aligned_offset(alignment) + size > current_block->size) {
+            // Room for the padding too, the block's data is only aligned like the header.
+            usize padded_size = size + alignment - 1;
+            usize new_block_size = padded_size > block_size ? padded_size : block_size;
             usize block_total_size = sizeof(Block) + new_block_size;
 
             if(max_size > 0 && total_allocated + block_total_size > max_size) {
@@ -316,10 +344,6 @@ struct ArenaAllocator {
 
         return true;
     }
-
-    usize align_forward(usize addr, usize alignment) {
-        return (addr + alignment - 1) & ~(alignment - 1);
-    }
 };
 
 struct GeneralPurposeAllocator {
@@ -444,3 +468,187 @@ struct GeneralPurposeAllocator {
         }
     }
 };
+
+// Size classes of PoolAllocator: 64, 128, ... 4096 bytes.
+constexpr u32 POOL_SIZE_CLASSES = 7;
+constexpr usize POOL_MIN_BLOCK_SIZE = 64;
+constexpr usize POOL_MAX_BLOCK_SIZE = POOL_MIN_BLOCK_SIZE << (POOL_SIZE_CLASSES - 1);
+constexpr usize POOL_CHUNK_SIZE = KB(64);
+// Blocks are aligned like malloc, which is all the child allocator has to provide.
+constexpr usize POOL_BLOCK_ALIGNMENT = alignof(std::max_align_t);
+
+/// @brief Thread-safe free lists of power-of-two blocks, carved from 64 KB chunks of the
+/// child allocator. For many short-lived allocations of a few hundred bytes, like coroutine
+/// frames. Larger or more strictly aligned requests go straight to the child. Freed blocks
+/// are reused but chunks are only returned to the child on `deinit`.
+struct PoolAllocator {
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Chunk {
+        Chunk* next;
+    };
+
+    Allocator child_allocator;
+    FreeBlock* free_lists[POOL_SIZE_CLASSES];
+    Chunk* chunks;
+    std::mutex lock;
+
+    // The lock cannot be moved, so the pool is initialized in place like StringInterner.
+    void init(Allocator child) {
+        new (&lock) std::mutex();
+        child_allocator = child;
+        for (auto& list : free_lists) {
+            list = nullptr;
+        }
+        chunks = nullptr;
+    }
+
+    void deinit() {
+        Chunk* chunk = chunks;
+        while (chunk) {
+            Chunk* next = chunk->next;
+            child_allocator.free(chunk, POOL_CHUNK_SIZE, POOL_BLOCK_ALIGNMENT);
+            chunk = next;
+        }
+        chunks = nullptr;
+        lock.~mutex();
+    }
+
+    Allocator allocator() {
+        return Allocator::init(this, alloc_impl, realloc_impl, free_impl);
+    }
+
+  private:
+    static bool pooled(usize size, usize alignment) {
+        return size <= POOL_MAX_BLOCK_SIZE && alignment <= POOL_BLOCK_ALIGNMENT;
+    }
+
+    static u32 size_class(usize size) {
+        u32 index = 0;
+        while ((POOL_MIN_BLOCK_SIZE << index) < size) {
+            index++;
+        }
+        return index;
+    }
+
+    static void* alloc_impl(void* context, usize size, usize alignment) {
+        PoolAllocator* pool = (PoolAllocator*)(context);
+        if (!pooled(size, alignment)) return pool->child_allocator.alloc(size, alignment);
+
+        u32 index = size_class(size);
+        std::lock_guard guard(pool->lock);
+
+        if (!pool->free_lists[index] && !pool->refill(index)) return nullptr;
+
+        FreeBlock* block = pool->free_lists[index];
+        pool->free_lists[index] = block->next;
+        return block;
+    }
+
+    static void*
+    realloc_impl(void* context, void* ptr, usize old_size, usize new_size, usize alignment) {
+        PoolAllocator* pool = (PoolAllocator*)(context);
+        bool old_pooled = pooled(old_size, alignment);
+        if (!old_pooled && !pooled(new_size, alignment)) {
+            return pool->child_allocator.realloc(ptr, old_size, new_size, alignment);
+        }
+        if (ptr && old_pooled && pooled(new_size, alignment) &&
+            size_class(old_size) == size_class(new_size)) {
+            return ptr;
+        }
+
+        void* new_ptr = alloc_impl(context, new_size, alignment);
+        if (new_ptr && ptr) {
+            memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+            free_impl(context, ptr, old_size, alignment);
+        }
+        return new_ptr;
+    }
+
+    static void free_impl(void* context, void* ptr, usize size, usize alignment) {
+        PoolAllocator* pool = (PoolAllocator*)(context);
+        if (!ptr) return;
+        if (!pooled(size, alignment)) {
+            pool->child_allocator.free(ptr, size, alignment);
+            return;
+        }
+
+        u32 index = size_class(size);
+        std::lock_guard guard(pool->lock);
+
+        FreeBlock* block = (FreeBlock*)ptr;
+        block->next = pool->free_lists[index];
+        pool->free_lists[index] = block;
+    }
+
+    // Called with the lock held. The first block of each chunk holds the chunk header.
+    bool refill(u32 index) {
+        u8* memory = (u8*)child_allocator.alloc(POOL_CHUNK_SIZE, POOL_BLOCK_ALIGNMENT);
+        if (!memory) return false;
+
+        Chunk* chunk = (Chunk*)memory;
+        chunk->next = chunks;
+        chunks = chunk;
+
+        usize block_size = POOL_MIN_BLOCK_SIZE << index;
+        for (usize offset = block_size; offset + block_size <= POOL_CHUNK_SIZE;
+             offset += block_size) {
+            FreeBlock* block = (FreeBlock*)(memory + offset);
+            block->next = free_lists[index];
+            free_lists[index] = block;
+        }
+        return true;
+    }
+};
+
+/// @brief Forwards to a child allocator and counts the calls going through it. Used by the
+/// benchmark to report allocations per frame. The counters are plain integers, so wrap only
+/// allocators that are used from one thread, like the arenas.
+struct CountingAllocator {
+    Allocator child_allocator;
+    u64 allocations;
+    u64 reallocations;
+    u64 frees;
+    u64 bytes_allocated;
+
+    static CountingAllocator init(Allocator child) {
+        return CountingAllocator{
+            .child_allocator = child,
+            .allocations = 0,
+            .reallocations = 0,
+            .frees = 0,
+            .bytes_allocated = 0,
+        };
+    }
+
+    Allocator allocator() {
+        return Allocator::init(this, alloc_impl, realloc_impl, free_impl);
+    }
+
+  private:
+    static void* alloc_impl(void* context, usize size, usize alignment) {
+        CountingAllocator* counter = (CountingAllocator*)(context);
+        counter->allocations++;
+        counter->bytes_allocated += size;
+
+        return counter->child_allocator.alloc(size, alignment);
+    }
+
+    static void*
+    realloc_impl(void* context, void* ptr, usize old_size, usize new_size, usize alignment) {
+        CountingAllocator* counter = (CountingAllocator*)(context);
+        counter->reallocations++;
+        if (new_size > old_size) counter->bytes_allocated += new_size - old_size;
+
+        return counter->child_allocator.realloc(ptr, old_size, new_size, alignment);
+    }
+
+    static void free_impl(void* context, void* ptr, usize size, usize alignment) {
+        CountingAllocator* counter = (CountingAllocator*)(context);
+        counter->frees++;
+
+        counter->child_allocator.free(ptr, size, alignment);
+    }
+};
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "allocator.h"
+#include "def.h"
+#include "file.h"
+#include "hash.h"
+#include "lz4.h"
+#include <cstring>
+#include <optional>
+#include <span>
+
+// Archive layout, all integers little endian:
+//
+//   ArchiveHeader
+//   ArchiveEntry[entry_count]      sorted by name_hash
+//   u32 buckets[bucket_count + 1]  index of the first entry per top-bits hash bucket
+//   names                          entry names, each null terminated
+//   entry data                     every entry starts on an ARCHIVE_ALIGNMENT boundary
+//
+// Because the table is sorted by hash, the entries of one bucket are contiguous and a lookup
+// only scans that bucket.
+
+constexpr u32 ARCHIVE_MAGIC = 0x314B4150; // "PAK1"
+constexpr u32 ARCHIVE_VERSION = 1;
+constexpr u64 ARCHIVE_ALIGNMENT = 4096;
+
+enum ArchiveCompression : u32 {
+    ARCHIVE_COMPRESSION_NONE,
+    ARCHIVE_COMPRESSION_LZ4,
+};
+
+struct ArchiveHeader {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 bucket_bits;
+    u64 toc_offset;
+    u64 buckets_offset;
+    u64 names_offset;
+    u64 names_size;
+};
+
+struct ArchiveEntry {
+    u64 name_hash;
+    u64 offset;
+    u64 stored_size;
+    u64 size;
+    u32 name_offset;
+    ArchiveCompression compression;
+};
+
+static_assert(sizeof(ArchiveHeader) == 48, "ArchiveHeader layout is part of the file format");
+static_assert(sizeof(ArchiveEntry) == 40, "ArchiveEntry layout is part of the file format");
+
+/// @brief Hash used for archive entry names.
+inline u64 archive_name_hash(string name) { return hash_bytes(name, strlen(name)); }
+
+/// @brief Picks the bucket table size for `entry_count` entries, about one entry per bucket.
+inline u32 archive_bucket_bits(u32 entry_count) {
+    u32 bits = 0;
+    while (bits < 24 && (1u << bits) < entry_count) {
+        bits++;
+    }
+    return bits;
+}
+
+inline u32 archive_bucket(u64 name_hash, u32 bucket_bits) {
+    return bucket_bits == 0 ? 0 : (u32)(name_hash >> (64 - bucket_bits));
+}
+
+/// @brief Read-only view of a packed archive. The whole file is mapped once; uncompressed
+/// entries are handed out without a copy.
+struct Archive {
+    MappedFile file;
+    const ArchiveHeader* header;
+    const ArchiveEntry* entries;
+    const u32* buckets;
+    const char* names;
+
+    /// @brief Maps and validates the archive at `filepath`
+    /// @return The archive, or nullopt if the file is missing or malformed
+    static std::optional<Archive> open(string filepath) {
+        // Lookups jump around the table, the data is read in place later.
+        auto file = MappedFile::open(filepath, MAPPED_FILE_RANDOM);
+        if (!file.has_value()) {
+            return std::nullopt;
+        }
+
+        auto archive = from_memory(file.value());
+        if (!archive.has_value()) {
+            file->deinit();
+        }
+
+        return archive;
+    }
+
+    void deinit() { file.deinit(); }
+
+    u32 entry_count() const { return header->entry_count; }
+
+    /// @brief Finds the entry named `name`.
+    const ArchiveEntry* find(string name) const {
+        u64 name_hash = archive_name_hash(name);
+
+        u32 bucket = archive_bucket(name_hash, header->bucket_bits);
+        for (u32 i = buckets[bucket]; i < buckets[bucket + 1]; i++) {
+            if (entries[i].name_hash != name_hash) continue;
+            // Hash collisions are resolved by name.
+            if (strcmp(names + entries[i].name_offset, name) == 0) return &entries[i];
+        }
+
+        return nullptr;
+    }
+
+    string entry_name(const ArchiveEntry* entry) const { return names + entry->name_offset; }
+
+    /// @brief Stored bytes of `entry`, compressed or not.
+    std::span<const u8> stored(const ArchiveEntry* entry) const {
+        return std::span<const u8>(file.data + entry->offset, entry->stored_size);
+    }
+
+    /// @brief Contents of an uncompressed entry, read straight from the mapping.
+    /// @return Nullopt for compressed entries, use `read` for those.
+    std::optional<std::span<const u8>> bytes(const ArchiveEntry* entry) const {
+        if (entry->compression != ARCHIVE_COMPRESSION_NONE) {
+            return std::nullopt;
+        }
+        return stored(entry);
+    }
+
+    /// @brief Decompresses or copies `entry` into `out`, which must hold `entry->size` bytes.
+    bool read(const ArchiveEntry* entry, u8* out, usize out_size) const {
+        if (out_size < entry->size) {
+            return false;
+        }
+
+        switch (entry->compression) {
+            case ARCHIVE_COMPRESSION_NONE:
+                memcpy(out, file.data + entry->offset, entry->size);
+                return true;
+            case ARCHIVE_COMPRESSION_LZ4:
+                return lz4_decompress(
+                    file.data + entry->offset,
+                    entry->stored_size,
+                    out,
+                    entry->size
+                );
+            default:
+                return false;
+        }
+    }
+
+  private:
+    static std::optional<Archive> from_memory(MappedFile file) {
+        if (file.size < sizeof(ArchiveHeader)) {
+            return std::nullopt;
+        }
+
+        auto header = (const ArchiveHeader*)file.data;
+        if (header->magic != ARCHIVE_MAGIC || header->version != ARCHIVE_VERSION) {
+            return std::nullopt;
+        }
+
+        u64 toc_end = header->toc_offset + (u64)header->entry_count * sizeof(ArchiveEntry);
+        u64 bucket_count = (1ull << header->bucket_bits) + 1;
+        u64 buckets_end = header->buckets_offset + bucket_count * sizeof(u32);
+        u64 names_end = header->names_offset + header->names_size;
+        bool in_bounds = header->bucket_bits <= 24 && toc_end <= file.size &&
+                         buckets_end <= file.size && names_end <= file.size &&
+                         header->names_size > 0 && file.data[names_end - 1] == '\0';
+        if (!in_bounds) {
+            return std::nullopt;
+        }
+
+        Archive archive = {
+            .file = file,
+            .header = header,
+            .entries = (const ArchiveEntry*)(file.data + header->toc_offset),
+            .buckets = (const u32*)(file.data + header->buckets_offset),
+            .names = (const char*)(file.data + header->names_offset),
+        };
+
+        // Validated once here so lookups and reads need no checks.
+        for (u32 i = 0; i < header->entry_count; i++) {
+            const ArchiveEntry& entry = archive.entries[i];
+            // Written without the sum, which a crafted offset could overflow.
+            bool valid = entry.offset <= file.size &&
+                         entry.stored_size <= file.size - entry.offset &&
+                         entry.name_offset < header->names_size;
+            // `read` copies `size` bytes of an uncompressed entry, which must be all it stores.
+            switch (entry.compression) {
+                case ARCHIVE_COMPRESSION_NONE:
+                    valid = valid && entry.size == entry.stored_size;
+                    break;
+                case ARCHIVE_COMPRESSION_LZ4:
+                    break;
+                default:
+                    valid = false;
+                    break;
+            }
+            if (!valid) {
+                return std::nullopt;
+            }
+        }
+        for (u64 i = 0; i < bucket_count; i++) {
+            bool valid = archive.buckets[i] <= header->entry_count &&
+                         (i == 0 || archive.buckets[i] >= archive.buckets[i - 1]);
+            if (!valid) {
+                return std::nullopt;
+            }
+        }
+
+        return archive;
+    }
+};
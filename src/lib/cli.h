@@ -1,50 +1,136 @@
 #pragma once
 
-#include "allocator.h"
-#include "array.h"
 #include "def.h"
-#include "string.h"
+#include "hash.h"
+#include "number.h"
+#include "str.h"
+#include <limits>
 #include <optional>
 #include <print>
+#include <span>
+#include <utility>
+
+// Commands and options live in caller-owned storage and the parser only keeps pointers to
+// them, so setting up and parsing a command line never allocates.
+constexpr u32 CLI_MAX_OPTIONS = 16;
+constexpr u32 CLI_MAX_COMMANDS = 16;
+// Short and long names of every option, kept at or under half full.
+constexpr u32 CLI_OPTION_SLOTS = 64;
+
+static_assert(CLI_OPTION_SLOTS >= CLI_MAX_OPTIONS * 4, "Option table must stay half empty");
+
+enum CLIValueType {
+    CLI_FLAG,
+    CLI_STRING,
+    CLI_INT,
+    CLI_FLOAT,
+    // One of `choices`, stored as its index.
+    CLI_ENUM,
+    // Numbers separated by commas, like `--sizes 64,128,256`.
+    CLI_LIST,
+};
 
 struct CLIOption {
     string short_name;
     string long_name;
     string description;
-    std::optional<string> value;
-    bool flag_option;
-
+    CLIValueType type;
+    const string* choices;
+    u32 choice_count;
+
+    // Filled in by CLIParser::parse. Values are checked against `type` while parsing, so the
+    // typed getters never see malformed text.
+    bool present;
+    Str value;
+    i64 int_value;
+    f64 float_value;
+    u32 choice;
+
+    /// @param short_name Name used as `-x`, or nullptr.
+    /// @param long_name Name used as `--name`, or nullptr.
     static CLIOption init(
         string short_name,
         string long_name,
         string description,
-        bool flag_option = false
+        CLIValueType type = CLI_STRING
     ) {
         return CLIOption{
             .short_name = short_name,
             .long_name = long_name,
             .description = description,
-            .value = std::nullopt,
-            .flag_option = flag_option,
+            .type = type,
+            .choices = nullptr,
+            .choice_count = 0,
+            .present = false,
+            .value = Str::lit(""),
+            .int_value = 0,
+            .float_value = 0.0,
+            .choice = 0,
         };
     }
 
-    static string parse_name(string arg) {
-        if (arg[0] == '-' && arg[1] == '-') {
-            return arg + 2; // Skip "--"
-        } else if (arg[0] == '-') {
-            return arg + 1; // Skip "-"
-        }
+    template <usize N>
+    static CLIOption init_enum(
+        string short_name,
+        string long_name,
+        string description,
+        const string (&choices)[N]
+    ) {
+        CLIOption option = init(short_name, long_name, description, CLI_ENUM);
+        option.choices = choices;
+        option.choice_count = (u32)N;
+        return option;
+    }
 
+    /// @brief Strips the leading dashes of an argument.
+    static Str parse_name(Str arg) {
+        if (arg.starts_with(Str::lit("--"))) return arg.slice(2);
+        if (arg.starts_with(Str::lit("-"))) return arg.slice(1);
         return arg;
     }
 
-    bool equals(string name_short_or_long) {
-        bool eq_short = string_equals(parse_name(short_name), name_short_or_long);
-        bool eq_long = string_equals(parse_name(long_name), name_short_or_long);
-
-        return (short_name && eq_short) || (long_name && eq_long);
+    /// @brief Checks `text` against the option's type and stores the typed value.
+    bool set_value(Str text) {
+        value = text;
+
+        switch (type) {
+            case CLI_FLAG:
+            case CLI_STRING:
+                return true;
+            case CLI_INT: {
+                auto parsed = int_from_str<i64>(text);
+                if (!parsed.has_value()) return false;
+                int_value = parsed.value();
+                float_value = (f64)int_value;
+                return true;
+            }
+            case CLI_FLOAT: {
+                auto parsed = float_from_str<f64>(text);
+                if (!parsed.has_value()) return false;
+                float_value = parsed.value();
+                return true;
+            }
+            case CLI_ENUM:
+                for (u32 i = 0; i < choice_count; i++) {
+                    if (text.equals(Str::from_cstr(choices[i]))) {
+                        choice = i;
+                        return true;
+                    }
+                }
+                return false;
+            case CLI_LIST: {
+                NumberScanner scanner = NumberScanner::init(text);
+                while (!scanner.at_end()) {
+                    if (!scanner.next_float<f64>().has_value()) return false;
+                }
+                return true;
+            }
+            default:
+                return false;
+        }
     }
+
+    bool takes_value() const { return type != CLI_FLAG; }
 };
 
 struct CLICommand;
@@ -52,49 +138,155 @@ struct CLICommand;
 typedef bool (*CommandCallback)(CLICommand& command, void* user_data);
 
 struct CLICommand {
+    struct Slot {
+        u32 hash;
+        // Index into `options`, or CLI_MAX_OPTIONS when the slot is empty.
+        u32 option;
+    };
+
     string name;
     string description;
-    ArrayList<CLIOption> options;
+    CLIOption* options;
+    u32 option_count;
     CommandCallback callback;
     void* user_data;
+    Slot slots[CLI_OPTION_SLOTS];
 
+    /// @brief Builds the command and its option lookup table. `options` must outlive it; when
+    /// two options share a name the first one wins.
+    template <usize N>
     static CLICommand init(
-        Allocator& allocator,
         string name,
         string description,
+        CLIOption (&options)[N],
         CommandCallback callback = nullptr,
-        void* user_data = nullptr,
-        usize max_options = 10
+        void* user_data = nullptr
     ) {
-        auto options = ArrayList<CLIOption>::init(allocator, max_options);
+        static_assert(N <= CLI_MAX_OPTIONS, "Too many options for one command");
+        return init(name, description, options, (u32)N, callback, user_data);
+    }
 
-        return CLICommand{
+    static CLICommand init(
+        string name,
+        string description,
+        CommandCallback callback = nullptr,
+        void* user_data = nullptr
+    ) {
+        return init(name, description, nullptr, 0, callback, user_data);
+    }
+
+    static CLICommand init(
+        string name,
+        string description,
+        CLIOption* options,
+        u32 option_count,
+        CommandCallback callback,
+        void* user_data
+    ) {
+        CLICommand command = {
             .name = name,
             .description = description,
             .options = options,
+            .option_count = option_count < CLI_MAX_OPTIONS ? option_count : CLI_MAX_OPTIONS,
             .callback = callback,
             .user_data = user_data,
+            .slots = {},
         };
+
+        for (u32 i = 0; i < CLI_OPTION_SLOTS; i++) {
+            command.slots[i].option = CLI_MAX_OPTIONS;
+        }
+        for (u32 i = 0; i < command.option_count; i++) {
+            command.insert(options[i].short_name, i);
+            command.insert(options[i].long_name, i);
+        }
+
+        return command;
     }
 
-    void deinit() { options.deinit(); }
+    /// @brief Finds an option by short or long name, with or without leading dashes.
+    CLIOption* find_option(Str name) {
+        name = CLIOption::parse_name(name);
+        u32 hash = (u32)hash_chars(name.data, name.len);
+
+        u32 mask = CLI_OPTION_SLOTS - 1;
+        for (u32 i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots[i];
+            if (slot.option == CLI_MAX_OPTIONS) return nullptr;
+            if (slot.hash == hash && option_has_name(options[slot.option], name)) {
+                return &options[slot.option];
+            }
+        }
+    }
 
-    bool add_option(CLIOption& option) { return options.append(option); }
+    CLIOption* find_option(string name) { return find_option(Str::from_cstr(name)); }
 
-    std::optional<CLIOption> get_option(string name) {
-        for (auto& opt : options) {
-            if (opt.equals(name)) return opt;
+    bool has(string name) {
+        CLIOption* option = find_option(name);
+        return option && option->present;
+    }
+
+    Str get_str(string name, Str fallback = Str::lit("")) {
+        CLIOption* option = find_option(name);
+        return option && option->present ? option->value : fallback;
+    }
+
+    /// @return The value, `fallback` if the option was not given, or nullopt after printing a
+    /// usage error if the value does not fit in `T`.
+    template <IntegerType T> std::optional<T> get_int(string name, T fallback = 0) {
+        CLIOption* option = find_option(name);
+        if (!option || !option->present || option->type != CLI_INT) return fallback;
+
+        if (!std::in_range<T>(option->int_value)) {
+            // Unary plus so 8-bit limits print as numbers.
+            std::println(
+                "Value {} for {} is out of range, expected {} to {}",
+                option->int_value,
+                name,
+                +std::numeric_limits<T>::min(),
+                +std::numeric_limits<T>::max()
+            );
+            return std::nullopt;
         }
-        return std::nullopt;
+        return (T)option->int_value;
+    }
+
+    template <FloatType T> T get_float(string name, T fallback = 0) {
+        CLIOption* option = find_option(name);
+        bool numeric = option && (option->type == CLI_FLOAT || option->type == CLI_INT);
+        if (!numeric || !option->present) return fallback;
+        return (T)option->float_value;
     }
 
-    void set_option_value(string name, string value) {
-        for (auto& opt : options) {
-            if (opt.equals(name)) {
-                opt.value = value;
-                return;
+    /// @return Index of the chosen value in the option's `choices`.
+    u32 get_enum(string name, u32 fallback = 0) {
+        CLIOption* option = find_option(name);
+        if (!option || !option->present || option->type != CLI_ENUM) return fallback;
+        return option->choice;
+    }
+
+    /// @brief Parses a list option into `out`.
+    /// @return How many values were written, stopping early when `out` is full or, for
+    /// integer lists, at the first value that is not an integer.
+    template <typename T>
+        requires IntegerType<T> || FloatType<T>
+    usize get_list(string name, std::span<T> out) {
+        CLIOption* option = find_option(name);
+        if (!option || !option->present || option->type != CLI_LIST) return 0;
+
+        NumberScanner scanner = NumberScanner::init(option->value);
+        usize count = 0;
+        while (count < out.size() && !scanner.at_end()) {
+            std::expected<T, NumberParseError> value;
+            if constexpr (FloatType<T>) {
+                value = scanner.next_float<T>();
+            } else {
+                value = scanner.next_int<T>();
             }
+            if (!value.has_value()) break;
+            out[count++] = value.value();
         }
+        return count;
     }
 
     bool execute() {
@@ -103,40 +295,55 @@ struct CLICommand {
         }
         return true;
     }
+
+  private:
+    static bool option_has_name(const CLIOption& option, Str name) {
+        return (option.short_name && name.equals(Str::from_cstr(option.short_name))) ||
+               (option.long_name && name.equals(Str::from_cstr(option.long_name)));
+    }
+
+    void insert(string option_name, u32 option) {
+        if (!option_name) return;
+
+        Str name = CLIOption::parse_name(Str::from_cstr(option_name));
+        if (find_option(name)) return;
+
+        u32 hash = (u32)hash_chars(name.data, name.len);
+        u32 mask = CLI_OPTION_SLOTS - 1;
+        u32 i = hash & mask;
+        while (slots[i].option != CLI_MAX_OPTIONS) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = Slot{.hash = hash, .option = option};
+    }
 };
 
 struct CLIParser {
     string program_name;
-    std::optional<CLICommand> current_command;
-    std::optional<CLICommand> main_command;
-    ArrayList<CLICommand> commands;
-
-    static CLIParser init(Allocator& allocator, string program_name, i32 max_commands = 20) {
-        auto commands = ArrayList<CLICommand>::init(allocator, max_commands);
+    CLICommand* current_command;
+    CLICommand* main_command;
+    CLICommand* commands[CLI_MAX_COMMANDS];
+    u32 command_count;
 
+    static CLIParser init(string program_name) {
         return CLIParser{
             .program_name = program_name,
-            .current_command = std::nullopt,
-            .main_command = std::nullopt,
-            .commands = commands,
+            .current_command = nullptr,
+            .main_command = nullptr,
+            .commands = {},
+            .command_count = 0,
         };
     }
 
-    void deinit() {
-        for (auto& cmd : commands) {
-            cmd.deinit();
-        }
-
-        if (main_command.has_value()) {
-            main_command->deinit();
-        }
-
-        commands.deinit();
+    /// @brief Registers `command`, which must outlive the parser.
+    bool add_command(CLICommand* command) {
+        if (command_count == CLI_MAX_COMMANDS) return false;
+        commands[command_count++] = command;
+        return true;
     }
 
-    bool add_command(CLICommand command) { return commands.append(command); }
-
-    void set_main_command(CLICommand command) { main_command = command; }
+    /// @brief Command used when the first argument is not a command name.
+    void set_main_command(CLICommand* command) { main_command = command; }
 
     int parse_and_execute(i32 argc, char* argv[]) {
         if (!parse(argc, argv)) {
@@ -150,84 +357,63 @@ struct CLIParser {
         return 0;
     }
 
+    /// @brief Picks the command and fills in its options in one pass over `argv`. Values point
+    /// into `argv`, nothing is copied.
     bool parse(i32 argc, char* argv[]) {
+        i32 first_option = 1;
+
         // If no arguments or first argument is an option, use main command
         if (argc < 2 || is_option(argv[1])) {
-            if (!main_command.has_value()) {
+            if (!main_command) {
                 print_help();
                 return false;
             }
-
             current_command = main_command;
-
-            // Parse options starting from argv[1] for main command
-            for (i32 i = 1; i < argc; i++) {
-                if (string_equals(argv[i], "--help") || string_equals(argv[i], "-h")) {
-                    print_command_help(current_command.value());
-                    return false;
-                }
-
-                if (is_option(argv[i])) {
-                    i32 consumed = parse_option(argv, argc, i, current_command.value());
-                    if(consumed == -1) return false;
-
-                    i += consumed;
-                }
+        } else {
+            current_command = find_command(Str::from_cstr(argv[1]));
+            if (!current_command) {
+                std::println("Unknown command: {}", argv[1]);
+                print_help();
+                return false;
             }
-
-            return true;
+            first_option = 2;
         }
 
-        // Look for named command
-        auto found_command = find_command(argv[1]);
-        if (!found_command.has_value()) {
-            std::println("Unknown command: {}", argv[1]);
-            print_help();
-            return false;
-        }
-
-        current_command = found_command;
+        for (i32 i = first_option; i < argc; i++) {
+            Str arg = Str::from_cstr(argv[i]);
+            if (!is_option(argv[i])) {
+                std::println("Unexpected argument: {}", argv[i]);
+                return false;
+            }
 
-        // Check for help option
-        for (i32 i = 2; i < argc; i++) {
-            if (string_equals(argv[i], "--help") || string_equals(argv[i], "-h")) {
-                print_command_help(current_command.value());
+            if (arg.equals(Str::lit("--help")) || arg.equals(Str::lit("-h"))) {
+                print_command_help(*current_command);
                 return false;
             }
-        }
 
-        // Parse options starting from argv[2] for named commands
-        for (i32 i = 2; i < argc; i++) {
-            if (is_option(argv[i])) {
-                i32 consumed = parse_option(argv, i, argc, current_command.value());
-                if (consumed == -1) {
-                    return false;
-                }
-                i += consumed;
+            i32 consumed = parse_option(argc, argv, i, *current_command);
+            if (consumed == -1) {
+                return false;
             }
+            i += consumed;
         }
 
         return true;
     }
 
     void print_help() {
-        std::println("Usage {} [options]", program_name);
-
-        if (main_command.has_value()) {
-            std::println("       {} <command> [options]\n", program_name);
-        } else {
-            std::println("       {} <command> [options]\n", program_name);
-        }
+        std::println("Usage: {} [options]", program_name);
+        std::println("       {} <command> [options]\n", program_name);
 
-        if (main_command.has_value()) {
+        if (main_command) {
             std::println("Main command:");
             std::println("{:<15} {}\n", "(default)", main_command->description);
         }
 
-        if (commands.len > 0) {
+        if (command_count > 0) {
             std::println("Commands:");
-            for (auto& cmd : commands) {
-                std::println("{:<15} {}", cmd.name, cmd.description);
+            for (u32 i = 0; i < command_count; i++) {
+                std::println("{:<15} {}", commands[i]->name, commands[i]->description);
             }
         }
 
@@ -242,10 +428,11 @@ struct CLIParser {
         std::println("Usage: {} {} [options]\n", program_name, command.name);
         std::println("{}\n", command.description);
 
-        if (command.options.len > 0) {
+        if (command.option_count > 0) {
             std::println("Options:");
 
-            for (auto& option : command.options) {
+            for (u32 i = 0; i < command.option_count; i++) {
+                const CLIOption& option = command.options[i];
                 std::print("  ");
 
                 if (option.short_name) {
@@ -259,50 +446,107 @@ struct CLIParser {
                     std::print("--{}", option.long_name);
                 }
 
-                if (option.value.has_value()) {
-                    std::print(" <value>");
-                }
-
-                std::println("\n{}", option.description);
+                print_value_hint(option);
+                std::println("\n      {}", option.description);
             }
         }
     }
 
   private:
-    i32 parse_option(char* argv[], i32 argc, i32 current_index, CLICommand& command) {
-        string option_name = CLIOption::parse_name(argv[current_index]);
-
-        // Find the option in the command
-        for (auto& option : command.options) {
-            if (option.equals(option_name)) {
-                if (option.flag_option) {
-                    command.set_option_value(option_name, "true"); // Flag options when present in the args are always `true`
-                    return 0; // No additional arguments consumed
-                }
-                // Option expects a value
-                if(current_index + 1 < argc && !is_option(argv[current_index + 1])) {
-                    command.set_option_value(option_name, argv[current_index + 1]);
-                    return 1; // One additional argument consumed
-                } else {
-                    std::println("Option {} requires a value.", argv[current_index]);
-                    return -1;
-                }
+    // Returns how many extra arguments were consumed, or -1 on error.
+    i32 parse_option(i32 argc, char* argv[], i32 current_index, CLICommand& command) {
+        Str arg = Str::from_cstr(argv[current_index]);
+
+        // `--name=value` carries its value in the same argument.
+        Str name = arg;
+        std::optional<Str> inline_value = std::nullopt;
+        auto equals = arg.find('=');
+        if (arg.starts_with(Str::lit("--")) && equals.has_value()) {
+            name = arg.slice(0, equals.value());
+            inline_value = arg.slice(equals.value() + 1);
+        }
+
+        CLIOption* option = command.find_option(name);
+        if (!option) {
+            std::println("Unknown option: {}", argv[current_index]);
+            return -1;
+        }
+
+        if (!option->takes_value()) {
+            if (inline_value.has_value()) {
+                std::println("Option {} does not take a value.", argv[current_index]);
+                return -1;
+            }
+            // Flag options when present in the args are always `true`
+            option->present = true;
+            option->set_value(Str::lit("true"));
+            return 0;
+        }
+
+        i32 consumed = 0;
+        if (!inline_value.has_value()) {
+            if (current_index + 1 >= argc || is_option(argv[current_index + 1])) {
+                std::println("Option {} requires a value.", argv[current_index]);
+                return -1;
             }
+            inline_value = Str::from_cstr(argv[current_index + 1]);
+            consumed = 1;
+        }
+
+        if (!option->set_value(inline_value.value())) {
+            std::print(
+                "Invalid value '{}' for {}",
+                argv[current_index + consumed],
+                argv[current_index]
+            );
+            print_value_hint(*option);
+            std::println("");
+            return -1;
         }
 
-        std::println("Unknown option: {}", argv[current_index]);
-        return -1; // Error
+        option->present = true;
+        return consumed;
     }
 
-    std::optional<CLICommand> find_command(string name) {
-        for (auto& command : commands) {
-            if (string_equals(command.name, name)) {
-                return command;
+    CLICommand* find_command(Str name) {
+        for (u32 i = 0; i < command_count; i++) {
+            if (name.equals(Str::from_cstr(commands[i]->name))) {
+                return commands[i];
             }
         }
 
-        return std::nullopt;
+        return nullptr;
+    }
+
+    static void print_value_hint(const CLIOption& option) {
+        switch (option.type) {
+            case CLI_FLAG:
+                break;
+            case CLI_STRING:
+                std::print(" <value>");
+                break;
+            case CLI_INT:
+                std::print(" <int>");
+                break;
+            case CLI_FLOAT:
+                std::print(" <float>");
+                break;
+            case CLI_ENUM:
+                std::print(" <");
+                for (u32 i = 0; i < option.choice_count; i++) {
+                    std::print("{}{}", i > 0 ? "|" : "", option.choices[i]);
+                }
+                std::print(">");
+                break;
+            case CLI_LIST:
+                std::print(" <n,n,...>");
+                break;
+        }
     }
 
-    bool is_option(char* arg) { return arg[0] == '-'; }
+    // Negative numbers are values, not options.
+    static bool is_option(string arg) {
+        return arg[0] == '-' && arg[1] != '\0' && !(arg[1] >= '0' && arg[1] <= '9') &&
+               arg[1] != '.';
+    }
 };
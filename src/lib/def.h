@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <utility>
 
@@ -31,12 +32,13 @@ template <typename F> struct Defer {
 
 template <typename F> Defer<F> makeDefer(F f) { return Defer<F>(f); };
 
-#define __defer(line) defer_##line
-#define _defer(line) __defer(line)
+// Not `__defer`: glibc's pthread.h declares a member with that name.
+#define DEFER_NAME_(line) defer_##line
+#define DEFER_NAME(line) DEFER_NAME_(line)
 
 struct defer_dummy {};
 template <typename F> Defer<F> operator+(defer_dummy, F&& f) {
     return makeDefer<F>(std::forward<F>(f));
 }
 
-#define defer auto _defer(__LINE__) = defer_dummy() + [&]()
+#define defer auto DEFER_NAME(__LINE__) = defer_dummy() + [&]()
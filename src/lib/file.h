@@ -4,6 +4,23 @@
 #include "def.h"
 #include <cstdio>
 #include <optional>
+#include <span>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+// Otherwise the min and max macros break Vec3::min, F32x4::max and friends.
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 struct File {
     char* data;
@@ -127,3 +144,138 @@ struct File {
         return data ? data : "";
     }
 };
+
+/// @brief How a mapped file is going to be read, forwarded to the kernel as a paging hint.
+enum MappedFileAccess {
+    MAPPED_FILE_SEQUENTIAL,
+    MAPPED_FILE_RANDOM,
+};
+
+/// @brief Read-only memory mapping of a whole file. The bytes are paged in straight from the
+/// page cache, so they can be handed to the GPU API without an allocation or a copy. Unlike
+/// `File` the contents are not null terminated.
+struct MappedFile {
+    const u8* data;
+    usize size;
+#ifdef _WIN32
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+#endif
+
+    /// @brief Maps the file at `filepath` into memory
+    /// @param filepath Path to the file to map
+    /// @param access Expected access pattern, sequential also asks for read-ahead
+    /// @param populate Fault every page in up front (MAP_POPULATE) instead of on first touch
+    /// @return The mapping, or nullopt if the file is missing, empty or cannot be mapped
+    static std::optional<MappedFile>
+    open(string filepath, MappedFileAccess access = MAPPED_FILE_SEQUENTIAL, bool populate = false) {
+        if (!filepath) {
+            return std::nullopt;
+        }
+
+#ifdef _WIN32
+        (void)populate;
+
+        DWORD flags = access == MAPPED_FILE_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN
+                                                       : FILE_FLAG_RANDOM_ACCESS;
+        HANDLE file_handle = CreateFileA(
+            filepath,
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            flags,
+            nullptr
+        );
+        if (file_handle == INVALID_HANDLE_VALUE) {
+            return std::nullopt;
+        }
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart <= 0) {
+            CloseHandle(file_handle);
+            return std::nullopt;
+        }
+
+        HANDLE mapping_handle =
+            CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping_handle) {
+            CloseHandle(file_handle);
+            return std::nullopt;
+        }
+
+        void* view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            CloseHandle(mapping_handle);
+            CloseHandle(file_handle);
+            return std::nullopt;
+        }
+
+        return MappedFile{
+            .data = (const u8*)view,
+            .size = (usize)file_size.QuadPart,
+            .file_handle = file_handle,
+            .mapping_handle = mapping_handle,
+        };
+#else
+        int fd = ::open(filepath, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return std::nullopt;
+        }
+
+        // The mapping keeps its own reference to the file.
+        defer { close(fd); };
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+            return std::nullopt;
+        }
+
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (populate) flags |= MAP_POPULATE;
+#else
+        (void)populate;
+#endif
+
+        void* view = mmap(nullptr, (usize)info.st_size, PROT_READ, flags, fd, 0);
+        if (view == MAP_FAILED) {
+            return std::nullopt;
+        }
+
+        if (access == MAPPED_FILE_SEQUENTIAL) {
+            madvise(view, (usize)info.st_size, MADV_SEQUENTIAL);
+            madvise(view, (usize)info.st_size, MADV_WILLNEED);
+        } else {
+            madvise(view, (usize)info.st_size, MADV_RANDOM);
+        }
+
+        return MappedFile{
+            .data = (const u8*)view,
+            .size = (usize)info.st_size,
+        };
+#endif
+    }
+
+    /// @brief Unmaps the file. The bytes must not be used afterwards.
+    void deinit() {
+        if (!data) {
+            return;
+        }
+
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(mapping_handle);
+        CloseHandle(file_handle);
+#else
+        munmap((void*)data, size);
+#endif
+
+        data = nullptr;
+        size = 0;
+    }
+
+    std::span<const u8> bytes() const { return std::span<const u8>(data, size); }
+
+    bool is_valid() const { return data != nullptr && size > 0; }
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "def.h"
+
+constexpr u64 FNV1A_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr u64 FNV1A_PRIME = 0x100000001b3ull;
+
+/// @brief 64-bit FNV-1a hash of a byte range.
+/// @param seed Previous hash to continue from, or FNV1A_OFFSET_BASIS.
+inline u64 hash_bytes(const void* data, usize size, u64 seed = FNV1A_OFFSET_BASIS) {
+    const u8* bytes = (const u8*)data;
+    u64 hash = seed;
+
+    for (usize i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV1A_PRIME;
+    }
+
+    return hash;
+}
+
+/// @brief Mixes `value` into `hash`. Used to hash structs field by field so padding bytes
+/// never affect the result.
+inline u64 hash_combine(u64 hash, u64 value) {
+    return hash_bytes(&value, sizeof(value), hash);
+}
+
+/// @brief FNV-1a over characters, usable in constant expressions. Matches `hash_bytes` over the
+/// same bytes.
+constexpr u64 hash_chars(const char* data, usize size, u64 seed = FNV1A_OFFSET_BASIS) {
+    u64 hash = seed;
+
+    for (usize i = 0; i < size; i++) {
+        hash ^= (u8)data[i];
+        hash *= FNV1A_PRIME;
+    }
+
+    return hash;
+}
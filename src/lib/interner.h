@@ -0,0 +1,201 @@
+#pragma once
+
+#include "allocator.h"
+#include "def.h"
+#include "hash.h"
+#include "str.h"
+#include <SDL3/SDL.h>
+#include <cstring>
+#include <optional>
+
+typedef u32 StringId;
+
+constexpr StringId STRING_ID_NONE = 0xFFFFFFFF;
+
+/// @brief A string together with its precomputed name hash.
+struct HashedStr {
+    Str str;
+    u64 hash;
+};
+
+inline u64 intern_hash(Str str) { return hash_chars(str.data, str.len); }
+
+/// @brief Hashes a literal at compile time, so interning or looking it up skips the hash.
+template <usize N> consteval HashedStr hashed(const char (&literal)[N]) {
+    return HashedStr{Str::lit(literal), hash_chars(literal, N - 1)};
+}
+
+/// @brief Maps strings to dense IDs starting at 0. Interned bytes live in an arena for the
+/// interner's lifetime, so views returned by `get` never move, and each one is followed by a
+/// null terminator so `get(id).data` is also a C string.
+///
+/// Lookups take a shared lock and only a miss takes the exclusive one, so concurrent readers
+/// of already interned names do not contend.
+struct StringInterner {
+    struct Slot {
+        u64 hash;
+        StringId id;
+    };
+
+    Allocator allocator;
+    ArenaAllocator bytes;
+
+    // Open addressing with linear probing, `slot_capacity` is a power of two.
+    Slot* slots;
+    u32 slot_capacity;
+
+    Str* strings;
+    u32 count;
+    u32 string_capacity;
+
+    SDL_RWLock* lock;
+
+    /// @brief Initialized in place, it is usually placed in memory from `Allocator::create`.
+    /// @return False if the lock or the tables could not be created; `deinit` cleans up.
+    bool init(Allocator allocator, u32 initial_capacity = 256) {
+        lock = SDL_CreateRWLock();
+        this->allocator = allocator;
+        bytes = ArenaAllocator::init(allocator, KB(16));
+
+        slot_capacity = 16;
+        while (slot_capacity < initial_capacity * 2) {
+            slot_capacity *= 2;
+        }
+        slots = allocator.alloc_array<Slot>(slot_capacity);
+        for (u32 i = 0; slots && i < slot_capacity; i++) {
+            slots[i].id = STRING_ID_NONE;
+        }
+
+        string_capacity = initial_capacity;
+        strings = allocator.alloc_array<Str>(string_capacity);
+        count = 0;
+
+        return lock && slots && strings;
+    }
+
+    void deinit() {
+        allocator.free_array(slots, slot_capacity);
+        allocator.free_array(strings, string_capacity);
+        bytes.deinit();
+        slots = nullptr;
+        strings = nullptr;
+        count = 0;
+        SDL_DestroyRWLock(lock);
+        lock = nullptr;
+    }
+
+    /// @brief Returns the ID of `str`, interning a copy first if it is new. Thread-safe.
+    /// @return STRING_ID_NONE if a new string could not be stored.
+    StringId intern(HashedStr str) {
+        SDL_LockRWLockForReading(lock);
+        StringId id = find_locked(str);
+        SDL_UnlockRWLock(lock);
+        if (id != STRING_ID_NONE) return id;
+
+        SDL_LockRWLockForWriting(lock);
+        defer { SDL_UnlockRWLock(lock); };
+        // Another thread may have inserted it between the two locks.
+        id = find_locked(str);
+        if (id != STRING_ID_NONE) return id;
+
+        return insert_locked(str);
+    }
+
+    StringId intern(Str str) { return intern(HashedStr{str, intern_hash(str)}); }
+    StringId intern(string str) { return intern(Str::from_cstr(str)); }
+
+    /// @brief Looks `str` up without interning it. Thread-safe.
+    std::optional<StringId> find(HashedStr str) const {
+        SDL_LockRWLockForReading(lock);
+        defer { SDL_UnlockRWLock(lock); };
+        StringId id = find_locked(str);
+        if (id == STRING_ID_NONE) return std::nullopt;
+        return id;
+    }
+
+    std::optional<StringId> find(Str str) const { return find(HashedStr{str, intern_hash(str)}); }
+
+    /// @brief The interned bytes of `id`. Thread-safe, the view stays valid until `deinit`.
+    Str get(StringId id) const {
+        SDL_LockRWLockForReading(lock);
+        defer { SDL_UnlockRWLock(lock); };
+        if (id >= count) return Str::lit("");
+        return strings[id];
+    }
+
+    u32 size() const {
+        SDL_LockRWLockForReading(lock);
+        defer { SDL_UnlockRWLock(lock); };
+        return count;
+    }
+
+  private:
+    StringId find_locked(HashedStr str) const {
+        u32 mask = slot_capacity - 1;
+        for (u32 i = (u32)str.hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots[i];
+            if (slot.id == STRING_ID_NONE) return STRING_ID_NONE;
+            if (slot.hash == str.hash && strings[slot.id].equals(str.str)) return slot.id;
+        }
+    }
+
+    // Nothing changes unless every allocation succeeds, so a failed insert leaves the
+    // interner as it was. The copied bytes stay in the arena either way.
+    StringId insert_locked(HashedStr str) {
+        char* copy = bytes.allocator().alloc_array<char>(str.str.len + 1);
+        if (!copy) return STRING_ID_NONE;
+        if (str.str.len > 0) memcpy(copy, str.str.data, str.str.len);
+        copy[str.str.len] = '\0';
+
+        if (count == string_capacity) {
+            u32 new_capacity = string_capacity * 2;
+            Str* grown = (Str*)allocator.realloc(
+                strings,
+                string_capacity * sizeof(Str),
+                new_capacity * sizeof(Str),
+                alignof(Str)
+            );
+            if (!grown) return STRING_ID_NONE;
+            strings = grown;
+            string_capacity = new_capacity;
+        }
+
+        // Keep the load factor at or under 1/2.
+        if ((count + 1) * 2 > slot_capacity && !grow_slots()) return STRING_ID_NONE;
+
+        StringId id = count++;
+        strings[id] = Str::init(copy, str.str.len);
+        place(str.hash, id);
+
+        return id;
+    }
+
+    void place(u64 hash, StringId id) {
+        u32 mask = slot_capacity - 1;
+        u32 i = (u32)hash & mask;
+        while (slots[i].id != STRING_ID_NONE) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = Slot{.hash = hash, .id = id};
+    }
+
+    bool grow_slots() {
+        Slot* grown = allocator.alloc_array<Slot>(slot_capacity * 2);
+        if (!grown) return false;
+
+        Slot* old_slots = slots;
+        u32 old_capacity = slot_capacity;
+        slots = grown;
+        slot_capacity *= 2;
+        for (u32 i = 0; i < slot_capacity; i++) {
+            slots[i].id = STRING_ID_NONE;
+        }
+
+        for (u32 i = 0; i < old_capacity; i++) {
+            if (old_slots[i].id != STRING_ID_NONE) place(old_slots[i].hash, old_slots[i].id);
+        }
+
+        allocator.free_array(old_slots, old_capacity);
+        return true;
+    }
+};
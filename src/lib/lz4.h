@@ -0,0 +1,188 @@
+#pragma once
+
+#include "def.h"
+#include <cstring>
+
+// LZ4 block format: a stream of sequences, each a token byte (literal length << 4 | match
+// length - 4), optional 255-run length extensions, the literals, and a 16-bit match offset.
+// The last sequence carries literals only.
+
+constexpr usize LZ4_MIN_MATCH = 4;
+// The last match must start this many bytes before the end of the input.
+constexpr usize LZ4_MATCH_FIND_LIMIT = 12;
+// The last bytes of the input are always emitted as literals.
+constexpr usize LZ4_LAST_LITERALS = 5;
+constexpr usize LZ4_MAX_OFFSET = 65535;
+constexpr u32 LZ4_HASH_BITS = 12;
+
+/// @brief Worst-case compressed size of `size` incompressible bytes.
+constexpr usize lz4_compress_bound(usize size) { return size + size / 255 + 16; }
+
+namespace lz4 {
+
+inline u32 read_u32(const u8* p) {
+    u32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline u32 hash(u32 sequence) { return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS); }
+
+// Writes the 255-run extension of a length that did not fit its 4-bit token field.
+inline bool write_length(u8*& op, const u8* op_end, usize length) {
+    while (length >= 255) {
+        if (op >= op_end) return false;
+        *op++ = 255;
+        length -= 255;
+    }
+    if (op >= op_end) return false;
+    *op++ = (u8)length;
+    return true;
+}
+
+inline bool write_sequence(
+    u8*& op,
+    const u8* op_end,
+    const u8* literals,
+    usize literal_length,
+    usize offset,
+    usize match_length
+) {
+    if (op >= op_end) return false;
+    u8* token = op++;
+
+    *token = (u8)((literal_length < 15 ? literal_length : 15) << 4);
+    if (literal_length >= 15 && !write_length(op, op_end, literal_length - 15)) return false;
+
+    if ((usize)(op_end - op) < literal_length) return false;
+    memcpy(op, literals, literal_length);
+    op += literal_length;
+
+    // Literal-only final sequence.
+    if (match_length == 0) return true;
+
+    if (op_end - op < 2) return false;
+    *op++ = (u8)(offset & 0xFF);
+    *op++ = (u8)(offset >> 8);
+
+    usize match_code = match_length - LZ4_MIN_MATCH;
+    *token |= (u8)(match_code < 15 ? match_code : 15);
+    if (match_code >= 15 && !write_length(op, op_end, match_code - 15)) return false;
+
+    return true;
+}
+
+// Reads a 255-run length extension.
+inline bool read_length(const u8*& ip, const u8* ip_end, usize& length) {
+    u8 byte;
+    do {
+        if (ip >= ip_end) return false;
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace lz4
+
+/// @brief Compresses `src` into an LZ4 block. Greedy single-probe matcher, it favours speed
+/// and a small footprint over ratio.
+/// @return Size of the compressed block, or 0 if it does not fit in `dst_capacity`.
+inline usize lz4_compress(const u8* src, usize src_size, u8* dst, usize dst_capacity) {
+    u8* op = dst;
+    const u8* op_end = dst + dst_capacity;
+    usize anchor = 0;
+
+    if (src_size > LZ4_MATCH_FIND_LIMIT) {
+        // Positions are stored +1 so zero means empty.
+        u32 table[1 << LZ4_HASH_BITS] = {};
+        usize match_find_end = src_size - LZ4_MATCH_FIND_LIMIT;
+        usize match_end = src_size - LZ4_LAST_LITERALS;
+
+        usize ip = 0;
+        while (ip < match_find_end) {
+            u32 sequence = lz4::read_u32(src + ip);
+            u32 h = lz4::hash(sequence);
+            usize candidate = table[h];
+            table[h] = (u32)(ip + 1);
+
+            bool found = candidate != 0 && ip - (candidate - 1) <= LZ4_MAX_OFFSET &&
+                         lz4::read_u32(src + candidate - 1) == sequence;
+            if (!found) {
+                ip++;
+                continue;
+            }
+
+            usize match = candidate - 1;
+            usize length = LZ4_MIN_MATCH;
+            while (ip + length < match_end && src[match + length] == src[ip + length]) {
+                length++;
+            }
+
+            bool written = lz4::write_sequence(
+                op,
+                op_end,
+                src + anchor,
+                ip - anchor,
+                ip - match,
+                length
+            );
+            if (!written) return 0;
+
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    if (!lz4::write_sequence(op, op_end, src + anchor, src_size - anchor, 0, 0)) return 0;
+    return (usize)(op - dst);
+}
+
+/// @brief Decompresses an LZ4 block, checking every read and write against the buffer bounds
+/// so corrupt input cannot overrun them.
+/// @return True if the block decoded to exactly `dst_size` bytes.
+inline bool lz4_decompress(const u8* src, usize src_size, u8* dst, usize dst_size) {
+    const u8* ip = src;
+    const u8* ip_end = src + src_size;
+    u8* op = dst;
+    u8* op_end = dst + dst_size;
+
+    while (ip < ip_end) {
+        u8 token = *ip++;
+
+        usize literal_length = token >> 4;
+        if (literal_length == 15 && !lz4::read_length(ip, ip_end, literal_length)) return false;
+        if ((usize)(ip_end - ip) < literal_length || (usize)(op_end - op) < literal_length) {
+            return false;
+        }
+        memcpy(op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        // The last sequence has no match.
+        if (ip == ip_end) break;
+
+        if (ip_end - ip < 2) return false;
+        usize offset = (usize)ip[0] | ((usize)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (usize)(op - dst)) return false;
+
+        usize match_length = token & 15;
+        if (match_length == 15 && !lz4::read_length(ip, ip_end, match_length)) return false;
+        match_length += LZ4_MIN_MATCH;
+        if ((usize)(op_end - op) < match_length) return false;
+
+        // Matches may overlap their own output, so copy forwards byte by byte in that case.
+        const u8* match = op - offset;
+        if (offset >= match_length) {
+            memcpy(op, match, match_length);
+            op += match_length;
+        } else {
+            for (usize i = 0; i < match_length; i++) {
+                *op++ = match[i];
+            }
+        }
+    }
+
+    return op == op_end;
+}
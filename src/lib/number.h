@@ -1,8 +1,12 @@
 #pragma once
 
+#include "array.h"
 #include "def.h"
-#include <cmath>
+#include "str.h"
+#include <charconv>
 #include <cstdint>
+#include <cstdlib>
+#include <expected>
 #include <limits>
 #include <optional>
 
@@ -11,56 +15,279 @@ concept IntegerType =
     std::same_as<T, i8> || std::same_as<T, i16> || std::same_as<T, i32> || std::same_as<T, i64> ||
     std::same_as<T, u8> || std::same_as<T, u16> || std::same_as<T, u32> || std::same_as<T, u64>;
 
-/// @brief Converts a string to an integer.
+template <typename T>
+concept FloatType = std::same_as<T, f32> || std::same_as<T, f64>;
+
+// Floating-point from_chars is missing from older standard libraries (libc++ before 20), which
+// fall back to strtod on a stack copy of the token. That path is locale dependent.
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#define NUMBER_FLOAT_FROM_CHARS 1
+#else
+#define NUMBER_FLOAT_FROM_CHARS 0
+#endif
+
+enum NumberParseError {
+    NUMBER_PARSE_INVALID,
+    NUMBER_PARSE_OUT_OF_RANGE,
+    NUMBER_PARSE_OUT_OF_MEMORY,
+};
+
+inline string to_string(NumberParseError error) {
+    switch (error) {
+        case NUMBER_PARSE_INVALID:
+            return "Not a number";
+        case NUMBER_PARSE_OUT_OF_RANGE:
+            return "Number out of range";
+        case NUMBER_PARSE_OUT_OF_MEMORY:
+            return "Out of memory";
+        default:
+            return "Unknown error";
+    }
+}
+
+/// @brief Result of parsing one number from the front of a span.
+template <typename T> struct NumberPrefix {
+    T value;
+    // Bytes consumed, at least one.
+    usize len;
+};
+
+// Separator scanning for the bulk parsers: whitespace and commas. Same dispatch as str_simd,
+// SSE2 always, AVX2 when the CPU has it.
+namespace number_simd {
+
+inline bool is_separator(char c) { return Str::is_space(c) || c == ','; }
+
+inline usize skip_separators_scalar(const char* data, usize len) {
+    usize i = 0;
+    while (i < len && is_separator(data[i])) {
+        i++;
+    }
+    return i;
+}
+
+#if STR_SIMD_X86
+// '\t' through '\r' are 9..13, so a byte b is one of them when (u8)(b - 9) <= 4.
+inline usize skip_separators_sse2(const char* data, usize len) {
+    __m128i control_base = _mm_set1_epi8(9);
+    __m128i control_span = _mm_set1_epi8(4);
+    __m128i space = _mm_set1_epi8(' ');
+    __m128i comma = _mm_set1_epi8(',');
+
+    usize i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i offset = _mm_sub_epi8(block, control_base);
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(offset, control_span), offset);
+        __m128i separator = _mm_or_si128(
+            control,
+            _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, comma))
+        );
+
+        u32 mask = ~(u32)_mm_movemask_epi8(separator) & 0xFFFF;
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + skip_separators_scalar(data + i, len - i);
+}
+
+__attribute__((target("avx2"))) inline usize skip_separators_avx2(const char* data, usize len) {
+    __m256i control_base = _mm256_set1_epi8(9);
+    __m256i control_span = _mm256_set1_epi8(4);
+    __m256i space = _mm256_set1_epi8(' ');
+    __m256i comma = _mm256_set1_epi8(',');
+
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i offset = _mm256_sub_epi8(block, control_base);
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, control_span), offset);
+        __m256i separator = _mm256_or_si256(
+            control,
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, comma))
+        );
+
+        u32 mask = ~(u32)_mm256_movemask_epi8(separator);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + skip_separators_sse2(data + i, len - i);
+}
+#endif
+
+/// @brief Number of leading whitespace and comma bytes in `data`.
+inline usize skip_separators(const char* data, usize len) {
+#if STR_SIMD_X86
+    // Values are usually one separator apart, so check the next byte before going wide.
+    if (len == 0 || !is_separator(data[0])) return 0;
+    if (len == 1 || !is_separator(data[1])) return 1;
+    return str_simd::has_avx2() ? skip_separators_avx2(data, len)
+                                : skip_separators_sse2(data, len);
+#else
+    return skip_separators_scalar(data, len);
+#endif
+}
+
+} // namespace number_simd
+
+/// @brief Parses the integer at the start of `str`, stopping at the first byte that is not
+/// part of it. Accepts an optional leading sign and covers the full range of T, including
+/// u64 values above INT64_MAX. Does not skip leading whitespace.
+template <IntegerType T>
+inline std::expected<NumberPrefix<T>, NumberParseError> int_prefix(Str str, i32 base = 10) {
+    const char* begin = str.data;
+    const char* end = str.data + str.len;
+    // from_chars takes '-' but not '+'.
+    if (begin < end && *begin == '+' && begin + 1 < end && begin[1] != '-') begin++;
+
+    T value;
+    auto result = std::from_chars(begin, end, value, base);
+    if (result.ec == std::errc::result_out_of_range) {
+        return std::unexpected(NUMBER_PARSE_OUT_OF_RANGE);
+    }
+    if (result.ec != std::errc{}) return std::unexpected(NUMBER_PARSE_INVALID);
+
+    return NumberPrefix<T>{value, (usize)(result.ptr - str.data)};
+}
+
+/// @brief Parses the floating-point number at the start of `str`, stopping at the first byte
+/// that is not part of it. Always uses '.' as the decimal point regardless of the C locale,
+/// and rounds straight to T, so an f32 is not rounded twice through double.
+template <FloatType T>
+inline std::expected<NumberPrefix<T>, NumberParseError> float_prefix(Str str) {
+    const char* begin = str.data;
+    const char* end = str.data + str.len;
+    if (begin < end && *begin == '+' && begin + 1 < end && begin[1] != '-') begin++;
+
+#if NUMBER_FLOAT_FROM_CHARS
+    T value;
+    auto result = std::from_chars(begin, end, value);
+    if (result.ec == std::errc::result_out_of_range) {
+        return std::unexpected(NUMBER_PARSE_OUT_OF_RANGE);
+    }
+    if (result.ec != std::errc{}) return std::unexpected(NUMBER_PARSE_INVALID);
+
+    return NumberPrefix<T>{value, (usize)(result.ptr - str.data)};
+#else
+    // strtod needs a terminator. Anything longer than this is not a sensible literal.
+    char buffer[128];
+    usize token_len = 0;
+    while (begin + token_len < end && token_len < sizeof(buffer) - 1) {
+        char c = begin[token_len];
+        bool token_char = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+                          (c >= 'A' && c <= 'Z') || c == '.' || c == '+' || c == '-';
+        if (!token_char) break;
+        buffer[token_len++] = c;
+    }
+    buffer[token_len] = '\0';
+
+    char* parsed_end;
+    T value = std::same_as<T, f32> ? strtof(buffer, &parsed_end) : strtod(buffer, &parsed_end);
+    if (parsed_end == buffer) return std::unexpected(NUMBER_PARSE_INVALID);
+    if (value == std::numeric_limits<T>::infinity() ||
+        value == -std::numeric_limits<T>::infinity()) {
+        bool literal_infinity = (buffer[0] == '-' ? buffer[1] : buffer[0]) == 'i' ||
+                                (buffer[0] == '-' ? buffer[1] : buffer[0]) == 'I';
+        if (!literal_infinity) return std::unexpected(NUMBER_PARSE_OUT_OF_RANGE);
+    }
+
+    return NumberPrefix<T>{value, (usize)(begin - str.data) + (usize)(parsed_end - buffer)};
+#endif
+}
+
+/// @brief Converts a string to an integer. The whole span must be the number.
 /// @tparam T The integer type to convert to.
-/// @param str The input string to convert.
+/// @param str The input to convert, not required to be null terminated.
 /// @return The converted integer, or std::nullopt if the conversion failed.
-template <IntegerType T> inline std::optional<T> int_from_str(string str) {
-    char* endptr;
-    int64_t num = strtol(str, &endptr, 10);
-    if (endptr == str || *endptr != '\0') {
+template <IntegerType T> inline std::optional<T> int_from_str(Str str, i32 base = 10) {
+    auto result = int_prefix<T>(str, base);
+    if (!result.has_value() || result->len != str.len) {
         return std::nullopt;
     }
 
-    // Check bounds for the target type
-    if constexpr (std::is_signed_v<T>) {
-        if (num < std::numeric_limits<T>::min() || num > std::numeric_limits<T>::max()) {
-            return std::nullopt;
-        }
-    } else {
-        if (num < 0 || static_cast<u64>(num) > std::numeric_limits<T>::max()) {
-            return std::nullopt;
-        }
-    }
-
-    return static_cast<T>(num);
+    return result->value;
 }
 
-template <typename T>
-concept FloatType = std::same_as<T, f32> || std::same_as<T, f64>;
+template <IntegerType T> inline std::optional<T> int_from_str(string str, i32 base = 10) {
+    return int_from_str<T>(Str::from_cstr(str), base);
+}
 
-/// @brief Converts a string to a floating-point number.
+/// @brief Converts a string to a floating-point number. The whole span must be the number.
 /// @tparam T The floating-point type to convert to.
-/// @param str The input string to convert.
+/// @param str The input to convert, not required to be null terminated.
 /// @return The converted floating-point number, or std::nullopt if the conversion failed.
-template <FloatType T> inline std::optional<T> float_from_str(string str) {
-    char* endptr;
-    double num = strtod(str, &endptr);
-    if (endptr == str || *endptr != '\0') {
+template <FloatType T> inline std::optional<T> float_from_str(Str str) {
+    auto result = float_prefix<T>(str);
+    if (!result.has_value() || result->len != str.len) {
         return std::nullopt;
     }
 
-    // Check for overflow/underflow
-    if (num == HUGE_VAL || num == -HUGE_VAL) {
-        return std::nullopt;
+    return result->value;
+}
+
+template <FloatType T> inline std::optional<T> float_from_str(string str) {
+    return float_from_str<T>(Str::from_cstr(str));
+}
+
+/// @brief Reads numbers one after another from a buffer in which they are separated by
+/// whitespace and/or commas, like vertex data or a CSV row. Nothing is copied.
+struct NumberScanner {
+    Str text;
+    usize cursor;
+
+    static NumberScanner init(Str text) { return NumberScanner{.text = text, .cursor = 0}; }
+
+    /// @brief Skips separators, then reports whether any input is left.
+    bool at_end() {
+        cursor += number_simd::skip_separators(text.data + cursor, text.len - cursor);
+        return cursor >= text.len;
+    }
+
+    /// @brief Parses the next number, which must be followed by a separator or the end of the
+    /// input. On failure the cursor stays at the start of the bad token.
+    template <FloatType T> std::expected<T, NumberParseError> next_float() {
+        return next<T>([](Str rest) { return float_prefix<T>(rest); });
     }
 
-    // Check bounds for f32
-    if constexpr (std::same_as<T, f32>) {
-        if (num > std::numeric_limits<f32>::max() || num < std::numeric_limits<f32>::lowest()) {
-            return std::nullopt;
+    template <IntegerType T> std::expected<T, NumberParseError> next_int(i32 base = 10) {
+        return next<T>([base](Str rest) { return int_prefix<T>(rest, base); });
+    }
+
+  private:
+    template <typename T, typename Parse> std::expected<T, NumberParseError> next(Parse parse) {
+        if (at_end()) return std::unexpected(NUMBER_PARSE_INVALID);
+
+        auto result = parse(text.slice(cursor));
+        if (!result.has_value()) return std::unexpected(result.error());
+
+        // "1.5x" is a bad token, not 1.5 followed by garbage.
+        usize end = cursor + result->len;
+        if (end < text.len && !number_simd::is_separator(text[end])) {
+            return std::unexpected(NUMBER_PARSE_INVALID);
+        }
+
+        cursor = end;
+        return result->value;
+    }
+};
+
+/// @brief Parses every number in `text` and appends them to `out`. Numbers are separated by
+/// whitespace and/or commas.
+/// @param error_offset Receives the byte offset of the first bad token on failure.
+/// @return How many values were appended. On failure the values before the bad token are
+/// still in `out`.
+template <FloatType T>
+inline std::expected<usize, NumberParseError>
+floats_from_str(Str text, ArrayList<T>& out, usize* error_offset = nullptr) {
+    NumberScanner scanner = NumberScanner::init(text);
+    usize count = 0;
+
+    while (!scanner.at_end()) {
+        auto value = scanner.next_float<T>();
+        if (!value.has_value() || !out.append(value.value())) {
+            if (error_offset) *error_offset = scanner.cursor;
+            return std::unexpected(value.has_value() ? NUMBER_PARSE_OUT_OF_MEMORY : value.error());
         }
+        count++;
     }
 
-    return static_cast<T>(num);
+    return count;
 }
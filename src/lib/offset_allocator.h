@@ -0,0 +1,361 @@
+#pragma once
+
+#include "allocator.h"
+#include "def.h"
+#include <bit>
+#include <optional>
+
+// Two-level segregated fit allocator for ranges inside a larger resource, such as a GPU buffer.
+// It never touches the memory it manages, it only hands out offsets. Sizes are binned with a
+// small float (5 bit exponent, 3 bit mantissa) giving 32 top bins of 8 leaf bins each, so
+// finding a fitting bin is two bit scans and both allocate and free are O(1).
+
+namespace small_float {
+constexpr u32 MANTISSA_BITS = 3;
+constexpr u32 MANTISSA_VALUE = 1 << MANTISSA_BITS;
+constexpr u32 MANTISSA_MASK = MANTISSA_VALUE - 1;
+
+/// @brief Bin index of the smallest bin whose sizes are all >= `size`.
+inline u32 uint_to_float_round_up(u32 size) {
+    u32 exp = 0;
+    u32 mantissa = 0;
+
+    if (size < MANTISSA_VALUE) {
+        mantissa = size;
+    } else {
+        u32 highest_set_bit = 31 - std::countl_zero(size);
+        u32 mantissa_start_bit = highest_set_bit - MANTISSA_BITS;
+        exp = mantissa_start_bit + 1;
+        mantissa = (size >> mantissa_start_bit) & MANTISSA_MASK;
+
+        u32 low_bits_mask = (1u << mantissa_start_bit) - 1;
+        if ((size & low_bits_mask) != 0) mantissa++;
+    }
+
+    // `+` instead of `|` so a mantissa overflow carries into the exponent.
+    return (exp << MANTISSA_BITS) + mantissa;
+}
+
+/// @brief Bin index of the largest bin whose sizes are all <= `size`.
+inline u32 uint_to_float_round_down(u32 size) {
+    u32 exp = 0;
+    u32 mantissa = 0;
+
+    if (size < MANTISSA_VALUE) {
+        mantissa = size;
+    } else {
+        u32 highest_set_bit = 31 - std::countl_zero(size);
+        u32 mantissa_start_bit = highest_set_bit - MANTISSA_BITS;
+        exp = mantissa_start_bit + 1;
+        mantissa = (size >> mantissa_start_bit) & MANTISSA_MASK;
+    }
+
+    return (exp << MANTISSA_BITS) | mantissa;
+}
+
+inline u32 float_to_uint(u32 value) {
+    u32 exp = value >> MANTISSA_BITS;
+    u32 mantissa = value & MANTISSA_MASK;
+
+    if (exp == 0) return mantissa;
+    return (mantissa | MANTISSA_VALUE) << (exp - 1);
+}
+} // namespace small_float
+
+/// @brief Handle to an allocated range. `node` identifies the allocation for `free`.
+struct OffsetAllocation {
+    u32 offset;
+    u32 node;
+};
+
+/// @brief Snapshot of free space, used to decide when a heap needs defragmenting.
+struct OffsetAllocatorReport {
+    u32 total_free;
+    u32 largest_free;
+    u32 free_regions;
+    // 0 when all free space is one contiguous region, approaching 1 as it splinters.
+    f32 fragmentation;
+};
+
+struct OffsetAllocator {
+    static constexpr u32 NUM_TOP_BINS = 32;
+    static constexpr u32 BINS_PER_LEAF = 8;
+    static constexpr u32 NUM_LEAF_BINS = NUM_TOP_BINS * BINS_PER_LEAF;
+    static constexpr u32 UNUSED = 0xffffffff;
+
+    struct Node {
+        u32 data_offset;
+        u32 data_size;
+        // Doubly linked list of free nodes in the same bin.
+        u32 bin_list_prev;
+        u32 bin_list_next;
+        // Address-ordered neighbors, used to merge free ranges.
+        u32 neighbor_prev;
+        u32 neighbor_next;
+        bool used;
+    };
+
+    Allocator allocator;
+    u32 size;
+    u32 max_allocations;
+    u32 free_storage;
+
+    u32 used_bins_top;
+    u8 used_bins[NUM_TOP_BINS];
+    u32 bin_indices[NUM_LEAF_BINS];
+
+    Node* nodes;
+    u32* free_nodes;
+    u32 free_node_count;
+
+    /// @brief Creates an allocator managing the range [0, size).
+    /// @param max_allocations Upper bound on live allocations plus free regions.
+    static OffsetAllocator init(Allocator allocator, u32 size, u32 max_allocations = 128 * 1024) {
+        OffsetAllocator result = {
+            .allocator = allocator,
+            .size = size,
+            .max_allocations = max_allocations,
+            .free_storage = 0,
+            .used_bins_top = 0,
+            .used_bins = {},
+            .bin_indices = {},
+            .nodes = allocator.alloc_array<Node>(max_allocations),
+            .free_nodes = allocator.alloc_array<u32>(max_allocations),
+            .free_node_count = 0,
+        };
+
+        result.reset();
+        return result;
+    }
+
+    void deinit() {
+        allocator.free_array(nodes, max_allocations);
+        allocator.free_array(free_nodes, max_allocations);
+        nodes = nullptr;
+        free_nodes = nullptr;
+    }
+
+    /// @brief Frees every allocation at once.
+    void reset() {
+        free_storage = 0;
+        used_bins_top = 0;
+
+        for (u32 i = 0; i < NUM_TOP_BINS; i++) {
+            used_bins[i] = 0;
+        }
+
+        for (u32 i = 0; i < NUM_LEAF_BINS; i++) {
+            bin_indices[i] = UNUSED;
+        }
+
+        if (!nodes || !free_nodes) return;
+
+        // Stack of free node indices, popped from the end so node 0 is handed out first.
+        for (u32 i = 0; i < max_allocations; i++) {
+            free_nodes[i] = max_allocations - i - 1;
+        }
+        free_node_count = max_allocations;
+
+        insert_node_into_bin(size, 0);
+    }
+
+    std::optional<OffsetAllocation> allocate(u32 alloc_size) {
+        // One node for the allocation and one for the remainder it may split off.
+        if (alloc_size == 0 || free_node_count < 2) return std::nullopt;
+
+        u32 min_bin_index = small_float::uint_to_float_round_up(alloc_size);
+        u32 min_top_bin_index = min_bin_index >> small_float::MANTISSA_BITS;
+        u32 min_leaf_bin_index = min_bin_index & small_float::MANTISSA_MASK;
+
+        u32 top_bin_index = min_top_bin_index;
+        u32 leaf_bin_index = UNUSED;
+
+        // Same top bin: any leaf at or above the minimum fits.
+        if (used_bins_top & (1u << top_bin_index)) {
+            leaf_bin_index =
+                find_lowest_set_bit_after(used_bins[top_bin_index], min_leaf_bin_index);
+        }
+
+        // Otherwise any leaf of the next non-empty top bin fits.
+        if (leaf_bin_index == UNUSED) {
+            top_bin_index = find_lowest_set_bit_after(used_bins_top, min_top_bin_index + 1);
+            if (top_bin_index == UNUSED) return std::nullopt;
+
+            leaf_bin_index = std::countr_zero(used_bins[top_bin_index]);
+        }
+
+        u32 bin_index = (top_bin_index << small_float::MANTISSA_BITS) | leaf_bin_index;
+
+        u32 node_index = bin_indices[bin_index];
+        Node& node = nodes[node_index];
+        u32 node_total_size = node.data_size;
+        node.data_size = alloc_size;
+        node.used = true;
+
+        bin_indices[bin_index] = node.bin_list_next;
+        if (node.bin_list_next != UNUSED) nodes[node.bin_list_next].bin_list_prev = UNUSED;
+        free_storage -= node_total_size;
+
+        if (bin_indices[bin_index] == UNUSED) {
+            used_bins[top_bin_index] &= ~(1u << leaf_bin_index);
+            if (used_bins[top_bin_index] == 0) used_bins_top &= ~(1u << top_bin_index);
+        }
+
+        // Return the tail of the region to the free bins.
+        u32 remainder_size = node_total_size - alloc_size;
+        if (remainder_size > 0) {
+            u32 new_node_index =
+                insert_node_into_bin(remainder_size, node.data_offset + alloc_size);
+
+            if (node.neighbor_next != UNUSED) {
+                nodes[node.neighbor_next].neighbor_prev = new_node_index;
+            }
+            nodes[new_node_index].neighbor_prev = node_index;
+            nodes[new_node_index].neighbor_next = node.neighbor_next;
+            node.neighbor_next = new_node_index;
+        }
+
+        return OffsetAllocation{.offset = node.data_offset, .node = node_index};
+    }
+
+    void free(OffsetAllocation allocation) {
+        if (!nodes || allocation.node == UNUSED) return;
+
+        u32 node_index = allocation.node;
+        Node& node = nodes[node_index];
+        if (!node.used) return;
+
+        u32 offset = node.data_offset;
+        u32 free_size = node.data_size;
+
+        // Merge with free neighbors on either side.
+        if (node.neighbor_prev != UNUSED && !nodes[node.neighbor_prev].used) {
+            Node& prev = nodes[node.neighbor_prev];
+            offset = prev.data_offset;
+            free_size += prev.data_size;
+
+            remove_node_from_bin(node.neighbor_prev);
+            node.neighbor_prev = prev.neighbor_prev;
+        }
+
+        if (node.neighbor_next != UNUSED && !nodes[node.neighbor_next].used) {
+            Node& next = nodes[node.neighbor_next];
+            free_size += next.data_size;
+
+            remove_node_from_bin(node.neighbor_next);
+            node.neighbor_next = next.neighbor_next;
+        }
+
+        u32 neighbor_prev = node.neighbor_prev;
+        u32 neighbor_next = node.neighbor_next;
+
+        free_nodes[free_node_count++] = node_index;
+
+        u32 combined_index = insert_node_into_bin(free_size, offset);
+        if (neighbor_next != UNUSED) {
+            nodes[combined_index].neighbor_next = neighbor_next;
+            nodes[neighbor_next].neighbor_prev = combined_index;
+        }
+        if (neighbor_prev != UNUSED) {
+            nodes[combined_index].neighbor_prev = neighbor_prev;
+            nodes[neighbor_prev].neighbor_next = combined_index;
+        }
+    }
+
+    u32 allocation_size(OffsetAllocation allocation) const {
+        if (!nodes || allocation.node == UNUSED) return 0;
+        return nodes[allocation.node].data_size;
+    }
+
+    /// @brief Walks every free region. O(free regions), meant for diagnostics, not the hot path.
+    OffsetAllocatorReport storage_report() const {
+        OffsetAllocatorReport report = {
+            .total_free = free_storage,
+            .largest_free = 0,
+            .free_regions = 0,
+            .fragmentation = 0.0f,
+        };
+
+        for (u32 bin = 0; bin < NUM_LEAF_BINS; bin++) {
+            for (u32 i = bin_indices[bin]; i != UNUSED; i = nodes[i].bin_list_next) {
+                report.free_regions++;
+                if (nodes[i].data_size > report.largest_free) {
+                    report.largest_free = nodes[i].data_size;
+                }
+            }
+        }
+
+        if (report.total_free > 0) {
+            report.fragmentation = 1.0f - (f32)report.largest_free / (f32)report.total_free;
+        }
+
+        return report;
+    }
+
+  private:
+    static u32 find_lowest_set_bit_after(u32 mask, u32 start_index) {
+        if (start_index >= 32) return UNUSED;
+
+        u32 bits = mask & ~((1u << start_index) - 1);
+        if (bits == 0) return UNUSED;
+
+        return std::countr_zero(bits);
+    }
+
+    u32 insert_node_into_bin(u32 node_size, u32 data_offset) {
+        u32 bin_index = small_float::uint_to_float_round_down(node_size);
+        u32 top_bin_index = bin_index >> small_float::MANTISSA_BITS;
+        u32 leaf_bin_index = bin_index & small_float::MANTISSA_MASK;
+
+        if (bin_indices[bin_index] == UNUSED) {
+            used_bins[top_bin_index] |= 1u << leaf_bin_index;
+            used_bins_top |= 1u << top_bin_index;
+        }
+
+        u32 top_node_index = bin_indices[bin_index];
+        u32 node_index = free_nodes[--free_node_count];
+
+        nodes[node_index] = Node{
+            .data_offset = data_offset,
+            .data_size = node_size,
+            .bin_list_prev = UNUSED,
+            .bin_list_next = top_node_index,
+            .neighbor_prev = UNUSED,
+            .neighbor_next = UNUSED,
+            .used = false,
+        };
+
+        if (top_node_index != UNUSED) nodes[top_node_index].bin_list_prev = node_index;
+        bin_indices[bin_index] = node_index;
+
+        free_storage += node_size;
+        return node_index;
+    }
+
+    void remove_node_from_bin(u32 node_index) {
+        Node& node = nodes[node_index];
+
+        if (node.bin_list_prev != UNUSED) {
+            nodes[node.bin_list_prev].bin_list_next = node.bin_list_next;
+            if (node.bin_list_next != UNUSED) {
+                nodes[node.bin_list_next].bin_list_prev = node.bin_list_prev;
+            }
+        } else {
+            // Head of its bin.
+            u32 bin_index = small_float::uint_to_float_round_down(node.data_size);
+            u32 top_bin_index = bin_index >> small_float::MANTISSA_BITS;
+            u32 leaf_bin_index = bin_index & small_float::MANTISSA_MASK;
+
+            bin_indices[bin_index] = node.bin_list_next;
+            if (node.bin_list_next != UNUSED) nodes[node.bin_list_next].bin_list_prev = UNUSED;
+
+            if (bin_indices[bin_index] == UNUSED) {
+                used_bins[top_bin_index] &= ~(1u << leaf_bin_index);
+                if (used_bins[top_bin_index] == 0) used_bins_top &= ~(1u << top_bin_index);
+            }
+        }
+
+        free_nodes[free_node_count++] = node_index;
+        free_storage -= node.data_size;
+    }
+};
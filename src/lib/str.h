@@ -0,0 +1,315 @@
+#pragma once
+
+#include "allocator.h"
+#include "def.h"
+#include <cstring>
+#include <optional>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define STR_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define STR_SIMD_X86 0
+#endif
+
+// Byte search kernels behind Str. SSE2 is part of x86-64 so it is always available there;
+// AVX2 is picked at runtime. Other targets use libc memchr, which is vectorized already.
+namespace str_simd {
+
+inline const char* find_byte_scalar(const char* data, usize len, char c) {
+    return (const char*)memchr(data, c, len);
+}
+
+// Compares `needle[1..len-1]` once the first and last bytes are known to match.
+inline bool matches_middle(const char* candidate, const char* needle, usize needle_len) {
+    return needle_len <= 2 || memcmp(candidate + 1, needle + 1, needle_len - 2) == 0;
+}
+
+inline const char*
+find_scalar(const char* data, usize len, const char* needle, usize needle_len) {
+    const char* end = data + len - needle_len + 1;
+    for (const char* p = data; p < end; p++) {
+        p = find_byte_scalar(p, (usize)(end - p), needle[0]);
+        if (!p) return nullptr;
+        if (p[needle_len - 1] == needle[needle_len - 1] &&
+            matches_middle(p, needle, needle_len)) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#if STR_SIMD_X86
+inline bool has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+inline const char* find_byte_sse2(const char* data, usize len, char c) {
+    __m128i target = _mm_set1_epi8(c);
+    usize i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(block, target));
+        if (mask) return data + i + __builtin_ctz(mask);
+    }
+    return find_byte_scalar(data + i, len - i, c);
+}
+
+__attribute__((target("avx2"))) inline const char*
+find_byte_avx2(const char* data, usize len, char c) {
+    __m256i target = _mm256_set1_epi8(c);
+    usize i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+        u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target));
+        if (mask) return data + i + __builtin_ctz(mask);
+    }
+    return find_byte_sse2(data + i, len - i, c);
+}
+
+// Substring search: compare the needle's first and last byte against 16 or 32 positions at
+// once and only memcmp the candidates where both match.
+inline const char*
+find_sse2(const char* data, usize len, const char* needle, usize needle_len) {
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+    usize positions = len - needle_len + 1;
+
+    usize i = 0;
+    for (; i + 16 <= positions; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i*)(data + i + needle_len - 1));
+        __m128i eq = _mm_and_si128(
+            _mm_cmpeq_epi8(block_first, first),
+            _mm_cmpeq_epi8(block_last, last)
+        );
+
+        u32 mask = (u32)_mm_movemask_epi8(eq);
+        while (mask) {
+            u32 bit = (u32)__builtin_ctz(mask);
+            if (matches_middle(data + i + bit, needle, needle_len)) return data + i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return find_scalar(data + i, len - i, needle, needle_len);
+}
+
+__attribute__((target("avx2"))) inline const char*
+find_avx2(const char* data, usize len, const char* needle, usize needle_len) {
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[needle_len - 1]);
+    usize positions = len - needle_len + 1;
+
+    usize i = 0;
+    for (; i + 32 <= positions; i += 32) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i block_last = _mm256_loadu_si256((const __m256i*)(data + i + needle_len - 1));
+        __m256i eq = _mm256_and_si256(
+            _mm256_cmpeq_epi8(block_first, first),
+            _mm256_cmpeq_epi8(block_last, last)
+        );
+
+        u32 mask = (u32)_mm256_movemask_epi8(eq);
+        while (mask) {
+            u32 bit = (u32)__builtin_ctz(mask);
+            if (matches_middle(data + i + bit, needle, needle_len)) return data + i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return find_sse2(data + i, len - i, needle, needle_len);
+}
+#endif
+
+inline const char* find_byte(const char* data, usize len, char c) {
+#if STR_SIMD_X86
+    return has_avx2() ? find_byte_avx2(data, len, c) : find_byte_sse2(data, len, c);
+#else
+    return find_byte_scalar(data, len, c);
+#endif
+}
+
+/// @brief Finds `needle` in `data`. Both lengths must be non-zero and needle_len <= len.
+inline const char* find(const char* data, usize len, const char* needle, usize needle_len) {
+    if (needle_len == 1) return find_byte(data, len, needle[0]);
+#if STR_SIMD_X86
+    return has_avx2() ? find_avx2(data, len, needle, needle_len)
+                      : find_sse2(data, len, needle, needle_len);
+#else
+    return find_scalar(data, len, needle, needle_len);
+#endif
+}
+
+} // namespace str_simd
+
+struct StrSplit;
+
+/// @brief Non-owning view of `len` bytes. Not null terminated; every operation works from the
+/// stored length, so nothing rescans the bytes for a terminator.
+struct Str {
+    const char* data;
+    usize len;
+
+    static constexpr Str init(const char* data, usize len) { return Str{data, len}; }
+
+    /// @brief Views a string literal, the length is known at compile time.
+    template <usize N> static constexpr Str lit(const char (&literal)[N]) {
+        return Str{literal, N - 1};
+    }
+
+    /// @brief Views a null-terminated C string, measuring it once.
+    static Str from_cstr(string str) { return str ? Str{str, strlen(str)} : Str{"", 0}; }
+
+    /// @brief Copies the view into `out` and null terminates it.
+    /// @return False if `out` was too small, the copy is truncated in that case.
+    bool to_cstr(mut_string out, usize out_size) const {
+        if (out_size == 0) return false;
+
+        usize count = len < out_size - 1 ? len : out_size - 1;
+        memcpy(out, data, count);
+        out[count] = '\0';
+        return count == len;
+    }
+
+    /// @brief Allocates a null-terminated copy, freed with `free_array(str, len + 1)`.
+    mut_string to_cstr(Allocator& allocator) const {
+        mut_string out = allocator.alloc_array<char>(len + 1);
+        if (!out) return nullptr;
+
+        memcpy(out, data, len);
+        out[len] = '\0';
+        return out;
+    }
+
+    bool is_empty() const { return len == 0; }
+
+    char operator[](usize index) const { return data[index]; }
+
+    const char* begin() const { return data; }
+    const char* end() const { return data + len; }
+
+    /// @brief Bytes from `start` up to `end`, both clamped to the view.
+    Str slice(usize start, usize end = USIZE_MAX) const {
+        if (end > len) end = len;
+        if (start > end) start = end;
+        return Str{data + start, end - start};
+    }
+
+    std::optional<usize> find(char c) const {
+        if (len == 0) return std::nullopt;
+
+        const char* found = str_simd::find_byte(data, len, c);
+        if (!found) return std::nullopt;
+        return (usize)(found - data);
+    }
+
+    std::optional<usize> find(Str needle) const {
+        if (needle.len == 0) return 0;
+        if (needle.len > len) return std::nullopt;
+
+        const char* found = str_simd::find(data, len, needle.data, needle.len);
+        if (!found) return std::nullopt;
+        return (usize)(found - data);
+    }
+
+    std::optional<usize> rfind(char c) const {
+        for (usize i = len; i > 0; i--) {
+            if (data[i - 1] == c) return i - 1;
+        }
+        return std::nullopt;
+    }
+
+    bool contains(char c) const { return find(c).has_value(); }
+    bool contains(Str needle) const { return find(needle).has_value(); }
+
+    bool starts_with(Str prefix) const {
+        return prefix.len <= len && memcmp(data, prefix.data, prefix.len) == 0;
+    }
+
+    bool ends_with(Str suffix) const {
+        return suffix.len <= len && memcmp(data + len - suffix.len, suffix.data, suffix.len) == 0;
+    }
+
+    bool equals(Str other) const {
+        return len == other.len && (len == 0 || memcmp(data, other.data, len) == 0);
+    }
+
+    bool operator==(Str other) const { return equals(other); }
+
+    /// @brief Lexicographic byte comparison, a shorter prefix orders first.
+    /// @return Negative, zero or positive like strcmp.
+    i32 compare(Str other) const {
+        usize common = len < other.len ? len : other.len;
+        i32 result = common == 0 ? 0 : memcmp(data, other.data, common);
+        if (result != 0) return result;
+        return len < other.len ? -1 : len > other.len ? 1 : 0;
+    }
+
+    Str trim_start() const {
+        usize start = 0;
+        while (start < len && is_space(data[start])) {
+            start++;
+        }
+        return Str{data + start, len - start};
+    }
+
+    Str trim_end() const {
+        usize end = len;
+        while (end > 0 && is_space(data[end - 1])) {
+            end--;
+        }
+        return Str{data, end};
+    }
+
+    Str trim() const { return trim_start().trim_end(); }
+
+    /// @brief Iterates the pieces between `delimiter` bytes without modifying the input.
+    StrSplit split(char delimiter) const;
+
+    static constexpr bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+};
+
+/// @brief Lazy split of a Str, usable with `next()` or a range-based for loop. Adjacent
+/// delimiters yield empty pieces, like `string_split`.
+struct StrSplit {
+    Str rest;
+    char delimiter;
+    bool finished;
+
+    std::optional<Str> next() {
+        if (finished) return std::nullopt;
+
+        auto index = rest.find(delimiter);
+        if (!index.has_value()) {
+            finished = true;
+            return rest;
+        }
+
+        Str piece = rest.slice(0, index.value());
+        rest = rest.slice(index.value() + 1);
+        return piece;
+    }
+
+    struct Iterator {
+        StrSplit* split;
+        std::optional<Str> current;
+
+        Str operator*() const { return current.value(); }
+        Iterator& operator++() {
+            current = split->next();
+            return *this;
+        }
+        bool operator!=(const Iterator&) const { return current.has_value(); }
+    };
+
+    Iterator begin() { return Iterator{this, next()}; }
+    Iterator end() { return Iterator{this, std::nullopt}; }
+};
+
+inline StrSplit Str::split(char delimiter) const {
+    return StrSplit{.rest = *this, .delimiter = delimiter, .finished = false};
+}
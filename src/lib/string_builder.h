@@ -0,0 +1,196 @@
+#pragma once
+
+#include "allocator.h"
+#include "def.h"
+#include "str.h"
+#include <charconv>
+#include <concepts>
+#include <cstring>
+#include <type_traits>
+
+/// @brief Growable text buffer on an Allocator. Meant for ArenaAllocator and
+/// FixedBufferAllocator, which both grow the last allocation in place, so building a string
+/// in the frame arena costs a few bump allocations and is released by the arena reset.
+///
+/// Appends never fail loudly: once an allocation fails the builder stops growing and
+/// `overflowed` is set, the text built so far stays valid.
+struct StringBuilder {
+    Allocator allocator;
+    char* data;
+    usize len;
+    usize capacity;
+    bool overflowed;
+
+    static StringBuilder init(Allocator allocator, usize initial_capacity = 64) {
+        StringBuilder builder = {
+            .allocator = allocator,
+            .data = nullptr,
+            .len = 0,
+            .capacity = 0,
+            .overflowed = false,
+        };
+        builder.reserve(initial_capacity);
+        return builder;
+    }
+
+    void deinit() {
+        allocator.free_array(data, capacity);
+        data = nullptr;
+        len = 0;
+        capacity = 0;
+    }
+
+    void clear() {
+        len = 0;
+        overflowed = false;
+    }
+
+    /// @brief Null terminates the text and returns a view of it. `result.data` is a valid C
+    /// string until the builder is appended to again or its memory is released.
+    Str finish() {
+        // Every append leaves a byte for the terminator, so this never reallocates.
+        if (!data || !reserve(0)) return Str::lit("");
+
+        data[len] = '\0';
+        return Str::init(data, len);
+    }
+
+    string c_str() { return finish().data; }
+
+    bool append(Str text) {
+        if (!reserve(text.len)) return false;
+        if (text.len > 0) memcpy(data + len, text.data, text.len);
+        len += text.len;
+        return true;
+    }
+
+    bool append(string text) { return append(Str::from_cstr(text)); }
+
+    bool append(char c) {
+        if (!reserve(1)) return false;
+        data[len++] = c;
+        return true;
+    }
+
+    bool append(bool value) { return append(value ? Str::lit("true") : Str::lit("false")); }
+
+    template <std::integral T>
+        requires(!std::same_as<T, bool> && !std::same_as<T, char>)
+    bool append(T value, i32 base = 10) {
+        // Enough for a 64-bit value in binary.
+        char buffer[66];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, base);
+        return append(Str::init(buffer, (usize)(result.ptr - buffer)));
+    }
+
+    /// @param precision Digits after the decimal point, or -1 for the shortest round-trip form.
+    template <std::floating_point T> bool append(T value, i32 precision = -1) {
+        char buffer[64];
+        auto result = precision < 0
+                          ? std::to_chars(buffer, buffer + sizeof(buffer), value)
+                          : std::to_chars(
+                                buffer,
+                                buffer + sizeof(buffer),
+                                value,
+                                std::chars_format::fixed,
+                                precision
+                            );
+        // Values too wide for the buffer, like 1e300 in fixed notation.
+        if (result.ec != std::errc{}) return append(Str::lit("<float>"));
+        return append(Str::init(buffer, (usize)(result.ptr - buffer)));
+    }
+
+    /// @brief Appends `fmt` with each `{}` replaced by the next argument. `{:.N}` sets the
+    /// precision of a float, `{:x}` and `{:b}` print integers in hex and binary, and `{{` /
+    /// `}}` are literal braces. Arguments without a placeholder are ignored, placeholders
+    /// without an argument are printed as is.
+    template <typename... Args> bool format(Str fmt, const Args&... args) {
+        usize cursor = 0;
+        (format_next(fmt, cursor, args), ...);
+        append_literal(fmt, cursor, fmt.len);
+        return !overflowed;
+    }
+
+    template <typename... Args> bool format(string fmt, const Args&... args) {
+        return format(Str::from_cstr(fmt), args...);
+    }
+
+  private:
+    bool reserve(usize additional) {
+        // One spare byte is always kept for the terminator `finish` writes.
+        usize required = len + additional + 1;
+        if (required <= capacity) return true;
+        if (overflowed) return false;
+
+        usize new_capacity = capacity < 16 ? 16 : capacity;
+        while (new_capacity < required) {
+            new_capacity *= 2;
+        }
+
+        char* new_data = data ? (char*)allocator.realloc(data, capacity, new_capacity, 1)
+                              : (char*)allocator.alloc(new_capacity, 1);
+        if (!new_data) {
+            overflowed = true;
+            return false;
+        }
+
+        data = new_data;
+        capacity = new_capacity;
+        return true;
+    }
+
+    // Copies fmt[from, to) while collapsing escaped braces.
+    void append_literal(Str fmt, usize from, usize to) {
+        for (usize i = from; i < to; i++) {
+            append(fmt[i]);
+            if ((fmt[i] == '{' || fmt[i] == '}') && i + 1 < to && fmt[i + 1] == fmt[i]) i++;
+        }
+    }
+
+    template <typename T> void format_next(Str fmt, usize& cursor, const T& arg) {
+        // Find the next placeholder, skipping escaped braces.
+        usize open = cursor;
+        while (open < fmt.len) {
+            if (fmt[open] == '{' && open + 1 < fmt.len && fmt[open + 1] == '{') {
+                open += 2;
+            } else if (fmt[open] == '}' && open + 1 < fmt.len && fmt[open + 1] == '}') {
+                open += 2;
+            } else if (fmt[open] == '{') {
+                break;
+            } else {
+                open++;
+            }
+        }
+
+        Str rest = fmt.slice(open);
+        auto close = rest.find('}');
+        if (open >= fmt.len || !close.has_value()) return;
+
+        append_literal(fmt, cursor, open);
+        cursor = open + close.value() + 1;
+
+        Str spec = rest.slice(1, close.value());
+        append_value(arg, spec.starts_with(Str::lit(":")) ? spec.slice(1) : Str::lit(""));
+    }
+
+    template <typename T> void append_value(const T& arg, Str spec) {
+        if constexpr (std::is_floating_point_v<T>) {
+            i32 precision = -1;
+            if (spec.starts_with(Str::lit("."))) {
+                precision = 0;
+                std::from_chars(spec.data + 1, spec.data + spec.len, precision);
+            }
+            append(arg, precision);
+        } else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+                             !std::is_same_v<T, char>) {
+            i32 base = spec.equals(Str::lit("x")) ? 16 : spec.equals(Str::lit("b")) ? 2 : 10;
+            append(arg, base);
+        } else if constexpr (std::is_convertible_v<T, Str>) {
+            append((Str)arg);
+        } else if constexpr (std::is_convertible_v<T, string>) {
+            append((string)arg);
+        } else {
+            append(arg);
+        }
+    }
+};
@@ -1,6 +1,19 @@
+#include "async_io.h"
+#include "bench.h"
+#include "ecs.h"
+#include "frame_stats.h"
+#include "input_log.h"
+#include "jobs.h"
 #include "lib/allocator.h"
+#include "lib/cli.h"
 #include "lib/def.h"
+#include "lib/string_builder.h"
+#include "profiler.h"
 #include "renderer.h"
+#include "simulation.h"
+#include "spatial_scene.h"
+#include "task.h"
+#include "transform.h"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
 
@@ -9,6 +22,11 @@ enum GameInitError {
     WINDOW_CREATION_FAILED,
     GPU_DEVICE_CREATION_FAILED,
     RENDERER_INIT_FAILED,
+    ASYNC_IO_INIT_FAILED,
+    JOB_SYSTEM_INIT_FAILED,
+    TASK_SCHEDULER_INIT_FAILED,
+    SIMULATION_INIT_FAILED,
+    TRANSFORMS_INIT_FAILED,
 };
 
 constexpr string to_string(GameInitError error) {
@@ -21,117 +39,321 @@ constexpr string to_string(GameInitError error) {
             return "GPU_DEVICE_CREATION_FAILED";
         case RENDERER_INIT_FAILED:
             return "RENDERER_INIT_FAILED";
+        case ASYNC_IO_INIT_FAILED:
+            return "ASYNC_IO_INIT_FAILED";
+        case JOB_SYSTEM_INIT_FAILED:
+            return "JOB_SYSTEM_INIT_FAILED";
+        case TASK_SCHEDULER_INIT_FAILED:
+            return "TASK_SCHEDULER_INIT_FAILED";
+        case SIMULATION_INIT_FAILED:
+            return "SIMULATION_INIT_FAILED";
+        case TRANSFORMS_INIT_FAILED:
+            return "TRANSFORMS_INIT_FAILED";
         default:
             return "UNKNOWN_ERROR";
     }
 }
 
+enum GameScene {
+    // The single rotating triangle.
+    SCENE_TRIANGLE,
+    // A grid filling the instance buffer, one instanced draw of MAX_INSTANCES triangles.
+    SCENE_INSTANCES,
+    // The same grid as entities, updated and drawn through ECS queries. Every other row spins.
+    SCENE_ENTITIES,
+    // Rows of entities parented to a pivot each. A few pivots swing, the other rows are static
+    // and cost nothing to update.
+    SCENE_HIERARCHY,
+    // Broad-phase benchmarks: drifting objects in a spatial grid and an AABB tree, queried with
+    // batches of boxes, rays and spheres. The first MAX_INSTANCES objects are drawn.
+    SCENE_SPATIAL_10K,
+    SCENE_SPATIAL_100K,
+    SCENE_SPATIAL_1M,
+};
+
+constexpr string GAME_SCENE_NAMES[] = {
+    "triangle",
+    "instances",
+    "entities",
+    "hierarchy",
+    "spatial-10k",
+    "spatial-100k",
+    "spatial-1m",
+};
+
+// Objects of the spatial scenes, in scene order.
+constexpr u32 SPATIAL_SCENE_OBJECTS[] = {10'000, 100'000, 1'000'000};
+
+// Nodes of the hierarchy scene: one pivot per row plus its instances.
+constexpr u32 HIERARCHY_SIDE = 128;
+constexpr u32 MAX_TRANSFORMS = HIERARCHY_SIDE * (HIERARCHY_SIDE + 1);
+
+// Components of the entities scene.
+struct Transform2D {
+    f32 x;
+    f32 y;
+    f32 scale;
+    f32 angle;
+};
+
+struct Spin {
+    f32 radians_per_second;
+};
+
+struct Tint {
+    Vec4 color;
+};
+
+struct TransformNode {
+    TransformId id;
+};
+
+// Rotates a node back and forth, `amplitude * sin(time * frequency)`.
+struct Swing {
+    f32 amplitude;
+    f32 frequency;
+};
+
 struct Game {
     Allocator& allocator;
 
-    Renderer& renderer;
+    Renderer renderer;
+    AsyncIO* io;
+    JobSystem* jobs;
+    TaskScheduler* tasks;
+    Simulation* simulation;
+    World world;
+    TransformHierarchy transforms;
+    // Only while a spatial scene runs.
+    SpatialScene* spatial;
+    // Seconds the scene has been stepped for, and real time not yet stepped. The scene systems
+    // step at SIM_TIMESTEP like the simulation, so they behave the same at any frame rate.
+    f32 scene_time;
     SDL_Window* window;
     SDL_GPUDevice* device;
 
     bool running;
+    bool headless;
+    GameScene scene;
     i32 window_width;
     i32 window_height;
 
-    // FPS track
-    u64 frame_count;
-    u64 last_time;
-    u64 fps_update_time;
-    i32 current_fps;
+    FrameStats frame_stats;
+    // Frames since the title was last updated.
+    u32 title_frames;
+    u64 title_update_time;
 
-    static std::expected<Game, GameInitError>
-    init(Allocator& allocator, Allocator& temp_allocator, i32 window_width, i32 window_height) {
-        if (!SDL_Init(SDL_INIT_VIDEO)) {
+    /// @param headless Run without a window or GPU device, rendering through the null backend.
+    static std::expected<Game, GameInitError> init(
+        Allocator& allocator,
+        Allocator& temp_allocator,
+        i32 window_width,
+        i32 window_height,
+        bool headless = false
+    ) {
+        // Zones are recorded from here on, and written as a Chrome trace on exit, when
+        // PROFILE_TRACE is set.
+        if (SDL_getenv("PROFILE_TRACE")) {
+            global_profiler.init(PageAllocator::init());
+            PROFILE_THREAD_NAME("main");
+        }
+
+        // Startup phases are logged, and written as a Chrome trace when STARTUP_TRACE is set.
+        StartupTrace trace = {};
+        u64 startup_start = SDL_GetPerformanceCounter();
+        u64 phase_start = startup_start;
+        auto end_phase = [&](string name) {
+            u64 now = SDL_GetPerformanceCounter();
+            trace.record(name, phase_start, now);
+            phase_start = now;
+        };
+
+        if (!SDL_Init(headless ? 0 : SDL_INIT_VIDEO)) {
             SDL_Log("Failed to start SDL %s\n", SDL_GetError());
             return std::unexpected(SDL_INIT_FAILED);
         }
+        end_phase("SDL_Init");
 
-        SDL_Window* window = SDL_CreateWindow(
-            "FPS: 0",
-            window_width,
-            window_height,
-            SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE
-        );
-        if (!window) {
-            SDL_Log("Failed to create window %s\n", SDL_GetError());
-            return std::unexpected(WINDOW_CREATION_FAILED);
-        }
+        // Headless runs have no window or device and render through the null backend.
+        SDL_Window* window = nullptr;
+        SDL_GPUDevice* device = nullptr;
+        if (!headless) {
+            window = SDL_CreateWindow(
+                "FPS: 0",
+                window_width,
+                window_height,
+                SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE
+            );
+            if (!window) {
+                SDL_Log("Failed to create window %s\n", SDL_GetError());
+                return std::unexpected(WINDOW_CREATION_FAILED);
+            }
+            end_phase("create window");
 
-        SDL_GPUDevice* device = SDL_CreateGPUDevice(
-            SDL_GPU_SHADERFORMAT_DXIL | SDL_GPU_SHADERFORMAT_SPIRV | SDL_GPU_SHADERFORMAT_MSL,
-            true,
-            nullptr
-        );
-        if (!device) {
-            SDL_Log("Failed to create GPU Device %s\n", SDL_GetError());
-            return std::unexpected(GPU_DEVICE_CREATION_FAILED);
-        }
+            device = SDL_CreateGPUDevice(
+                SDL_GPU_SHADERFORMAT_DXIL | SDL_GPU_SHADERFORMAT_SPIRV |
+                    SDL_GPU_SHADERFORMAT_MSL,
+                true,
+                nullptr
+            );
+            if (!device) {
+                SDL_Log("Failed to create GPU Device %s\n", SDL_GetError());
+                return std::unexpected(GPU_DEVICE_CREATION_FAILED);
+            }
 
-        string device_driver = SDL_GetGPUDeviceDriver(device);
-        SDL_Log("Created GPU Device with driver %s\n", device_driver);
+            string device_driver = SDL_GetGPUDeviceDriver(device);
+            SDL_Log("Created GPU Device with driver %s\n", device_driver);
 
-        if (!SDL_ClaimWindowForGPUDevice(device, window)) {
-            SDL_Log("Failed to claim window for GPU Device %s\n", SDL_GetError());
-            return std::unexpected(WINDOW_CREATION_FAILED);
+            if (!SDL_ClaimWindowForGPUDevice(device, window)) {
+                SDL_Log("Failed to claim window for GPU Device %s\n", SDL_GetError());
+                return std::unexpected(WINDOW_CREATION_FAILED);
+            }
+            end_phase("create GPU device");
         }
 
-        auto renderer = Renderer::init(temp_allocator, device, window);
+        auto progress = [](u32 completed, u32 total, void*) {
+            SDL_Log("Loading %u/%u\n", completed, total);
+        };
+        auto renderer =
+            Renderer::init(allocator, temp_allocator, device, window, progress, nullptr, &trace);
         if (!renderer.has_value()) {
             SDL_Log("Failed to initialize renderer: %s\n", to_string(renderer.error()));
             return std::unexpected(RENDERER_INIT_FAILED);
         }
+        end_phase("renderer init");
 
-        SDL_ShowWindow(window);
+        AsyncIO* io = allocator.create<AsyncIO>();
+        if (!io->init()) {
+            SDL_Log("Failed to start async I/O\n");
+            return std::unexpected(ASYNC_IO_INIT_FAILED);
+        }
+        end_phase("async I/O init");
+
+        JobSystem* jobs = allocator.create<JobSystem>();
+        if (!jobs->init(allocator)) {
+            SDL_Log("Failed to start job system\n");
+            return std::unexpected(JOB_SYSTEM_INIT_FAILED);
+        }
+        renderer->jobs = jobs;
+        SDL_Log("Job system running on %u workers\n", jobs->worker_count);
+        end_phase("job system init");
+
+        TaskScheduler* tasks = allocator.create<TaskScheduler>();
+        if (!tasks->init(io, jobs)) {
+            SDL_Log("Failed to start task scheduler\n");
+            return std::unexpected(TASK_SCHEDULER_INIT_FAILED);
+        }
+
+        Simulation* simulation = allocator.create<Simulation>();
+        if (!simulation->init(allocator, MAX_INSTANCES, Game::simulate)) {
+            SDL_Log("Failed to initialize simulation\n");
+            return std::unexpected(SIMULATION_INIT_FAILED);
+        }
+
+        TransformHierarchy transforms = TransformHierarchy::init(allocator, MAX_TRANSFORMS);
+        if (!transforms.is_valid()) {
+            SDL_Log("Failed to allocate transform hierarchy\n");
+            return std::unexpected(TRANSFORMS_INIT_FAILED);
+        }
+
+        if (window) {
+            SDL_ShowWindow(window);
+        }
+
+        phase_start = startup_start;
+        end_phase("startup");
+        trace.log();
+
+        string trace_path = SDL_getenv("STARTUP_TRACE");
+        if (trace_path && !trace.write_chrome_trace(trace_path)) {
+            SDL_Log("Failed to write startup trace to %s\n", trace_path);
+        }
 
         u64 current_time = SDL_GetPerformanceCounter();
 
         return Game{
             .allocator = allocator,
             .renderer = renderer.value(),
+            .io = io,
+            .jobs = jobs,
+            .tasks = tasks,
+            .simulation = simulation,
+            .world = World::init(allocator),
+            .transforms = transforms,
+            .spatial = nullptr,
+            .scene_time = 0.0f,
             .window = window,
             .device = device,
             .running = true,
+            .headless = headless,
+            .scene = SCENE_TRIANGLE,
             .window_width = window_width,
             .window_height = window_height,
-            .frame_count = 0,
-            .last_time = current_time,
-            .fps_update_time = current_time,
-            .current_fps = 0
+            .frame_stats = FrameStats::init(allocator),
+            .title_frames = 0,
+            .title_update_time = current_time,
         };
     }
 
     void deinit() {
+        simulation->deinit();
+        allocator.destroy(simulation);
+        world.deinit();
+        transforms.deinit();
+        if (spatial) {
+            spatial->deinit();
+            allocator.destroy(spatial);
+        }
+        // Before AsyncIO, suspended reads point into the scheduler.
+        tasks->deinit();
+        allocator.destroy(tasks);
+        io->deinit();
+        allocator.destroy(io);
+        jobs->deinit();
+        allocator.destroy(jobs);
+
+        // The I/O and job workers have stopped, so every ring is quiet.
+        string profile_path = SDL_getenv("PROFILE_TRACE");
+        if (profile_path && !PROFILER_ENABLED) {
+            SDL_Log("Not writing %s, built with PROFILER_ENABLED=0\n", profile_path);
+        } else if (profile_path && !global_profiler.write_chrome_trace(profile_path)) {
+            SDL_Log("Failed to write profile trace to %s\n", profile_path);
+        }
+        global_profiler.deinit();
+
+        frame_stats.deinit();
         renderer.deinit();
-        SDL_ReleaseWindowFromGPUDevice(device, window);
-        SDL_DestroyWindow(window);
-        SDL_DestroyGPUDevice(device);
+        if (!headless) {
+            SDL_ReleaseWindowFromGPUDevice(device, window);
+            SDL_DestroyWindow(window);
+            SDL_DestroyGPUDevice(device);
+        }
         SDL_Quit();
     }
 
-    void update_fps() {
-        frame_count++;
+    /// @brief Once a second, shows the frame time distribution of that second in the title.
+    /// Average FPS hides stutter, so the p99 frame time and 1% low are shown next to it.
+    void update_title() {
+        title_frames++;
         u64 current_time = SDL_GetPerformanceCounter();
         u64 frequency = SDL_GetPerformanceFrequency();
+        if (current_time - title_update_time < frequency || !window) return;
 
-        // Update FPS every second
-        if (current_time - fps_update_time >= frequency) {
-            f64 elapsed = (f64)(current_time - fps_update_time) / frequency;
-            current_fps = (i32)(frame_count / elapsed);
-
-            // Update window title
-            char title[64];
-            SDL_snprintf(title, sizeof(title), "FPS: %d", current_fps);
-            SDL_SetWindowTitle(window, title);
+        FrameSummary summary = frame_stats.summarize(title_frames);
+        f64 fps = summary.avg_ms > 0.0 ? 1000.0 / summary.avg_ms : 0.0;
 
-            frame_count = 0;
-            fps_update_time = current_time;
-        }
+        // Update window title, built in the frame arena
+        StringBuilder title = StringBuilder::init(renderer.temp_allocator);
+        title.format(
+            "FPS: {:.0} | p99: {:.2} ms | 1% low: {:.0} FPS",
+            fps,
+            summary.p99_ms,
+            summary.low_1_percent_fps
+        );
+        SDL_SetWindowTitle(window, title.c_str());
 
-        last_time = current_time;
+        title_frames = 0;
+        title_update_time = current_time;
     }
 
     void handle_event(SDL_Event* event) {
@@ -155,39 +377,553 @@ struct Game {
         }
     }
 
-    bool render() { return renderer.render(window, window_width, window_height); }
-};
+    /// @brief Fixed step of every scene: objects spin in place and, when the simulation steps
+    /// on the main thread, the scene systems run.
+    static void simulate(const SimState& previous, SimState& next, f32 dt, void* user_data) {
+        for (u32 i = 0; i < next.count; i++) {
+            next.objects[i].angle = previous.objects[i].angle + previous.objects[i].spin * dt;
+        }
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) {
-    ArenaAllocator permanent_storage = ArenaAllocator::init(PageAllocator::init(), 4096, GB(2));
-    Allocator allocator = permanent_storage.allocator();
+        Game* game = (Game*)user_data;
+        if (game) game->step_systems(dt);
+    }
 
-    ArenaAllocator temp_storage = ArenaAllocator::init(PageAllocator::init(), 4096, MB(64));
-    Allocator temp_allocator = temp_storage.allocator();
+    /// @brief Seeds the simulation, or spawns the entities, of `scene` and starts stepping it.
+    /// @param threaded Step the simulation on its own thread instead of in `update`.
+    void start_scene(GameScene scene, bool threaded) {
+        this->scene = scene;
 
-    auto game = Game::init(allocator, temp_allocator, 1280, 720);
-    if (!game.has_value()) {
-        SDL_Log("Failed to initialize game: %s\n", to_string(game.error()));
-        return -1;
+        switch (scene) {
+            case SCENE_TRIANGLE: {
+                SimState& state = simulation->seed(1);
+                state.objects[0] = SimObject{
+                    .x = 0.0f,
+                    .y = 0.0f,
+                    .scale = 0.8f,
+                    .angle = 0.0f,
+                    .spin = 1.0f,
+                    .color = Vec4::one(),
+                };
+                break;
+            }
+            case SCENE_INSTANCES: {
+                constexpr u32 side = 128;
+                static_assert(side * side <= MAX_INSTANCES);
+
+                SimState& state = simulation->seed(side * side);
+                f32 cell = 2.0f / side;
+                for (u32 y = 0; y < side; y++) {
+                    for (u32 x = 0; x < side; x++) {
+                        state.objects[y * side + x] = SimObject{
+                            .x = -1.0f + cell * (x + 0.5f),
+                            .y = -1.0f + cell * (y + 0.5f),
+                            .scale = cell,
+                            .angle = (f32)(x + y) * 0.05f,
+                            .spin = 1.0f,
+                            .color = Vec4::init((f32)x / side, (f32)y / side, 0.5f, 1.0f),
+                        };
+                    }
+                }
+                break;
+            }
+            case SCENE_ENTITIES: {
+                constexpr u32 side = 128;
+                static_assert(side * side <= MAX_INSTANCES);
+
+                simulation->seed(0);
+                f32 cell = 2.0f / side;
+                for (u32 y = 0; y < side; y++) {
+                    for (u32 x = 0; x < side; x++) {
+                        Transform2D transform = {
+                            .x = -1.0f + cell * (x + 0.5f),
+                            .y = -1.0f + cell * (y + 0.5f),
+                            .scale = cell,
+                            .angle = (f32)(x + y) * 0.05f,
+                        };
+                        Tint tint = {.color = Vec4::init((f32)x / side, (f32)y / side, 0.5f, 1.0f)};
+                        if (y % 2 == 0) {
+                            world.spawn(transform, tint, Spin{.radians_per_second = 1.0f});
+                        } else {
+                            world.spawn(transform, tint);
+                        }
+                    }
+                }
+                break;
+            }
+            case SCENE_HIERARCHY: {
+                constexpr u32 side = HIERARCHY_SIDE;
+                static_assert(side * side <= MAX_INSTANCES);
+
+                simulation->seed(0);
+                f32 cell = 2.0f / side;
+                for (u32 y = 0; y < side; y++) {
+                    // Pivots sit at the left edge, so a swinging row turns about its first cell.
+                    TransformId pivot = transforms.create(
+                        TRANSFORM_NONE,
+                        Vec3::init(-1.0f, -1.0f + cell * (y + 0.5f), 0.0f)
+                    );
+                    if (y % 16 == 0) {
+                        world.spawn(
+                            TransformNode{pivot},
+                            Swing{.amplitude = 0.1f, .frequency = 1.0f + (f32)y / side}
+                        );
+                    }
+
+                    for (u32 x = 0; x < side; x++) {
+                        TransformId node = transforms.create(
+                            pivot,
+                            Vec3::init(cell * (x + 0.5f), 0.0f, 0.0f),
+                            (f32)(x + y) * 0.05f,
+                            Vec3::init(cell, cell, 1.0f)
+                        );
+                        Vec4 color = Vec4::init((f32)x / side, 0.5f, (f32)y / side, 1.0f);
+                        world.spawn(TransformNode{node}, Tint{color});
+                    }
+                }
+                break;
+            }
+            case SCENE_SPATIAL_10K:
+            case SCENE_SPATIAL_100K:
+            case SCENE_SPATIAL_1M: {
+                simulation->seed(0);
+                spatial = allocator.create<SpatialScene>();
+                if (!spatial) break;
+                if (!spatial->init(allocator, SPATIAL_SCENE_OBJECTS[scene - SCENE_SPATIAL_10K])) {
+                    SDL_Log("Failed to set up the spatial scene\n");
+                    spatial->deinit();
+                    allocator.destroy(spatial);
+                    spatial = nullptr;
+                }
+                break;
+            }
+        }
+
+        // The systems use the world and the job system, which belong to the main thread.
+        bool has_systems = world.archetypes.len > 0 || spatial;
+        if (threaded && has_systems) {
+            SDL_Log("Ignoring --sim-thread, this scene's systems step on the main thread\n");
+            threaded = false;
+        }
+        // Game is moved out of `init`, so the step reaches it through the pointer set here.
+        simulation->user_data = threaded ? nullptr : this;
+
+        simulation->start(threaded);
+        SDL_Log("Simulation running %s\n", threaded ? "on its own thread" : "in the frame loop");
+    }
+
+    /// @brief Runs the fixed steps due after `frame_seconds` more of real time, scene systems
+    /// included, and fills the frame's instance batch from the results.
+    void update(f64 frame_seconds) {
+        PROFILE_SCOPE("update");
+
+        simulation->advance(frame_seconds);
+        draw_entities();
+        if (spatial) draw_spatial();
+
+        SimFrame frame = simulation->begin_read();
+        defer { simulation->end_read(); };
+
+        u32 count = frame.current->count;
+        std::span<Instance> batch = renderer.instances.push_uninitialized(count);
+        if (batch.empty()) return;
+
+        // Objects are interpolated in parallel, a thousand per job.
+        jobs->parallel_for(count, 1024, [&](u32 begin, u32 end, JobWorker&) {
+            for (u32 i = begin; i < end; i++) {
+                SimObject object = Simulation::interpolate(frame, i);
+                batch[i] = Instance{
+                    .model = Mat4x4::translation(object.x, object.y, 0.0f) *
+                             Mat4x4::scale(object.scale, object.scale, 1.0f) *
+                             Mat4x4::rotation_z(object.angle),
+                    .color = object.color,
+                };
+            }
+        });
     }
 
-    defer {
-        game->deinit();
+    /// @brief One fixed step of the scene systems: spins the entities that have a Spin, swings
+    /// the nodes that have a Swing and moves the spatial scene's objects.
+    void step_systems(f32 dt) {
+        PROFILE_SCOPE("scene step");
+
+        scene_time += dt;
+
+        world.query<Transform2D, Spin>().parallel_each(
+            *jobs,
+            [&](Entity, Transform2D& transform, Spin& spin, JobWorker&) {
+                transform.angle += spin.radians_per_second * dt;
+            }
+        );
+
+        // Marking nodes dirty is not thread safe, and only a few nodes swing.
+        world.query<TransformNode, Swing>().each([&](Entity, TransformNode& node, Swing& swing) {
+            transforms.set_rotation(node.id, swing.amplitude * sinf(scene_time * swing.frequency));
+        });
+
+        // Structural changes the systems recorded.
+        world.flush();
+
+        // Only nodes this step moved are recomputed.
+        transforms.update(jobs);
+
+        if (spatial) spatial->update(dt, *jobs);
+    }
+
+    /// @brief Draws every entity with a transform and a tint, a chunk per job.
+    void draw_entities() {
+        auto drawn = world.query<Transform2D, Tint>();
+        std::span<Instance> batch = renderer.instances.push_uninitialized(drawn.count());
+        if (!batch.empty()) {
+            drawn.parallel_each_chunk(*jobs, [&](const EcsChunkView& view, JobWorker&) {
+                const Transform2D* transforms = view.column<Transform2D>();
+                const Tint* tints = view.column<Tint>();
+                for (u32 i = 0; i < view.count; i++) {
+                    const Transform2D& transform = transforms[i];
+                    batch[view.first + i] = Instance{
+                        .model = Mat4x4::translation(transform.x, transform.y, 0.0f) *
+                                 Mat4x4::scale(transform.scale, transform.scale, 1.0f) *
+                                 Mat4x4::rotation_z(transform.angle),
+                        .color = tints[i].color,
+                    };
+                }
+            });
+        }
+
+        auto nodes = world.query<TransformNode, Tint>();
+        batch = renderer.instances.push_uninitialized(nodes.count());
+        if (!batch.empty()) {
+            nodes.parallel_each_chunk(*jobs, [&](const EcsChunkView& view, JobWorker&) {
+                const TransformNode* transform_nodes = view.column<TransformNode>();
+                const Tint* tints = view.column<Tint>();
+                for (u32 i = 0; i < view.count; i++) {
+                    batch[view.first + i] = Instance{
+                        .model = transforms.world(transform_nodes[i].id),
+                        .color = tints[i].color,
+                    };
+                }
+            });
+        }
+    }
+
+    /// @brief Draws as much of the spatial scene as fits the batch.
+    void draw_spatial() {
+        u32 count = spatial->object_count < MAX_INSTANCES ? spatial->object_count : MAX_INSTANCES;
+        std::span<Instance> batch = renderer.instances.push_uninitialized(count);
+        if (!batch.empty()) spatial->draw(batch, *jobs);
+    }
+
+    bool render() {
+        PROFILE_SCOPE("render");
+
+        renderer.reload_shaders(tasks);
+
+        return renderer.render(window, window_width, window_height, &frame_stats);
+    }
+};
+
+/// @brief Process-wide memory. Both arenas are wrapped in a CountingAllocator so the
+/// benchmark can report allocations per frame. Initialized in place: the counters point at
+/// the arenas and the allocators at the counters.
+struct AppMemory {
+    ArenaAllocator permanent_storage;
+    ArenaAllocator temp_storage;
+    CountingAllocator permanent_counter;
+    CountingAllocator temp_counter;
+    Allocator allocator;
+    Allocator temp_allocator;
+
+    void init() {
+        permanent_storage = ArenaAllocator::init(PageAllocator::init(), 4096, GB(2));
+        temp_storage = ArenaAllocator::init(PageAllocator::init(), 4096, MB(64));
+        permanent_counter = CountingAllocator::init(permanent_storage.allocator());
+        temp_counter = CountingAllocator::init(temp_storage.allocator());
+        allocator = permanent_counter.allocator();
+        temp_allocator = temp_counter.allocator();
+    }
+
+    void deinit() {
         permanent_storage.deinit();
         temp_storage.deinit();
-    };
+    }
+
+    u64 allocation_count() const {
+        return permanent_counter.allocations + permanent_counter.reallocations +
+               temp_counter.allocations + temp_counter.reallocations;
+    }
 
+    u64 allocated_bytes() const {
+        return permanent_counter.bytes_allocated + temp_counter.bytes_allocated;
+    }
+};
+
+/// @brief Records the frame's draw stats and allocations as profiler counters.
+static void profile_frame_counters(
+    [[maybe_unused]] const RenderStats& stats,
+    [[maybe_unused]] u64 allocated_bytes
+) {
+    PROFILE_COUNTER("draw calls", stats.draw_calls);
+    PROFILE_COUNTER("instances", stats.instances);
+    PROFILE_COUNTER("bytes allocated", allocated_bytes);
+}
+
+/// @brief Loads the log given with --replay into `log`, if there is one.
+/// @return False if the log could not be read
+static bool load_replay(CLICommand& command, Allocator allocator, InputLog* log) {
+    Str path = command.get_str("replay");
+    if (path.is_empty()) return true;
+
+    // Option values point into argv, so the view is null terminated.
+    auto loaded = InputLog::load(allocator, path.data);
+    if (!loaded.has_value()) {
+        SDL_Log("Failed to read input log %s\n", path.data);
+        return false;
+    }
+    log->deinit();
+    *log = loaded.value();
+    SDL_Log(
+        "Replaying %u frames, %llu events from %s\n",
+        log->frame_count,
+        (unsigned long long)log->records.len,
+        path.data
+    );
+    return true;
+}
+
+/// @brief Whether to step the simulation on its own thread. Replays keep it in the frame
+/// loop, where it advances exactly one step per frame.
+static bool use_sim_thread(CLICommand& command, bool replaying) {
+    if (!command.has("sim-thread")) return false;
+    if (replaying) SDL_Log("Ignoring --sim-thread, replays step the simulation per frame\n");
+    return !replaying;
+}
+
+/// @brief Plays the game. With --record the handled events are logged per frame; with
+/// --replay a log drives the same frames instead of live input, on a fixed clock.
+static bool run_game(CLICommand& command, void* user_data) {
+    AppMemory* memory = (AppMemory*)user_data;
+
+    Str record_path = command.get_str("record");
+    bool recording = !record_path.is_empty();
+    bool replaying = !command.get_str("replay").is_empty();
+    if (recording && replaying) {
+        SDL_Log("--record and --replay cannot be combined\n");
+        return false;
+    }
+
+    InputLog input = InputLog::init(memory->allocator);
+    defer { input.deinit(); };
+    if (!load_replay(command, memory->allocator, &input)) return false;
+
+    auto game = Game::init(memory->allocator, memory->temp_allocator, 1280, 720);
+    if (!game.has_value()) {
+        SDL_Log("Failed to initialize game: %s\n", to_string(game.error()));
+        return false;
+    }
+    defer { game->deinit(); };
+    game->start_scene(SCENE_TRIANGLE, use_sim_thread(command, replaying));
+
+    u64 frequency = SDL_GetPerformanceFrequency();
+    u64 last_frame = SDL_GetPerformanceCounter();
+    u32 frame = 0;
     while (game->running) {
+        PROFILE_FRAME();
+        u64 bytes_before = memory->allocated_bytes();
+        game->frame_stats.begin_frame();
+
+        {
+            PROFILE_SCOPE("events");
+            SDL_Event event;
+            while (SDL_PollEvent(&event)) {
+                // Live input is ignored during a replay, but closing the window still ends it.
+                if (replaying && event.type != SDL_EVENT_QUIT) continue;
+                if (recording) input.record(frame, event);
+                game->handle_event(&event);
+            }
+            while (replaying && input.next(frame, &event)) {
+                game->handle_event(&event);
+            }
+        }
+        game->frame_stats.end_phase(FRAME_PHASE_EVENTS);
+
+        // Finished asset reads, work that jobs handed back to the main thread and due tasks run
+        // here.
+        game->io->poll();
+        game->jobs->run_main_jobs();
+        game->tasks->tick(game->renderer.frames.frames_completed);
+        // Replays run on a fixed clock, one simulation step per frame.
+        u64 now = SDL_GetPerformanceCounter();
+        game->update(replaying ? SIM_TIMESTEP : (f64)(now - last_frame) / (f64)frequency);
+        last_frame = now;
+        game->frame_stats.end_phase(FRAME_PHASE_UPDATE);
+
+        if (!game->render()) {
+            SDL_Log("Render failed\n");
+        }
+        game->frame_stats.end_frame();
+        profile_frame_counters(game->renderer.stats, memory->allocated_bytes() - bytes_before);
+
+        game->update_title();
+        memory->temp_storage.reset();
+        game->jobs->reset_scratch();
+
+        frame++;
+        if (replaying && input.finished(frame)) game->running = false;
+    }
+
+    if (recording) {
+        // Option values point into argv, so the view is null terminated.
+        if (!input.save(record_path.data, frame, memory->temp_allocator)) {
+            SDL_Log("Failed to write input log to %s\n", record_path.data);
+            return false;
+        }
+        SDL_Log(
+            "Recorded %u frames, %llu events to %s\n",
+            frame,
+            (unsigned long long)input.records.len,
+            record_path.data
+        );
+    }
+
+    return true;
+}
+
+/// @brief Runs a fixed number of frames and reports per-frame CPU time, allocations and draw
+/// stats. Every frame advances the simulation by exactly one step, so runs are repeatable.
+/// With --replay, the recorded input is handled on the frames it was recorded on.
+static bool run_bench(CLICommand& command, void* user_data) {
+    AppMemory* memory = (AppMemory*)user_data;
+
+    std::optional<u32> frames = command.get_int<u32>("frames", 1000);
+    std::optional<u32> warmup = command.get_int<u32>("warmup", 100);
+    if (!frames.has_value() || !warmup.has_value()) return false;
+    if (frames.value() < 1 || (u64)frames.value() + warmup.value() > UINT32_MAX) {
+        SDL_Log("--frames must be at least 1, and --frames plus --warmup fit in 32 bits\n");
+        return false;
+    }
+    u32 measured_frames = frames.value();
+    u32 warmup_frames = warmup.value();
+    bool headless = command.has("headless");
+    GameScene scene = (GameScene)command.get_enum("scene", SCENE_TRIANGLE);
+    Str out_path = command.get_str("out");
+    bool replaying = !command.get_str("replay").is_empty();
+
+    InputLog input = InputLog::init(memory->allocator);
+    defer { input.deinit(); };
+    if (!load_replay(command, memory->allocator, &input)) return false;
+
+    auto game = Game::init(memory->allocator, memory->temp_allocator, 1280, 720, headless);
+    if (!game.has_value()) {
+        SDL_Log("Failed to initialize game: %s\n", to_string(game.error()));
+        return false;
+    }
+    defer { game->deinit(); };
+    game->start_scene(scene, use_sim_thread(command, replaying));
+
+    BenchResults results = BenchResults::init(
+        memory->allocator,
+        measured_frames,
+        warmup_frames,
+        GAME_SCENE_NAMES[scene],
+        headless
+    );
+    defer { results.deinit(); };
+
+    FrameStats& frame_stats = game->frame_stats;
+    for (u32 frame = 0; frame < warmup_frames + measured_frames && game->running; frame++) {
+        // Whole-run statistics start after the warm-up.
+        if (frame == warmup_frames) frame_stats.reset();
+
+        u64 allocations_before = memory->allocation_count();
+        u64 bytes_before = memory->allocated_bytes();
+        PROFILE_FRAME();
+        frame_stats.begin_frame();
+
+        if (!headless) {
+            PROFILE_SCOPE("events");
+            SDL_Event event;
+            while (SDL_PollEvent(&event)) {
+                // Replays see only the recorded input.
+                if (replaying) continue;
+                game->handle_event(&event);
+            }
+        }
         SDL_Event event;
-        while (SDL_PollEvent(&event)) {
+        while (replaying && input.next(frame, &event)) {
             game->handle_event(&event);
         }
+        frame_stats.end_phase(FRAME_PHASE_EVENTS);
+
+        game->io->poll();
+        game->jobs->run_main_jobs();
+        game->tasks->tick(game->renderer.frames.frames_completed);
+        game->update(SIM_TIMESTEP);
+        frame_stats.end_phase(FRAME_PHASE_UPDATE);
+
         if (!game->render()) {
             SDL_Log("Render failed\n");
         }
-        game->update_fps();
-        temp_storage.reset();
+        const FrameSample& sample = frame_stats.end_frame();
+        profile_frame_counters(game->renderer.stats, memory->allocated_bytes() - bytes_before);
+
+        if (frame >= warmup_frames) {
+            results.record(BenchFrame{
+                .timing = sample,
+                .allocations = memory->allocation_count() - allocations_before,
+                .allocated_bytes = memory->allocated_bytes() - bytes_before,
+                .render = game->renderer.stats,
+            });
+        }
+        memory->temp_storage.reset();
+        game->jobs->reset_scratch();
     }
 
-    return 0;
+    results.summary = frame_stats.summarize_all();
+    results.log_summary();
+    if (!out_path.is_empty()) {
+        // Option values point into argv, so the view is null terminated.
+        if (!results.write_json(out_path.data, memory->temp_allocator)) {
+            SDL_Log("Failed to write bench results to %s\n", out_path.data);
+            return false;
+        }
+        SDL_Log("Wrote bench results to %s\n", out_path.data);
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    AppMemory memory = {};
+    memory.init();
+    defer { memory.deinit(); };
+
+    CLIOption bench_options[] = {
+        CLIOption::init("n", "frames", "Frames to measure, 1000 by default", CLI_INT),
+        CLIOption::init("w", "warmup", "Frames to run before measuring, 100 by default", CLI_INT),
+        CLIOption::init(nullptr, "headless", "Use the null renderer, no window or GPU", CLI_FLAG),
+        CLIOption::init_enum("s", "scene", "Scene to render", GAME_SCENE_NAMES),
+        CLIOption::init("o", "out", "Write the per-frame results to this JSON file"),
+        CLIOption::init(nullptr, "sim-thread", "Step the simulation on its own thread", CLI_FLAG),
+        CLIOption::init(nullptr, "replay", "Handle the input recorded in this log"),
+    };
+    CLIOption run_options[] = {
+        CLIOption::init(nullptr, "sim-thread", "Step the simulation on its own thread", CLI_FLAG),
+        CLIOption::init(nullptr, "record", "Record the handled input to this log"),
+        CLIOption::init(nullptr, "replay", "Replay the input in this log on a fixed clock"),
+    };
+
+    CLICommand run = CLICommand::init("run", "Run the game", run_options, run_game, &memory);
+    CLICommand bench = CLICommand::init(
+        "bench",
+        "Render a fixed number of frames and report frame times",
+        bench_options,
+        run_bench,
+        &memory
+    );
+
+    CLIParser parser = CLIParser::init(argv[0]);
+    parser.set_main_command(&run);
+    parser.add_command(&run);
+    parser.add_command(&bench);
+
+    return parser.parse_and_execute(argc, argv);
 }
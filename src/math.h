@@ -3,6 +3,21 @@
 #include "lib/def.h"
 #include <cmath>
 
+// Mat4x4 products and F32x4 use SSE on x86-64, where it is always available, and NEON on ARM64.
+#if defined(__x86_64__) || defined(_M_X64)
+#define MATH_SIMD_SSE 1
+#include <xmmintrin.h>
+#else
+#define MATH_SIMD_SSE 0
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define MATH_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define MATH_SIMD_NEON 0
+#endif
+
 struct Vec3 {
     union {
         struct { f32 x, y, z; };
@@ -25,6 +40,14 @@ struct Vec3 {
         return init(1.0f, 1.0f, 1.0f);
     }
 
+    static Vec3 min(Vec3 a, Vec3 b) {
+        return init(fminf(a.x, b.x), fminf(a.y, b.y), fminf(a.z, b.z));
+    }
+
+    static Vec3 max(Vec3 a, Vec3 b) {
+        return init(fmaxf(a.x, b.x), fmaxf(a.y, b.y), fmaxf(a.z, b.z));
+    }
+
     Vec3 operator+(Vec3 other) const {
         return init(x + other.x, y + other.y, z + other.z);
     }
@@ -226,19 +249,69 @@ struct Mat4x4 {
         result.m22 = -(far + near) / (far - near);
         result.m23 = -(2.0f * far * near) / (far - near);
         result.m32 = -1.0f;
+        // `{}` starts out as the identity.
+        result.m33 = 0.0f;
         return result;
     }
 
-    Mat4x4 operator*(Mat4x4 other) const {
+    /// @brief Translation, then rotation about z, then scale, as one matrix: the same as
+    /// `translation(t) * rotation_z(radians) * scale(s)` without the two products.
+    static Mat4x4 translation_rotation_scale(Vec3 t, f32 radians, Vec3 s) {
         Mat4x4 result = {};
+        f32 c = cosf(radians);
+        f32 sn = sinf(radians);
+
+        result.m00 = c * s.x;
+        result.m01 = -sn * s.y;
+        result.m03 = t.x;
+        result.m10 = sn * s.x;
+        result.m11 = c * s.y;
+        result.m13 = t.y;
+        result.m22 = s.z;
+        result.m23 = t.z;
+        return result;
+    }
+
+    // Every row of the product is a sum of the rows of `other`, weighted by the row of this
+    // matrix, so each row is four broadcast multiply-adds.
+    Mat4x4 operator*(const Mat4x4& other) const {
+        Mat4x4 result;
 
+#if MATH_SIMD_SSE
+        __m128 b0 = _mm_loadu_ps(other.mat[0]);
+        __m128 b1 = _mm_loadu_ps(other.mat[1]);
+        __m128 b2 = _mm_loadu_ps(other.mat[2]);
+        __m128 b3 = _mm_loadu_ps(other.mat[3]);
+        for (i32 row = 0; row < 4; row++) {
+            __m128 r = _mm_mul_ps(_mm_set1_ps(mat[row][0]), b0);
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(mat[row][1]), b1));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(mat[row][2]), b2));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(mat[row][3]), b3));
+            _mm_storeu_ps(result.mat[row], r);
+        }
+#elif MATH_SIMD_NEON
+        float32x4_t b0 = vld1q_f32(other.mat[0]);
+        float32x4_t b1 = vld1q_f32(other.mat[1]);
+        float32x4_t b2 = vld1q_f32(other.mat[2]);
+        float32x4_t b3 = vld1q_f32(other.mat[3]);
+        for (i32 row = 0; row < 4; row++) {
+            float32x4_t r = vmulq_n_f32(b0, mat[row][0]);
+            r = vmlaq_n_f32(r, b1, mat[row][1]);
+            r = vmlaq_n_f32(r, b2, mat[row][2]);
+            r = vmlaq_n_f32(r, b3, mat[row][3]);
+            vst1q_f32(result.mat[row], r);
+        }
+#else
         for (i32 row = 0; row < 4; row++) {
             for (i32 col = 0; col < 4; col++) {
+                f32 sum = 0.0f;
                 for (i32 k = 0; k < 4; k++) {
-                    result.mat[row][col] += mat[row][k] * other.mat[k][col];
+                    sum += mat[row][k] * other.mat[k][col];
                 }
+                result.mat[row][col] = sum;
             }
         }
+#endif
 
         return result;
     }
@@ -249,3 +322,109 @@ struct Mat4x4 {
     f32* data() { return m; }
     const f32* data() const { return m; }
 };
+
+/// @brief Four floats processed as one SSE or NEON register, or a plain array elsewhere.
+/// Comparisons return a lane mask, bit `i` set when lane `i` passed.
+struct F32x4 {
+#if MATH_SIMD_SSE
+    __m128 v;
+#elif MATH_SIMD_NEON
+    float32x4_t v;
+#else
+    f32 v[4];
+#endif
+
+    static F32x4 splat(f32 x) {
+#if MATH_SIMD_SSE
+        return F32x4{_mm_set1_ps(x)};
+#elif MATH_SIMD_NEON
+        return F32x4{vdupq_n_f32(x)};
+#else
+        return F32x4{{x, x, x, x}};
+#endif
+    }
+
+    /// @brief Loads four consecutive floats, no alignment needed.
+    static F32x4 load(const f32* data) {
+#if MATH_SIMD_SSE
+        return F32x4{_mm_loadu_ps(data)};
+#elif MATH_SIMD_NEON
+        return F32x4{vld1q_f32(data)};
+#else
+        return F32x4{{data[0], data[1], data[2], data[3]}};
+#endif
+    }
+
+    static F32x4 init(f32 a, f32 b, f32 c, f32 d) {
+        f32 lanes[4] = {a, b, c, d};
+        return load(lanes);
+    }
+
+    F32x4 operator+(F32x4 other) const {
+#if MATH_SIMD_SSE
+        return F32x4{_mm_add_ps(v, other.v)};
+#elif MATH_SIMD_NEON
+        return F32x4{vaddq_f32(v, other.v)};
+#else
+        return F32x4{{v[0] + other.v[0], v[1] + other.v[1], v[2] + other.v[2], v[3] + other.v[3]}};
+#endif
+    }
+
+    F32x4 operator-(F32x4 other) const {
+#if MATH_SIMD_SSE
+        return F32x4{_mm_sub_ps(v, other.v)};
+#elif MATH_SIMD_NEON
+        return F32x4{vsubq_f32(v, other.v)};
+#else
+        return F32x4{{v[0] - other.v[0], v[1] - other.v[1], v[2] - other.v[2], v[3] - other.v[3]}};
+#endif
+    }
+
+    F32x4 operator*(F32x4 other) const {
+#if MATH_SIMD_SSE
+        return F32x4{_mm_mul_ps(v, other.v)};
+#elif MATH_SIMD_NEON
+        return F32x4{vmulq_f32(v, other.v)};
+#else
+        return F32x4{{v[0] * other.v[0], v[1] * other.v[1], v[2] * other.v[2], v[3] * other.v[3]}};
+#endif
+    }
+
+    static F32x4 min(F32x4 a, F32x4 b) {
+#if MATH_SIMD_SSE
+        return F32x4{_mm_min_ps(a.v, b.v)};
+#elif MATH_SIMD_NEON
+        return F32x4{vminq_f32(a.v, b.v)};
+#else
+        return F32x4{{fminf(a.v[0], b.v[0]), fminf(a.v[1], b.v[1]), fminf(a.v[2], b.v[2]),
+                      fminf(a.v[3], b.v[3])}};
+#endif
+    }
+
+    static F32x4 max(F32x4 a, F32x4 b) {
+#if MATH_SIMD_SSE
+        return F32x4{_mm_max_ps(a.v, b.v)};
+#elif MATH_SIMD_NEON
+        return F32x4{vmaxq_f32(a.v, b.v)};
+#else
+        return F32x4{{fmaxf(a.v[0], b.v[0]), fmaxf(a.v[1], b.v[1]), fmaxf(a.v[2], b.v[2]),
+                      fmaxf(a.v[3], b.v[3])}};
+#endif
+    }
+
+    /// @brief Lanes where this is less than or equal to `other`.
+    u32 le(F32x4 other) const {
+#if MATH_SIMD_SSE
+        return (u32)_mm_movemask_ps(_mm_cmple_ps(v, other.v));
+#elif MATH_SIMD_NEON
+        const uint32x4_t bits = {1, 2, 4, 8};
+        return vaddvq_u32(vandq_u32(vcleq_f32(v, other.v), bits));
+#else
+        u32 mask = 0;
+        for (u32 i = 0; i < 4; i++) {
+            if (v[i] <= other.v[i]) mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+};
@@ -0,0 +1,386 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/def.h"
+#include "lib/hash.h"
+#include "profiler.h"
+#include <SDL3/SDL.h>
+#include <cstring>
+#include <optional>
+
+constexpr u32 PIPELINE_MAX_VERTEX_BUFFERS = 4;
+constexpr u32 PIPELINE_MAX_VERTEX_ATTRIBUTES = 8;
+constexpr u32 PIPELINE_MAX_COLOR_TARGETS = 4;
+
+/// @brief Everything that identifies a graphics pipeline, stored by value so it can be hashed
+/// and kept around to create the pipeline later.
+struct PipelineDesc {
+    SDL_GPUShader* vertex_shader;
+    SDL_GPUShader* fragment_shader;
+
+    SDL_GPUVertexBufferDescription vertex_buffers[PIPELINE_MAX_VERTEX_BUFFERS];
+    u32 num_vertex_buffers;
+    SDL_GPUVertexAttribute vertex_attributes[PIPELINE_MAX_VERTEX_ATTRIBUTES];
+    u32 num_vertex_attributes;
+
+    SDL_GPUPrimitiveType primitive_type;
+    SDL_GPURasterizerState rasterizer_state;
+
+    SDL_GPUColorTargetDescription color_targets[PIPELINE_MAX_COLOR_TARGETS];
+    u32 num_color_targets;
+    SDL_GPUTextureFormat depth_stencil_format;
+    bool has_depth_stencil_target;
+
+    static PipelineDesc init(
+        SDL_GPUShader* vertex_shader,
+        SDL_GPUShader* fragment_shader,
+        SDL_GPUPrimitiveType primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST
+    ) {
+        PipelineDesc desc = {};
+        desc.vertex_shader = vertex_shader;
+        desc.fragment_shader = fragment_shader;
+        desc.primitive_type = primitive_type;
+        desc.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_FILL;
+        return desc;
+    }
+
+    bool add_vertex_buffer(u32 slot, u32 pitch, SDL_GPUVertexInputRate input_rate) {
+        if (num_vertex_buffers >= PIPELINE_MAX_VERTEX_BUFFERS) return false;
+
+        vertex_buffers[num_vertex_buffers++] = SDL_GPUVertexBufferDescription{
+            .slot = slot,
+            .pitch = pitch,
+            .input_rate = input_rate,
+        };
+        return true;
+    }
+
+    bool add_vertex_attribute(
+        u32 location,
+        u32 buffer_slot,
+        SDL_GPUVertexElementFormat format,
+        u32 offset
+    ) {
+        if (num_vertex_attributes >= PIPELINE_MAX_VERTEX_ATTRIBUTES) return false;
+
+        vertex_attributes[num_vertex_attributes++] = SDL_GPUVertexAttribute{
+            .location = location,
+            .buffer_slot = buffer_slot,
+            .format = format,
+            .offset = offset,
+        };
+        return true;
+    }
+
+    bool add_color_target(SDL_GPUTextureFormat format, SDL_GPUColorTargetBlendState blend = {}) {
+        if (num_color_targets >= PIPELINE_MAX_COLOR_TARGETS) return false;
+
+        color_targets[num_color_targets++] = SDL_GPUColorTargetDescription{
+            .format = format,
+            .blend_state = blend,
+        };
+        return true;
+    }
+
+    /// @brief Hashes every field that reaches `create_info`, one by one. Shaders are identified
+    /// by their handle, which is unique for as long as the shader is alive.
+    u64 hash() const {
+        u64 h = FNV1A_OFFSET_BASIS;
+        h = hash_combine(h, (u64)(uintptr_t)vertex_shader);
+        h = hash_combine(h, (u64)(uintptr_t)fragment_shader);
+
+        h = hash_combine(h, num_vertex_buffers);
+        for (u32 i = 0; i < num_vertex_buffers; i++) {
+            h = hash_combine(h, vertex_buffers[i].slot);
+            h = hash_combine(h, vertex_buffers[i].pitch);
+            h = hash_combine(h, vertex_buffers[i].input_rate);
+            h = hash_combine(h, vertex_buffers[i].instance_step_rate);
+        }
+
+        h = hash_combine(h, num_vertex_attributes);
+        for (u32 i = 0; i < num_vertex_attributes; i++) {
+            h = hash_combine(h, vertex_attributes[i].location);
+            h = hash_combine(h, vertex_attributes[i].buffer_slot);
+            h = hash_combine(h, vertex_attributes[i].format);
+            h = hash_combine(h, vertex_attributes[i].offset);
+        }
+
+        h = hash_combine(h, primitive_type);
+        h = hash_combine(h, rasterizer_state.fill_mode);
+        h = hash_combine(h, rasterizer_state.cull_mode);
+        h = hash_combine(h, rasterizer_state.front_face);
+        h = hash_combine(h, f32_bits(rasterizer_state.depth_bias_constant_factor));
+        h = hash_combine(h, f32_bits(rasterizer_state.depth_bias_clamp));
+        h = hash_combine(h, f32_bits(rasterizer_state.depth_bias_slope_factor));
+        h = hash_combine(h, rasterizer_state.enable_depth_bias);
+        h = hash_combine(h, rasterizer_state.enable_depth_clip);
+
+        h = hash_combine(h, num_color_targets);
+        for (u32 i = 0; i < num_color_targets; i++) {
+            const SDL_GPUColorTargetBlendState& blend = color_targets[i].blend_state;
+            h = hash_combine(h, color_targets[i].format);
+            h = hash_combine(h, blend.enable_blend);
+            h = hash_combine(h, blend.src_color_blendfactor);
+            h = hash_combine(h, blend.dst_color_blendfactor);
+            h = hash_combine(h, blend.color_blend_op);
+            h = hash_combine(h, blend.src_alpha_blendfactor);
+            h = hash_combine(h, blend.dst_alpha_blendfactor);
+            h = hash_combine(h, blend.alpha_blend_op);
+            h = hash_combine(h, blend.enable_color_write_mask);
+            h = hash_combine(h, blend.color_write_mask);
+        }
+
+        h = hash_combine(h, has_depth_stencil_target);
+        h = hash_combine(h, depth_stencil_format);
+
+        return h;
+    }
+
+    /// @brief Compares the same fields as `hash`, so a hash collision never returns another
+    /// descriptor's pipeline.
+    bool equals(const PipelineDesc& other) const {
+        if (vertex_shader != other.vertex_shader || fragment_shader != other.fragment_shader) {
+            return false;
+        }
+
+        if (num_vertex_buffers != other.num_vertex_buffers) return false;
+        for (u32 i = 0; i < num_vertex_buffers; i++) {
+            const SDL_GPUVertexBufferDescription& a = vertex_buffers[i];
+            const SDL_GPUVertexBufferDescription& b = other.vertex_buffers[i];
+            if (a.slot != b.slot || a.pitch != b.pitch || a.input_rate != b.input_rate ||
+                a.instance_step_rate != b.instance_step_rate) {
+                return false;
+            }
+        }
+
+        if (num_vertex_attributes != other.num_vertex_attributes) return false;
+        for (u32 i = 0; i < num_vertex_attributes; i++) {
+            const SDL_GPUVertexAttribute& a = vertex_attributes[i];
+            const SDL_GPUVertexAttribute& b = other.vertex_attributes[i];
+            if (a.location != b.location || a.buffer_slot != b.buffer_slot ||
+                a.format != b.format || a.offset != b.offset) {
+                return false;
+            }
+        }
+
+        const SDL_GPURasterizerState& r = rasterizer_state;
+        const SDL_GPURasterizerState& o = other.rasterizer_state;
+        if (primitive_type != other.primitive_type || r.fill_mode != o.fill_mode ||
+            r.cull_mode != o.cull_mode || r.front_face != o.front_face ||
+            f32_bits(r.depth_bias_constant_factor) != f32_bits(o.depth_bias_constant_factor) ||
+            f32_bits(r.depth_bias_clamp) != f32_bits(o.depth_bias_clamp) ||
+            f32_bits(r.depth_bias_slope_factor) != f32_bits(o.depth_bias_slope_factor) ||
+            r.enable_depth_bias != o.enable_depth_bias ||
+            r.enable_depth_clip != o.enable_depth_clip) {
+            return false;
+        }
+
+        if (num_color_targets != other.num_color_targets) return false;
+        for (u32 i = 0; i < num_color_targets; i++) {
+            const SDL_GPUColorTargetBlendState& a = color_targets[i].blend_state;
+            const SDL_GPUColorTargetBlendState& b = other.color_targets[i].blend_state;
+            if (color_targets[i].format != other.color_targets[i].format ||
+                a.enable_blend != b.enable_blend ||
+                a.src_color_blendfactor != b.src_color_blendfactor ||
+                a.dst_color_blendfactor != b.dst_color_blendfactor ||
+                a.color_blend_op != b.color_blend_op ||
+                a.src_alpha_blendfactor != b.src_alpha_blendfactor ||
+                a.dst_alpha_blendfactor != b.dst_alpha_blendfactor ||
+                a.alpha_blend_op != b.alpha_blend_op ||
+                a.enable_color_write_mask != b.enable_color_write_mask ||
+                a.color_write_mask != b.color_write_mask) {
+                return false;
+            }
+        }
+
+        return has_depth_stencil_target == other.has_depth_stencil_target &&
+               depth_stencil_format == other.depth_stencil_format;
+    }
+
+    SDL_GPUGraphicsPipelineCreateInfo create_info() const {
+        return SDL_GPUGraphicsPipelineCreateInfo{
+            .vertex_shader = vertex_shader,
+            .fragment_shader = fragment_shader,
+            .vertex_input_state =
+                {
+                    .vertex_buffer_descriptions = vertex_buffers,
+                    .num_vertex_buffers = num_vertex_buffers,
+                    .vertex_attributes = vertex_attributes,
+                    .num_vertex_attributes = num_vertex_attributes,
+                },
+            .primitive_type = primitive_type,
+            .rasterizer_state = rasterizer_state,
+            .target_info =
+                {
+                    .color_target_descriptions = color_targets,
+                    .num_color_targets = num_color_targets,
+                    .depth_stencil_format = depth_stencil_format,
+                    .has_depth_stencil_target = has_depth_stencil_target,
+                },
+        };
+    }
+
+  private:
+    // Floats are hashed and compared by their bits, so the two always agree.
+    static u32 f32_bits(f32 value) {
+        u32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+};
+
+/// @brief Creates graphics pipelines on first use and deduplicates them by descriptor. `get` may
+/// be called from any thread, its allocator must then be thread-safe.
+struct PipelineCache {
+    struct Entry {
+        u64 hash;
+        PipelineDesc desc;
+        SDL_GPUGraphicsPipeline* pipeline;
+    };
+
+    Allocator allocator;
+    SDL_GPUDevice* device;
+    SDL_Mutex* mutex;
+    // Open addressing table with linear probing, `capacity` is a power of two.
+    Entry* entries;
+    u32 capacity;
+    u32 count;
+
+    static PipelineCache init(Allocator allocator, SDL_GPUDevice* device, u32 capacity = 64) {
+        u32 table_capacity = 1;
+        while (table_capacity < capacity) {
+            table_capacity *= 2;
+        }
+
+        Entry* entries = allocator.alloc_array<Entry>(table_capacity);
+        for (u32 i = 0; i < table_capacity; i++) {
+            entries[i].pipeline = nullptr;
+        }
+
+        return PipelineCache{
+            .allocator = allocator,
+            .device = device,
+            .mutex = SDL_CreateMutex(),
+            .entries = entries,
+            .capacity = table_capacity,
+            .count = 0,
+        };
+    }
+
+    void deinit() {
+        for (u32 i = 0; i < capacity; i++) {
+            if (entries[i].pipeline) {
+                SDL_ReleaseGPUGraphicsPipeline(device, entries[i].pipeline);
+            }
+        }
+
+        allocator.free_array(entries, capacity);
+        entries = nullptr;
+        capacity = 0;
+        count = 0;
+        SDL_DestroyMutex(mutex);
+    }
+
+    /// @brief Returns the pipeline for `desc`, creating it if this is the first request.
+    SDL_GPUGraphicsPipeline* get(const PipelineDesc& desc) {
+        u64 hash = desc.hash();
+
+        SDL_LockMutex(mutex);
+        Entry* entry = find(hash, desc);
+        SDL_GPUGraphicsPipeline* cached = entry ? entry->pipeline : nullptr;
+        SDL_UnlockMutex(mutex);
+        if (cached) return cached;
+
+        // Created outside the lock, driver compilation is the slow part.
+        PROFILE_SCOPE("create pipeline");
+        SDL_GPUGraphicsPipelineCreateInfo info = desc.create_info();
+        SDL_GPUGraphicsPipeline* pipeline = SDL_CreateGPUGraphicsPipeline(device, &info);
+        if (!pipeline) {
+            SDL_Log("Failed to create graphics pipeline %s\n", SDL_GetError());
+            return nullptr;
+        }
+
+        SDL_LockMutex(mutex);
+        defer { SDL_UnlockMutex(mutex); };
+
+        Entry* raced = find(hash, desc);
+        if (raced) {
+            SDL_ReleaseGPUGraphicsPipeline(device, pipeline);
+            return raced->pipeline;
+        }
+
+        insert(hash, desc, pipeline);
+        return pipeline;
+    }
+
+    /// @brief Releases every cached pipeline built from `shader`, once the shader itself is
+    /// gone, so a later shader that reuses the handle cannot hit them.
+    /// @return Number of pipelines released.
+    u32 remove_shader(SDL_GPUShader* shader) {
+        SDL_LockMutex(mutex);
+        defer { SDL_UnlockMutex(mutex); };
+
+        u32 removed = 0;
+        for (u32 i = 0; i < capacity; i++) {
+            Entry& entry = entries[i];
+            if (!entry.pipeline) continue;
+            if (entry.desc.vertex_shader != shader && entry.desc.fragment_shader != shader) {
+                continue;
+            }
+
+            SDL_ReleaseGPUGraphicsPipeline(device, entry.pipeline);
+            entry.pipeline = nullptr;
+            removed++;
+        }
+
+        // Removed slots break the probe chains of the entries after them.
+        if (removed > 0) rehash(capacity);
+
+        return removed;
+    }
+
+  private:
+    Entry* find(u64 hash, const PipelineDesc& desc) {
+        u32 mask = capacity - 1;
+        for (u32 i = (u32)hash & mask;; i = (i + 1) & mask) {
+            if (!entries[i].pipeline) return nullptr;
+            if (entries[i].hash == hash && entries[i].desc.equals(desc)) return &entries[i];
+        }
+    }
+
+    void insert(u64 hash, const PipelineDesc& desc, SDL_GPUGraphicsPipeline* pipeline) {
+        // Keep the load factor under 3/4 so probes stay short.
+        if ((count + 1) * 4 > capacity * 3) grow();
+
+        u32 mask = capacity - 1;
+        u32 i = (u32)hash & mask;
+        while (entries[i].pipeline) {
+            i = (i + 1) & mask;
+        }
+
+        entries[i] = Entry{.hash = hash, .desc = desc, .pipeline = pipeline};
+        count++;
+    }
+
+    void grow() { rehash(capacity * 2); }
+
+    void rehash(u32 new_capacity) {
+        Entry* old_entries = entries;
+        u32 old_capacity = capacity;
+
+        capacity = new_capacity;
+        entries = allocator.alloc_array<Entry>(capacity);
+        for (u32 i = 0; i < capacity; i++) {
+            entries[i].pipeline = nullptr;
+        }
+        count = 0;
+
+        for (u32 i = 0; i < old_capacity; i++) {
+            if (old_entries[i].pipeline) {
+                insert(old_entries[i].hash, old_entries[i].desc, old_entries[i].pipeline);
+            }
+        }
+
+        allocator.free_array(old_entries, old_capacity);
+    }
+};
@@ -0,0 +1,336 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/def.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PROFILER_RDTSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define PROFILER_RDTSC 0
+#endif
+
+// Zones are cheap enough to leave in release builds; build with -DPROFILER_ENABLED=0 to
+// remove every PROFILE_* macro from the program.
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// Per thread, a power of two. Older events are overwritten once a thread's ring is full.
+constexpr u32 PROFILER_EVENTS_PER_THREAD = 1 << 16;
+// The job system and the startup task graph each run at most this many threads; jobs.h and
+// startup.h assert it.
+constexpr u32 PROFILER_MAX_POOL_THREADS = 64;
+// Rings are never recycled, so there is one for every thread that can exist: both pools, plus
+// the main, async io, simulation and shader watcher threads.
+constexpr u32 PROFILER_MAX_THREADS = 2 * PROFILER_MAX_POOL_THREADS + 4;
+
+enum ProfileEventType : u32 {
+    PROFILE_EVENT_ZONE,
+    PROFILE_EVENT_COUNTER,
+    PROFILE_EVENT_FRAME,
+};
+
+struct ProfileEvent {
+    // Must outlive the profiler, in practice a string literal.
+    string name;
+    u64 start;
+    // Duration in ticks for zones, the value for counters, the frame index for frames.
+    u64 value;
+    ProfileEventType type;
+};
+
+/// @brief Raw timestamp: the TSC on x86-64, the performance counter elsewhere.
+inline u64 profiler_now() {
+#if PROFILER_RDTSC
+    return __rdtsc();
+#else
+    return SDL_GetPerformanceCounter();
+#endif
+}
+
+/// @brief Writes `text` as a quoted JSON string, for trace exports. Names are usually
+/// literals, but nothing stops one from holding a quote, a backslash or a control character.
+inline void profiler_write_json_string(FILE* file, string text) {
+    fputc('"', file);
+    for (string c = text ? text : ""; *c; c++) {
+        u8 ch = (u8)*c;
+        if (ch == '"' || ch == '\\') {
+            fputc('\\', file);
+            fputc(ch, file);
+        } else if (ch < 0x20) {
+            fprintf(file, "\\u%04x", ch);
+        } else {
+            fputc(ch, file);
+        }
+    }
+    fputc('"', file);
+}
+
+/// @brief Event ring written only by its own thread. The writer publishes with a release
+/// store of `head`, so a reader that acquires `head` sees every event before it.
+struct ProfilerThread {
+    ProfileEvent* events;
+    u64 mask;
+    std::atomic<u64> head;
+    u64 thread_id;
+    string name;
+
+    void write(ProfileEvent event) {
+        u64 index = head.load(std::memory_order_relaxed);
+        events[index & mask] = event;
+        head.store(index + 1, std::memory_order_release);
+    }
+};
+
+/// @brief Collects zones, counters and frame markers from every thread into per-thread
+/// rings, and exports them as Chrome Trace Event JSON. Recording takes no locks; only the
+/// first event of each thread takes the mutex to register the thread's ring.
+///
+/// There is one process-wide instance, `global_profiler`. Until `init` is called every
+/// PROFILE_* macro returns after one relaxed load.
+struct Profiler {
+    Allocator allocator;
+    std::atomic<bool> enabled;
+    SDL_Mutex* mutex;
+
+    ProfilerThread threads[PROFILER_MAX_THREADS];
+    std::atomic<u32> thread_count;
+    // Handed to threads that got no ring. Never written: their events are only counted.
+    ProfilerThread full;
+    std::atomic<u64> dropped_events;
+
+    std::atomic<u64> frame_index;
+
+    // Pairs of raw and performance counter timestamps, taken at `init` and at export, give
+    // the tick rate without a calibration sleep.
+    u64 start_ticks;
+    u64 start_counter;
+
+    /// @brief Starts recording. Call once, before the threads that should be profiled start.
+    void init(Allocator allocator) {
+        if constexpr (!PROFILER_ENABLED) return;
+
+        this->allocator = allocator;
+        mutex = SDL_CreateMutex();
+        thread_count.store(0);
+        frame_index.store(0);
+        dropped_events.store(0);
+        full.events = nullptr;
+        start_ticks = profiler_now();
+        start_counter = SDL_GetPerformanceCounter();
+        enabled.store(true, std::memory_order_release);
+    }
+
+    /// @brief Stops recording and frees every ring. Other threads must be done recording.
+    void deinit() {
+        if (!enabled.exchange(false)) return;
+
+        for (u32 i = 0; i < thread_count.load(); i++) {
+            allocator.free_array(threads[i].events, PROFILER_EVENTS_PER_THREAD);
+            threads[i].events = nullptr;
+        }
+        thread_count.store(0);
+        SDL_DestroyMutex(mutex);
+        mutex = nullptr;
+    }
+
+    bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    ProfilerThread* register_thread() {
+        SDL_LockMutex(mutex);
+        defer { SDL_UnlockMutex(mutex); };
+
+        u32 index = thread_count.load();
+        if (index == PROFILER_MAX_THREADS) return &full;
+
+        ProfilerThread& thread = threads[index];
+        thread.events = allocator.alloc_array<ProfileEvent>(PROFILER_EVENTS_PER_THREAD);
+        if (!thread.events) return &full;
+        thread.mask = PROFILER_EVENTS_PER_THREAD - 1;
+        thread.head.store(0);
+        thread.thread_id = SDL_GetCurrentThreadID();
+        thread.name = nullptr;
+
+        thread_count.store(index + 1, std::memory_order_release);
+        return &thread;
+    }
+
+    /// @brief Writes every event still in the rings as Chrome Trace Event JSON, viewable in
+    /// chrome://tracing or Perfetto. Threads may keep recording, but events they write while
+    /// the export runs may be missing or, if a ring wraps meanwhile, garbled.
+    bool write_chrome_trace(string path) {
+        if (!is_enabled()) return false;
+
+        FILE* file = fopen(path, "wb");
+        if (!file) return false;
+        defer { fclose(file); };
+
+        f64 to_us = ticks_to_us();
+        bool first = true;
+        auto separator = [&]() {
+            const char* result = first ? "" : ",\n";
+            first = false;
+            return result;
+        };
+
+        fprintf(file, "{\"traceEvents\":[\n");
+        u32 count = thread_count.load(std::memory_order_acquire);
+        for (u32 tid = 0; tid < count; tid++) {
+            ProfilerThread& thread = threads[tid];
+            if (thread.name) {
+                fprintf(
+                    file,
+                    "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+                    "\"args\":{\"name\":",
+                    separator(),
+                    tid
+                );
+                profiler_write_json_string(file, thread.name);
+                fprintf(file, "}}");
+            }
+
+            u64 head = thread.head.load(std::memory_order_acquire);
+            u64 first_event = head > PROFILER_EVENTS_PER_THREAD ? head - PROFILER_EVENTS_PER_THREAD
+                                                                : 0;
+            for (u64 i = first_event; i < head; i++) {
+                const ProfileEvent& event = thread.events[i & thread.mask];
+                f64 ts = (f64)(event.start - start_ticks) * to_us;
+                fprintf(file, "%s{\"name\":", separator());
+                profiler_write_json_string(file, event.name);
+                switch (event.type) {
+                    case PROFILE_EVENT_ZONE:
+                        fprintf(
+                            file,
+                            ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                            tid,
+                            ts,
+                            (f64)event.value * to_us
+                        );
+                        break;
+                    case PROFILE_EVENT_COUNTER:
+                        fprintf(
+                            file,
+                            ",\"ph\":\"C\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,"
+                            "\"args\":{\"value\":%llu}}",
+                            tid,
+                            ts,
+                            (unsigned long long)event.value
+                        );
+                        break;
+                    case PROFILE_EVENT_FRAME:
+                        fprintf(
+                            file,
+                            ",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,"
+                            "\"args\":{\"frame\":%llu}}",
+                            tid,
+                            ts,
+                            (unsigned long long)event.value
+                        );
+                        break;
+                }
+            }
+        }
+        fprintf(file, "\n]}\n");
+
+        u64 dropped = dropped_events.load(std::memory_order_relaxed);
+        if (dropped > 0) {
+            SDL_Log("Profiler dropped %llu events from threads without a ring\n", dropped);
+        }
+        return true;
+    }
+
+  private:
+    f64 ticks_to_us() const {
+        f64 counter_us = 1000000.0 / (f64)SDL_GetPerformanceFrequency();
+#if PROFILER_RDTSC
+        u64 elapsed_ticks = profiler_now() - start_ticks;
+        u64 elapsed_counter = SDL_GetPerformanceCounter() - start_counter;
+        if (elapsed_ticks == 0) return 0.0;
+        return (f64)elapsed_counter / (f64)elapsed_ticks * counter_us;
+#else
+        return counter_us;
+#endif
+    }
+};
+
+inline Profiler global_profiler = {};
+inline thread_local ProfilerThread* profiler_thread = nullptr;
+
+inline ProfilerThread* profiler_current_thread() {
+    ProfilerThread* thread = profiler_thread;
+    if (!thread) [[unlikely]] {
+        thread = global_profiler.register_thread();
+        profiler_thread = thread;
+    }
+    return thread;
+}
+
+inline void profile_record(string name, u64 start, u64 value, ProfileEventType type) {
+    if (!global_profiler.is_enabled()) return;
+
+    ProfilerThread* thread = profiler_current_thread();
+    if (thread == &global_profiler.full) [[unlikely]] {
+        global_profiler.dropped_events.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    thread->write(ProfileEvent{.name = name, .start = start, .value = value, .type = type});
+}
+
+/// @brief Times its own lifetime. Created by PROFILE_SCOPE, recorded when it goes out of
+/// scope.
+struct ProfileZone {
+    string name;
+    u64 start;
+
+    static ProfileZone begin(string name) { return ProfileZone{name, profiler_now()}; }
+
+    ~ProfileZone() {
+        u64 end = profiler_now();
+        profile_record(name, start, end - start, PROFILE_EVENT_ZONE);
+    }
+};
+
+inline void profile_counter(string name, u64 value) {
+    profile_record(name, profiler_now(), value, PROFILE_EVENT_COUNTER);
+}
+
+inline void profile_frame() {
+    if (!global_profiler.is_enabled()) return;
+
+    u64 frame = global_profiler.frame_index.fetch_add(1, std::memory_order_relaxed);
+    profile_record("frame", profiler_now(), frame, PROFILE_EVENT_FRAME);
+}
+
+/// @brief Names the calling thread in exported traces.
+inline void profile_thread_name(string name) {
+    if (!global_profiler.is_enabled()) return;
+
+    ProfilerThread* thread = profiler_current_thread();
+    if (thread != &global_profiler.full) thread->name = name;
+}
+
+#if PROFILER_ENABLED
+#define PROFILE_NAME_(line) profile_zone_##line
+#define PROFILE_NAME(line) PROFILE_NAME_(line)
+
+/// Times the rest of the enclosing scope. `name` must outlive the profiler, usually a literal.
+#define PROFILE_SCOPE(name) ProfileZone PROFILE_NAME(__LINE__) = ProfileZone::begin(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_COUNTER(name, value) profile_counter(name, (u64)(value))
+#define PROFILE_FRAME() profile_frame()
+#define PROFILE_THREAD_NAME(name) profile_thread_name(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
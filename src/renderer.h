@@ -1,9 +1,19 @@
 #pragma once
 
+#include "frame_ring.h"
+#include "frame_stats.h"
+#include "gpu_heap.h"
+#include "instancing.h"
 #include "lib/allocator.h"
 #include "lib/def.h"
 #include "math.h"
+#include "pipeline_cache.h"
+#include "profiler.h"
 #include "shader.h"
+#include "shader_cache.h"
+#include "startup.h"
+#include "task.h"
+#include "upload.h"
 #include <SDL3/SDL.h>
 #include <expected>
 
@@ -33,12 +43,30 @@ struct TransformBuffer {
     Mat4x4 mvp_matrix;
 };
 
+// Shaders of the built-in pipelines.
+constexpr string SHADER_TRIANGLE_VERT = "raw-triangle.vert";
+constexpr string SHADER_INSTANCED_VERT = "instanced.vert";
+constexpr string SHADER_SOLID_COLOR_FRAG = "solid-color.frag";
+
+constexpr u32 MAX_INSTANCES = 16384;
+constexpr u32 FRAME_TRANSFER_BUFFER_SIZE = MAX_INSTANCES * sizeof(InstanceData);
+constexpr u32 STAGING_BUFFER_SIZE = MB(16);
+constexpr u32 VERTEX_HEAP_SIZE = MB(64);
+constexpr u32 INDEX_HEAP_SIZE = MB(16);
+
+#ifdef NDEBUG
+constexpr bool SHADER_HOT_RELOAD = false;
+#else
+constexpr bool SHADER_HOT_RELOAD = true;
+#endif
+
 enum RendererInitError {
     VERTEX_SHADER_LOAD_ERROR,
     FRAGMENT_SHADER_LOAD_ERROR,
     PIPELINE_CREATION_ERROR,
     VERTEX_BUFFER_CREATION_ERROR,
-    TRANSFER_BUFFER_CREATION_ERROR
+    TRANSFER_BUFFER_CREATION_ERROR,
+    INSTANCE_BUFFER_CREATION_ERROR,
 };
 
 constexpr string to_string(RendererInitError error) {
@@ -53,92 +81,249 @@ constexpr string to_string(RendererInitError error) {
             return "VERTEX_BUFFER_CREATION_ERROR";
         case TRANSFER_BUFFER_CREATION_ERROR:
             return "TRANSFER_BUFFER_CREATION_ERROR";
+        case INSTANCE_BUFFER_CREATION_ERROR:
+            return "INSTANCE_BUFFER_CREATION_ERROR";
         default:
             return "UNKNOWN_ERROR";
     }
 }
 
+/// @brief Shader and pipeline creation for `Renderer::init`, split into startup tasks. The
+/// shaders load in parallel, then every pipeline is built on its own worker.
+struct RendererStartup {
+    struct ShaderLoad {
+        ShaderCache* cache;
+        string name;
+        ShaderResources resources;
+        SDL_GPUShader* shader;
+    };
+
+    struct PipelineBuild {
+        PipelineCache* cache;
+        const PipelineDesc* desc;
+        SDL_GPUGraphicsPipeline* pipeline;
+    };
+
+    PipelineCache* pipelines;
+    SDL_GPUTextureFormat swapchain_format;
+
+    ShaderLoad vertex_shader;
+    ShaderLoad instanced_vertex_shader;
+    ShaderLoad fragment_shader;
+
+    PipelineDesc pipeline_fill;
+    PipelineDesc pipeline_line;
+    PipelineDesc pipeline_instanced;
+    PipelineBuild builds[3];
+
+    static RendererStartup init(
+        ShaderCache* shaders,
+        PipelineCache* pipelines,
+        SDL_GPUTextureFormat swapchain_format
+    ) {
+        RendererStartup startup = {};
+        startup.pipelines = pipelines;
+        startup.swapchain_format = swapchain_format;
+        startup.vertex_shader = ShaderLoad{
+            .cache = shaders,
+            .name = SHADER_TRIANGLE_VERT,
+            .resources = ShaderResources{.num_uniform_buffers = 1},
+            .shader = nullptr,
+        };
+        startup.instanced_vertex_shader = ShaderLoad{
+            .cache = shaders,
+            .name = SHADER_INSTANCED_VERT,
+            .resources = ShaderResources{.num_storage_buffers = 1},
+            .shader = nullptr,
+        };
+        startup.fragment_shader = ShaderLoad{
+            .cache = shaders,
+            .name = SHADER_SOLID_COLOR_FRAG,
+            .resources = ShaderResources{},
+            .shader = nullptr,
+        };
+        return startup;
+    }
+
+    /// @brief Adds the startup tasks to `graph`. `this` must outlive `graph.run`.
+    void schedule(TaskGraph& graph) {
+        builds[0] = PipelineBuild{.cache = pipelines, .desc = &pipeline_fill, .pipeline = nullptr};
+        builds[1] = PipelineBuild{.cache = pipelines, .desc = &pipeline_line, .pipeline = nullptr};
+        builds[2] =
+            PipelineBuild{.cache = pipelines, .desc = &pipeline_instanced, .pipeline = nullptr};
+
+        u32 loads[] = {
+            graph.add("load raw-triangle.vert", load_shader_task, &vertex_shader),
+            graph.add("load instanced.vert", load_shader_task, &instanced_vertex_shader),
+            graph.add("load solid-color.frag", load_shader_task, &fragment_shader),
+        };
+
+        u32 describe = graph.add("describe pipelines", describe_pipelines_task, this);
+        for (u32 load : loads) {
+            graph.depends_on(describe, load);
+        }
+
+        string build_names[] = {
+            "build pipeline fill",
+            "build pipeline line",
+            "build pipeline instanced",
+        };
+        for (u32 i = 0; i < 3; i++) {
+            u32 build = graph.add(build_names[i], build_pipeline_task, &builds[i]);
+            graph.depends_on(build, describe);
+        }
+    }
+
+  private:
+    static void load_shader_task(void* data) {
+        auto load = (ShaderLoad*)data;
+
+        load->shader = load->cache->get(load->name, load->resources);
+    }
+
+    static void describe_pipelines_task(void* data) {
+        auto startup = (RendererStartup*)data;
+        SDL_GPUShader* vertex = startup->vertex_shader.shader;
+        SDL_GPUShader* instanced_vertex = startup->instanced_vertex_shader.shader;
+        SDL_GPUShader* fragment = startup->fragment_shader.shader;
+        if (!vertex || !instanced_vertex || !fragment) return;
+
+        PipelineDesc fill = PipelineDesc::init(vertex, fragment);
+        fill.add_vertex_buffer(0, sizeof(VertexData), SDL_GPU_VERTEXINPUTRATE_VERTEX);
+        fill.add_vertex_attribute(0, 0, SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4, 0);
+        fill.add_vertex_attribute(1, 0, SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4, sizeof(f32) * 4);
+        fill.add_color_target(startup->swapchain_format);
+        startup->pipeline_fill = fill;
+
+        startup->pipeline_line = fill;
+        startup->pipeline_line.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_LINE;
+
+        startup->pipeline_instanced = fill;
+        startup->pipeline_instanced.vertex_shader = instanced_vertex;
+    }
+
+    static void build_pipeline_task(void* data) {
+        auto build = (PipelineBuild*)data;
+        // Left null when a shader failed to load.
+        if (!build->desc->vertex_shader || !build->desc->fragment_shader) return;
+
+        build->pipeline = build->cache->get(*build->desc);
+    }
+};
+
+/// @brief What the last `Renderer::render` submitted.
+struct RenderStats {
+    u32 draw_calls;
+    u32 instances;
+    u32 vertices;
+    u32 upload_bytes;
+};
+
 struct Renderer {
     Allocator& allocator;
+    Allocator& temp_allocator;
     SDL_GPUDevice* device{};
-    SDL_GPUGraphicsPipeline* pipeline_fill{};
-    SDL_GPUGraphicsPipeline* pipeline_line{};
-    SDL_GPUBuffer* vertex_buffer{};
-
-    static std::expected<Renderer, RendererInitError>
-    init(Allocator& allocator, SDL_GPUDevice* device, SDL_Window* window) {
-        SDL_GPUShader* vertex_shader =
-            load_shader(allocator, device, "raw-triangle.vert", 0, 1, 0, 0);
-        SDL_GPUShader* fragment_shader =
-            load_shader(allocator, device, "solid-color.frag", 0, 0, 0, 0);
-
-        if (!vertex_shader || !fragment_shader) {
-            SDL_Log("Failed to load shaders %s\n", SDL_GetError());
+
+    // Shaders stay alive for the renderer's lifetime so pipelines can be created lazily.
+    ShaderCache shaders;
+    PipelineCache pipelines;
+    PipelineDesc pipeline_fill;
+    PipelineDesc pipeline_line;
+    PipelineDesc pipeline_instanced;
+
+    // Shared geometry buffers, meshes are ranges inside them. Vertex ranges are aligned to
+    // sizeof(VertexData) so a mesh is addressed by its first vertex.
+    GPUBufferHeap vertex_heap;
+    GPUBufferHeap index_heap;
+    GPUBufferRange triangle;
+
+    // Instanced path: every instance pushed into `instances` during the frame is packed into
+    // `instance_buffer` and drawn with a single draw call.
+    SDL_GPUBuffer* instance_buffer{};
+    InstanceBatch instances;
+
+    FrameRing frames;
+    UploadManager uploads;
+
+    // Headless renderers have no device. `render` still packs the instance batch, into
+    // `headless_instances` instead of a transfer buffer, so the frame's CPU work is measured
+    // the same way without a GPU or a window.
+    bool headless;
+    InstanceData* headless_instances;
+
+    RenderStats stats;
+
+    // Packs the instance batch in parallel when set. Owned by the caller.
+    JobSystem* jobs;
+
+    /// @param device GPU device to render with, or nullptr for the headless null backend.
+    static std::expected<Renderer, RendererInitError> init(
+        Allocator& allocator,
+        Allocator& temp_allocator,
+        SDL_GPUDevice* device,
+        SDL_Window* window,
+        TaskProgressFn progress = nullptr,
+        void* progress_data = nullptr,
+        StartupTrace* trace = nullptr
+    ) {
+        PROFILE_SCOPE("renderer init");
+        if (!device) {
+            return init_headless(allocator, temp_allocator);
+        }
+
+        // Both caches are filled from startup worker threads, so they get a thread-safe
+        // allocator instead of the arena.
+        auto shaders = ShaderCache::init(PageAllocator::init(), device, SHADER_HOT_RELOAD);
+        if (!shaders.has_value()) {
             return std::unexpected(VERTEX_SHADER_LOAD_ERROR);
         }
+        auto pipelines = PipelineCache::init(PageAllocator::init(), device);
 
-        defer {
-            SDL_ReleaseGPUShader(device, vertex_shader);
-            SDL_ReleaseGPUShader(device, fragment_shader);
-        };
+        RendererStartup startup = RendererStartup::init(
+            &shaders.value(),
+            &pipelines,
+            SDL_GetGPUSwapchainTextureFormat(device, window)
+        );
 
-        SDL_GPUGraphicsPipelineCreateInfo pipeline_info = {
-            .vertex_shader = vertex_shader,
-            .fragment_shader = fragment_shader,
-            .vertex_input_state =
-                (SDL_GPUVertexInputState){
-                    .vertex_buffer_descriptions =
-                        (SDL_GPUVertexBufferDescription[]){
-                            {
-                                .slot = 0,
-                                .pitch = sizeof(VertexData),
-                                .input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX,
-                            },
-                        },
-                    .num_vertex_buffers = 1,
-                    .vertex_attributes =
-                        (SDL_GPUVertexAttribute[]){
-                            {
-                                .location = 0,
-                                .buffer_slot = 0,
-                                .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
-                                .offset = 0,
-                            },
-                            {
-                                .location = 1,
-                                .buffer_slot = 0,
-                                .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
-                                .offset = sizeof(f32) * 4,
-                            },
-                        },
-                    .num_vertex_attributes = 2,
-                },
-            .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
-            .target_info = {
-                .color_target_descriptions =
-                    (SDL_GPUColorTargetDescription[]){
-                        {
-                            .format = SDL_GetGPUSwapchainTextureFormat(device, window),
-                        },
-                    },
-                .num_color_targets = 1,
-            },
-        };
+        TaskGraph graph = TaskGraph::init(allocator);
+        defer { graph.deinit(); };
+        startup.schedule(graph);
 
-        pipeline_info.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_FILL;
-        SDL_GPUGraphicsPipeline* pipeline_fill =
-            SDL_CreateGPUGraphicsPipeline(device, &pipeline_info);
-        if (!pipeline_fill) {
-            SDL_Log("Failed to create graphics pipeline %s\n", SDL_GetError());
-            return std::unexpected(PIPELINE_CREATION_ERROR);
+        // Joined here, before the first frame.
+        graph.run((u32)SDL_GetNumLogicalCPUCores(), progress, progress_data, trace);
+
+        if (!startup.vertex_shader.shader || !startup.instanced_vertex_shader.shader) {
+            SDL_Log("Failed to load vertex shaders %s\n", SDL_GetError());
+            return std::unexpected(VERTEX_SHADER_LOAD_ERROR);
         }
 
-        pipeline_info.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_LINE;
-        SDL_GPUGraphicsPipeline* pipeline_line =
-            SDL_CreateGPUGraphicsPipeline(device, &pipeline_info);
-        if (!pipeline_line) {
-            SDL_Log("Failed to create graphics pipeline %s\n", SDL_GetError());
-            return std::unexpected(PIPELINE_CREATION_ERROR);
+        if (!startup.fragment_shader.shader) {
+            SDL_Log("Failed to load fragment shader %s\n", SDL_GetError());
+            return std::unexpected(FRAGMENT_SHADER_LOAD_ERROR);
+        }
+
+        for (auto& build : startup.builds) {
+            if (!build.pipeline) {
+                SDL_Log("Failed to create graphics pipelines %s\n", SDL_GetError());
+                return std::unexpected(PIPELINE_CREATION_ERROR);
+            }
+        }
+
+        SDL_GPUBuffer* instance_buffer = SDL_CreateGPUBuffer(
+            device,
+            &(SDL_GPUBufferCreateInfo){
+                .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
+                .size = MAX_INSTANCES * sizeof(InstanceData),
+            }
+        );
+        if (!instance_buffer) {
+            SDL_Log("Failed to create instance buffer %s\n", SDL_GetError());
+            return std::unexpected(INSTANCE_BUFFER_CREATION_ERROR);
+        }
+
+        auto frames = FrameRing::init(device, FRAME_TRANSFER_BUFFER_SIZE);
+        if (!frames.has_value()) {
+            return std::unexpected(TRANSFER_BUFFER_CREATION_ERROR);
         }
 
         VertexData triangle_vertices[] = {
@@ -156,79 +341,193 @@ struct Renderer {
             },
         };
 
-        SDL_GPUBufferCreateInfo vertex_buffer_info = {
-            .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-            .size = sizeof(triangle_vertices),
-        };
+        auto vertex_heap = GPUBufferHeap::init(
+            allocator,
+            device,
+            SDL_GPU_BUFFERUSAGE_VERTEX,
+            VERTEX_HEAP_SIZE,
+            sizeof(VertexData)
+        );
+        auto index_heap =
+            GPUBufferHeap::init(allocator, device, SDL_GPU_BUFFERUSAGE_INDEX, INDEX_HEAP_SIZE, 4);
+        if (!vertex_heap.has_value() || !index_heap.has_value()) {
+            return std::unexpected(VERTEX_BUFFER_CREATION_ERROR);
+        }
 
-        SDL_GPUBuffer* vertex_buffer = SDL_CreateGPUBuffer(device, &vertex_buffer_info);
-        if (!vertex_buffer) {
-            SDL_Log("Failed to create vertex buffer %s\n", SDL_GetError());
+        auto triangle = vertex_heap->allocate(sizeof(triangle_vertices));
+        if (!triangle.has_value()) {
             return std::unexpected(VERTEX_BUFFER_CREATION_ERROR);
         }
 
-        SDL_GPUTransferBuffer* transfer_buffer = SDL_CreateGPUTransferBuffer(
-            device,
-            &(SDL_GPUTransferBufferCreateInfo){
-                .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-                .size = sizeof(triangle_vertices),
-            }
+        auto uploads = UploadManager::init(allocator, device, STAGING_BUFFER_SIZE);
+        if (!uploads.has_value()) {
+            return std::unexpected(TRANSFER_BUFFER_CREATION_ERROR);
+        }
+
+        // Recorded into the first frame's copy pass.
+        bool staged = uploads->upload_buffer(
+            triangle->buffer,
+            triangle->offset,
+            triangle_vertices,
+            sizeof(triangle_vertices)
         );
-        if (!transfer_buffer) {
-            SDL_Log("Failed to create transfer buffer %s\n", SDL_GetError());
+        if (!staged) {
+            SDL_Log("Failed to stage vertex data\n");
             return std::unexpected(TRANSFER_BUFFER_CREATION_ERROR);
         }
-        defer { SDL_ReleaseGPUTransferBuffer(device, transfer_buffer); };
 
-        void* transfer_data = SDL_MapGPUTransferBuffer(device, transfer_buffer, false);
-        memcpy(transfer_data, triangle_vertices, sizeof(triangle_vertices));
-        SDL_UnmapGPUTransferBuffer(device, transfer_buffer);
+        return Renderer{
+            .allocator = allocator,
+            .temp_allocator = temp_allocator,
+            .device = device,
+            .shaders = shaders.value(),
+            .pipelines = pipelines,
+            .pipeline_fill = startup.pipeline_fill,
+            .pipeline_line = startup.pipeline_line,
+            .pipeline_instanced = startup.pipeline_instanced,
+            .vertex_heap = vertex_heap.value(),
+            .index_heap = index_heap.value(),
+            .triangle = triangle.value(),
+            .instance_buffer = instance_buffer,
+            .instances = InstanceBatch::init(allocator, MAX_INSTANCES),
+            .frames = frames.value(),
+            .uploads = uploads.value(),
+            .headless = false,
+            .headless_instances = nullptr,
+            .stats = {},
+            .jobs = nullptr,
+        };
+    }
+
+    /// @brief Renderer for the null backend, see `headless`.
+    static Renderer init_headless(Allocator& allocator, Allocator& temp_allocator) {
+        return Renderer{
+            .allocator = allocator,
+            .temp_allocator = temp_allocator,
+            .device = nullptr,
+            .instances = InstanceBatch::init(allocator, MAX_INSTANCES),
+            .headless = true,
+            .headless_instances = allocator.alloc_array<InstanceData>(MAX_INSTANCES),
+            .stats = {},
+            .jobs = nullptr,
+        };
+    }
+
+    void deinit() {
+        if (headless) {
+            instances.deinit();
+            allocator.free_array(headless_instances, MAX_INSTANCES);
+            return;
+        }
+
+        frames.deinit();
+        uploads.deinit();
+        instances.deinit();
+        SDL_ReleaseGPUBuffer(device, instance_buffer);
+        vertex_heap.deinit();
+        index_heap.deinit();
+        pipelines.deinit();
+        shaders.deinit();
+    }
+
+    /// @brief Starts a `reload_shader` task for every shader whose binary changed on disk.
+    /// Must be called between frames.
+    void reload_shaders(TaskScheduler* tasks) {
+        if (headless) return;
+
+        string changed[SHADER_WATCH_QUEUE_SIZE];
+        u32 count = shaders.poll_changed(changed, SHADER_WATCH_QUEUE_SIZE);
+        for (u32 i = 0; i < count; i++) {
+            if (!tasks->spawn(reload_shader(tasks, changed[i]))) {
+                SDL_Log("Failed to start hot reload of %s\n", changed[i]);
+            }
+        }
+    }
+
+    /// @brief Reads the new binary of `shader_name` without stalling the frame loop, hashes it
+    /// on a worker, then swaps it in on the main thread and rebuilds the pipelines using it.
+    /// @param shader_name Interned by the shader cache.
+    Task<void> reload_shader(TaskScheduler* tasks, string shader_name) {
+        char path[1024];
+        if (!shader_path(path, sizeof(path), shader_name, shaders.format)) co_return;
+
+        // Freed on whichever thread the task ends on, so not the arena.
+        Allocator file_allocator = PageAllocator::init();
+        AsyncIOResult file = co_await tasks->read_file(path, file_allocator);
+        if (file.status != ASYNC_IO_COMPLETE) {
+            SDL_Log("Hot reload of %s could not read %s\n", shader_name, path);
+            co_return;
+        }
+        defer { file_allocator.free_array(file.data, file.size); };
+
+        co_await tasks->resume_on_worker();
+        u64 code_hash = hash_bytes(file.data, file.size);
+
+        co_await tasks->resume_on_main();
+        ShaderReload reloads[8];
+        u32 count = shaders.apply_reload(shader_name, file.data, file.size, code_hash, reloads, 8);
+        for (u32 i = 0; i < count; i++) {
+            retarget_pipelines(reloads[i]);
+        }
+    }
+
+    /// @brief Packs the instance batch into the frame's transfer buffer and records its upload.
+    /// @return Number of instances uploaded.
+    u32 upload_instances(SDL_GPUCopyPass* copy_pass, Mat4x4 view_projection) {
+        PROFILE_SCOPE("upload instances");
+        if (instances.count() == 0) return 0;
+
+        u32 count = instances.count() < MAX_INSTANCES ? instances.count() : MAX_INSTANCES;
+        auto upload = frames.upload(count * (u32)sizeof(InstanceData));
+        if (!upload.has_value()) return 0;
+
+        instances.pack((InstanceData*)upload->data, count, view_projection, jobs);
 
-        SDL_GPUCommandBuffer* upload_cmdbuf = SDL_AcquireGPUCommandBuffer(device);
-        SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(upload_cmdbuf);
+        // The storage buffer is cycled because earlier frames may still be reading it.
         SDL_UploadToGPUBuffer(
             copy_pass,
             &(SDL_GPUTransferBufferLocation){
-                .transfer_buffer = transfer_buffer,
-                .offset = 0,
+                .transfer_buffer = upload->transfer_buffer,
+                .offset = upload->offset,
             },
             &(SDL_GPUBufferRegion){
-                .buffer = vertex_buffer,
+                .buffer = instance_buffer,
                 .offset = 0,
-                .size = sizeof(triangle_vertices),
+                .size = count * (u32)sizeof(InstanceData),
             },
-            false
+            true
         );
-        SDL_EndGPUCopyPass(copy_pass);
-        SDL_SubmitGPUCommandBuffer(upload_cmdbuf);
 
-        return Renderer{
-            .allocator = allocator,
-            .device = device,
-            .pipeline_fill = pipeline_fill,
-            .pipeline_line = pipeline_line,
-            .vertex_buffer = vertex_buffer,
-        };
+        return count;
     }
 
-    void deinit() {
-        SDL_ReleaseGPUBuffer(device, vertex_buffer);
-        SDL_ReleaseGPUGraphicsPipeline(device, pipeline_fill);
-        SDL_ReleaseGPUGraphicsPipeline(device, pipeline_line);
-    }
+    /// @param timing Receives the present wait, render record and submit phases, if given.
+    bool render(
+        SDL_Window* window,
+        i32 window_width,
+        i32 window_height,
+        FrameStats* timing = nullptr
+    ) {
+        defer { instances.clear(); };
+        stats = {};
+        auto end_phase = [timing](FramePhase phase) {
+            if (timing) timing->end_phase(phase);
+        };
 
-    bool render(SDL_Window* window, i32 window_width, i32 window_height) {
         f32 aspect_ratio = (f32)window_width / (f32)window_height;
         Mat4x4 projection =
             Mat4x4::orthographic(-aspect_ratio, aspect_ratio, -1.0f, 1.0f, -1.0f, 1.0f);
 
-        f32 time = SDL_GetTicks() / 1000.0f;
-        Mat4x4 rotation = Mat4x4::rotation_z(time);
-        Mat4x4 scale = Mat4x4::scale(0.8f, 0.8f, 1.0f);
-        Mat4x4 model = scale * rotation;
+        if (headless) {
+            PROFILE_SCOPE("pack instances");
+            u32 count = instances.pack(headless_instances, MAX_INSTANCES, projection, jobs);
+            if (count > 0) record_draw(count);
+            end_phase(FRAME_PHASE_RENDER_RECORD);
+            return true;
+        }
 
-        Mat4x4 mvp = projection * model;
-        TransformBuffer transform_buffer = {.mvp_matrix = mvp};
+        frames.begin_frame();
+        uploads.retire(frames.frames_completed);
 
         SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device);
         if (!cmdbuf) {
@@ -237,25 +536,27 @@ struct Renderer {
         }
 
         SDL_GPUTexture* swapchain_texture;
-        if (!SDL_WaitAndAcquireGPUSwapchainTexture(
-                cmdbuf,
-                window,
-                &swapchain_texture,
-                nullptr,
-                nullptr
-            )) {
+        if (!frames.acquire_swapchain(cmdbuf, window, &swapchain_texture)) {
             SDL_Log("Failed to acquire swapchain texture %s\n", SDL_GetError());
+            SDL_CancelGPUCommandBuffer(cmdbuf);
             return false;
         }
+        end_phase(FRAME_PHASE_PRESENT_WAIT);
 
         if (!swapchain_texture) {
-            SDL_Log("Swapchain texture is null\n");
-            SDL_SubmitGPUCommandBuffer(cmdbuf);
-            return false;
+            // No image available yet, the GPU is behind. Skip this frame rather than stalling.
+            frames.submit(cmdbuf);
+            end_phase(FRAME_PHASE_SUBMIT);
+            return true;
         }
 
-        SDL_PushGPUVertexUniformData(cmdbuf, 0, &transform_buffer, sizeof(TransformBuffer));
+        // All of the frame's transfers go through a single copy pass.
+        SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmdbuf);
+        uploads.flush(copy_pass, frames.frame_number);
+        u32 instance_count = upload_instances(copy_pass, projection);
+        SDL_EndGPUCopyPass(copy_pass);
 
+        PROFILE_SCOPE("record draws");
         SDL_GPURenderPass* render_pass = SDL_BeginGPURenderPass(
             cmdbuf,
             &(SDL_GPUColorTargetInfo){
@@ -267,24 +568,77 @@ struct Renderer {
             1,
             nullptr
         );
-        SDL_BindGPUGraphicsPipeline(render_pass, pipeline_fill);
-
-        SDL_BindGPUVertexBuffers(
-            render_pass,
-            0,
-            (SDL_GPUBufferBinding[]){
-                {
-                    .buffer = vertex_buffer,
-                    .offset = 0,
+
+        SDL_GPUGraphicsPipeline* pipeline = pipelines.get(pipeline_instanced);
+        if (instance_count > 0 && pipeline) {
+            SDL_BindGPUGraphicsPipeline(render_pass, pipeline);
+
+            SDL_BindGPUVertexBuffers(
+                render_pass,
+                0,
+                (SDL_GPUBufferBinding[]){
+                    {
+                        .buffer = vertex_heap.buffer,
+                        .offset = 0,
+                    },
                 },
-            },
-            1
-        );
+                1
+            );
+            SDL_BindGPUVertexStorageBuffers(render_pass, 0, &instance_buffer, 1);
+
+            u32 first_vertex = triangle.offset / sizeof(VertexData);
+            SDL_DrawGPUPrimitives(render_pass, 3, instance_count, first_vertex, 0);
+            record_draw(instance_count);
+        }
 
-        SDL_DrawGPUPrimitives(render_pass, 3, 1, 0, 0);
         SDL_EndGPURenderPass(render_pass);
-        SDL_SubmitGPUCommandBuffer(cmdbuf);
+        end_phase(FRAME_PHASE_RENDER_RECORD);
+
+        bool submitted = frames.submit(cmdbuf);
+        end_phase(FRAME_PHASE_SUBMIT);
+        return submitted;
+    }
+
+  private:
+    /// @brief Points the built-in pipelines that use `reload.name` at the new shader and builds
+    /// them right away, so the next frame does not hitch.
+    void retarget_pipelines(const ShaderReload& reload) {
+        struct PipelineShaders {
+            PipelineDesc* desc;
+            string vertex;
+            string fragment;
+        };
+        PipelineShaders built_in[] = {
+            {&pipeline_fill, SHADER_TRIANGLE_VERT, SHADER_SOLID_COLOR_FRAG},
+            {&pipeline_line, SHADER_TRIANGLE_VERT, SHADER_SOLID_COLOR_FRAG},
+            {&pipeline_instanced, SHADER_INSTANCED_VERT, SHADER_SOLID_COLOR_FRAG},
+        };
+
+        // Matched by name, another name may still be using the old shader.
+        for (PipelineShaders& pipeline : built_in) {
+            PipelineDesc* desc = pipeline.desc;
+            bool changed = false;
+            if (desc->vertex_shader == reload.old_shader &&
+                string_equals(pipeline.vertex, reload.name)) {
+                desc->vertex_shader = reload.new_shader;
+                changed = true;
+            }
+            if (desc->fragment_shader == reload.old_shader &&
+                string_equals(pipeline.fragment, reload.name)) {
+                desc->fragment_shader = reload.new_shader;
+                changed = true;
+            }
+            if (changed) pipelines.get(*desc);
+        }
+
+        if (reload.old_released) pipelines.remove_shader(reload.old_shader);
+    }
 
-        return true;
+    // Every draw is currently the instanced triangle.
+    void record_draw(u32 instance_count) {
+        stats.draw_calls++;
+        stats.instances += instance_count;
+        stats.vertices += 3 * instance_count;
+        stats.upload_bytes += instance_count * (u32)sizeof(InstanceData);
     }
 };
\ No newline at end of file
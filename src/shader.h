@@ -1,89 +1,91 @@
 #pragma once
 
 #include "lib/def.h"
-#include "lib/file.h"
 #include "lib/string.h"
 #include <SDL3/SDL.h>
+#include <optional>
 
-// Function to create and compile shader from file
-SDL_GPUShader* load_shader(
-    Allocator& allocator,
-    SDL_GPUDevice* device,
-    string shader_name,
-    u32 num_samplers,
-    u32 num_uniform_buffers,
-    u32 num_storage_buffers,
-    u32 num_storage_textures
-) {
-    SDL_GPUShaderStage stage;
-    if (string_contains(shader_name, ".vert")) {
-        stage = SDL_GPU_SHADERSTAGE_VERTEX;
-    } else if (string_contains(shader_name, ".frag")) {
-        stage = SDL_GPU_SHADERSTAGE_FRAGMENT;
-    } else {
-        SDL_Log("Unsupported shader file type: %s\n", shader_name);
-        return nullptr;
-    }
+constexpr string SHADER_COMPILED_DIR = "assets/shaders/compiled";
+
+struct ShaderFormat {
+    SDL_GPUShaderFormat format;
+    string extension;
+    string entrypoint;
+};
 
+struct ShaderResources {
+    u32 num_samplers;
+    u32 num_uniform_buffers;
+    u32 num_storage_buffers;
+    u32 num_storage_textures;
+};
+
+// Picks the compiled shader flavour the device's backend consumes
+std::optional<ShaderFormat> shader_format_for_device(SDL_GPUDevice* device) {
     SDL_GPUShaderFormat backend_formats = SDL_GetGPUShaderFormats(device);
-    SDL_GPUShaderFormat format = SDL_GPU_SHADERFORMAT_INVALID;
-    char extension[8] = "";
-    char entrypoint[16] = "main";
 
     if ((backend_formats & SDL_GPU_SHADERFORMAT_SPIRV) != 0) {
-        format = SDL_GPU_SHADERFORMAT_SPIRV;
-        strncpy(extension, ".spv", sizeof(extension));
+        return ShaderFormat{SDL_GPU_SHADERFORMAT_SPIRV, ".spv", "main"};
     } else if ((backend_formats & SDL_GPU_SHADERFORMAT_DXIL) != 0) {
-        format = SDL_GPU_SHADERFORMAT_DXIL;
-        strncpy(extension, ".dxil", sizeof(extension));
+        return ShaderFormat{SDL_GPU_SHADERFORMAT_DXIL, ".dxil", "main"};
     } else if ((backend_formats & SDL_GPU_SHADERFORMAT_MSL) != 0) {
-        format = SDL_GPU_SHADERFORMAT_MSL;
-        strncpy(extension, ".msl", sizeof(extension));
-        strncpy(entrypoint, "main0", sizeof(entrypoint));
-    } else {
-        SDL_Log("No supported shader formats available");
-        return nullptr;
+        return ShaderFormat{SDL_GPU_SHADERFORMAT_MSL, ".msl", "main0"};
     }
 
-    char shader_path[1024];
+    SDL_Log("No supported shader formats available");
+    return std::nullopt;
+}
+
+std::optional<SDL_GPUShaderStage> shader_stage_from_name(string shader_name) {
+    if (string_contains(shader_name, ".vert")) {
+        return SDL_GPU_SHADERSTAGE_VERTEX;
+    } else if (string_contains(shader_name, ".frag")) {
+        return SDL_GPU_SHADERSTAGE_FRAGMENT;
+    }
+
+    SDL_Log("Unsupported shader file type: %s\n", shader_name);
+    return std::nullopt;
+}
+
+// Builds "assets/shaders/compiled/<name><extension>" into `out`
+bool shader_path(mut_string out, usize out_size, string shader_name, ShaderFormat format) {
     i32 result = snprintf(
-        shader_path,
-        sizeof(shader_path),
-        "assets/shaders/compiled/%s%s",
+        out,
+        out_size,
+        "%s/%s%s",
+        SHADER_COMPILED_DIR,
         shader_name,
-        extension
+        format.extension
     );
 
-    if (result < 0 || result >= (i32)sizeof(shader_path)) {
+    if (result < 0 || result >= (i32)out_size) {
         SDL_Log("Shader path too long or formatting error\n");
-        return nullptr;
+        return false;
     }
 
-    SDL_Log(
-        "Loading shader %s from: %s\n",
-        stage == SDL_GPU_SHADERSTAGE_VERTEX ? "VERTEX" : "FRAGMENT",
-        shader_path
-    );
-
-    auto file = File::read_all(allocator, shader_path);
-    if (!file.has_value()) {
-        SDL_Log("Failed to read shader file: %s\n", shader_path);
-        return nullptr;
-    }
-    defer { file->deinit(); };
+    return true;
+}
 
+SDL_GPUShader* create_shader(
+    SDL_GPUDevice* device,
+    const u8* code,
+    usize code_size,
+    ShaderFormat format,
+    SDL_GPUShaderStage stage,
+    ShaderResources resources
+) {
     return SDL_CreateGPUShader(
         device,
         &(SDL_GPUShaderCreateInfo){
-            .code_size = file->size,
-            .code = (u8*)file->c_str(),
-            .entrypoint = entrypoint,
-            .format = format,
+            .code_size = code_size,
+            .code = code,
+            .entrypoint = format.entrypoint,
+            .format = format.format,
             .stage = stage,
-            .num_samplers = num_samplers,
-            .num_storage_textures = num_storage_textures,
-            .num_storage_buffers = num_storage_buffers,
-            .num_uniform_buffers = num_uniform_buffers,
+            .num_samplers = resources.num_samplers,
+            .num_storage_textures = resources.num_storage_textures,
+            .num_storage_buffers = resources.num_storage_buffers,
+            .num_uniform_buffers = resources.num_uniform_buffers,
         }
     );
 }
@@ -0,0 +1,488 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/archive.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include "lib/file.h"
+#include "lib/hash.h"
+#include "lib/interner.h"
+#include "lib/str.h"
+#include "profiler.h"
+#include "shader.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <cstring>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+constexpr usize SHADER_NAME_MAX = 64;
+constexpr u32 SHADER_WATCH_QUEUE_SIZE = 32;
+// Written by build.sh from the compiled shader directory. Loose files are used when missing.
+constexpr string SHADER_ARCHIVE_PATH = "assets/shaders.pak";
+
+/// @brief Watches the compiled shader directory on a background thread and queues the names
+/// of shaders whose binaries were rewritten. Only available on Linux (inotify).
+struct ShaderWatcher {
+    SDL_Thread* thread;
+    SDL_Mutex* mutex;
+    std::atomic<bool> running;
+    int inotify_fd;
+
+    char pending[SHADER_WATCH_QUEUE_SIZE][SHADER_NAME_MAX];
+    u32 pending_count;
+
+    // The watcher is shared with its thread, so it is initialized in place.
+    bool init(string directory) {
+        thread = nullptr;
+        mutex = nullptr;
+        running = false;
+        inotify_fd = -1;
+        pending_count = 0;
+
+#ifdef __linux__
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0) {
+            SDL_Log("Failed to initialize inotify, shader hot reload disabled\n");
+            return false;
+        }
+
+        if (inotify_add_watch(inotify_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            SDL_Log("Failed to watch %s, shader hot reload disabled\n", directory);
+            close(inotify_fd);
+            inotify_fd = -1;
+            return false;
+        }
+
+        mutex = SDL_CreateMutex();
+        running = true;
+        thread = SDL_CreateThread(watch_thread, "shader-watcher", this);
+        if (!thread) {
+            running = false;
+            deinit();
+            return false;
+        }
+
+        return true;
+#else
+        (void)directory;
+        return false;
+#endif
+    }
+
+    void deinit() {
+        running = false;
+        if (thread) {
+            SDL_WaitThread(thread, nullptr);
+            thread = nullptr;
+        }
+
+#ifdef __linux__
+        if (inotify_fd >= 0) {
+            close(inotify_fd);
+            inotify_fd = -1;
+        }
+#endif
+
+        if (mutex) {
+            SDL_DestroyMutex(mutex);
+            mutex = nullptr;
+        }
+    }
+
+    /// @brief Moves the queued shader file names into `out`.
+    /// @return Number of names written.
+    u32 drain(char (*out)[SHADER_NAME_MAX], u32 max_count) {
+        if (!mutex) return 0;
+
+        SDL_LockMutex(mutex);
+        u32 count = pending_count < max_count ? pending_count : max_count;
+        memcpy(out, pending, count * SHADER_NAME_MAX);
+        pending_count = 0;
+        SDL_UnlockMutex(mutex);
+
+        return count;
+    }
+
+  private:
+    void push(string file_name) {
+        SDL_LockMutex(mutex);
+
+        bool queued = false;
+        for (u32 i = 0; i < pending_count; i++) {
+            if (string_equals(pending[i], file_name)) queued = true;
+        }
+
+        if (!queued && pending_count < SHADER_WATCH_QUEUE_SIZE) {
+            SDL_strlcpy(pending[pending_count], file_name, SHADER_NAME_MAX);
+            pending_count++;
+        }
+
+        SDL_UnlockMutex(mutex);
+    }
+
+    static int watch_thread(void* data) {
+#ifdef __linux__
+        ShaderWatcher* watcher = (ShaderWatcher*)data;
+        alignas(inotify_event) char buffer[4096];
+
+        while (watcher->running) {
+            pollfd fd = {.fd = watcher->inotify_fd, .events = POLLIN, .revents = 0};
+            if (poll(&fd, 1, 100) <= 0) continue;
+
+            ssize_t length = read(watcher->inotify_fd, buffer, sizeof(buffer));
+            for (ssize_t offset = 0; offset < length;) {
+                auto event = (inotify_event*)(buffer + offset);
+                if (event->len > 0) watcher->push(event->name);
+                offset += sizeof(inotify_event) + event->len;
+            }
+        }
+#else
+        (void)data;
+#endif
+        return 0;
+    }
+};
+
+/// @brief Bytes of a compiled shader, mapped from its loose file or taken from the archive.
+struct ShaderBinary {
+    const u8* data;
+    usize size;
+    MappedFile file;
+    // Set when the archive entry was compressed.
+    u8* decompressed;
+    Allocator allocator;
+
+    void deinit() {
+        file.deinit();
+        allocator.free_array(decompressed, size);
+    }
+};
+
+/// @brief A shader name that hot reload pointed at a new shader.
+struct ShaderReload {
+    // Interned, valid for the cache's lifetime.
+    string name;
+    SDL_GPUShader* old_shader;
+    SDL_GPUShader* new_shader;
+    // False while other names with the same bytes still use `old_shader`.
+    bool old_released;
+};
+
+/// @brief Creates each shader once, keyed by name plus resource counts. Binaries with identical
+/// contents share one SDL_GPUShader. With hot reload enabled, `poll_changed` reports shaders
+/// whose compiled files changed on disk and `apply_reload` swaps in their new binaries.
+/// Shaders are read from SHADER_ARCHIVE_PATH when it exists, hot reload always uses the loose
+/// files. Its allocator must be thread-safe if `get` is called from several threads.
+struct ShaderCache {
+    struct Entry {
+        u64 key;
+        u64 content_hash;
+        StringId name;
+        SDL_GPUShaderStage stage;
+        ShaderResources resources;
+        SDL_GPUShader* shader;
+    };
+
+    SDL_GPUDevice* device;
+    ShaderFormat format;
+    ArrayList<Entry> entries;
+    ShaderWatcher* watcher;
+    // Entry names, so hot reload matches changed files by ID instead of strcmp.
+    StringInterner* names;
+    std::optional<Archive> archive;
+    SDL_Mutex* mutex;
+    Allocator allocator;
+
+    static std::optional<ShaderCache>
+    init(Allocator allocator, SDL_GPUDevice* device, bool hot_reload = false) {
+        auto format = shader_format_for_device(device);
+        if (!format.has_value()) return std::nullopt;
+
+        ShaderWatcher* watcher = nullptr;
+        if (hot_reload) {
+            watcher = allocator.create<ShaderWatcher>();
+            if (!watcher->init(SHADER_COMPILED_DIR)) {
+                allocator.destroy(watcher);
+                watcher = nullptr;
+            }
+        }
+
+        StringInterner* names = allocator.create<StringInterner>();
+        if (!names || !names->init(allocator)) {
+            SDL_Log("Failed to create the shader name table\n");
+            if (names) {
+                names->deinit();
+                allocator.destroy(names);
+            }
+            if (watcher) {
+                watcher->deinit();
+                allocator.destroy(watcher);
+            }
+            return std::nullopt;
+        }
+
+        return ShaderCache{
+            .device = device,
+            .format = format.value(),
+            .entries = ArrayList<Entry>::init(allocator),
+            .watcher = watcher,
+            .names = names,
+            .archive = Archive::open(SHADER_ARCHIVE_PATH),
+            .mutex = SDL_CreateMutex(),
+            .allocator = allocator,
+        };
+    }
+
+    void deinit() {
+        if (watcher) {
+            watcher->deinit();
+            allocator.destroy(watcher);
+            watcher = nullptr;
+        }
+
+        for (usize i = 0; i < entries.len; i++) {
+            if (!is_shared(entries.items[i].shader, i + 1)) {
+                SDL_ReleaseGPUShader(device, entries.items[i].shader);
+            }
+        }
+
+        entries.deinit();
+        names->deinit();
+        allocator.destroy(names);
+        if (archive.has_value()) archive->deinit();
+        SDL_DestroyMutex(mutex);
+    }
+
+    /// @brief Returns the shader for `shader_name`, loading it on the first request.
+    /// Safe to call from several threads; the file is read and compiled outside the lock.
+    SDL_GPUShader* get(string shader_name, ShaderResources resources) {
+        u64 key = shader_key(shader_name, resources);
+
+        SDL_LockMutex(mutex);
+        SDL_GPUShader* cached = find(key);
+        SDL_UnlockMutex(mutex);
+        if (cached) return cached;
+
+        PROFILE_SCOPE("load shader");
+        auto stage = shader_stage_from_name(shader_name);
+        if (!stage.has_value()) return nullptr;
+
+        auto file = read_shader(shader_name);
+        if (!file.has_value()) return nullptr;
+        defer { file->deinit(); };
+
+        Entry entry = {
+            .key = key,
+            .content_hash =
+                content_hash(hash_bytes(file->data, file->size), stage.value(), resources),
+            .name = names->intern(shader_name),
+            .stage = stage.value(),
+            .resources = resources,
+            .shader = nullptr,
+        };
+
+        SDL_LockMutex(mutex);
+        for (auto& existing : entries) {
+            if (existing.content_hash == entry.content_hash) {
+                entry.shader = existing.shader;
+                break;
+            }
+        }
+        SDL_UnlockMutex(mutex);
+
+        bool created = false;
+        if (!entry.shader) {
+            entry.shader = create_shader(
+                device,
+                file->data,
+                file->size,
+                format,
+                entry.stage,
+                resources
+            );
+            if (!entry.shader) {
+                SDL_Log("Failed to create shader %s %s\n", shader_name, SDL_GetError());
+                return nullptr;
+            }
+            created = true;
+        }
+
+        SDL_LockMutex(mutex);
+        defer { SDL_UnlockMutex(mutex); };
+
+        // Another thread may have loaded the same shader in the meantime.
+        SDL_GPUShader* raced = find(key);
+        if (raced) {
+            if (created) SDL_ReleaseGPUShader(device, entry.shader);
+            return raced;
+        }
+
+        entries.append(entry);
+        return entry.shader;
+    }
+
+    /// @brief Names of loaded shaders whose binaries changed on disk since the last call.
+    /// The new binaries are the loose files, see `shader_path`; read them and hand them to
+    /// `apply_reload`. Main thread only.
+    /// @param out Receives interned names, valid for the cache's lifetime.
+    /// @return Number of names written to `out`.
+    u32 poll_changed(string* out, u32 max_names) {
+        if (!watcher) return 0;
+
+        char changed[SHADER_WATCH_QUEUE_SIZE][SHADER_NAME_MAX];
+        u32 changed_count = watcher->drain(changed, SHADER_WATCH_QUEUE_SIZE);
+        u32 name_count = 0;
+
+        for (u32 c = 0; c < changed_count && name_count < max_names; c++) {
+            // Only binaries for the active backend matter, "name.vert.spv" -> "name.vert".
+            Str file_name = Str::from_cstr(changed[c]);
+            Str extension = Str::from_cstr(format.extension);
+            if (file_name.len <= extension.len || !file_name.ends_with(extension)) continue;
+            // Names that were never loaded are not interned and cannot match an entry.
+            auto changed_name = names->find(file_name.slice(0, file_name.len - extension.len));
+            if (!changed_name.has_value()) continue;
+
+            out[name_count++] = names->get(changed_name.value()).data;
+        }
+
+        return name_count;
+    }
+
+    /// @brief Points the entries of `shader_name` at a shader built from `code`, its new
+    /// binary. Call between frames. Only the entries of that name get the new shader; other
+    /// names that shared the old one by content keep it, and it is released once none do.
+    /// @param code_hash `hash_bytes` of `code`, so the caller can hash off the main thread.
+    /// @param out Receives the retargeted names so dependent pipelines can be rebuilt.
+    /// @return Number of reloads written to `out`.
+    u32 apply_reload(
+        string shader_name,
+        const u8* code,
+        usize code_size,
+        u64 code_hash,
+        ShaderReload* out,
+        u32 max_reloads
+    ) {
+        auto name = names->find(Str::from_cstr(shader_name));
+        if (!name.has_value()) return 0;
+
+        u32 reload_count = 0;
+        for (auto& entry : entries) {
+            if (entry.name != name.value() || reload_count >= max_reloads) continue;
+
+            u64 new_hash = content_hash(code_hash, entry.stage, entry.resources);
+            if (new_hash == entry.content_hash) continue;
+
+            SDL_GPUShader* new_shader =
+                create_shader(device, code, code_size, format, entry.stage, entry.resources);
+            if (!new_shader) {
+                SDL_Log("Hot reload of %s failed %s\n", shader_name, SDL_GetError());
+                continue;
+            }
+
+            SDL_Log("Hot reloaded shader %s\n", shader_name);
+            SDL_GPUShader* old_shader = entry.shader;
+            entry.shader = new_shader;
+            entry.content_hash = new_hash;
+
+            // Pipelines keep their own copy of the code, so the old shader can go as soon as
+            // no other entry refers to it.
+            bool old_released = !is_shared(old_shader, 0);
+            if (old_released) SDL_ReleaseGPUShader(device, old_shader);
+            out[reload_count++] = ShaderReload{
+                .name = names->get(entry.name).data,
+                .old_shader = old_shader,
+                .new_shader = new_shader,
+                .old_released = old_released,
+            };
+        }
+
+        return reload_count;
+    }
+
+  private:
+    SDL_GPUShader* find(u64 key) {
+        for (auto& entry : entries) {
+            if (entry.key == key) return entry.shader;
+        }
+        return nullptr;
+    }
+
+    static u64 shader_key(string shader_name, ShaderResources resources) {
+        u64 key = hash_bytes(shader_name, strlen(shader_name));
+        key = hash_combine(key, resources.num_samplers);
+        key = hash_combine(key, resources.num_uniform_buffers);
+        key = hash_combine(key, resources.num_storage_buffers);
+        key = hash_combine(key, resources.num_storage_textures);
+        return key;
+    }
+
+    static u64 content_hash(u64 code_hash, SDL_GPUShaderStage stage, ShaderResources resources) {
+        // The create info is part of the identity, same bytes with other counts differ.
+        u64 hash = hash_combine(code_hash, stage);
+        return hash_combine(hash, shader_key("", resources));
+    }
+
+    // Mapped rather than read, the bytes only live until the shader is created.
+    std::optional<ShaderBinary> read_shader(string shader_name) {
+        ShaderBinary binary = {
+            .data = nullptr,
+            .size = 0,
+            .file = {},
+            .decompressed = nullptr,
+            .allocator = allocator,
+        };
+
+        if (archive.has_value()) {
+            char entry_name[SHADER_NAME_MAX + 16];
+            SDL_snprintf(entry_name, sizeof(entry_name), "%s%s", shader_name, format.extension);
+
+            const ArchiveEntry* entry = archive->find(entry_name);
+            if (entry) {
+                auto bytes = archive->bytes(entry);
+                if (bytes.has_value()) {
+                    binary.data = bytes->data();
+                    binary.size = bytes->size();
+                    return binary;
+                }
+
+                binary.decompressed = allocator.alloc_array<u8>(entry->size);
+                binary.size = entry->size;
+                if (archive->read(entry, binary.decompressed, binary.size)) {
+                    binary.data = binary.decompressed;
+                    return binary;
+                }
+
+                SDL_Log("Corrupt archive entry %s, reading the loose file\n", entry_name);
+                binary.deinit();
+                binary.decompressed = nullptr;
+                binary.size = 0;
+            }
+        }
+
+        char path[1024];
+        if (!shader_path(path, sizeof(path), shader_name, format)) return std::nullopt;
+
+        auto file = MappedFile::open(path);
+        if (!file.has_value()) {
+            SDL_Log("Failed to read shader file: %s\n", path);
+            return std::nullopt;
+        }
+
+        binary.file = file.value();
+        binary.data = file->data;
+        binary.size = file->size;
+        return binary;
+    }
+
+    bool is_shared(SDL_GPUShader* shader, usize from) {
+        for (usize i = from; i < entries.len; i++) {
+            if (entries.items[i].shader == shader) return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/def.h"
+#include "math.h"
+#include "profiler.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+
+// Simulation rate, independent of the display rate.
+constexpr f64 SIM_TIMESTEP = 1.0 / 60.0;
+// Steps per `advance` at most. After a longer stall the simulation slows down instead of
+// spending ever longer catching up.
+constexpr u32 SIM_MAX_CATCH_UP_STEPS = 5;
+// The two published states, the two the renderer may be reading and one being written would
+// need five; four make the writer wait only if it publishes twice during one read.
+constexpr u32 SIM_STATE_BUFFERS = 4;
+constexpr u32 SIM_NO_BUFFER = ~0u;
+
+/// @brief 2D transform of one simulated object, plus what the renderer needs to draw it.
+struct SimObject {
+    f32 x;
+    f32 y;
+    f32 scale;
+    // Radians, not wrapped, so interpolation never takes the long way round.
+    f32 angle;
+    // Radians per second.
+    f32 spin;
+    Vec4 color;
+};
+
+struct SimState {
+    SimObject* objects;
+    u32 count;
+    u64 step;
+    f64 time;
+};
+
+/// @brief Advances `next` one fixed step past `previous`. `next` starts out as a copy of
+/// `previous` with `step` and `time` already advanced.
+typedef void (*SimStepFn)(const SimState& previous, SimState& next, f32 dt, void* user_data);
+
+/// @brief The two most recent states and how far rendering is between them.
+struct SimFrame {
+    const SimState* previous;
+    const SimState* current;
+    // 0 at `previous`, 1 at `current`.
+    f32 alpha;
+};
+
+/// @brief Fixed-timestep simulation, decoupled from the frame rate. Steps run at
+/// SIM_TIMESTEP from an accumulator and the renderer interpolates between the last two states,
+/// so motion is smooth at any display rate while the simulation cost stays fixed.
+///
+/// Runs either from the frame loop through `advance`, or on its own thread, in which case a
+/// slow step delays only the next state and never the frame. States live in a small ring; the
+/// simulation publishes each new one and the renderer reads the latest pair between
+/// `begin_read` and `end_read`.
+struct Simulation {
+    Allocator allocator;
+    SimStepFn step_fn;
+    void* user_data;
+
+    SimState states[SIM_STATE_BUFFERS];
+    u32 capacity;
+
+    // Protects the buffer indices below.
+    SDL_Mutex* mutex;
+    SDL_Condition* released;
+    u32 previous;
+    u32 current;
+    u32 reading_previous;
+    u32 reading_current;
+    // Performance counter when `current` was published, for interpolation on the thread path.
+    u64 published_at;
+
+    // Owned by whichever thread steps.
+    f64 accumulator;
+    u64 skipped_steps;
+
+    bool threaded;
+    SDL_Thread* thread;
+    std::atomic<bool> running;
+
+    /// @brief Initialized in place, the simulation thread keeps a pointer to it.
+    /// @param capacity Most objects a state can hold.
+    bool init(Allocator allocator, u32 capacity, SimStepFn step_fn, void* user_data = nullptr) {
+        this->allocator = allocator;
+        this->capacity = capacity;
+        this->step_fn = step_fn;
+        this->user_data = user_data;
+
+        for (auto& state : states) {
+            state = SimState{
+                .objects = allocator.alloc_array<SimObject>(capacity),
+                .count = 0,
+                .step = 0,
+                .time = 0.0,
+            };
+            if (!state.objects) return false;
+        }
+
+        mutex = SDL_CreateMutex();
+        released = SDL_CreateCondition();
+        previous = 0;
+        current = 0;
+        reading_previous = SIM_NO_BUFFER;
+        reading_current = SIM_NO_BUFFER;
+        published_at = SDL_GetPerformanceCounter();
+        accumulator = 0.0;
+        skipped_steps = 0;
+        threaded = false;
+        thread = nullptr;
+        running.store(false);
+
+        return mutex && released;
+    }
+
+    void deinit() {
+        stop();
+        for (auto& state : states) {
+            allocator.free_array(state.objects, capacity);
+            state.objects = nullptr;
+        }
+        SDL_DestroyCondition(released);
+        SDL_DestroyMutex(mutex);
+    }
+
+    /// @brief Stops the simulation and returns an empty initial state to fill in before
+    /// `start`.
+    SimState& seed(u32 count) {
+        stop();
+
+        SimState& state = states[0];
+        state.count = count < capacity ? count : capacity;
+        state.step = 0;
+        state.time = 0.0;
+        previous = 0;
+        current = 0;
+        accumulator = 0.0;
+        return state;
+    }
+
+    /// @brief Starts stepping from the seeded state.
+    /// @param on_thread Step on a dedicated thread instead of in `advance`.
+    void start(bool on_thread) {
+        published_at = SDL_GetPerformanceCounter();
+        threaded = on_thread;
+        if (!threaded) return;
+
+        running.store(true);
+        thread = SDL_CreateThread(simulation_thread, "simulation", this);
+        if (!thread) {
+            SDL_Log("Failed to start simulation thread %s\n", SDL_GetError());
+            running.store(false);
+            threaded = false;
+        }
+    }
+
+    void stop() {
+        if (!thread) return;
+
+        running.store(false);
+        SDL_WaitThread(thread, nullptr);
+        thread = nullptr;
+    }
+
+    /// @brief Runs the steps due after `frame_seconds` more of real time, at most
+    /// SIM_MAX_CATCH_UP_STEPS of them. Does nothing when the simulation has its own thread.
+    /// @return Number of steps run.
+    u32 advance(f64 frame_seconds) {
+        if (threaded) return 0;
+        return run_due_steps(frame_seconds);
+    }
+
+    /// @brief Pins the latest two states for interpolation until `end_read`. Main thread only.
+    SimFrame begin_read() {
+        SDL_LockMutex(mutex);
+        reading_previous = previous;
+        reading_current = current;
+        u64 since_publish = SDL_GetPerformanceCounter() - published_at;
+        SDL_UnlockMutex(mutex);
+
+        // On the thread the accumulator belongs to the other side, real time stands in for it.
+        f64 elapsed = threaded ? (f64)since_publish / (f64)SDL_GetPerformanceFrequency()
+                               : accumulator;
+        f64 alpha = elapsed / SIM_TIMESTEP;
+        alpha = alpha < 0.0 ? 0.0 : (alpha > 1.0 ? 1.0 : alpha);
+
+        return SimFrame{
+            .previous = &states[reading_previous],
+            .current = &states[reading_current],
+            .alpha = (f32)alpha,
+        };
+    }
+
+    void end_read() {
+        SDL_LockMutex(mutex);
+        reading_previous = SIM_NO_BUFFER;
+        reading_current = SIM_NO_BUFFER;
+        SDL_UnlockMutex(mutex);
+        SDL_SignalCondition(released);
+    }
+
+    /// @brief Object `index` of `frame`, between its two states.
+    static SimObject interpolate(const SimFrame& frame, u32 index) {
+        const SimObject& a = frame.previous->objects[index];
+        const SimObject& b = frame.current->objects[index];
+        f32 t = frame.alpha;
+
+        return SimObject{
+            .x = a.x + (b.x - a.x) * t,
+            .y = a.y + (b.y - a.y) * t,
+            .scale = a.scale + (b.scale - a.scale) * t,
+            .angle = a.angle + (b.angle - a.angle) * t,
+            .spin = b.spin,
+            .color = b.color,
+        };
+    }
+
+  private:
+    u32 run_due_steps(f64 elapsed) {
+        accumulator += elapsed;
+
+        u32 steps = 0;
+        while (accumulator >= SIM_TIMESTEP && steps < SIM_MAX_CATCH_UP_STEPS) {
+            step();
+            accumulator -= SIM_TIMESTEP;
+            steps++;
+        }
+
+        // Too far behind, let the simulation fall back rather than spiral.
+        if (accumulator >= SIM_TIMESTEP) {
+            u64 dropped = (u64)(accumulator / SIM_TIMESTEP);
+            skipped_steps += dropped;
+            accumulator -= (f64)dropped * SIM_TIMESTEP;
+        }
+        return steps;
+    }
+
+    void step() {
+        PROFILE_SCOPE("simulation step");
+
+        u32 target = acquire_write_buffer();
+        const SimState& from = states[current];
+        SimState& next = states[target];
+        next.count = from.count;
+        next.step = from.step + 1;
+        next.time = from.time + SIM_TIMESTEP;
+        memcpy(next.objects, from.objects, from.count * sizeof(SimObject));
+
+        step_fn(from, next, (f32)SIM_TIMESTEP, user_data);
+
+        SDL_LockMutex(mutex);
+        previous = current;
+        current = target;
+        published_at = SDL_GetPerformanceCounter();
+        SDL_UnlockMutex(mutex);
+    }
+
+    // A buffer that is neither published nor being read, waiting for the renderer if needed.
+    u32 acquire_write_buffer() {
+        SDL_LockMutex(mutex);
+        defer { SDL_UnlockMutex(mutex); };
+
+        while (true) {
+            for (u32 i = 0; i < SIM_STATE_BUFFERS; i++) {
+                if (i != previous && i != current && i != reading_previous &&
+                    i != reading_current) {
+                    return i;
+                }
+            }
+            SDL_WaitCondition(released, mutex);
+        }
+    }
+
+    static int simulation_thread(void* data) {
+        Simulation* sim = (Simulation*)data;
+        PROFILE_THREAD_NAME("simulation");
+
+        u64 frequency = SDL_GetPerformanceFrequency();
+        u64 last = SDL_GetPerformanceCounter();
+        while (sim->running.load(std::memory_order_relaxed)) {
+            u64 now = SDL_GetPerformanceCounter();
+            sim->run_due_steps((f64)(now - last) / (f64)frequency);
+            last = now;
+
+            // Sleep until the next step is due.
+            f64 remaining = SIM_TIMESTEP - sim->accumulator;
+            if (remaining > 0.0) SDL_DelayNS((u64)(remaining * 1e9));
+        }
+        return 0;
+    }
+};
@@ -0,0 +1,971 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include "math.h"
+#include "profiler.h"
+#include <SDL3/SDL.h>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <span>
+
+constexpr u32 SPATIAL_NONE = ~0u;
+// Tree traversal stack entries kept on the thread's stack. A traversal needs the tree height
+// plus one, and rotations keep the height within a small multiple of log2 of the leaf count,
+// around 40 for a million leaves; taller trees allocate their stack.
+constexpr u32 SPATIAL_STACK_SIZE = 256;
+// Cells a grid ray query walks at most, for rays without a useful `max_t`.
+constexpr u32 SPATIAL_GRID_MAX_RAY_CELLS = 1 << 16;
+// Cells a grid object is entered in at most. Larger objects go to a list every query tests.
+constexpr u32 SPATIAL_GRID_MAX_OBJECT_CELLS = 64;
+
+struct Aabb {
+    Vec3 min;
+    Vec3 max;
+
+    static Aabb init(Vec3 min, Vec3 max) { return Aabb{.min = min, .max = max}; }
+
+    static Aabb from_center(Vec3 center, Vec3 half_extents) {
+        return Aabb{.min = center - half_extents, .max = center + half_extents};
+    }
+
+    /// @brief A box that contains nothing and overlaps nothing.
+    static Aabb empty() {
+        return Aabb{
+            .min = Vec3::init(INFINITY, INFINITY, INFINITY),
+            .max = Vec3::init(-INFINITY, -INFINITY, -INFINITY),
+        };
+    }
+
+    static Aabb merge(const Aabb& a, const Aabb& b) {
+        return Aabb{.min = Vec3::min(a.min, b.min), .max = Vec3::max(a.max, b.max)};
+    }
+
+    Aabb expand(f32 margin) const {
+        Vec3 m = Vec3::init(margin, margin, margin);
+        return Aabb{.min = min - m, .max = max + m};
+    }
+
+    bool contains(const Aabb& other) const {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+               other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+    }
+
+    bool overlaps(const Aabb& other) const {
+        return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y &&
+               other.min.y <= max.y && min.z <= other.max.z && other.min.z <= max.z;
+    }
+
+    f32 surface_area() const {
+        Vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
+
+struct Ray {
+    Vec3 origin;
+    // Need not be normalized, `max_t` is in multiples of it.
+    Vec3 direction;
+    f32 max_t;
+};
+
+struct Sphere {
+    Vec3 center;
+    f32 radius;
+};
+
+/// @brief One result of a batch query: query `query` of the batch touched `object`.
+struct SpatialHit {
+    u32 query;
+    u32 object;
+};
+
+/// @brief Four boxes, one per lane. Also the query packet of batch box queries.
+struct Aabb4 {
+    F32x4 min_x, min_y, min_z;
+    F32x4 max_x, max_y, max_z;
+
+    typedef Aabb Query;
+
+    static Aabb4 splat(const Aabb& box) {
+        return Aabb4{
+            F32x4::splat(box.min.x),
+            F32x4::splat(box.min.y),
+            F32x4::splat(box.min.z),
+            F32x4::splat(box.max.x),
+            F32x4::splat(box.max.y),
+            F32x4::splat(box.max.z),
+        };
+    }
+
+    /// @brief Packs `count` boxes, at most four; the missing lanes get empty boxes.
+    static Aabb4 gather(const Aabb* boxes, u32 count) {
+        Aabb lanes[4];
+        for (u32 i = 0; i < 4; i++) {
+            lanes[i] = i < count ? boxes[i] : Aabb::empty();
+        }
+        return Aabb4{
+            F32x4::init(lanes[0].min.x, lanes[1].min.x, lanes[2].min.x, lanes[3].min.x),
+            F32x4::init(lanes[0].min.y, lanes[1].min.y, lanes[2].min.y, lanes[3].min.y),
+            F32x4::init(lanes[0].min.z, lanes[1].min.z, lanes[2].min.z, lanes[3].min.z),
+            F32x4::init(lanes[0].max.x, lanes[1].max.x, lanes[2].max.x, lanes[3].max.x),
+            F32x4::init(lanes[0].max.y, lanes[1].max.y, lanes[2].max.y, lanes[3].max.y),
+            F32x4::init(lanes[0].max.z, lanes[1].max.z, lanes[2].max.z, lanes[3].max.z),
+        };
+    }
+
+    /// @brief Lanes where the boxes overlap those of `box`.
+    u32 test(const Aabb4& box) const {
+        return min_x.le(box.max_x) & box.min_x.le(max_x) & min_y.le(box.max_y) &
+               box.min_y.le(max_y) & min_z.le(box.max_z) & box.min_z.le(max_z);
+    }
+};
+
+/// @brief Four rays, the query packet of batch ray queries.
+struct Ray4 {
+    F32x4 origin_x, origin_y, origin_z;
+    F32x4 inverse_x, inverse_y, inverse_z;
+    F32x4 max_t;
+
+    typedef Ray Query;
+
+    static Ray4 splat(const Ray& ray) { return gather(&ray, 1, true); }
+
+    /// @brief Packs `count` rays, at most four; the missing lanes never hit.
+    static Ray4 gather(const Ray* rays, u32 count, bool splat = false) {
+        f32 lanes[7][4];
+        for (u32 i = 0; i < 4; i++) {
+            u32 source = splat ? 0 : i;
+            bool used = splat || i < count;
+            const Ray& ray = rays[used ? source : 0];
+            lanes[0][i] = ray.origin.x;
+            lanes[1][i] = ray.origin.y;
+            lanes[2][i] = ray.origin.z;
+            // Zero components give infinities, which the slab test handles.
+            lanes[3][i] = 1.0f / ray.direction.x;
+            lanes[4][i] = 1.0f / ray.direction.y;
+            lanes[5][i] = 1.0f / ray.direction.z;
+            lanes[6][i] = used ? ray.max_t : -1.0f;
+        }
+        return Ray4{
+            F32x4::load(lanes[0]),
+            F32x4::load(lanes[1]),
+            F32x4::load(lanes[2]),
+            F32x4::load(lanes[3]),
+            F32x4::load(lanes[4]),
+            F32x4::load(lanes[5]),
+            F32x4::load(lanes[6]),
+        };
+    }
+
+    /// @brief Lanes whose ray crosses `box` within [0, max_t], by the slab test.
+    u32 test(const Aabb4& box) const {
+        F32x4 x1 = (box.min_x - origin_x) * inverse_x;
+        F32x4 x2 = (box.max_x - origin_x) * inverse_x;
+        F32x4 y1 = (box.min_y - origin_y) * inverse_y;
+        F32x4 y2 = (box.max_y - origin_y) * inverse_y;
+        F32x4 z1 = (box.min_z - origin_z) * inverse_z;
+        F32x4 z2 = (box.max_z - origin_z) * inverse_z;
+
+        F32x4 enter = F32x4::max(
+            F32x4::max(F32x4::min(x1, x2), F32x4::min(y1, y2)),
+            F32x4::max(F32x4::min(z1, z2), F32x4::splat(0.0f))
+        );
+        F32x4 exit = F32x4::min(
+            F32x4::min(F32x4::max(x1, x2), F32x4::max(y1, y2)),
+            F32x4::min(F32x4::max(z1, z2), max_t)
+        );
+        return enter.le(exit);
+    }
+};
+
+/// @brief Four spheres, the query packet of batch sphere queries.
+struct Sphere4 {
+    F32x4 center_x, center_y, center_z;
+    F32x4 radius_squared;
+
+    typedef Sphere Query;
+
+    static Sphere4 splat(const Sphere& sphere) { return gather(&sphere, 1, true); }
+
+    /// @brief Packs `count` spheres, at most four; the missing lanes never overlap.
+    static Sphere4 gather(const Sphere* spheres, u32 count, bool splat = false) {
+        f32 lanes[4][4];
+        for (u32 i = 0; i < 4; i++) {
+            bool used = splat || i < count;
+            const Sphere& sphere = spheres[used && !splat ? i : 0];
+            lanes[0][i] = sphere.center.x;
+            lanes[1][i] = sphere.center.y;
+            lanes[2][i] = sphere.center.z;
+            lanes[3][i] = used ? sphere.radius * sphere.radius : -1.0f;
+        }
+        return Sphere4{
+            F32x4::load(lanes[0]),
+            F32x4::load(lanes[1]),
+            F32x4::load(lanes[2]),
+            F32x4::load(lanes[3]),
+        };
+    }
+
+    /// @brief Lanes whose sphere overlaps `box`: the closest point of the box is within the
+    /// radius.
+    u32 test(const Aabb4& box) const {
+        F32x4 zero = F32x4::splat(0.0f);
+        F32x4 dx = F32x4::max(F32x4::max(box.min_x - center_x, center_x - box.max_x), zero);
+        F32x4 dy = F32x4::max(F32x4::max(box.min_y - center_y, center_y - box.max_y), zero);
+        F32x4 dz = F32x4::max(F32x4::max(box.min_z - center_z, center_z - box.max_z), zero);
+        return (dx * dx + dy * dy + dz * dz).le(radius_squared);
+    }
+};
+
+/// @brief Grid entries in bucket order: the object and a copy of its bounds as
+/// structure-of-arrays, so a bucket is tested four entries at a time.
+struct SpatialGridEntries {
+    u32* objects;
+    f32* min_x;
+    f32* min_y;
+    f32* min_z;
+    f32* max_x;
+    f32* max_y;
+    f32* max_z;
+    usize capacity;
+
+    bool reserve(Allocator allocator, usize count) {
+        if (count <= capacity) return true;
+
+        deinit(allocator);
+        // Grow geometrically, objects moving between cells change the entry count slightly.
+        usize new_capacity = count + count / 4;
+        objects = allocator.alloc_array<u32>(new_capacity);
+        min_x = allocator.alloc_array<f32>(new_capacity);
+        min_y = allocator.alloc_array<f32>(new_capacity);
+        min_z = allocator.alloc_array<f32>(new_capacity);
+        max_x = allocator.alloc_array<f32>(new_capacity);
+        max_y = allocator.alloc_array<f32>(new_capacity);
+        max_z = allocator.alloc_array<f32>(new_capacity);
+        capacity = new_capacity;
+        if (!objects || !min_x || !min_y || !min_z || !max_x || !max_y || !max_z) {
+            deinit(allocator);
+            return false;
+        }
+        return true;
+    }
+
+    void deinit(Allocator allocator) {
+        allocator.free_array(objects, capacity);
+        allocator.free_array(min_x, capacity);
+        allocator.free_array(min_y, capacity);
+        allocator.free_array(min_z, capacity);
+        allocator.free_array(max_x, capacity);
+        allocator.free_array(max_y, capacity);
+        allocator.free_array(max_z, capacity);
+        *this = {};
+    }
+
+    void set(usize index, u32 object, const Aabb& box) {
+        objects[index] = object;
+        min_x[index] = box.min.x;
+        min_y[index] = box.min.y;
+        min_z[index] = box.min.z;
+        max_x[index] = box.max.x;
+        max_y[index] = box.max.y;
+        max_z[index] = box.max.z;
+    }
+
+    Aabb4 load(usize index) const {
+        return Aabb4{
+            F32x4::load(min_x + index),
+            F32x4::load(min_y + index),
+            F32x4::load(min_z + index),
+            F32x4::load(max_x + index),
+            F32x4::load(max_y + index),
+            F32x4::load(max_z + index),
+        };
+    }
+};
+
+/// @brief Uniform grid over unbounded space, cells hashed into a fixed bucket table. Meant
+/// for many small objects that move every frame: `build` re-buckets all of them with a
+/// counting sort in O(n), with no per-object bookkeeping to keep up to date.
+///
+/// An object is entered in every cell its bounds overlap, so objects should be no larger
+/// than a cell or two. Those covering more than SPATIAL_GRID_MAX_OBJECT_CELLS cells go to one
+/// oversized list instead, which every query tests; a few large objects are fine, many are
+/// better off in an AabbTree. Queries visit the cells they overlap and test the entries there
+/// against the query, four at a time. Results are exact for the object bounds.
+struct SpatialGrid {
+    Allocator allocator;
+    f32 cell_size;
+    f32 inverse_cell_size;
+    u32 bucket_mask;
+    // First entry of each bucket and of the oversized list after them, plus one past the last
+    // entry.
+    u32* bucket_starts;
+
+    SpatialGridEntries entries;
+    u32 entry_count;
+    u32 object_count;
+
+    // Query stamp per object, so an object found through several cells is reported once.
+    ArrayList<u32> stamps;
+    u32 stamp;
+
+    /// @param buckets Rounded up to a power of two, about twice the object count works well.
+    /// @return The grid, or nullopt if the bucket table could not be allocated
+    static std::optional<SpatialGrid> init(Allocator allocator, f32 cell_size, u32 buckets) {
+        u32 bucket_count = 1;
+        while (bucket_count < buckets) {
+            bucket_count <<= 1;
+        }
+
+        u32* bucket_starts = allocator.alloc_array<u32>(bucket_count + 2);
+        if (!bucket_starts) {
+            SDL_Log("Failed to allocate %u grid buckets\n", bucket_count);
+            return std::nullopt;
+        }
+
+        return SpatialGrid{
+            .allocator = allocator,
+            .cell_size = cell_size,
+            .inverse_cell_size = 1.0f / cell_size,
+            .bucket_mask = bucket_count - 1,
+            .bucket_starts = bucket_starts,
+            .entries = {},
+            .entry_count = 0,
+            .object_count = 0,
+            .stamps = ArrayList<u32>::init(allocator),
+            .stamp = 0,
+        };
+    }
+
+    void deinit() {
+        allocator.free_array(bucket_starts, bucket_mask + 3);
+        entries.deinit(allocator);
+        stamps.deinit();
+    }
+
+    u32 bucket_count() const { return bucket_mask + 1; }
+
+    /// @brief Replaces the grid's contents with `bounds`, object `i` being `bounds[i]`.
+    bool build(std::span<const Aabb> bounds) {
+        PROFILE_SCOPE("grid build");
+
+        object_count = (u32)bounds.size();
+        memset(bucket_starts, 0, (bucket_count() + 2) * sizeof(u32));
+
+        usize count = 0;
+        for (const Aabb& box : bounds) {
+            for_each_entry_bucket(box, [&](u32 bucket) {
+                bucket_starts[bucket + 1]++;
+                count++;
+            });
+        }
+        for (u32 bucket = 0; bucket <= oversized_bucket(); bucket++) {
+            bucket_starts[bucket + 1] += bucket_starts[bucket];
+        }
+
+        // Padded with empty boxes, so four-wide loads at the end stay in bounds.
+        if (!entries.reserve(allocator, count + 3)) {
+            entry_count = 0;
+            object_count = 0;
+            return false;
+        }
+        entry_count = (u32)count;
+
+        // Fill each bucket from its start, then shift the starts back. Only the object goes
+        // to its scattered slot, the bounds are copied after in entry order.
+        for (u32 i = 0; i < object_count; i++) {
+            for_each_entry_bucket(bounds[i], [&](u32 bucket) {
+                entries.objects[bucket_starts[bucket]++] = i;
+            });
+        }
+        for (u32 bucket = oversized_bucket() + 1; bucket > 0; bucket--) {
+            bucket_starts[bucket] = bucket_starts[bucket - 1];
+        }
+        bucket_starts[0] = 0;
+        for (u32 e = 0; e < entry_count; e++) {
+            entries.set(e, entries.objects[e], bounds[entries.objects[e]]);
+        }
+        for (u32 i = 0; i < 3; i++) {
+            entries.set(count + i, SPATIAL_NONE, Aabb::empty());
+        }
+
+        if (!stamps.resize(object_count)) return false;
+        memset(stamps.items, 0, object_count * sizeof(u32));
+        stamp = 0;
+        return true;
+    }
+
+    void query_boxes(std::span<const Aabb> boxes, ArrayList<SpatialHit>& hits) {
+        PROFILE_SCOPE("grid box queries");
+        for (u32 i = 0; i < boxes.size(); i++) {
+            query_cells(cells(boxes[i]), Aabb4::splat(boxes[i]), i, hits);
+        }
+    }
+
+    void query_spheres(std::span<const Sphere> spheres, ArrayList<SpatialHit>& hits) {
+        PROFILE_SCOPE("grid sphere queries");
+        for (u32 i = 0; i < spheres.size(); i++) {
+            Vec3 radius = Vec3::init(spheres[i].radius, spheres[i].radius, spheres[i].radius);
+            Aabb bounds = Aabb::from_center(spheres[i].center, radius);
+            query_cells(cells(bounds), Sphere4::splat(spheres[i]), i, hits);
+        }
+    }
+
+    /// @brief Walks the cells each ray crosses, front to back, up to its `max_t`.
+    void query_rays(std::span<const Ray> rays, ArrayList<SpatialHit>& hits) {
+        PROFILE_SCOPE("grid ray queries");
+        for (u32 i = 0; i < rays.size(); i++) {
+            query_ray(rays[i], i, hits);
+        }
+    }
+
+  private:
+    struct CellRange {
+        i32 min_x, min_y, min_z;
+        i32 max_x, max_y, max_z;
+
+        u64 cell_count() const {
+            if (max_x < min_x || max_y < min_y || max_z < min_z) return 0;
+            return (u64)((i64)max_x - min_x + 1) * (u64)((i64)max_y - min_y + 1) *
+                   (u64)((i64)max_z - min_z + 1);
+        }
+    };
+
+    i32 cell(f32 coordinate) const {
+        // Clamped, so huge and infinite coordinates stay representable.
+        f32 index = floorf(coordinate * inverse_cell_size);
+        index = index < -1e9f ? -1e9f : (index > 1e9f ? 1e9f : index);
+        return (i32)index;
+    }
+
+    CellRange cells(const Aabb& box) const {
+        return CellRange{
+            cell(box.min.x),
+            cell(box.min.y),
+            cell(box.min.z),
+            cell(box.max.x),
+            cell(box.max.y),
+            cell(box.max.z),
+        };
+    }
+
+    u32 bucket(i32 x, i32 y, i32 z) const {
+        return (((u32)x * 73856093u) ^ ((u32)y * 19349663u) ^ ((u32)z * 83492791u)) &
+               bucket_mask;
+    }
+
+    // Past the hashed buckets, holds the objects that cover too many cells.
+    u32 oversized_bucket() const { return bucket_count(); }
+
+    /// @brief Calls `fn` with every bucket an object with bounds `box` is entered in.
+    template <typename Fn> void for_each_entry_bucket(const Aabb& box, Fn&& fn) const {
+        CellRange range = cells(box);
+        if (range.cell_count() > SPATIAL_GRID_MAX_OBJECT_CELLS) {
+            fn(oversized_bucket());
+            return;
+        }
+        for_each_bucket(range, fn);
+    }
+
+    template <typename Fn> void for_each_bucket(const CellRange& range, Fn&& fn) const {
+        for (i32 z = range.min_z; z <= range.max_z; z++) {
+            for (i32 y = range.min_y; y <= range.max_y; y++) {
+                for (i32 x = range.min_x; x <= range.max_x; x++) {
+                    fn(bucket(x, y, z));
+                }
+            }
+        }
+    }
+
+    u32 next_stamp() {
+        if (++stamp == 0) {
+            memset(stamps.items, 0, stamps.len * sizeof(u32));
+            stamp = 1;
+        }
+        return stamp;
+    }
+
+    /// @brief Tests the entries [begin, end) four at a time and reports the new objects.
+    template <typename Packet>
+    void test_entries(
+        u32 begin,
+        u32 end,
+        const Packet& query,
+        u32 query_index,
+        ArrayList<SpatialHit>& hits
+    ) {
+        for (u32 e = begin; e < end; e += 4) {
+            u32 mask = query.test(entries.load(e));
+            if (end - e < 4) mask &= (1u << (end - e)) - 1;
+            while (mask) {
+                u32 object = entries.objects[e + __builtin_ctz(mask)];
+                mask &= mask - 1;
+                if (stamps.items[object] == stamp) continue;
+                stamps.items[object] = stamp;
+                hits.append(SpatialHit{.query = query_index, .object = object});
+            }
+        }
+    }
+
+    template <typename Packet>
+    void query_cells(
+        const CellRange& range,
+        const Packet& query,
+        u32 query_index,
+        ArrayList<SpatialHit>& hits
+    ) {
+        next_stamp();
+        // A query wider than the table is cheaper as one pass over every entry.
+        if (range.cell_count() > bucket_count()) {
+            test_entries(0, entry_count, query, query_index, hits);
+            return;
+        }
+        test_oversized(query, query_index, hits);
+        for_each_bucket(range, [&](u32 b) {
+            test_entries(bucket_starts[b], bucket_starts[b + 1], query, query_index, hits);
+        });
+    }
+
+    template <typename Packet>
+    void test_oversized(const Packet& query, u32 query_index, ArrayList<SpatialHit>& hits) {
+        u32 b = oversized_bucket();
+        test_entries(bucket_starts[b], bucket_starts[b + 1], query, query_index, hits);
+    }
+
+    // Amanatides and Woo: step to whichever cell boundary the ray reaches first.
+    void query_ray(const Ray& ray, u32 query_index, ArrayList<SpatialHit>& hits) {
+        next_stamp();
+        Ray4 query = Ray4::splat(ray);
+        test_oversized(query, query_index, hits);
+
+        i32 position[3];
+        i32 step[3];
+        f32 next_t[3];
+        f32 delta_t[3];
+        for (u32 axis = 0; axis < 3; axis++) {
+            f32 origin = ray.origin[axis];
+            f32 direction = ray.direction[axis];
+            position[axis] = cell(origin);
+            if (direction > 0.0f) {
+                step[axis] = 1;
+                next_t[axis] = ((f32)(position[axis] + 1) * cell_size - origin) / direction;
+                delta_t[axis] = cell_size / direction;
+            } else if (direction < 0.0f) {
+                step[axis] = -1;
+                next_t[axis] = ((f32)position[axis] * cell_size - origin) / direction;
+                delta_t[axis] = -cell_size / direction;
+            } else {
+                step[axis] = 0;
+                next_t[axis] = INFINITY;
+                delta_t[axis] = INFINITY;
+            }
+        }
+
+        for (u32 visited = 0; visited < SPATIAL_GRID_MAX_RAY_CELLS; visited++) {
+            u32 b = bucket(position[0], position[1], position[2]);
+            test_entries(bucket_starts[b], bucket_starts[b + 1], query, query_index, hits);
+
+            u32 axis = next_t[0] < next_t[1] ? 0 : 1;
+            if (next_t[2] < next_t[axis]) axis = 2;
+            if (next_t[axis] > ray.max_t) break;
+            position[axis] += step[axis];
+            next_t[axis] += delta_t[axis];
+        }
+    }
+};
+
+struct AabbTreeNode {
+    // Fattened by the tree's margin for leaves.
+    Aabb box;
+    // Next free node while on the free list.
+    u32 parent;
+    u32 child1;
+    u32 child2;
+    u32 user_id;
+    // 0 for leaves, -1 for free nodes.
+    i32 height;
+
+    bool is_leaf() const { return child1 == SPATIAL_NONE; }
+};
+
+/// @brief Dynamic bounding volume hierarchy over boxes of any size. Leaves hold boxes grown by
+/// a margin, so objects that move a little stay inside and cost nothing; a leaf that leaves
+/// its box is refit in place while it stays within its parent, and reinserted otherwise.
+/// Inserts pick the sibling that grows the surface area least, and a rotation at every level
+/// on the way back up keeps the tree close to balanced.
+///
+/// Batch queries traverse with packets of four queries, testing every node against all four
+/// at once. Queries in a batch that lie close together share most of their traversal. Hits
+/// are reported against the fattened leaf boxes, a superset of the exact overlaps.
+struct AabbTree {
+    Allocator allocator;
+    ArrayList<AabbTreeNode> nodes;
+    u32 root;
+    u32 free_list;
+    u32 leaf_count;
+    f32 margin;
+
+    /// @param margin Added to every side of a leaf box.
+    /// @param capacity Leaves to reserve room for.
+    static AabbTree init(Allocator allocator, f32 margin, u32 capacity = 0) {
+        AabbTree tree = {
+            .allocator = allocator,
+            .nodes = ArrayList<AabbTreeNode>::init(allocator),
+            .root = SPATIAL_NONE,
+            .free_list = SPATIAL_NONE,
+            .leaf_count = 0,
+            .margin = margin,
+        };
+        if (capacity > 0) tree.nodes.reserve(2 * (usize)capacity);
+        return tree;
+    }
+
+    void deinit() { nodes.deinit(); }
+
+    /// @brief Adds `box`, reported as `user_id` by queries.
+    /// @return The proxy to update and remove it with, or SPATIAL_NONE when out of memory
+    u32 insert(const Aabb& box, u32 user_id) {
+        u32 proxy = alloc_node();
+        if (proxy == SPATIAL_NONE) return SPATIAL_NONE;
+
+        AabbTreeNode& node = nodes.items[proxy];
+        node.box = box.expand(margin);
+        node.user_id = user_id;
+        node.height = 0;
+        if (!insert_leaf(proxy)) {
+            free_node(proxy);
+            return SPATIAL_NONE;
+        }
+        leaf_count++;
+        return proxy;
+    }
+
+    void remove(u32 proxy) {
+        remove_leaf(proxy);
+        free_node(proxy);
+        leaf_count--;
+    }
+
+    /// @brief Moves the leaf `proxy` to `box`.
+    /// @return True if the tree changed
+    bool update(u32 proxy, const Aabb& box) {
+        AabbTreeNode& leaf = nodes.items[proxy];
+        if (leaf.box.contains(box)) return false;
+
+        Aabb fat = box.expand(margin);
+        u32 parent = leaf.parent;
+        if (parent != SPATIAL_NONE && nodes.items[parent].box.contains(fat)) {
+            // Ancestor boxes can only shrink, so a refit keeps the tree as good as it was.
+            leaf.box = fat;
+            refit(parent);
+            return true;
+        }
+
+        remove_leaf(proxy);
+        nodes.items[proxy].box = fat;
+        // Cannot fail: the parent node the removal freed is reused.
+        insert_leaf(proxy);
+        return true;
+    }
+
+    const Aabb& fat_box(u32 proxy) const { return nodes.items[proxy].box; }
+    u32 user_id(u32 proxy) const { return nodes.items[proxy].user_id; }
+    i32 height() const { return root == SPATIAL_NONE ? 0 : nodes.items[root].height; }
+
+    /// @return False if the tree is taller than SPATIAL_STACK_SIZE allows and a traversal
+    /// stack could not be allocated, the hits are incomplete then
+    bool query_boxes(std::span<const Aabb> boxes, ArrayList<SpatialHit>& hits) const {
+        PROFILE_SCOPE("tree box queries");
+        return query_packets<Aabb4>(boxes, hits);
+    }
+
+    bool query_rays(std::span<const Ray> rays, ArrayList<SpatialHit>& hits) const {
+        PROFILE_SCOPE("tree ray queries");
+        return query_packets<Ray4>(rays, hits);
+    }
+
+    bool query_spheres(std::span<const Sphere> spheres, ArrayList<SpatialHit>& hits) const {
+        PROFILE_SCOPE("tree sphere queries");
+        return query_packets<Sphere4>(spheres, hits);
+    }
+
+  private:
+    template <typename Packet>
+    bool query_packets(
+        std::span<const typename Packet::Query> queries,
+        ArrayList<SpatialHit>& hits
+    ) const {
+        if (root == SPATIAL_NONE) return true;
+
+        // Popping a node and pushing its two children leaves one pending sibling per level
+        // above, so the stack never holds more than the height plus one.
+        u32 needed = (u32)height() + 1;
+        u32 stack_size = needed > SPATIAL_STACK_SIZE ? needed : SPATIAL_STACK_SIZE;
+        u32 fixed_nodes[SPATIAL_STACK_SIZE];
+        u32 fixed_masks[SPATIAL_STACK_SIZE];
+        u32* stack_nodes = fixed_nodes;
+        u32* stack_masks = fixed_masks;
+        Allocator stack_allocator = allocator;
+        if (stack_size > SPATIAL_STACK_SIZE) {
+            stack_nodes = stack_allocator.alloc_array<u32>(stack_size);
+            stack_masks = stack_allocator.alloc_array<u32>(stack_size);
+        }
+        defer {
+            if (stack_nodes != fixed_nodes) {
+                stack_allocator.free_array(stack_nodes, stack_size);
+                stack_allocator.free_array(stack_masks, stack_size);
+            }
+        };
+        if (!stack_nodes || !stack_masks) {
+            SDL_Log("Failed to allocate a query stack for tree height %d\n", height());
+            return false;
+        }
+
+        for (u32 first = 0; first < queries.size(); first += 4) {
+            u32 count = queries.size() - first < 4 ? (u32)(queries.size() - first) : 4;
+            Packet packet = Packet::gather(queries.data() + first, count);
+
+            // Each entry carries the lanes still active when it was pushed.
+            u32 top = 0;
+            stack_nodes[top] = root;
+            stack_masks[top++] = (1u << count) - 1;
+
+            while (top > 0) {
+                top--;
+                const AabbTreeNode& node = nodes.items[stack_nodes[top]];
+                u32 mask = stack_masks[top] & packet.test(Aabb4::splat(node.box));
+                if (!mask) continue;
+
+                if (node.is_leaf()) {
+                    while (mask) {
+                        u32 lane = __builtin_ctz(mask);
+                        mask &= mask - 1;
+                        hits.append(SpatialHit{.query = first + lane, .object = node.user_id});
+                    }
+                    continue;
+                }
+
+                // Only a height out of step with the tree could get here.
+                if (top + 2 > stack_size) {
+                    SDL_Log("AabbTree query stack overflow, tree height %d\n", height());
+                    return false;
+                }
+                stack_nodes[top] = node.child1;
+                stack_masks[top++] = mask;
+                stack_nodes[top] = node.child2;
+                stack_masks[top++] = mask;
+            }
+        }
+        return true;
+    }
+
+    u32 alloc_node() {
+        u32 index;
+        if (free_list != SPATIAL_NONE) {
+            index = free_list;
+            free_list = nodes.items[index].parent;
+        } else {
+            index = (u32)nodes.len;
+            if (!nodes.append(AabbTreeNode{})) return SPATIAL_NONE;
+        }
+
+        nodes.items[index] = AabbTreeNode{
+            .box = Aabb::empty(),
+            .parent = SPATIAL_NONE,
+            .child1 = SPATIAL_NONE,
+            .child2 = SPATIAL_NONE,
+            .user_id = SPATIAL_NONE,
+            .height = 0,
+        };
+        return index;
+    }
+
+    void free_node(u32 index) {
+        nodes.items[index].parent = free_list;
+        nodes.items[index].height = -1;
+        free_list = index;
+    }
+
+    /// @brief Recomputes the boxes from `index` up to the root.
+    void refit(u32 index) {
+        while (index != SPATIAL_NONE) {
+            AabbTreeNode& node = nodes.items[index];
+            node.box = Aabb::merge(nodes.items[node.child1].box, nodes.items[node.child2].box);
+            index = node.parent;
+        }
+    }
+
+    /// @brief Recomputes boxes and heights from `index` up to the root, rebalancing on the
+    /// way.
+    void fix_upwards(u32 index) {
+        while (index != SPATIAL_NONE) {
+            index = balance(index);
+
+            AabbTreeNode& node = nodes.items[index];
+            const AabbTreeNode& child1 = nodes.items[node.child1];
+            const AabbTreeNode& child2 = nodes.items[node.child2];
+            node.height = 1 + (child1.height > child2.height ? child1.height : child2.height);
+            node.box = Aabb::merge(child1.box, child2.box);
+            index = node.parent;
+        }
+    }
+
+    /// @return False if there was no memory for the leaf's new parent; the tree is unchanged
+    bool insert_leaf(u32 leaf) {
+        if (root == SPATIAL_NONE) {
+            root = leaf;
+            nodes.items[leaf].parent = SPATIAL_NONE;
+            return true;
+        }
+
+        // Descend towards the cheapest sibling: pairing with a node costs the area of the new
+        // parent, and every ancestor grows by the same amount either way.
+        Aabb box = nodes.items[leaf].box;
+        u32 index = root;
+        while (!nodes.items[index].is_leaf()) {
+            const AabbTreeNode& node = nodes.items[index];
+            f32 area = node.box.surface_area();
+            f32 combined_area = Aabb::merge(node.box, box).surface_area();
+
+            f32 cost = 2.0f * combined_area;
+            f32 inheritance = 2.0f * (combined_area - area);
+            f32 cost1 = child_cost(node.child1, box) + inheritance;
+            f32 cost2 = child_cost(node.child2, box) + inheritance;
+
+            if (cost < cost1 && cost < cost2) break;
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+
+        u32 sibling = index;
+        u32 old_parent = nodes.items[sibling].parent;
+        u32 new_parent = alloc_node();
+        if (new_parent == SPATIAL_NONE) return false;
+
+        AabbTreeNode& parent = nodes.items[new_parent];
+        parent.parent = old_parent;
+        parent.box = Aabb::merge(box, nodes.items[sibling].box);
+        parent.height = nodes.items[sibling].height + 1;
+        parent.child1 = sibling;
+        parent.child2 = leaf;
+        nodes.items[sibling].parent = new_parent;
+        nodes.items[leaf].parent = new_parent;
+
+        if (old_parent == SPATIAL_NONE) {
+            root = new_parent;
+        } else if (nodes.items[old_parent].child1 == sibling) {
+            nodes.items[old_parent].child1 = new_parent;
+        } else {
+            nodes.items[old_parent].child2 = new_parent;
+        }
+
+        fix_upwards(nodes.items[leaf].parent);
+        return true;
+    }
+
+    f32 child_cost(u32 child, const Aabb& box) const {
+        const AabbTreeNode& node = nodes.items[child];
+        f32 merged = Aabb::merge(box, node.box).surface_area();
+        return node.is_leaf() ? merged : merged - node.box.surface_area();
+    }
+
+    void remove_leaf(u32 leaf) {
+        if (leaf == root) {
+            root = SPATIAL_NONE;
+            return;
+        }
+
+        u32 parent = nodes.items[leaf].parent;
+        u32 grandparent = nodes.items[parent].parent;
+        u32 sibling = nodes.items[parent].child1 == leaf ? nodes.items[parent].child2
+                                                         : nodes.items[parent].child1;
+
+        if (grandparent == SPATIAL_NONE) {
+            root = sibling;
+            nodes.items[sibling].parent = SPATIAL_NONE;
+            free_node(parent);
+            return;
+        }
+
+        if (nodes.items[grandparent].child1 == parent) {
+            nodes.items[grandparent].child1 = sibling;
+        } else {
+            nodes.items[grandparent].child2 = sibling;
+        }
+        nodes.items[sibling].parent = grandparent;
+        free_node(parent);
+        fix_upwards(grandparent);
+    }
+
+    /// @brief Rotates the taller grandchild of `index_a` up if its children's heights differ by
+    /// more than one.
+    /// @return The node now in `index_a`'s place
+    u32 balance(u32 index_a) {
+        AabbTreeNode* a = &nodes.items[index_a];
+        if (a->is_leaf() || a->height < 2) return index_a;
+
+        u32 index_b = a->child1;
+        u32 index_c = a->child2;
+        AabbTreeNode* b = &nodes.items[index_b];
+        AabbTreeNode* c = &nodes.items[index_c];
+        i32 difference = c->height - b->height;
+
+        if (difference > 1) {
+            rotate_up(index_a, index_c, true);
+            return index_c;
+        }
+        if (difference < -1) {
+            rotate_up(index_a, index_b, false);
+            return index_b;
+        }
+        return index_a;
+    }
+
+    /// @brief Makes `index_up`, a child of `index_a`, the parent of `index_a`. Its taller child
+    /// stays with it, the shorter one moves to `index_a`.
+    /// @param right Whether `index_up` is `child2` of `index_a`.
+    void rotate_up(u32 index_a, u32 index_up, bool right) {
+        AabbTreeNode* a = &nodes.items[index_a];
+        AabbTreeNode* up = &nodes.items[index_up];
+        u32 index_f = up->child1;
+        u32 index_g = up->child2;
+        AabbTreeNode* f = &nodes.items[index_f];
+        AabbTreeNode* g = &nodes.items[index_g];
+
+        up->child1 = index_a;
+        up->parent = a->parent;
+        a->parent = index_up;
+
+        if (up->parent == SPATIAL_NONE) {
+            root = index_up;
+        } else if (nodes.items[up->parent].child1 == index_a) {
+            nodes.items[up->parent].child1 = index_up;
+        } else {
+            nodes.items[up->parent].child2 = index_up;
+        }
+
+        // The child of `a` that stays.
+        u32 index_other = right ? a->child1 : a->child2;
+        AabbTreeNode* other = &nodes.items[index_other];
+
+        u32 index_keep = f->height > g->height ? index_f : index_g;
+        u32 index_move = f->height > g->height ? index_g : index_f;
+        AabbTreeNode* keep = &nodes.items[index_keep];
+        AabbTreeNode* move = &nodes.items[index_move];
+
+        up->child2 = index_keep;
+        if (right) {
+            a->child2 = index_move;
+        } else {
+            a->child1 = index_move;
+        }
+        move->parent = index_a;
+
+        a->box = Aabb::merge(other->box, move->box);
+        up->box = Aabb::merge(a->box, keep->box);
+        a->height = 1 + (other->height > move->height ? other->height : move->height);
+        up->height = 1 + (a->height > keep->height ? a->height : keep->height);
+    }
+};
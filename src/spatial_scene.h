@@ -0,0 +1,243 @@
+#pragma once
+
+#include "instancing.h"
+#include "jobs.h"
+#include "lib/allocator.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include "math.h"
+#include "profiler.h"
+#include "spatial.h"
+#include <SDL3/SDL.h>
+#include <cmath>
+#include <span>
+
+// Queries of each kind per frame, against each structure.
+constexpr u32 SPATIAL_SCENE_QUERIES = 1024;
+
+/// @brief Small objects drifting about the unit square, indexed by both a SpatialGrid and an
+/// AabbTree, and queried with batches of boxes, rays and spheres every frame. Times each
+/// structure separately and logs the averages when done.
+struct SpatialScene {
+    Allocator allocator;
+    u32 object_count;
+    f32 radius;
+    Vec3* positions;
+    Vec3* velocities;
+    Aabb* bounds;
+    u32* proxies;
+    // Frame an object was last hit on, for drawing.
+    u32* hit_frames;
+
+    SpatialGrid grid;
+    AabbTree tree;
+
+    Aabb* query_boxes;
+    Ray* query_rays;
+    Sphere* query_spheres;
+    ArrayList<SpatialHit> hits;
+    u32 random;
+
+    // Updates run so far.
+    u32 frame;
+    // Performance counter ticks spent per stage, over all updates.
+    u64 grid_build_ticks;
+    u64 grid_query_ticks;
+    u64 tree_update_ticks;
+    u64 tree_query_ticks;
+    u64 grid_hits;
+    u64 tree_hits;
+
+    /// @brief Initialized in place, like the other scene state the Game owns by pointer.
+    bool init(Allocator allocator, u32 object_count) {
+        this->allocator = allocator;
+        this->object_count = object_count;
+        // Objects cover about a tenth of the 2x2 square, whatever their number.
+        radius = 0.15f / sqrtf((f32)object_count);
+
+        positions = allocator.alloc_array<Vec3>(object_count);
+        velocities = allocator.alloc_array<Vec3>(object_count);
+        bounds = allocator.alloc_array<Aabb>(object_count);
+        proxies = allocator.alloc_array<u32>(object_count);
+        hit_frames = allocator.alloc_array<u32>(object_count);
+        query_boxes = allocator.alloc_array<Aabb>(SPATIAL_SCENE_QUERIES);
+        query_rays = allocator.alloc_array<Ray>(SPATIAL_SCENE_QUERIES);
+        query_spheres = allocator.alloc_array<Sphere>(SPATIAL_SCENE_QUERIES);
+
+        // Cells a few objects wide, buckets for twice as many entries as objects.
+        auto new_grid = SpatialGrid::init(allocator, 4.0f * radius, 2 * object_count);
+        // An empty grid is safe to deinit.
+        grid = new_grid.value_or(SpatialGrid{});
+        tree = AabbTree::init(allocator, 0.5f * radius, object_count);
+        hits = ArrayList<SpatialHit>::init(allocator);
+        random = 0x9E3779B9u;
+        frame = 0;
+        grid_build_ticks = 0;
+        grid_query_ticks = 0;
+        tree_update_ticks = 0;
+        tree_query_ticks = 0;
+        grid_hits = 0;
+        tree_hits = 0;
+
+        if (!positions || !velocities || !bounds || !proxies || !hit_frames || !query_boxes ||
+            !query_rays || !query_spheres || !new_grid.has_value()) {
+            return false;
+        }
+
+        f32 speed = 2.0f * radius;
+        for (u32 i = 0; i < object_count; i++) {
+            positions[i] = Vec3::init(next_signed(), next_signed(), 0.0f);
+            velocities[i] = Vec3::init(next_signed() * speed, next_signed() * speed, 0.0f);
+            bounds[i] = object_bounds(i);
+            hit_frames[i] = ~0u;
+            proxies[i] = tree.insert(bounds[i], i);
+            if (proxies[i] == SPATIAL_NONE) return false;
+        }
+        return true;
+    }
+
+    void deinit() {
+        if (frame > 0) log_summary();
+
+        hits.deinit();
+        tree.deinit();
+        grid.deinit();
+        allocator.free_array(query_spheres, SPATIAL_SCENE_QUERIES);
+        allocator.free_array(query_rays, SPATIAL_SCENE_QUERIES);
+        allocator.free_array(query_boxes, SPATIAL_SCENE_QUERIES);
+        allocator.free_array(hit_frames, object_count);
+        allocator.free_array(proxies, object_count);
+        allocator.free_array(bounds, object_count);
+        allocator.free_array(velocities, object_count);
+        allocator.free_array(positions, object_count);
+    }
+
+    /// @brief Moves the objects, brings both structures up to date and runs the frame's
+    /// queries against each.
+    void update(f32 dt, JobSystem& jobs) {
+        PROFILE_SCOPE("spatial scene");
+
+        jobs.parallel_for(object_count, 4096, [&](u32 begin, u32 end, JobWorker&) {
+            for (u32 i = begin; i < end; i++) {
+                Vec3& position = positions[i];
+                Vec3& velocity = velocities[i];
+                position = position + velocity * dt;
+                // Bounce off the edges of the square.
+                if (fabsf(position.x) > 1.0f) velocity.x = -velocity.x;
+                if (fabsf(position.y) > 1.0f) velocity.y = -velocity.y;
+                bounds[i] = object_bounds(i);
+            }
+        });
+
+        generate_queries();
+
+        u64 start = SDL_GetPerformanceCounter();
+        grid.build(std::span<const Aabb>(bounds, object_count));
+        u64 grid_built = SDL_GetPerformanceCounter();
+        hits.clear();
+        grid.query_boxes(std::span<const Aabb>(query_boxes, SPATIAL_SCENE_QUERIES), hits);
+        grid.query_rays(std::span<const Ray>(query_rays, SPATIAL_SCENE_QUERIES), hits);
+        grid.query_spheres(std::span<const Sphere>(query_spheres, SPATIAL_SCENE_QUERIES), hits);
+        u64 grid_queried = SDL_GetPerformanceCounter();
+        grid_hits += hits.len;
+
+        {
+            PROFILE_SCOPE("tree update");
+            for (u32 i = 0; i < object_count; i++) {
+                tree.update(proxies[i], bounds[i]);
+            }
+        }
+        u64 tree_updated = SDL_GetPerformanceCounter();
+        hits.clear();
+        tree.query_boxes(std::span<const Aabb>(query_boxes, SPATIAL_SCENE_QUERIES), hits);
+        tree.query_rays(std::span<const Ray>(query_rays, SPATIAL_SCENE_QUERIES), hits);
+        tree.query_spheres(std::span<const Sphere>(query_spheres, SPATIAL_SCENE_QUERIES), hits);
+        u64 tree_queried = SDL_GetPerformanceCounter();
+        tree_hits += hits.len;
+
+        grid_build_ticks += grid_built - start;
+        grid_query_ticks += grid_queried - grid_built;
+        tree_update_ticks += tree_updated - grid_queried;
+        tree_query_ticks += tree_queried - tree_updated;
+
+        for (const SpatialHit& hit : std::span<const SpatialHit>(hits.items, hits.len)) {
+            hit_frames[hit.object] = frame;
+        }
+        frame++;
+    }
+
+    /// @brief The first `batch.size()` objects, red if a query touched them in the last
+    /// update.
+    void draw(std::span<Instance> batch, JobSystem& jobs) const {
+        // Before the first update nothing was hit, and `hit_frames` still holds ~0u.
+        u32 drawn_frame = frame > 0 ? frame - 1 : ~0u - 1;
+        jobs.parallel_for((u32)batch.size(), 1024, [&](u32 begin, u32 end, JobWorker&) {
+            for (u32 i = begin; i < end; i++) {
+                f32 size = 2.0f * radius;
+                bool hit = hit_frames[i] == drawn_frame;
+                batch[i] = Instance{
+                    .model = Mat4x4::translation(positions[i].x, positions[i].y, 0.0f) *
+                             Mat4x4::scale(size, size, 1.0f),
+                    .color = hit ? Vec4::init(1.0f, 0.2f, 0.2f, 1.0f)
+                                 : Vec4::init(0.4f, 0.4f, 0.5f, 1.0f),
+                };
+            }
+        });
+    }
+
+  private:
+    // Flat, like the scene, so objects and box queries touch one layer of grid cells.
+    Aabb object_bounds(u32 index) const {
+        return Aabb::from_center(positions[index], Vec3::init(radius, radius, 0.0f));
+    }
+
+    // xorshift32, so every run queries the same places.
+    u32 next_random() {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        return random;
+    }
+
+    // Uniform in [-1, 1].
+    f32 next_signed() { return (f32)(next_random() >> 8) * (2.0f / 16777216.0f) - 1.0f; }
+
+    /// @brief Queries a few objects across, spread over the square. Each batch is generated
+    /// as runs of four nearby queries, the way gameplay code tends to ask about one area.
+    void generate_queries() {
+        f32 reach = 8.0f * radius;
+        for (u32 i = 0; i < SPATIAL_SCENE_QUERIES; i++) {
+            Vec3 center = Vec3::init(next_signed(), next_signed(), 0.0f);
+            if (i % 4 != 0) {
+                Vec3 jitter = Vec3::init(next_signed(), next_signed(), 0.0f) * reach;
+                center = query_spheres[i - i % 4].center + jitter;
+            }
+            Vec3 extents = Vec3::init(reach, reach, 0.0f);
+            query_boxes[i] = Aabb::from_center(center, extents);
+            query_spheres[i] = Sphere{.center = center, .radius = reach};
+            query_rays[i] = Ray{
+                .origin = center,
+                .direction = Vec3::init(next_signed(), next_signed(), 0.0f),
+                .max_t = 4.0f * reach,
+            };
+        }
+    }
+
+    void log_summary() const {
+        f64 ms = 1000.0 / (f64)SDL_GetPerformanceFrequency() / (f64)frame;
+        SDL_Log(
+            "Spatial %u objects, %u queries per kind, per update: "
+            "grid build %.3f ms, grid queries %.3f ms (%.0f hits), "
+            "tree update %.3f ms, tree queries %.3f ms (%.0f hits), tree height %d\n",
+            object_count,
+            SPATIAL_SCENE_QUERIES,
+            (f64)grid_build_ticks * ms,
+            (f64)grid_query_ticks * ms,
+            (f64)grid_hits / (f64)frame,
+            (f64)tree_update_ticks * ms,
+            (f64)tree_query_ticks * ms,
+            (f64)tree_hits / (f64)frame,
+            tree.height()
+        );
+    }
+};
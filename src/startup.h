@@ -0,0 +1,270 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include "profiler.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <cstdio>
+
+constexpr u32 STARTUP_TRACE_MAX_SPANS = 256;
+constexpr u32 TASK_MAX_DEPENDENTS = 8;
+constexpr u32 TASK_MAX_THREADS = 64;
+static_assert(TASK_MAX_THREADS <= PROFILER_MAX_POOL_THREADS, "Workers need profiler rings");
+
+struct TraceSpan {
+    string name;
+    u64 start;
+    u64 end;
+    u64 thread_id;
+};
+
+/// @brief Fixed-size list of timed spans, safe to record into from any thread.
+struct StartupTrace {
+    TraceSpan spans[STARTUP_TRACE_MAX_SPANS];
+    std::atomic<u32> count;
+
+    void record(string name, u64 start, u64 end) {
+        u32 index = count.fetch_add(1);
+        if (index >= STARTUP_TRACE_MAX_SPANS) return;
+
+        spans[index] = TraceSpan{
+            .name = name,
+            .start = start,
+            .end = end,
+            .thread_id = SDL_GetCurrentThreadID(),
+        };
+    }
+
+    u32 span_count() const {
+        u32 n = count.load();
+        return n < STARTUP_TRACE_MAX_SPANS ? n : STARTUP_TRACE_MAX_SPANS;
+    }
+
+    void log() const {
+        f64 frequency = (f64)SDL_GetPerformanceFrequency();
+        for (u32 i = 0; i < span_count(); i++) {
+            f64 ms = (f64)(spans[i].end - spans[i].start) * 1000.0 / frequency;
+            SDL_Log("Startup %-28s %8.3f ms\n", spans[i].name, ms);
+        }
+    }
+
+    /// @brief Writes the spans as Chrome Trace Event JSON, viewable in chrome://tracing or
+    /// Perfetto.
+    bool write_chrome_trace(string path) const {
+        FILE* file = fopen(path, "wb");
+        if (!file) return false;
+        defer { fclose(file); };
+
+        u32 n = span_count();
+        u64 origin = n > 0 ? spans[0].start : 0;
+        for (u32 i = 0; i < n; i++) {
+            if (spans[i].start < origin) origin = spans[i].start;
+        }
+
+        f64 to_us = 1000000.0 / (f64)SDL_GetPerformanceFrequency();
+        fprintf(file, "{\"traceEvents\":[\n");
+        for (u32 i = 0; i < n; i++) {
+            fprintf(file, "{\"name\":");
+            profiler_write_json_string(file, spans[i].name);
+            fprintf(
+                file,
+                ",\"ph\":\"X\",\"pid\":0,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+                (unsigned long long)spans[i].thread_id,
+                (f64)(spans[i].start - origin) * to_us,
+                (f64)(spans[i].end - spans[i].start) * to_us,
+                i + 1 < n ? "," : ""
+            );
+        }
+        fprintf(file, "]}\n");
+
+        return true;
+    }
+};
+
+typedef void (*TaskFn)(void* user_data);
+typedef void (*TaskProgressFn)(u32 completed, u32 total, void* user_data);
+
+/// @brief One-shot graph of startup tasks. Tasks whose dependencies are done run in parallel
+/// on a pool of worker threads; `run` returns once every task has finished.
+struct TaskGraph {
+    struct Task {
+        string name;
+        TaskFn fn;
+        void* user_data;
+        u32 unfinished_dependencies;
+        u32 dependents[TASK_MAX_DEPENDENTS];
+        u32 num_dependents;
+    };
+
+    Allocator allocator;
+    ArrayList<Task> tasks;
+
+    // Only valid while `run` executes.
+    SDL_Mutex* mutex;
+    SDL_Condition* condition;
+    ArrayList<u32> ready;
+    u32 completed;
+    u32 running;
+    StartupTrace* trace;
+
+    static TaskGraph init(Allocator allocator) {
+        return TaskGraph{
+            .allocator = allocator,
+            .tasks = ArrayList<Task>::init(allocator),
+            .mutex = nullptr,
+            .condition = nullptr,
+            .ready = ArrayList<u32>::init(allocator),
+            .completed = 0,
+            .running = 0,
+            .trace = nullptr,
+        };
+    }
+
+    void deinit() {
+        tasks.deinit();
+        ready.deinit();
+    }
+
+    u32 add(string name, TaskFn fn, void* user_data) {
+        tasks.append(Task{
+            .name = name,
+            .fn = fn,
+            .user_data = user_data,
+            .unfinished_dependencies = 0,
+            .dependents = {},
+            .num_dependents = 0,
+        });
+        return (u32)tasks.len - 1;
+    }
+
+    /// @brief Makes `task` wait for `dependency` to finish.
+    bool depends_on(u32 task, u32 dependency) {
+        Task& parent = tasks.items[dependency];
+        if (parent.num_dependents >= TASK_MAX_DEPENDENTS) return false;
+
+        parent.dependents[parent.num_dependents++] = task;
+        tasks.items[task].unfinished_dependencies++;
+        return true;
+    }
+
+    /// @brief Runs every task on `num_threads` workers, at most TASK_MAX_THREADS, and blocks
+    /// until they are done.
+    /// @param progress Called on the calling thread whenever tasks complete, may be null.
+    /// @return False if the graph has a dependency cycle and could not finish.
+    bool run(
+        u32 num_threads,
+        TaskProgressFn progress = nullptr,
+        void* progress_data = nullptr,
+        StartupTrace* startup_trace = nullptr
+    ) {
+        u32 total = (u32)tasks.len;
+        if (total == 0) return true;
+        if (num_threads == 0) num_threads = 1;
+        if (num_threads > TASK_MAX_THREADS) num_threads = TASK_MAX_THREADS;
+
+        mutex = SDL_CreateMutex();
+        condition = SDL_CreateCondition();
+        completed = 0;
+        running = 0;
+        trace = startup_trace;
+
+        // Reserved up front so workers never allocate.
+        ready.clear();
+        ready.reserve(total);
+        for (u32 i = 0; i < total; i++) {
+            if (tasks.items[i].unfinished_dependencies == 0) ready.append(i);
+        }
+
+        auto threads = allocator.alloc_array<SDL_Thread*>(num_threads);
+        u32 spawned = 0;
+        for (u32 t = 0; t < num_threads; t++) {
+            threads[t] = SDL_CreateThread(spawned_worker_thread, "startup-worker", this);
+            if (threads[t]) spawned++;
+        }
+
+        // No thread could be spawned, run everything here instead.
+        if (spawned == 0) worker_thread(this);
+
+        SDL_LockMutex(mutex);
+        u32 reported = 0;
+        while (true) {
+            if (progress && completed != reported) {
+                reported = completed;
+                SDL_UnlockMutex(mutex);
+                progress(reported, total, progress_data);
+                SDL_LockMutex(mutex);
+                continue;
+            }
+
+            if (completed == total || stalled()) break;
+            SDL_WaitCondition(condition, mutex);
+        }
+        bool finished = completed == total;
+        SDL_UnlockMutex(mutex);
+
+        // Wake workers waiting on a stalled graph so they can exit.
+        SDL_BroadcastCondition(condition);
+
+        for (u32 t = 0; t < num_threads; t++) {
+            if (threads[t]) SDL_WaitThread(threads[t], nullptr);
+        }
+        allocator.free_array(threads, num_threads);
+
+        SDL_DestroyCondition(condition);
+        SDL_DestroyMutex(mutex);
+        mutex = nullptr;
+        condition = nullptr;
+
+        if (!finished) SDL_Log("Startup task graph stalled, check for dependency cycles\n");
+        return finished;
+    }
+
+  private:
+    bool stalled() { return ready.len == 0 && running == 0 && completed < tasks.len; }
+
+    static int spawned_worker_thread(void* data) {
+        PROFILE_THREAD_NAME("startup-worker");
+        return worker_thread(data);
+    }
+
+    static int worker_thread(void* data) {
+        TaskGraph* graph = (TaskGraph*)data;
+
+        SDL_LockMutex(graph->mutex);
+        while (graph->completed < graph->tasks.len && !graph->stalled()) {
+            auto next = graph->ready.pop();
+            if (!next.has_value()) {
+                SDL_WaitCondition(graph->condition, graph->mutex);
+                continue;
+            }
+
+            graph->running++;
+            SDL_UnlockMutex(graph->mutex);
+
+            Task& task = graph->tasks.items[next.value()];
+            u64 start = SDL_GetPerformanceCounter();
+            {
+                PROFILE_SCOPE(task.name);
+                task.fn(task.user_data);
+            }
+            u64 end = SDL_GetPerformanceCounter();
+            if (graph->trace) graph->trace->record(task.name, start, end);
+
+            SDL_LockMutex(graph->mutex);
+            graph->running--;
+            graph->completed++;
+            for (u32 i = 0; i < task.num_dependents; i++) {
+                Task& dependent = graph->tasks.items[task.dependents[i]];
+                if (--dependent.unfinished_dependencies == 0) {
+                    graph->ready.append(task.dependents[i]);
+                }
+            }
+            SDL_BroadcastCondition(graph->condition);
+        }
+        SDL_UnlockMutex(graph->mutex);
+
+        return 0;
+    }
+};
@@ -0,0 +1,376 @@
+#pragma once
+
+#include "async_io.h"
+#include "jobs.h"
+#include "lib/allocator.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <coroutine>
+#include <optional>
+#include <type_traits>
+
+// Coroutine frames of every Task come from here. TaskScheduler points it at its pool while it
+// runs; frames must be freed by the allocator they came from, so all tasks have to finish
+// before the scheduler is torn down.
+inline Allocator task_frame_allocator = PageAllocator::init();
+
+template <typename T> struct TaskPromise;
+
+/// @brief Lazily started coroutine returning T. A task does nothing until it is either
+/// awaited by another task, which resumes when it finishes, or handed to
+/// `TaskScheduler::spawn`. Either one takes ownership of the coroutine frame and frees it once
+/// the task completes, so a task must be used exactly once.
+///
+/// `co_await` on the scheduler's awaitables suspends without blocking the thread, which lets
+/// loading code read as straight-line steps: read a file, create a shader, upload, wait for
+/// the GPU.
+template <typename T = void> struct Task {
+    using promise_type = TaskPromise<T>;
+
+    // Null if the coroutine frame could not be allocated.
+    std::coroutine_handle<promise_type> handle;
+
+    bool is_valid() const { return (bool)handle; }
+
+    struct Awaiter {
+        std::coroutine_handle<promise_type> handle;
+
+        bool await_ready() const { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+            handle.promise().continuation = caller;
+            return handle;
+        }
+
+        T await_resume() {
+            defer { handle.destroy(); };
+            if constexpr (!std::is_void_v<T>) return std::move(*handle.promise().value);
+        }
+    };
+
+    Awaiter operator co_await() && { return Awaiter{handle}; }
+};
+
+struct TaskPromiseBase {
+    // Promises are constructed by the coroutine machinery, hence the member initializers.
+    // Resumed when the task finishes, the awaiting task.
+    std::coroutine_handle<> continuation{};
+    // Set for tasks started by `TaskScheduler::spawn`, which free their own frame.
+    std::atomic<u32>* detached_count{};
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept {
+            TaskPromiseBase& promise = handle.promise();
+            if (promise.continuation) return promise.continuation;
+
+            if (promise.detached_count) {
+                std::atomic<u32>* count = promise.detached_count;
+                handle.destroy();
+                count->fetch_sub(1, std::memory_order_release);
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+
+    void unhandled_exception() {
+        SDL_Log("Unhandled exception in task\n");
+        abort();
+    }
+
+    // Returning null instead of throwing makes the coroutine return an invalid Task.
+    static void* operator new(usize size) noexcept {
+        return task_frame_allocator.alloc(size, alignof(std::max_align_t));
+    }
+
+    static void operator delete(void* ptr, usize size) {
+        task_frame_allocator.free(ptr, size, alignof(std::max_align_t));
+    }
+};
+
+template <typename T> struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object() {
+        return Task<T>{std::coroutine_handle<TaskPromise>::from_promise(*this)};
+    }
+
+    static Task<T> get_return_object_on_allocation_failure() { return Task<T>{nullptr}; }
+
+    void return_value(T result) { value.emplace(std::move(result)); }
+};
+
+template <> struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object() {
+        return Task<void>{std::coroutine_handle<TaskPromise>::from_promise(*this)};
+    }
+
+    static Task<void> get_return_object_on_allocation_failure() { return Task<void>{nullptr}; }
+
+    void return_void() {}
+};
+
+/// @brief Resumes suspended tasks from the frame loop. `tick` runs once per frame on the
+/// main thread; the awaitables below park a task in one of its queues until it is due.
+///
+/// Tasks run on the main thread unless they `co_await resume_on_worker()`, and go back with
+/// `co_await resume_on_main()`. Waiting never blocks a thread, so hundreds of loads can be in
+/// flight while frames keep rendering.
+struct TaskScheduler {
+    struct FenceWait {
+        std::coroutine_handle<> handle;
+        u64 frame_number;
+    };
+
+    PoolAllocator frame_pool;
+    AsyncIO* io;
+    JobSystem* jobs;
+    u64 main_thread_id;
+
+    // Protects the queues, tasks on workers park themselves too.
+    SDL_Mutex* mutex;
+    ArrayList<std::coroutine_handle<>> main_queue;
+    ArrayList<std::coroutine_handle<>> next_frame_queue;
+    ArrayList<FenceWait> fence_waits;
+    // Main thread only, the tasks `tick` is resuming.
+    ArrayList<std::coroutine_handle<>> resuming;
+
+    std::atomic<u64> frames_completed;
+    std::atomic<u32> running_tasks;
+
+    /// @brief Initialized in place, suspended tasks point into the queues.
+    /// @param io Serves `read_file`. Must be polled on the same thread that calls `tick`.
+    /// @param jobs Serves `resume_on_worker`, may be null.
+    bool init(AsyncIO* io, JobSystem* jobs) {
+        // The queues grow under the lock from any thread, so they cannot use an arena.
+        Allocator allocator = PageAllocator::init();
+        frame_pool.init(PageAllocator::init());
+        task_frame_allocator = frame_pool.allocator();
+
+        this->io = io;
+        this->jobs = jobs;
+        main_thread_id = SDL_GetCurrentThreadID();
+        mutex = SDL_CreateMutex();
+        main_queue = ArrayList<std::coroutine_handle<>>::init(allocator);
+        next_frame_queue = ArrayList<std::coroutine_handle<>>::init(allocator);
+        fence_waits = ArrayList<FenceWait>::init(allocator);
+        resuming = ArrayList<std::coroutine_handle<>>::init(allocator);
+        frames_completed.store(0);
+        running_tasks.store(0);
+
+        return mutex != nullptr;
+    }
+
+    /// @brief Frees the queues and the frame pool. Tasks still suspended are leaked.
+    void deinit() {
+        u32 running = running_tasks.load(std::memory_order_acquire);
+        if (running > 0) SDL_Log("%u tasks still running at shutdown\n", running);
+
+        main_queue.deinit();
+        next_frame_queue.deinit();
+        fence_waits.deinit();
+        resuming.deinit();
+        SDL_DestroyMutex(mutex);
+
+        task_frame_allocator = PageAllocator::init();
+        if (running == 0) frame_pool.deinit();
+    }
+
+    /// @brief Starts `task` on the calling thread, up to its first suspension. The frame is
+    /// freed when it finishes.
+    /// @return False if the task's frame could not be allocated.
+    bool spawn(Task<void> task) {
+        if (!task.is_valid()) return false;
+
+        running_tasks.fetch_add(1, std::memory_order_relaxed);
+        task.handle.promise().detached_count = &running_tasks;
+        task.handle.resume();
+        return true;
+    }
+
+    /// @brief Resumes every task that became due: those sent back to the main thread, those
+    /// whose GPU frame completed and those waiting since the previous tick. Main thread only,
+    /// after `AsyncIO::poll`.
+    /// @param gpu_frames_completed Frames the GPU has finished, like FrameRing::frames_completed.
+    /// @return Number of tasks resumed.
+    u32 tick(u64 gpu_frames_completed) {
+        frames_completed.store(gpu_frames_completed, std::memory_order_release);
+
+        // Collected under the lock and resumed outside it, so tasks can park themselves again.
+        SDL_LockMutex(mutex);
+        resuming.clear();
+        for (auto handle : main_queue) {
+            resuming.append(handle);
+        }
+        main_queue.clear();
+        for (usize i = 0; i < fence_waits.len;) {
+            if (fence_waits.items[i].frame_number < gpu_frames_completed) {
+                resuming.append(fence_waits.items[i].handle);
+                fence_waits.swap_remove(i);
+            } else {
+                i++;
+            }
+        }
+        for (auto handle : next_frame_queue) {
+            resuming.append(handle);
+        }
+        next_frame_queue.clear();
+        SDL_UnlockMutex(mutex);
+
+        for (auto handle : resuming) {
+            handle.resume();
+        }
+        return (u32)resuming.len;
+    }
+
+    bool on_main_thread() const { return SDL_GetCurrentThreadID() == main_thread_id; }
+
+    struct MainThreadAwaiter {
+        TaskScheduler* scheduler;
+
+        bool await_ready() const { return scheduler->on_main_thread(); }
+        void await_suspend(std::coroutine_handle<> handle) { scheduler->park(handle); }
+        void await_resume() const {}
+    };
+
+    struct NextFrameAwaiter {
+        TaskScheduler* scheduler;
+
+        bool await_ready() const { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            SDL_LockMutex(scheduler->mutex);
+            scheduler->next_frame_queue.append(handle);
+            SDL_UnlockMutex(scheduler->mutex);
+        }
+
+        void await_resume() const {}
+    };
+
+    struct GPUFrameAwaiter {
+        TaskScheduler* scheduler;
+        u64 frame_number;
+
+        bool await_ready() const {
+            return frame_number < scheduler->frames_completed.load(std::memory_order_acquire);
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            SDL_LockMutex(scheduler->mutex);
+            scheduler->fence_waits.append(FenceWait{handle, frame_number});
+            SDL_UnlockMutex(scheduler->mutex);
+        }
+
+        void await_resume() const {}
+    };
+
+    struct WorkerAwaiter {
+        TaskScheduler* scheduler;
+
+        // With no other worker the job would only run once the main thread waits on one.
+        bool await_ready() const {
+            return scheduler->jobs == nullptr || scheduler->jobs->worker_count < 2;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            scheduler->jobs->submit(resume_job, handle.address());
+        }
+
+        void await_resume() const {}
+
+        static void resume_job(Job& job, JobWorker&) {
+            std::coroutine_handle<>::from_address(job.data).resume();
+        }
+    };
+
+    struct ReadFileAwaiter {
+        TaskScheduler* scheduler;
+        string path;
+        Allocator allocator;
+        AsyncIOPriority priority;
+        std::coroutine_handle<> handle;
+        AsyncIOResult result;
+
+        bool await_ready() const { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            this->handle = handle;
+            auto request = scheduler->io->read(path, allocator, on_read, this, priority);
+            if (!request.has_value()) {
+                result = AsyncIOResult{
+                    .handle = {},
+                    .status = ASYNC_IO_FAILED,
+                    .data = nullptr,
+                    .size = 0,
+                    .user_data = nullptr,
+                };
+                return false;
+            }
+            return true;
+        }
+
+        AsyncIOResult await_resume() const { return result; }
+
+        // Runs inside AsyncIO::poll. The task resumes from the following `tick`.
+        static void on_read(const AsyncIOResult& result) {
+            ReadFileAwaiter* awaiter = (ReadFileAwaiter*)result.user_data;
+            awaiter->result = result;
+            awaiter->scheduler->park(awaiter->handle);
+        }
+    };
+
+    /// @brief Continues the task on the main thread, from the next `tick` unless it is
+    /// already there. Required before SDL window and GPU calls.
+    MainThreadAwaiter resume_on_main() { return MainThreadAwaiter{this}; }
+
+    /// @brief Continues the task on a job system worker, for CPU-heavy steps like
+    /// decompression. Runs inline when there is no job system or it has a single worker.
+    WorkerAwaiter resume_on_worker() { return WorkerAwaiter{this}; }
+
+    /// @brief Continues the task from the next frame's `tick`.
+    NextFrameAwaiter next_frame() { return NextFrameAwaiter{this}; }
+
+    /// @brief Continues the task once the GPU has finished `frame_number`. Uploads queued
+    /// before a frame is rendered are flushed in that frame, so waiting on the FrameRing's
+    /// current `frame_number` waits for them to land.
+    GPUFrameAwaiter gpu_frame(u64 frame_number) { return GPUFrameAwaiter{this, frame_number}; }
+
+    /// @brief Reads the whole file at `path` through AsyncIO. Main thread only. On success the
+    /// result owns a buffer from `allocator`, see AsyncIOResult. While every AsyncIO request
+    /// is taken the read waits for a free one, frame by frame, so any number of loads can be
+    /// started at once.
+    Task<AsyncIOResult> read_file(
+        string path,
+        Allocator allocator,
+        AsyncIOPriority priority = ASYNC_IO_PRIORITY_NORMAL
+    ) {
+        while (io->is_full()) {
+            co_await next_frame();
+        }
+
+        co_return co_await ReadFileAwaiter{
+            .scheduler = this,
+            .path = path,
+            .allocator = allocator,
+            .priority = priority,
+            .handle = nullptr,
+            .result = {},
+        };
+    }
+
+  private:
+    void park(std::coroutine_handle<> handle) {
+        SDL_LockMutex(mutex);
+        main_queue.append(handle);
+        SDL_UnlockMutex(mutex);
+    }
+};
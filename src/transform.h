@@ -0,0 +1,456 @@
+#pragma once
+
+#include "jobs.h"
+#include "lib/allocator.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include "math.h"
+#include "profiler.h"
+#include <SDL3/SDL.h>
+#include <cstring>
+
+typedef u32 TransformId;
+constexpr TransformId TRANSFORM_NONE = ~0u;
+
+// Nodes per job when a level is propagated in parallel.
+constexpr u32 TRANSFORM_PROPAGATE_GRAIN = 256;
+
+/// @brief Per-node arrays, indexed by slot. Slots are in breadth-first order.
+struct TransformSlots {
+    Vec3* positions;
+    f32* rotations;
+    Vec3* scales;
+    Mat4x4* worlds;
+    // Slot of the parent, TRANSFORM_NONE for roots.
+    u32* parents;
+    // The children of a node occupy consecutive slots.
+    u32* first_children;
+    u32* child_counts;
+    u32* depths;
+    TransformId* ids;
+    u8* dirty;
+
+    static TransformSlots init(Allocator allocator, u32 capacity) {
+        return TransformSlots{
+            .positions = allocator.alloc_array<Vec3>(capacity),
+            .rotations = allocator.alloc_array<f32>(capacity),
+            .scales = allocator.alloc_array<Vec3>(capacity),
+            .worlds = allocator.alloc_array<Mat4x4>(capacity),
+            .parents = allocator.alloc_array<u32>(capacity),
+            .first_children = allocator.alloc_array<u32>(capacity),
+            .child_counts = allocator.alloc_array<u32>(capacity),
+            .depths = allocator.alloc_array<u32>(capacity),
+            .ids = allocator.alloc_array<TransformId>(capacity),
+            .dirty = allocator.alloc_array<u8>(capacity),
+        };
+    }
+
+    void deinit(Allocator allocator, u32 capacity) {
+        allocator.free_array(positions, capacity);
+        allocator.free_array(rotations, capacity);
+        allocator.free_array(scales, capacity);
+        allocator.free_array(worlds, capacity);
+        allocator.free_array(parents, capacity);
+        allocator.free_array(first_children, capacity);
+        allocator.free_array(child_counts, capacity);
+        allocator.free_array(depths, capacity);
+        allocator.free_array(ids, capacity);
+        allocator.free_array(dirty, capacity);
+    }
+
+    bool is_valid() const {
+        return positions && rotations && scales && worlds && parents && first_children &&
+               child_counts && depths && ids && dirty;
+    }
+
+    /// @brief Copies slot `from` of `source` to slot `to`, links excepted.
+    void copy(u32 to, const TransformSlots& source, u32 from) {
+        positions[to] = source.positions[from];
+        rotations[to] = source.rotations[from];
+        scales[to] = source.scales[from];
+        worlds[to] = source.worlds[from];
+        ids[to] = source.ids[from];
+        dirty[to] = source.dirty[from];
+    }
+};
+
+/// @brief Scene hierarchy of local transforms (translation, rotation about z, scale) and the
+/// world matrices derived from them.
+///
+/// Nodes are stored structure-of-arrays in breadth-first order, so every parent comes before
+/// its children and each depth is a contiguous level. `update` recomputes world matrices only
+/// for nodes whose local transform changed and their descendants, a level at a time, with
+/// the nodes of a level split across the job workers. A hierarchy where nothing moved costs
+/// nothing to update.
+///
+/// Structural changes (create, destroy, reparent) are cheap to make but reorder every node on
+/// the next `update`, so they belong in scene setup rather than in every frame.
+struct TransformHierarchy {
+    Allocator allocator;
+    u32 capacity;
+    // Live nodes, in slots [0, count).
+    u32 count;
+
+    TransformSlots slots;
+    // Target of the reorder, swapped with `slots` afterwards.
+    TransformSlots spare;
+
+    // Indexed by id.
+    u32* slot_of;
+    TransformId* parent_of;
+    u8* alive;
+    ArrayList<TransformId> free_ids;
+    TransformId next_id;
+
+    // Ids whose local transform changed since the last update.
+    ArrayList<TransformId> dirty_ids;
+    bool order_dirty;
+
+    // Scratch for `update`, all sized to the capacity.
+    u32* child_offsets;
+    TransformId* children;
+    u32* dirty_by_depth;
+    u32* depth_offsets;
+    u8* queued;
+    ArrayList<u32> level;
+    ArrayList<u32> next_level;
+
+    static TransformHierarchy init(Allocator allocator, u32 capacity) {
+        TransformHierarchy hierarchy = {
+            .allocator = allocator,
+            .capacity = capacity,
+            .count = 0,
+            .slots = TransformSlots::init(allocator, capacity),
+            .spare = TransformSlots::init(allocator, capacity),
+            .slot_of = allocator.alloc_array<u32>(capacity),
+            .parent_of = allocator.alloc_array<TransformId>(capacity),
+            .alive = allocator.alloc_array<u8>(capacity),
+            .free_ids = ArrayList<TransformId>::init_capacity(allocator, capacity, capacity),
+            .next_id = 0,
+            .dirty_ids = ArrayList<TransformId>::init_capacity(allocator, capacity, capacity),
+            .order_dirty = false,
+            .child_offsets = allocator.alloc_array<u32>(capacity + 1),
+            .children = allocator.alloc_array<TransformId>(capacity),
+            .dirty_by_depth = allocator.alloc_array<u32>(capacity),
+            .depth_offsets = allocator.alloc_array<u32>(capacity + 1),
+            .queued = allocator.alloc_array<u8>(capacity),
+            .level = ArrayList<u32>::init_capacity(allocator, capacity, capacity),
+            .next_level = ArrayList<u32>::init_capacity(allocator, capacity, capacity),
+        };
+        if (hierarchy.queued) memset(hierarchy.queued, 0, capacity);
+        return hierarchy;
+    }
+
+    void deinit() {
+        slots.deinit(allocator, capacity);
+        spare.deinit(allocator, capacity);
+        allocator.free_array(slot_of, capacity);
+        allocator.free_array(parent_of, capacity);
+        allocator.free_array(alive, capacity);
+        free_ids.deinit();
+        dirty_ids.deinit();
+        allocator.free_array(child_offsets, capacity + 1);
+        allocator.free_array(children, capacity);
+        allocator.free_array(dirty_by_depth, capacity);
+        allocator.free_array(depth_offsets, capacity + 1);
+        allocator.free_array(queued, capacity);
+        level.deinit();
+        next_level.deinit();
+    }
+
+    bool is_valid() const {
+        return slots.is_valid() && spare.is_valid() && slot_of && parent_of && alive &&
+               child_offsets && children && dirty_by_depth && depth_offsets && queued;
+    }
+
+    bool is_alive(TransformId id) const { return id < next_id && alive[id]; }
+
+    /// @brief Adds a node under `parent`, or a root. Ids of destroyed nodes are reused.
+    /// @return The new node, or TRANSFORM_NONE when the hierarchy is full
+    TransformId create(
+        TransformId parent = TRANSFORM_NONE,
+        Vec3 position = Vec3::zero(),
+        f32 rotation = 0.0f,
+        Vec3 scale = Vec3::one()
+    ) {
+        if (parent != TRANSFORM_NONE && !is_alive(parent)) return TRANSFORM_NONE;
+        // Destroyed nodes keep their slot until the next reorder.
+        if (count == capacity) return TRANSFORM_NONE;
+
+        TransformId id;
+        if (free_ids.len > 0) {
+            id = free_ids.items[--free_ids.len];
+        } else if (next_id < capacity) {
+            id = next_id++;
+        } else {
+            return TRANSFORM_NONE;
+        }
+
+        u32 slot = count++;
+        slot_of[id] = slot;
+        parent_of[id] = parent;
+        alive[id] = 1;
+
+        slots.positions[slot] = position;
+        slots.rotations[slot] = rotation;
+        slots.scales[slot] = scale;
+        slots.worlds[slot] = Mat4x4::identity();
+        slots.parents[slot] = parent == TRANSFORM_NONE ? TRANSFORM_NONE : slot_of[parent];
+        slots.ids[slot] = id;
+        slots.dirty[slot] = 0;
+
+        order_dirty = true;
+        mark_dirty(id);
+        return id;
+    }
+
+    /// @brief Destroys `id` and every node below it.
+    void destroy(TransformId id) {
+        if (!is_alive(id)) return;
+
+        // Descendants are collected by the reorder, which no longer reaches them.
+        alive[id] = 0;
+        order_dirty = true;
+    }
+
+    /// @brief Moves `id` under `parent`, or makes it a root. Fails if `parent` is `id` or
+    /// one of its descendants.
+    bool set_parent(TransformId id, TransformId parent) {
+        if (!is_alive(id)) return false;
+        if (parent != TRANSFORM_NONE) {
+            if (!is_alive(parent)) return false;
+            for (TransformId p = parent; p != TRANSFORM_NONE; p = parent_of[p]) {
+                if (p == id) return false;
+            }
+        }
+
+        parent_of[id] = parent;
+        order_dirty = true;
+        mark_dirty(id);
+        return true;
+    }
+
+    TransformId parent(TransformId id) const { return parent_of[id]; }
+
+    void set_position(TransformId id, Vec3 position) {
+        slots.positions[slot_of[id]] = position;
+        mark_dirty(id);
+    }
+
+    void set_rotation(TransformId id, f32 rotation) {
+        slots.rotations[slot_of[id]] = rotation;
+        mark_dirty(id);
+    }
+
+    void set_scale(TransformId id, Vec3 scale) {
+        slots.scales[slot_of[id]] = scale;
+        mark_dirty(id);
+    }
+
+    Vec3 position(TransformId id) const { return slots.positions[slot_of[id]]; }
+    f32 rotation(TransformId id) const { return slots.rotations[slot_of[id]]; }
+    Vec3 scale(TransformId id) const { return slots.scales[slot_of[id]]; }
+
+    /// @brief World matrix of `id` as of the last `update`. `id` must be alive.
+    const Mat4x4& world(TransformId id) const { return slots.worlds[slot_of[id]]; }
+
+    /// @brief Reorders the nodes if the structure changed and recomputes the world matrices of
+    /// every changed node and its descendants.
+    /// @param jobs Splits large levels across the job system's workers when given.
+    void update(JobSystem* jobs = nullptr) {
+        if (order_dirty) reorder();
+        if (dirty_ids.len == 0) return;
+
+        PROFILE_SCOPE("propagate transforms");
+        u32 level_count = bucket_dirty_by_depth();
+
+        // A level is the children of the nodes changed on the level above, plus the nodes on
+        // this level that changed themselves.
+        level.len = 0;
+        for (u32 depth = 0; depth < level_count; depth++) {
+            next_level.len = 0;
+            for (usize i = 0; i < level.len; i++) {
+                u32 parent = level.items[i];
+                u32 first = slots.first_children[parent];
+                for (u32 child = first; child < first + slots.child_counts[parent]; child++) {
+                    queued[child] = 1;
+                    next_level.items[next_level.len++] = child;
+                }
+            }
+            for (u32 i = depth_offsets[depth]; i < depth_offsets[depth + 1]; i++) {
+                u32 slot = dirty_by_depth[i];
+                if (queued[slot]) continue;
+                queued[slot] = 1;
+                next_level.items[next_level.len++] = slot;
+            }
+
+            propagate(next_level, jobs);
+
+            for (usize i = 0; i < next_level.len; i++) {
+                queued[next_level.items[i]] = 0;
+            }
+            ArrayList<u32> done = level;
+            level = next_level;
+            next_level = done;
+        }
+
+        // Below the deepest changed node, only descendants are left.
+        while (level.len > 0) {
+            next_level.len = 0;
+            for (usize i = 0; i < level.len; i++) {
+                u32 parent = level.items[i];
+                u32 first = slots.first_children[parent];
+                for (u32 child = first; child < first + slots.child_counts[parent]; child++) {
+                    next_level.items[next_level.len++] = child;
+                }
+            }
+
+            propagate(next_level, jobs);
+
+            ArrayList<u32> done = level;
+            level = next_level;
+            next_level = done;
+        }
+
+        dirty_ids.len = 0;
+    }
+
+  private:
+    void mark_dirty(TransformId id) {
+        u32 slot = slot_of[id];
+        if (slots.dirty[slot]) return;
+        slots.dirty[slot] = 1;
+        dirty_ids.items[dirty_ids.len++] = id;
+    }
+
+    void propagate(ArrayList<u32>& nodes, JobSystem* jobs) {
+        if (!jobs || nodes.len <= TRANSFORM_PROPAGATE_GRAIN) {
+            propagate_range(nodes.items, (u32)nodes.len);
+            return;
+        }
+
+        jobs->parallel_for(
+            nodes,
+            TRANSFORM_PROPAGATE_GRAIN,
+            [&](std::span<u32> range, JobWorker&) {
+                propagate_range(range.data(), (u32)range.size());
+            }
+        );
+    }
+
+    void propagate_range(const u32* nodes, u32 node_count) {
+        for (u32 i = 0; i < node_count; i++) {
+            u32 slot = nodes[i];
+            Mat4x4 local = Mat4x4::translation_rotation_scale(
+                slots.positions[slot],
+                slots.rotations[slot],
+                slots.scales[slot]
+            );
+            u32 parent = slots.parents[slot];
+            slots.worlds[slot] = parent == TRANSFORM_NONE ? local : slots.worlds[parent] * local;
+            slots.dirty[slot] = 0;
+        }
+    }
+
+    /// @brief Counting sort of the dirty nodes by depth into `dirty_by_depth`, with
+    /// `depth_offsets` marking where each depth starts.
+    /// @return One past the deepest dirty depth.
+    u32 bucket_dirty_by_depth() {
+        u32 level_count = 0;
+        for (usize i = 0; i < dirty_ids.len; i++) {
+            TransformId id = dirty_ids.items[i];
+            if (!is_alive(id)) continue;
+            u32 depth = slots.depths[slot_of[id]];
+            if (depth + 1 > level_count) level_count = depth + 1;
+        }
+
+        memset(depth_offsets, 0, (level_count + 1) * sizeof(u32));
+        for (usize i = 0; i < dirty_ids.len; i++) {
+            TransformId id = dirty_ids.items[i];
+            if (is_alive(id)) depth_offsets[slots.depths[slot_of[id]] + 1]++;
+        }
+        for (u32 depth = 0; depth < level_count; depth++) {
+            depth_offsets[depth + 1] += depth_offsets[depth];
+        }
+
+        // Fill each bucket from its start, then shift the offsets back.
+        for (usize i = 0; i < dirty_ids.len; i++) {
+            TransformId id = dirty_ids.items[i];
+            if (!is_alive(id)) continue;
+            u32 slot = slot_of[id];
+            dirty_by_depth[depth_offsets[slots.depths[slot]]++] = slot;
+        }
+        for (u32 depth = level_count; depth > 0; depth--) {
+            depth_offsets[depth] = depth_offsets[depth - 1];
+        }
+        depth_offsets[0] = 0;
+
+        return level_count;
+    }
+
+    /// @brief Lays the live nodes out breadth-first, giving every node's children consecutive
+    /// slots, and frees the nodes that are no longer reachable from a live root.
+    void reorder() {
+        PROFILE_SCOPE("reorder transforms");
+
+        // Children of every id, grouped by parent.
+        memset(child_offsets, 0, (next_id + 1) * sizeof(u32));
+        for (TransformId id = 0; id < next_id; id++) {
+            if (alive[id] && parent_of[id] != TRANSFORM_NONE) child_offsets[parent_of[id] + 1]++;
+        }
+        for (TransformId id = 0; id < next_id; id++) {
+            child_offsets[id + 1] += child_offsets[id];
+        }
+        for (TransformId id = 0; id < next_id; id++) {
+            if (alive[id] && parent_of[id] != TRANSFORM_NONE) {
+                children[child_offsets[parent_of[id]]++] = id;
+            }
+        }
+        for (TransformId id = next_id; id > 0; id--) {
+            child_offsets[id] = child_offsets[id - 1];
+        }
+        child_offsets[0] = 0;
+
+        // The new slots double as the queue: a node's slot is its position in the traversal.
+        u32 placed = 0;
+        for (TransformId id = 0; id < next_id; id++) {
+            if (!alive[id] || parent_of[id] != TRANSFORM_NONE) continue;
+            spare.copy(placed, slots, slot_of[id]);
+            spare.parents[placed] = TRANSFORM_NONE;
+            spare.depths[placed] = 0;
+            placed++;
+        }
+        for (u32 slot = 0; slot < placed; slot++) {
+            TransformId id = spare.ids[slot];
+            spare.first_children[slot] = placed;
+            spare.child_counts[slot] = 0;
+            for (u32 i = child_offsets[id]; i < child_offsets[id + 1]; i++) {
+                TransformId child = children[i];
+                spare.copy(placed, slots, slot_of[child]);
+                spare.parents[placed] = slot;
+                spare.depths[placed] = spare.depths[slot] + 1;
+                spare.child_counts[slot]++;
+                placed++;
+            }
+        }
+
+        // Anything not placed was destroyed or lost an ancestor.
+        memset(alive, 0, next_id);
+        for (u32 slot = 0; slot < placed; slot++) {
+            alive[spare.ids[slot]] = 1;
+            slot_of[spare.ids[slot]] = slot;
+        }
+        free_ids.len = 0;
+        for (TransformId id = next_id; id > 0; id--) {
+            if (alive[id - 1]) continue;
+            slot_of[id - 1] = TRANSFORM_NONE;
+            free_ids.items[free_ids.len++] = id - 1;
+        }
+
+        TransformSlots old = slots;
+        slots = spare;
+        spare = old;
+        count = placed;
+        order_dirty = false;
+    }
+};
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "lib/allocator.h"
+#include "lib/array.h"
+#include "lib/def.h"
+#include <SDL3/SDL.h>
+#include <cstring>
+#include <optional>
+
+struct PendingBufferCopy {
+    u32 staging_offset;
+    SDL_GPUBufferRegion destination;
+};
+
+struct PendingTextureCopy {
+    u32 staging_offset;
+    u32 pixels_per_row;
+    u32 rows_per_layer;
+    SDL_GPUTextureRegion destination;
+};
+
+// Staging bytes written before `ring_head` can be reused once `frame_number` has completed.
+struct UploadRetirement {
+    u64 frame_number;
+    u64 ring_head;
+};
+
+/// @brief Streams buffer and texture data to the GPU through one persistent staging ring.
+/// Uploads are sub-allocated from the ring and queued, `flush` records all of them into the
+/// frame's copy pass, and `retire` recycles staging space once the GPU has consumed it.
+struct UploadManager {
+    SDL_GPUDevice* device;
+    SDL_GPUTransferBuffer* staging_buffer;
+    u8* mapped;
+    u32 capacity;
+
+    // Monotonic byte positions. The ring slot of a position is `position % capacity`.
+    u64 head;
+    u64 tail;
+
+    ArrayList<PendingBufferCopy> buffer_copies;
+    ArrayList<PendingTextureCopy> texture_copies;
+    ArrayList<UploadRetirement> in_flight;
+
+    static std::optional<UploadManager>
+    init(Allocator allocator, SDL_GPUDevice* device, u32 capacity) {
+        SDL_GPUTransferBuffer* staging_buffer = SDL_CreateGPUTransferBuffer(
+            device,
+            &(SDL_GPUTransferBufferCreateInfo){
+                .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+                .size = capacity,
+            }
+        );
+        if (!staging_buffer) {
+            SDL_Log("Failed to create staging buffer %s\n", SDL_GetError());
+            return std::nullopt;
+        }
+
+        return UploadManager{
+            .device = device,
+            .staging_buffer = staging_buffer,
+            .mapped = nullptr,
+            .capacity = capacity,
+            .head = 0,
+            .tail = 0,
+            .buffer_copies = ArrayList<PendingBufferCopy>::init(allocator),
+            .texture_copies = ArrayList<PendingTextureCopy>::init(allocator),
+            .in_flight = ArrayList<UploadRetirement>::init(allocator),
+        };
+    }
+
+    void deinit() {
+        if (mapped) {
+            SDL_UnmapGPUTransferBuffer(device, staging_buffer);
+            mapped = nullptr;
+        }
+
+        SDL_ReleaseGPUTransferBuffer(device, staging_buffer);
+        buffer_copies.deinit();
+        texture_copies.deinit();
+        in_flight.deinit();
+    }
+
+    /// @brief Queues `size` bytes of `data` to be copied into `buffer` at `offset`.
+    /// @return False if the staging ring has no room left this frame.
+    bool upload_buffer(SDL_GPUBuffer* buffer, u32 offset, const void* data, u32 size) {
+        auto staging_offset = stage(data, size, 16);
+        if (!staging_offset.has_value()) return false;
+
+        return buffer_copies.append(PendingBufferCopy{
+            .staging_offset = staging_offset.value(),
+            .destination = {.buffer = buffer, .offset = offset, .size = size},
+        });
+    }
+
+    /// @brief Queues `size` bytes of tightly packed texel data to be copied into `region`.
+    /// @return False if the staging ring has no room left this frame.
+    bool upload_texture(SDL_GPUTextureRegion region, const void* data, u32 size) {
+        // Texel offsets must be aligned to the texel block size, 16 covers every format.
+        auto staging_offset = stage(data, size, 16);
+        if (!staging_offset.has_value()) return false;
+
+        return texture_copies.append(PendingTextureCopy{
+            .staging_offset = staging_offset.value(),
+            .pixels_per_row = 0,
+            .rows_per_layer = 0,
+            .destination = region,
+        });
+    }
+
+    bool has_pending() const { return buffer_copies.len > 0 || texture_copies.len > 0; }
+
+    /// @brief Records every queued copy into `copy_pass`. The staging space is held until
+    /// `frame_number` is reported complete through `retire`.
+    void flush(SDL_GPUCopyPass* copy_pass, u64 frame_number) {
+        if (!has_pending()) return;
+
+        if (mapped) {
+            SDL_UnmapGPUTransferBuffer(device, staging_buffer);
+            mapped = nullptr;
+        }
+
+        for (auto& copy : buffer_copies) {
+            SDL_UploadToGPUBuffer(
+                copy_pass,
+                &(SDL_GPUTransferBufferLocation){
+                    .transfer_buffer = staging_buffer,
+                    .offset = copy.staging_offset,
+                },
+                &copy.destination,
+                false
+            );
+        }
+
+        for (auto& copy : texture_copies) {
+            SDL_UploadToGPUTexture(
+                copy_pass,
+                &(SDL_GPUTextureTransferInfo){
+                    .transfer_buffer = staging_buffer,
+                    .offset = copy.staging_offset,
+                    .pixels_per_row = copy.pixels_per_row,
+                    .rows_per_layer = copy.rows_per_layer,
+                },
+                &copy.destination,
+                false
+            );
+        }
+
+        buffer_copies.clear();
+        texture_copies.clear();
+        in_flight.append(UploadRetirement{.frame_number = frame_number, .ring_head = head});
+    }
+
+    /// @brief Releases the staging space of every flush whose frame number is below
+    /// `frames_completed`.
+    void retire(u64 frames_completed) {
+        usize retired = 0;
+        while (retired < in_flight.len) {
+            UploadRetirement& retirement = in_flight.items[retired];
+            if (retirement.frame_number >= frames_completed) break;
+
+            tail = retirement.ring_head;
+            retired++;
+        }
+
+        if (retired == 0) return;
+
+        memmove(
+            in_flight.items,
+            in_flight.items + retired,
+            (in_flight.len - retired) * sizeof(UploadRetirement)
+        );
+        in_flight.len -= retired;
+    }
+
+  private:
+    std::optional<u32> stage(const void* data, u32 size, u32 alignment) {
+        if (size == 0 || size > capacity) {
+            SDL_Log("Upload of %u bytes does not fit the staging ring\n", size);
+            return std::nullopt;
+        }
+
+        u64 start = (head + alignment - 1) & ~(u64)(alignment - 1);
+        u32 ring_offset = (u32)(start % capacity);
+
+        // Uploads are never split, wrap to the start of the ring instead.
+        if (ring_offset + size > capacity) {
+            start += capacity - ring_offset;
+            ring_offset = 0;
+        }
+
+        if (start + size - tail > capacity) {
+            return std::nullopt;
+        }
+
+        if (!mapped) {
+            // Only retired ranges are written, so the buffer never needs cycling.
+            mapped = (u8*)SDL_MapGPUTransferBuffer(device, staging_buffer, false);
+            if (!mapped) {
+                SDL_Log("Failed to map staging buffer %s\n", SDL_GetError());
+                return std::nullopt;
+            }
+        }
+
+        memcpy(mapped + ring_offset, data, size);
+        head = start + size;
+
+        return ring_offset;
+    }
+};
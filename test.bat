@@ -0,0 +1,52 @@
+@echo off
+setlocal enabledelayedexpansion
+
+:: Builds and runs the CPU-only tests in tests\, one program per *_test.cpp.
+set PROJECT_ROOT=%~dp0
+set TEST_DIR=%PROJECT_ROOT%tests
+set BUILD_DIR=%PROJECT_ROOT%build\tests
+
+:: Set SDL3 paths
+set SDL3_DIR=C:\SDKs\SDL3
+set SDL3_BUILD_DIR=%SDL3_DIR%\build\Release
+set SDL3_INCLUDE_DIR=%SDL3_DIR%\include
+set SDL3_LIB_DIR=%SDL3_BUILD_DIR%
+
+if not exist "%BUILD_DIR%" mkdir "%BUILD_DIR%"
+
+set FAILED=0
+for %%f in ("%TEST_DIR%\*_test.cpp") do (
+    echo Compiling %%~nf...
+    clang++ -std=c++23 ^
+        -g ^
+        -O1 ^
+        -Wall ^
+        -Wextra ^
+        -Wpedantic ^
+        -Wno-c99-extensions ^
+        -Wno-dangling ^
+        -Wno-address-of-temporary ^
+        -Wno-missing-designated-field-initializers ^
+        -Wno-nested-anon-types ^
+        -Wno-gnu-anonymous-struct ^
+        -Wno-reorder-init-list ^
+        -Wno-deprecated-declarations ^
+        -I%SDL3_INCLUDE_DIR% ^
+        -L%SDL3_LIB_DIR% ^
+        -o "%BUILD_DIR%\%%~nf.exe" ^
+        "%%f" ^
+        -lSDL3
+    if errorlevel 1 (
+        echo Compilation of %%~nf failed
+        set FAILED=1
+    ) else (
+        "%BUILD_DIR%\%%~nf.exe"
+        if errorlevel 1 set FAILED=1
+    )
+)
+
+if !FAILED! neq 0 (
+    echo Tests failed
+    exit /b 1
+)
+echo All tests passed!
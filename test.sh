@@ -0,0 +1,52 @@
+#!/bin/bash
+
+# Builds and runs the CPU-only tests in tests/, one program per *_test.cpp.
+CC="clang++"
+CFLAGS="-std=c++23 \
+    -g \
+    -O1 \
+    -Wall \
+    -Wextra \
+    -Wpedantic \
+    -Wno-c99-extensions \
+    -Wno-dangling \
+    -Wno-address-of-temporary \
+    -Wno-missing-designated-field-initializers \
+    -Wno-nested-anon-types \
+    -Wno-gnu-anonymous-struct \
+    -Wno-reorder-init-list"
+
+PROJECT_ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+TEST_DIR="$PROJECT_ROOT/tests"
+BUILD_DIR="$PROJECT_ROOT/build/tests"
+
+mkdir -p "$BUILD_DIR"
+
+# Check if pkg-config is available and can find SDL3
+if command -v pkg-config &> /dev/null && pkg-config --exists sdl3; then
+    SDL3_CFLAGS=$(pkg-config --cflags sdl3)
+    SDL3_LIBS=$(pkg-config --libs sdl3)
+else
+    SDL3_CFLAGS="-I/usr/local/include"
+    SDL3_LIBS="-L/usr/local/lib -lSDL3"
+fi
+
+failed=0
+for file in "$TEST_DIR"/*_test.cpp; do
+    name=$(basename "$file" .cpp)
+    echo "Compiling $name..."
+    if ! $CC $CFLAGS $SDL3_CFLAGS -o "$BUILD_DIR/$name" "$file" $SDL3_LIBS; then
+        echo "Compilation of $name failed"
+        failed=1
+        continue
+    fi
+    if ! "$BUILD_DIR/$name"; then
+        failed=1
+    fi
+done
+
+if [ $failed -ne 0 ]; then
+    echo "Tests failed"
+    exit 1
+fi
+echo "All tests passed!"
@@ -0,0 +1,87 @@
+#include "../src/ecs.h"
+#include "test.h"
+
+struct Position {
+    f32 x, y, z;
+};
+
+struct Velocity {
+    f32 x, y, z;
+};
+
+// As aligned as a component may be, so every column needs the chunk's full alignment.
+struct alignas(ECS_CHUNK_ALIGNMENT) Bounds {
+    f32 min[4];
+    f32 max[4];
+};
+
+static bool is_aligned(const void* ptr, usize alignment) {
+    return ((usize)ptr & (alignment - 1)) == 0;
+}
+
+/// @brief Fills a few archetypes over many chunks and checks every chunk and column against
+/// the alignment it was allocated with. The world lives in an arena, like the game's.
+static void test_chunks_are_aligned() {
+    ArenaAllocator arena = ArenaAllocator::init(PageAllocator::init(), 4096);
+    defer { arena.deinit(); };
+    Allocator allocator = arena.allocator();
+    World world = World::init(allocator);
+    defer { world.deinit(); };
+
+    for (u32 i = 0; i < 5000; i++) {
+        Position position = {(f32)i, 0.0f, 0.0f};
+        if (i % 3 == 0) {
+            CHECK(world.spawn(position) != ENTITY_NULL);
+        } else if (i % 3 == 1) {
+            CHECK(world.spawn(position, Velocity{1.0f, 0.0f, 0.0f}) != ENTITY_NULL);
+        } else {
+            CHECK(world.spawn(position, Bounds{}) != ENTITY_NULL);
+        }
+        // Small allocations in between, so chunks do not follow each other back to back.
+        if (i % 1000 == 0) CHECK(allocator.alloc(24, 8) != nullptr);
+    }
+
+    usize chunk_count = 0;
+    for (usize a = 0; a < world.archetypes.len; a++) {
+        const EcsArchetype* archetype = world.archetypes.items[a];
+        for (usize c = 0; c < archetype->chunks.len; c++) {
+            const EcsChunk& chunk = archetype->chunks.items[c];
+            CHECK(((usize)chunk.data & 63) == 0);
+            CHECK(is_aligned(chunk.data, ECS_CHUNK_ALIGNMENT));
+            for (u32 component = 0; component < ECS_MAX_COMPONENTS; component++) {
+                if (!archetype->has(component)) continue;
+                CHECK(is_aligned(archetype->column(chunk, component),
+                                 ecs_components[component].alignment));
+            }
+            chunk_count++;
+        }
+    }
+    CHECK(chunk_count > 3);
+
+    u32 visited = 0;
+    world.query<Bounds>().each([&](Entity, Bounds& bounds) {
+        CHECK(is_aligned(&bounds, alignof(Bounds)));
+        visited++;
+    });
+    CHECK(visited == 5000 / 3);
+}
+
+static void test_arena_honors_alignment() {
+    ArenaAllocator arena = ArenaAllocator::init(PageAllocator::init(), 256);
+    defer { arena.deinit(); };
+    Allocator allocator = arena.allocator();
+
+    // Odd sizes leave every offset misaligned for the next request.
+    for (usize alignment = 1; alignment <= 4096; alignment *= 2) {
+        CHECK(allocator.alloc(3, 1) != nullptr);
+        void* ptr = allocator.alloc(alignment * 3, alignment);
+        CHECK(ptr != nullptr);
+        CHECK(is_aligned(ptr, alignment));
+    }
+}
+
+int main() {
+    test_arena_honors_alignment();
+    test_chunks_are_aligned();
+    return test_result("ecs");
+}
@@ -0,0 +1,107 @@
+#include "../src/instancing.h"
+#include "test.h"
+#include <cstddef>
+
+// Above INSTANCE_PACK_GRAIN, so packing with a job system splits the work.
+constexpr u32 INSTANCING_TEST_COUNT = 5000;
+constexpr u8 INSTANCING_TEST_GUARD = 0xCD;
+
+// The shader reads a StructuredBuffer of float4x4 then float4, 16-byte aligned, no padding.
+static_assert(offsetof(InstanceData, mvp_matrix) == 0);
+static_assert(offsetof(InstanceData, color) == 64);
+static_assert(sizeof(InstanceData) % 16 == 0);
+
+static Mat4x4 test_model(u32 i) {
+    return Mat4x4::translation((f32)i, (f32)(i % 7), 0.5f) * Mat4x4::rotation_z(0.01f * i);
+}
+
+static Vec4 test_color(u32 i) { return Vec4::init((f32)i, 0.25f, 0.5f, 1.0f); }
+
+static void fill(InstanceBatch& batch, u32 count) {
+    batch.clear();
+    for (u32 i = 0; i < count; i++) {
+        CHECK(batch.push(test_model(i), test_color(i)));
+    }
+}
+
+/// @brief Whether `bytes` holds `count` packed instances followed only by guard bytes, read
+/// back at the byte offsets the shader uses rather than through InstanceData.
+static bool packed_as_expected(const u8* bytes, usize size, u32 count, const Mat4x4& vp) {
+    for (u32 i = 0; i < count; i++) {
+        const u8* instance = bytes + (usize)i * 80;
+        Mat4x4 mvp = vp * test_model(i);
+        Vec4 color = test_color(i);
+        if (memcmp(instance, mvp.m, 64) != 0) return false;
+        f32 rgba[4];
+        memcpy(rgba, instance + 64, sizeof(rgba));
+        if (rgba[0] != color.x || rgba[1] != color.y || rgba[2] != color.z ||
+            rgba[3] != color.w) {
+            return false;
+        }
+    }
+    for (usize i = (usize)count * 80; i < size; i++) {
+        if (bytes[i] != INSTANCING_TEST_GUARD) return false;
+    }
+    return true;
+}
+
+static void test_pack(JobSystem* jobs) {
+    Allocator allocator = PageAllocator::init();
+    InstanceBatch batch = InstanceBatch::init(allocator, INSTANCING_TEST_COUNT);
+    usize size = INSTANCING_TEST_COUNT * sizeof(InstanceData);
+    u8* bytes = allocator.alloc_array<u8>(size);
+    defer {
+        allocator.free_array(bytes, size);
+        batch.deinit();
+    };
+    Mat4x4 vp = Mat4x4::orthographic(-2.0f, 2.0f, -1.0f, 1.0f, 0.0f, 1.0f);
+
+    // Whole batches, with and without room to spare, and the empty one.
+    for (u32 count : {0u, 1u, 100u, INSTANCING_TEST_COUNT}) {
+        fill(batch, count);
+        memset(bytes, INSTANCING_TEST_GUARD, size);
+        CHECK(batch.pack((InstanceData*)bytes, INSTANCING_TEST_COUNT, vp, jobs) == count);
+        CHECK(packed_as_expected(bytes, size, count, vp));
+    }
+
+    // Partial batches: the destination holds fewer instances than the batch, on both sides of
+    // the parallel grain. Nothing past `max_count` is written.
+    fill(batch, INSTANCING_TEST_COUNT);
+    for (u32 max_count : {0u, 7u, INSTANCE_PACK_GRAIN + 1, INSTANCING_TEST_COUNT - 1}) {
+        memset(bytes, INSTANCING_TEST_GUARD, size);
+        CHECK(batch.pack((InstanceData*)bytes, max_count, vp, jobs) == max_count);
+        CHECK(packed_as_expected(bytes, size, max_count, vp));
+    }
+}
+
+static void test_push_uninitialized() {
+    InstanceBatch batch = InstanceBatch::init(PageAllocator::init(), 10);
+    defer { batch.deinit(); };
+
+    CHECK(batch.push(test_model(0), test_color(0)));
+    std::span<Instance> filled = batch.push_uninitialized(6);
+    CHECK(filled.size() == 6);
+    CHECK(filled.data() == batch.instances.items + 1);
+    CHECK(batch.count() == 7);
+
+    // No partial room: all or nothing.
+    CHECK(batch.push_uninitialized(4).empty());
+    CHECK(batch.count() == 7);
+    CHECK(batch.push_uninitialized(3).size() == 3);
+    CHECK(batch.count() == 10);
+}
+
+int main() {
+    test_pack(nullptr);
+
+    JobSystem jobs;
+    if (jobs.init(PageAllocator::init(), 4)) {
+        test_pack(&jobs);
+        jobs.deinit();
+    } else {
+        CHECK(false);
+    }
+
+    test_push_uninitialized();
+    return test_result("instancing");
+}
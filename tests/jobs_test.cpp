@@ -0,0 +1,75 @@
+#include "../src/jobs.h"
+#include "test.h"
+
+// Well above JOB_POOL_SIZE, so job storage is reused many times over while the first, largest
+// ranges are still queued.
+constexpr u32 JOBS_TEST_COUNT = 200000;
+
+static u8 runs[JOBS_TEST_COUNT];
+
+static bool every_index_once() {
+    for (u32 i = 0; i < JOBS_TEST_COUNT; i++) {
+        if (runs[i] != 1) return false;
+    }
+    return true;
+}
+
+static void test_parallel_for_covers_every_index(JobSystem& jobs, u32 grain) {
+    memset(runs, 0, sizeof(runs));
+    jobs.parallel_for(JOBS_TEST_COUNT, grain, [](u32 begin, u32 end, JobWorker&) {
+        for (u32 i = begin; i < end; i++) {
+            runs[i]++;
+        }
+    });
+    CHECK(every_index_once());
+}
+
+static void test_nested_parallel_for(JobSystem& jobs) {
+    memset(runs, 0, sizeof(runs));
+    constexpr u32 outer = 200;
+    constexpr u32 inner = JOBS_TEST_COUNT / outer;
+    jobs.parallel_for(outer, 1, [&](u32 begin, u32 end, JobWorker&) {
+        for (u32 o = begin; o < end; o++) {
+            jobs.parallel_for(inner, 1, [&](u32 inner_begin, u32 inner_end, JobWorker&) {
+                for (u32 i = inner_begin; i < inner_end; i++) {
+                    runs[o * inner + i]++;
+                }
+            });
+        }
+    });
+    CHECK(every_index_once());
+}
+
+static void test_counter_joins_submitted_jobs(JobSystem& jobs) {
+    std::atomic<u32> ran = 0;
+    JobCounter counter = {};
+    for (u32 i = 0; i < JOBS_TEST_COUNT; i++) {
+        jobs.submit(
+            [](Job& job, JobWorker&) {
+                ((std::atomic<u32>*)job.data)->fetch_add(1, std::memory_order_relaxed);
+            },
+            &ran,
+            &counter
+        );
+    }
+    jobs.wait(&counter);
+    CHECK(ran.load() == JOBS_TEST_COUNT);
+    CHECK(counter.done());
+}
+
+int main() {
+    for (u32 worker_count : {1u, 2u, 4u, 8u}) {
+        JobSystem jobs;
+        if (!jobs.init(PageAllocator::init(), worker_count)) {
+            CHECK(false);
+            continue;
+        }
+        defer { jobs.deinit(); };
+
+        test_parallel_for_covers_every_index(jobs, 1);
+        test_parallel_for_covers_every_index(jobs, 64);
+        test_nested_parallel_for(jobs);
+        test_counter_joins_submitted_jobs(jobs);
+    }
+    return test_result("jobs");
+}
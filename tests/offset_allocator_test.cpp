@@ -0,0 +1,162 @@
+#include "../src/lib/offset_allocator.h"
+#include "test.h"
+#include <chrono>
+
+static Allocator heap() { return PageAllocator::init(); }
+
+static void test_fill_and_coalesce() {
+    constexpr u32 size = 1024 * 1024;
+    constexpr u32 block = 1024;
+    OffsetAllocator allocator = OffsetAllocator::init(heap(), size);
+    defer { allocator.deinit(); };
+
+    OffsetAllocation blocks[size / block];
+    for (u32 i = 0; i < size / block; i++) {
+        auto allocation = allocator.allocate(block);
+        CHECK(allocation.has_value());
+        if (!allocation) return;
+        blocks[i] = *allocation;
+        CHECK(allocation->offset % block == 0 && allocation->offset + block <= size);
+    }
+    CHECK(!allocator.allocate(1).has_value());
+    CHECK(allocator.storage_report().total_free == 0);
+
+    // Every other block, nothing can merge yet.
+    for (u32 i = 0; i < size / block; i += 2) {
+        allocator.free(blocks[i]);
+    }
+    OffsetAllocatorReport report = allocator.storage_report();
+    CHECK(report.total_free == size / 2);
+    CHECK(report.free_regions == size / block / 2);
+    CHECK(report.largest_free == block);
+    CHECK(!allocator.allocate(2 * block).has_value());
+
+    // The rest fills the holes back into one region.
+    for (u32 i = 1; i < size / block; i += 2) {
+        allocator.free(blocks[i]);
+    }
+    report = allocator.storage_report();
+    CHECK(report.total_free == size);
+    CHECK(report.free_regions == 1);
+    CHECK(report.largest_free == size);
+    CHECK(report.fragmentation == 0.0f);
+
+    auto whole = allocator.allocate(size);
+    CHECK(whole.has_value() && whole->offset == 0);
+}
+
+static void test_neighbors_merge_both_ways() {
+    // Sizes that are exact bins, so the last block fits the remainder exactly.
+    OffsetAllocator allocator = OffsetAllocator::init(heap(), 384);
+    defer { allocator.deinit(); };
+
+    auto a = allocator.allocate(128);
+    auto b = allocator.allocate(128);
+    auto c = allocator.allocate(128);
+    CHECK(a && b && c);
+    if (!a || !b || !c) return;
+    CHECK(a->offset == 0 && b->offset == 128 && c->offset == 256);
+
+    allocator.free(*a);
+    allocator.free(*c);
+    CHECK(allocator.storage_report().free_regions == 2);
+
+    // Freeing the middle merges with the free ranges on both sides.
+    allocator.free(*b);
+    OffsetAllocatorReport report = allocator.storage_report();
+    CHECK(report.free_regions == 1 && report.largest_free == 384);
+
+    // Double frees and empty requests are ignored.
+    allocator.free(*b);
+    CHECK(allocator.storage_report().total_free == 384);
+    CHECK(!allocator.allocate(0).has_value());
+}
+
+// xorshift32, so failures reproduce.
+static u32 next_random(u32& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static void test_random_against_occupancy() {
+    constexpr u32 size = 1 << 16;
+    constexpr u32 max_live = 512;
+    OffsetAllocator allocator = OffsetAllocator::init(heap(), size, 4096);
+    defer { allocator.deinit(); };
+
+    static u8 owner[size];
+    OffsetAllocation live[max_live];
+    u32 live_sizes[max_live];
+    u32 live_count = 0;
+    u32 used = 0;
+    u32 random = 0x12345678;
+    u32 overlaps = 0;
+
+    for (u32 step = 0; step < 200000; step++) {
+        bool allocate = live_count == 0 || (live_count < max_live && next_random(random) % 2);
+        if (allocate) {
+            u32 alloc_size = 1 + next_random(random) % 700;
+            auto allocation = allocator.allocate(alloc_size);
+            if (!allocation) continue;
+
+            CHECK(allocation->offset + alloc_size <= size);
+            for (u32 i = allocation->offset; i < allocation->offset + alloc_size; i++) {
+                overlaps += owner[i];
+                owner[i] = 1;
+            }
+            live[live_count] = *allocation;
+            live_sizes[live_count++] = alloc_size;
+            used += alloc_size;
+        } else {
+            u32 index = next_random(random) % live_count;
+            CHECK(allocator.allocation_size(live[index]) == live_sizes[index]);
+            memset(owner + live[index].offset, 0, live_sizes[index]);
+            allocator.free(live[index]);
+            used -= live_sizes[index];
+            live[index] = live[--live_count];
+            live_sizes[index] = live_sizes[live_count];
+        }
+        if (step % 1024 == 0) CHECK(allocator.storage_report().total_free == size - used);
+    }
+    CHECK(overlaps == 0);
+
+    while (live_count > 0) {
+        allocator.free(live[--live_count]);
+    }
+    OffsetAllocatorReport report = allocator.storage_report();
+    CHECK(report.total_free == size && report.free_regions == 1);
+}
+
+/// @brief Not a check: prints the cost of an allocate and free pair on a busy heap.
+static void bench_allocate_free() {
+    constexpr u32 live_count = 4096;
+    constexpr u32 rounds = 1000000;
+    OffsetAllocator allocator = OffsetAllocator::init(heap(), 1 << 30);
+    defer { allocator.deinit(); };
+
+    static OffsetAllocation live[live_count];
+    u32 random = 0x9E3779B9u;
+    for (u32 i = 0; i < live_count; i++) {
+        live[i] = allocator.allocate(1 + next_random(random) % 65536).value();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (u32 i = 0; i < rounds; i++) {
+        u32 index = next_random(random) % live_count;
+        allocator.free(live[index]);
+        live[index] = allocator.allocate(1 + next_random(random) % 65536).value();
+    }
+    f64 ns = std::chrono::duration<f64, std::nano>(std::chrono::steady_clock::now() - start)
+                 .count();
+    std::printf("offset allocator: %.1f ns per free + allocate\n", ns / rounds);
+}
+
+int main() {
+    test_fill_and_coalesce();
+    test_neighbors_merge_both_ways();
+    test_random_against_occupancy();
+    bench_allocate_free();
+    return test_result("offset_allocator");
+}
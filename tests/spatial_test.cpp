@@ -0,0 +1,206 @@
+#include "../src/spatial.h"
+#include "test.h"
+#include <algorithm>
+
+constexpr u32 SPATIAL_TEST_QUERIES = 37;
+
+// xorshift32, so failures reproduce.
+static u32 random_state = 12345;
+
+static f32 next_unit() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return (f32)(random_state >> 8) / 16777216.0f;
+}
+
+static f32 next_signed() { return next_unit() * 2.0f - 1.0f; }
+
+static bool ray_overlaps(const Ray& ray, const Aabb& box) {
+    f32 enter = 0.0f;
+    f32 exit = ray.max_t;
+    for (u32 axis = 0; axis < 3; axis++) {
+        f32 inverse = 1.0f / ray.direction[axis];
+        f32 t1 = (box.min[axis] - ray.origin[axis]) * inverse;
+        f32 t2 = (box.max[axis] - ray.origin[axis]) * inverse;
+        enter = std::max(enter, std::min(t1, t2));
+        exit = std::min(exit, std::max(t1, t2));
+    }
+    return enter <= exit;
+}
+
+static bool sphere_overlaps(const Sphere& sphere, const Aabb& box) {
+    f32 distance_squared = 0.0f;
+    for (u32 axis = 0; axis < 3; axis++) {
+        f32 below = box.min[axis] - sphere.center[axis];
+        f32 above = sphere.center[axis] - box.max[axis];
+        f32 d = std::max(std::max(below, above), 0.0f);
+        distance_squared += d * d;
+    }
+    return distance_squared <= sphere.radius * sphere.radius;
+}
+
+static bool hit_less(const SpatialHit& a, const SpatialHit& b) {
+    return a.query != b.query ? a.query < b.query : a.object < b.object;
+}
+
+/// @brief Whether `hits` holds exactly the pairs `overlaps(query, object)` accepts, each once.
+template <typename Query, typename Overlaps>
+static bool matches_brute_force(
+    ArrayList<SpatialHit>& hits,
+    const Query* queries,
+    const Aabb* boxes,
+    u32 object_count,
+    Overlaps&& overlaps
+) {
+    std::sort(hits.items, hits.items + hits.len, hit_less);
+    usize next = 0;
+    for (u32 q = 0; q < SPATIAL_TEST_QUERIES; q++) {
+        for (u32 object = 0; object < object_count; object++) {
+            if (!overlaps(queries[q], boxes[object])) continue;
+            if (next == hits.len) return false;
+            const SpatialHit& hit = hits.items[next++];
+            if (hit.query != q || hit.object != object) return false;
+        }
+    }
+    return next == hits.len;
+}
+
+static bool box_overlaps(const Aabb& query, const Aabb& box) { return query.overlaps(box); }
+
+/// @brief Moves `object_count` boxes about for a few steps and checks every grid and tree
+/// query against brute force: exact bounds for the grid, fattened leaf boxes for the tree.
+static void test_queries_match_brute_force(u32 object_count, f32 max_extent, u32 large_every) {
+    Allocator allocator = PageAllocator::init();
+    Aabb* boxes = allocator.alloc_array<Aabb>(object_count);
+    Aabb* fat_boxes = allocator.alloc_array<Aabb>(object_count);
+    u32* proxies = allocator.alloc_array<u32>(object_count);
+    defer {
+        allocator.free_array(proxies, object_count);
+        allocator.free_array(fat_boxes, object_count);
+        allocator.free_array(boxes, object_count);
+    };
+
+    SpatialGrid grid = SpatialGrid::init(allocator, 0.8f, 2 * object_count).value();
+    AabbTree tree = AabbTree::init(allocator, 0.1f, object_count);
+    ArrayList<SpatialHit> hits = ArrayList<SpatialHit>::init(allocator);
+    defer {
+        hits.deinit();
+        tree.deinit();
+        grid.deinit();
+    };
+
+    for (u32 i = 0; i < object_count; i++) {
+        Vec3 center = Vec3::init(next_signed() * 10.0f, next_signed() * 10.0f, next_signed());
+        f32 extent = 0.05f + next_unit() * max_extent;
+        // Some objects span far more cells than the grid enters them in.
+        if (large_every > 0 && i % large_every == 0) extent = 4.0f;
+        boxes[i] = Aabb::from_center(center, Vec3::init(extent, extent, extent));
+        proxies[i] = tree.insert(boxes[i], i);
+        CHECK(proxies[i] != SPATIAL_NONE);
+    }
+
+    Aabb query_boxes[SPATIAL_TEST_QUERIES];
+    Ray query_rays[SPATIAL_TEST_QUERIES];
+    Sphere query_spheres[SPATIAL_TEST_QUERIES];
+    for (u32 step = 0; step < 10; step++) {
+        for (u32 i = 0; i < object_count; i++) {
+            Vec3 move = Vec3::init(next_signed(), next_signed(), next_signed()) * 0.2f;
+            // Now and then far enough to leave the fattened box and the parent's.
+            if (next_unit() < 0.01f) move = move * 100.0f;
+            boxes[i] = Aabb::init(boxes[i].min + move, boxes[i].max + move);
+            tree.update(proxies[i], boxes[i]);
+        }
+        CHECK(grid.build(std::span<const Aabb>(boxes, object_count)));
+
+        for (u32 i = 0; i < SPATIAL_TEST_QUERIES; i++) {
+            Vec3 center = Vec3::init(next_signed(), next_signed(), next_signed()) * 12.0f;
+            // One query wide enough to take the grid's pass over every entry.
+            f32 reach = next_unit() * (i == 5 ? 40.0f : 2.0f);
+            query_boxes[i] = Aabb::from_center(center, Vec3::init(reach, reach, reach));
+            query_spheres[i] = Sphere{.center = center, .radius = reach};
+            // Every seventh ray is parallel to the xy plane.
+            f32 z = i % 7 == 0 ? 0.0f : next_signed();
+            query_rays[i] = Ray{
+                .origin = center,
+                .direction = Vec3::init(next_signed(), next_signed(), z),
+                .max_t = next_unit() * 20.0f,
+            };
+        }
+        for (u32 i = 0; i < object_count; i++) {
+            fat_boxes[i] = tree.fat_box(proxies[i]);
+            CHECK(fat_boxes[i].contains(boxes[i]));
+        }
+
+        hits.clear();
+        grid.query_boxes(query_boxes, hits);
+        CHECK(matches_brute_force(hits, query_boxes, boxes, object_count, box_overlaps));
+        hits.clear();
+        grid.query_rays(query_rays, hits);
+        CHECK(matches_brute_force(hits, query_rays, boxes, object_count, ray_overlaps));
+        hits.clear();
+        grid.query_spheres(query_spheres, hits);
+        CHECK(matches_brute_force(hits, query_spheres, boxes, object_count, sphere_overlaps));
+
+        hits.clear();
+        CHECK(tree.query_boxes(query_boxes, hits));
+        CHECK(matches_brute_force(hits, query_boxes, fat_boxes, object_count, box_overlaps));
+        hits.clear();
+        CHECK(tree.query_rays(query_rays, hits));
+        CHECK(matches_brute_force(hits, query_rays, fat_boxes, object_count, ray_overlaps));
+        hits.clear();
+        CHECK(tree.query_spheres(query_spheres, hits));
+        CHECK(matches_brute_force(hits, query_spheres, fat_boxes, object_count, sphere_overlaps));
+    }
+    CHECK(tree.leaf_count == object_count);
+}
+
+static void test_tree_insert_out_of_memory() {
+    // Room for the tree's first node allocation only: eight nodes, four leaves.
+    alignas(AabbTreeNode) static u8 buffer[8 * sizeof(AabbTreeNode)];
+    FixedBufferAllocator fixed = FixedBufferAllocator::init(buffer);
+    AabbTree tree = AabbTree::init(fixed.allocator(), 0.0f, 1);
+
+    u32 proxies[4];
+    for (u32 i = 0; i < 4; i++) {
+        Vec3 center = Vec3::init((f32)i * 3.0f, 0.0f, 0.0f);
+        proxies[i] = tree.insert(Aabb::from_center(center, Vec3::init(1.0f, 1.0f, 1.0f)), i);
+        CHECK(proxies[i] != SPATIAL_NONE);
+    }
+
+    // The leaf fits, its new parent does not; twice, so the freed leaf node is reused.
+    Aabb extra = Aabb::from_center(Vec3::init(20.0f, 0.0f, 0.0f), Vec3::init(1.0f, 1.0f, 1.0f));
+    CHECK(tree.insert(extra, 4) == SPATIAL_NONE);
+    CHECK(tree.insert(extra, 4) == SPATIAL_NONE);
+    CHECK(tree.leaf_count == 4);
+
+    ArrayList<SpatialHit> hits = ArrayList<SpatialHit>::init(PageAllocator::init());
+    defer { hits.deinit(); };
+    Aabb everything = Aabb::init(Vec3::init(-100, -100, -100), Vec3::init(100, 100, 100));
+    CHECK(tree.query_boxes(std::span<const Aabb>(&everything, 1), hits));
+    CHECK(hits.len == 4);
+
+    // Removing a leaf frees two nodes, enough for one more insert.
+    tree.remove(proxies[0]);
+    CHECK(tree.insert(extra, 4) != SPATIAL_NONE);
+    CHECK(tree.leaf_count == 4);
+}
+
+static void test_grid_init_out_of_memory() {
+    alignas(u32) static u8 buffer[64 * sizeof(u32)];
+    FixedBufferAllocator fixed = FixedBufferAllocator::init(buffer);
+    CHECK(!SpatialGrid::init(fixed.allocator(), 1.0f, 1024).has_value());
+
+    auto grid = SpatialGrid::init(fixed.allocator(), 1.0f, 32);
+    CHECK(grid.has_value());
+    if (grid.has_value()) grid->deinit();
+}
+
+int main() {
+    test_queries_match_brute_force(50, 0.3f, 0);
+    test_queries_match_brute_force(3000, 2.0f, 0);
+    test_queries_match_brute_force(5000, 0.3f, 100);
+    test_tree_insert_out_of_memory();
+    test_grid_init_out_of_memory();
+    return test_result("spatial");
+}
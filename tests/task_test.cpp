@@ -0,0 +1,191 @@
+#include "../src/task.h"
+#include "test.h"
+#include <cstdio>
+
+constexpr string TASK_TEST_FILE = "task_test.tmp";
+
+/// @brief The frame loop's part in running tasks, without rendering.
+struct TaskTestLoop {
+    AsyncIO io;
+    JobSystem jobs;
+    TaskScheduler tasks;
+    u64 gpu_frames;
+
+    bool init(u32 worker_count) {
+        gpu_frames = 0;
+        if (!io.init()) return false;
+        if (!jobs.init(PageAllocator::init(), worker_count)) return false;
+        return tasks.init(&io, &jobs);
+    }
+
+    void deinit() {
+        tasks.deinit();
+        io.deinit();
+        jobs.deinit();
+    }
+
+    void frame() {
+        io.poll();
+        jobs.run_main_jobs();
+        tasks.tick(gpu_frames);
+    }
+
+    /// @brief Runs frames until every spawned task has finished.
+    /// @return False if they did not within a few seconds.
+    bool run_until_done() {
+        u64 deadline = SDL_GetTicks() + 5000;
+        while (tasks.running_tasks.load(std::memory_order_acquire) > 0) {
+            if (SDL_GetTicks() > deadline) return false;
+            frame();
+            SDL_Delay(1);
+        }
+        return true;
+    }
+};
+
+static Task<void> set_flag(bool* flag) {
+    *flag = true;
+    co_return;
+}
+
+static void test_spawn_runs_to_completion(TaskTestLoop& loop) {
+    bool ran = false;
+    CHECK(loop.tasks.spawn(set_flag(&ran)));
+    // Nothing to wait for, so the task finished inside `spawn` and freed itself.
+    CHECK(ran);
+    CHECK(loop.tasks.running_tasks.load() == 0);
+}
+
+static Task<u32> leaf_value(TaskScheduler* tasks, u32 value) {
+    co_await tasks->next_frame();
+    co_return value;
+}
+
+static Task<u32> sum_of_leaves(TaskScheduler* tasks) {
+    u32 first = co_await leaf_value(tasks, 20);
+    u32 second = co_await leaf_value(tasks, 22);
+    co_return first + second;
+}
+
+static Task<void> store_nested_sum(TaskScheduler* tasks, u32* out) {
+    *out = co_await sum_of_leaves(tasks);
+}
+
+static void test_nested_await(TaskTestLoop& loop) {
+    u32 result = 0;
+    CHECK(loop.tasks.spawn(store_nested_sum(&loop.tasks, &result)));
+    CHECK(loop.run_until_done());
+    CHECK(result == 42);
+}
+
+static Task<void> count_frames(TaskScheduler* tasks, u32* count) {
+    for (u32 i = 0; i < 3; i++) {
+        co_await tasks->next_frame();
+        (*count)++;
+    }
+}
+
+static void test_next_frame(TaskTestLoop& loop) {
+    u32 count = 0;
+    CHECK(loop.tasks.spawn(count_frames(&loop.tasks, &count)));
+    CHECK(count == 0);
+    for (u32 frame = 1; frame <= 3; frame++) {
+        loop.frame();
+        CHECK(count == frame);
+    }
+    CHECK(loop.tasks.running_tasks.load() == 0);
+}
+
+struct ThreadHops {
+    u64 main_thread;
+    u64 worker_thread;
+    u64 back_on_main_thread;
+};
+
+static Task<void> hop_threads(TaskScheduler* tasks, ThreadHops* hops) {
+    co_await tasks->resume_on_worker();
+    hops->worker_thread = SDL_GetCurrentThreadID();
+    co_await tasks->resume_on_main();
+    hops->back_on_main_thread = SDL_GetCurrentThreadID();
+}
+
+static void test_resume_on_worker_and_main(TaskTestLoop& loop) {
+    ThreadHops hops = {};
+    hops.main_thread = SDL_GetCurrentThreadID();
+    CHECK(loop.tasks.spawn(hop_threads(&loop.tasks, &hops)));
+    CHECK(loop.run_until_done());
+    CHECK(hops.worker_thread != 0 && hops.worker_thread != hops.main_thread);
+    CHECK(hops.back_on_main_thread == hops.main_thread);
+}
+
+static Task<void> wait_gpu_frame(TaskScheduler* tasks, u64 frame_number, bool* done) {
+    co_await tasks->gpu_frame(frame_number);
+    *done = true;
+}
+
+static void test_gpu_frame(TaskTestLoop& loop) {
+    bool done = false;
+    loop.gpu_frames = 3;
+    CHECK(loop.tasks.spawn(wait_gpu_frame(&loop.tasks, 4, &done)));
+    loop.frame();
+    CHECK(!done);
+
+    // Frame 4 is finished once five frames have completed.
+    loop.gpu_frames = 5;
+    loop.frame();
+    CHECK(done);
+
+    // Already finished frames do not suspend at all.
+    done = false;
+    CHECK(loop.tasks.spawn(wait_gpu_frame(&loop.tasks, 2, &done)));
+    CHECK(done);
+}
+
+static Task<void> read_whole_file(TaskScheduler* tasks, string path, AsyncIOResult* out) {
+    *out = co_await tasks->read_file(path, PageAllocator::init());
+}
+
+static void test_read_file(TaskTestLoop& loop) {
+    const char contents[] = "task test file contents";
+    FILE* file = fopen(TASK_TEST_FILE, "wb");
+    CHECK(file);
+    if (!file) return;
+    fwrite(contents, 1, sizeof(contents), file);
+    fclose(file);
+    defer { remove(TASK_TEST_FILE); };
+
+    AsyncIOResult result = {};
+    result.status = ASYNC_IO_FAILED;
+    CHECK(loop.tasks.spawn(read_whole_file(&loop.tasks, TASK_TEST_FILE, &result)));
+    CHECK(loop.run_until_done());
+    CHECK(result.status == ASYNC_IO_COMPLETE);
+    CHECK(result.size == sizeof(contents));
+    CHECK(result.data && memcmp(result.data, contents, sizeof(contents)) == 0);
+    PageAllocator::init().free_array(result.data, result.size);
+
+    AsyncIOResult missing = {};
+    missing.status = ASYNC_IO_COMPLETE;
+    CHECK(loop.tasks.spawn(read_whole_file(&loop.tasks, "task_test_missing.tmp", &missing)));
+    CHECK(loop.run_until_done());
+    CHECK(missing.status == ASYNC_IO_FAILED);
+    CHECK(missing.data == nullptr);
+}
+
+int main() {
+    TaskTestLoop* loop = new TaskTestLoop;
+    if (!loop->init(4)) {
+        std::printf("task: failed to start the task loop\n");
+        return 1;
+    }
+
+    test_spawn_runs_to_completion(*loop);
+    test_nested_await(*loop);
+    test_next_frame(*loop);
+    test_resume_on_worker_and_main(*loop);
+    test_gpu_frame(*loop);
+    test_read_file(*loop);
+
+    loop->deinit();
+    delete loop;
+    return test_result("task");
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Minimal harness for the CPU-only tests. Each test file is its own program: it registers
+// nothing, just calls its test functions from main and returns `test_result()`.
+
+#include "../src/lib/def.h"
+#include <cstdio>
+
+inline u32 test_checks = 0;
+inline u32 test_failures = 0;
+
+#define CHECK(condition)                                                                          \
+    do {                                                                                          \
+        test_checks++;                                                                            \
+        if (!(condition)) {                                                                       \
+            test_failures++;                                                                      \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);             \
+        }                                                                                         \
+    } while (0)
+
+/// @brief Prints the summary line of a test program.
+/// @return The process exit code, non-zero if any check failed.
+inline int test_result(string name) {
+    std::printf("%s: %u checks, %u failed\n", name, test_checks, test_failures);
+    return test_failures == 0 ? 0 : 1;
+}
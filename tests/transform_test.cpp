@@ -0,0 +1,221 @@
+#include "../src/transform.h"
+#include "test.h"
+#include <cmath>
+
+constexpr u32 TRANSFORM_TEST_CAPACITY = 4096;
+
+static bool nearly_equal(const Mat4x4& a, const Mat4x4& b) {
+    for (u32 i = 0; i < 16; i++) {
+        if (fabsf(a.m[i] - b.m[i]) > 1e-4f) return false;
+    }
+    return true;
+}
+
+static Mat4x4 local_matrix(const TransformHierarchy& hierarchy, TransformId id) {
+    return Mat4x4::translation_rotation_scale(
+        hierarchy.position(id),
+        hierarchy.rotation(id),
+        hierarchy.scale(id)
+    );
+}
+
+/// @brief World matrix of `id` computed from scratch, parent by parent.
+static Mat4x4 expected_world(const TransformHierarchy& hierarchy, TransformId id) {
+    TransformId parent = hierarchy.parent(id);
+    Mat4x4 local = local_matrix(hierarchy, id);
+    return parent == TRANSFORM_NONE ? local : expected_world(hierarchy, parent) * local;
+}
+
+static Vec3 test_position(u32 i) {
+    return Vec3::init((f32)(i % 7) * 0.25f, (f32)(i % 5) * -0.5f, 0.0f);
+}
+
+static void test_world_is_parent_times_local() {
+    TransformHierarchy hierarchy = TransformHierarchy::init(PageAllocator::init(), 64);
+    CHECK(hierarchy.is_valid());
+    defer { hierarchy.deinit(); };
+
+    TransformId root = hierarchy.create(TRANSFORM_NONE, Vec3::init(1, 2, 0), 0.5f);
+    TransformId child = hierarchy.create(root, Vec3::init(0, 1, 0), 0.25f, Vec3::init(2, 2, 1));
+    TransformId grandchild = hierarchy.create(child, Vec3::init(3, 0, 0), -1.0f);
+    TransformId other_root = hierarchy.create(TRANSFORM_NONE, Vec3::init(-4, 0, 0));
+    hierarchy.update();
+
+    CHECK(nearly_equal(hierarchy.world(root), local_matrix(hierarchy, root)));
+    CHECK(nearly_equal(hierarchy.world(child),
+                       hierarchy.world(root) * local_matrix(hierarchy, child)));
+    CHECK(nearly_equal(hierarchy.world(grandchild),
+                       hierarchy.world(child) * local_matrix(hierarchy, grandchild)));
+    CHECK(nearly_equal(hierarchy.world(other_root), local_matrix(hierarchy, other_root)));
+
+    // A moved parent carries its descendants along.
+    hierarchy.set_rotation(root, 1.5f);
+    hierarchy.set_position(child, Vec3::init(0, -1, 0));
+    hierarchy.update();
+    CHECK(nearly_equal(hierarchy.world(grandchild), expected_world(hierarchy, grandchild)));
+
+    // So does a new parent.
+    CHECK(hierarchy.set_parent(grandchild, other_root));
+    hierarchy.update();
+    CHECK(hierarchy.parent(grandchild) == other_root);
+    CHECK(nearly_equal(hierarchy.world(grandchild),
+                       hierarchy.world(other_root) * local_matrix(hierarchy, grandchild)));
+}
+
+static void test_update_recomputes_only_dirty_subtrees() {
+    TransformHierarchy hierarchy = TransformHierarchy::init(PageAllocator::init(), 64);
+    defer { hierarchy.deinit(); };
+
+    TransformId moved = hierarchy.create(TRANSFORM_NONE, Vec3::init(1, 0, 0));
+    TransformId moved_child = hierarchy.create(moved, Vec3::init(0, 1, 0));
+    TransformId still = hierarchy.create(TRANSFORM_NONE, Vec3::init(-1, 0, 0));
+    TransformId still_child = hierarchy.create(still, Vec3::init(0, -1, 0));
+    hierarchy.update();
+
+    // Matrices no update would produce. Only the ones recomputed lose them.
+    Mat4x4 marker = Mat4x4::scale(7.0f, 7.0f, 7.0f);
+    TransformId nodes[] = {moved, moved_child, still, still_child};
+    for (TransformId id : nodes) {
+        hierarchy.slots.worlds[hierarchy.slot_of[id]] = marker;
+    }
+
+    // Nothing changed, nothing is recomputed.
+    hierarchy.update();
+    for (TransformId id : nodes) {
+        CHECK(nearly_equal(hierarchy.world(id), marker));
+    }
+
+    hierarchy.set_position(moved, Vec3::init(2, 0, 0));
+    hierarchy.update();
+    CHECK(nearly_equal(hierarchy.world(moved), expected_world(hierarchy, moved)));
+    CHECK(nearly_equal(hierarchy.world(moved_child), expected_world(hierarchy, moved_child)));
+    CHECK(nearly_equal(hierarchy.world(still), marker));
+    CHECK(nearly_equal(hierarchy.world(still_child), marker));
+
+    // A changed child recomputes itself, not its parent.
+    hierarchy.set_rotation(still_child, 0.5f);
+    hierarchy.update();
+    CHECK(nearly_equal(hierarchy.world(still), marker));
+    Mat4x4 expected = marker * local_matrix(hierarchy, still_child);
+    CHECK(nearly_equal(hierarchy.world(still_child), expected));
+}
+
+static void test_destroy_frees_descendants() {
+    TransformHierarchy hierarchy = TransformHierarchy::init(PageAllocator::init(), 8);
+    defer { hierarchy.deinit(); };
+
+    TransformId root = hierarchy.create();
+    TransformId doomed = hierarchy.create(root, Vec3::init(1, 0, 0));
+    TransformId doomed_child = hierarchy.create(doomed, Vec3::init(1, 0, 0));
+    TransformId doomed_grandchild = hierarchy.create(doomed_child, Vec3::init(1, 0, 0));
+    TransformId sibling = hierarchy.create(root, Vec3::init(0, 1, 0));
+    hierarchy.update();
+    CHECK(hierarchy.count == 5);
+
+    hierarchy.destroy(doomed);
+    CHECK(!hierarchy.is_alive(doomed));
+    hierarchy.update();
+    CHECK(hierarchy.count == 2);
+    CHECK(!hierarchy.is_alive(doomed_child));
+    CHECK(!hierarchy.is_alive(doomed_grandchild));
+    CHECK(hierarchy.is_alive(root) && hierarchy.is_alive(sibling));
+    CHECK(nearly_equal(hierarchy.world(sibling), expected_world(hierarchy, sibling)));
+
+    // The three freed ids come back before any new one.
+    TransformId reused[3];
+    for (TransformId& id : reused) {
+        id = hierarchy.create(sibling);
+        CHECK(id == doomed || id == doomed_child || id == doomed_grandchild);
+    }
+    CHECK(reused[0] != reused[1] && reused[1] != reused[2] && reused[0] != reused[2]);
+    CHECK(hierarchy.create(sibling) == 5);
+    hierarchy.update();
+    for (TransformId id : reused) {
+        CHECK(hierarchy.parent(id) == sibling);
+        CHECK(nearly_equal(hierarchy.world(id), expected_world(hierarchy, id)));
+    }
+}
+
+static void test_set_parent_rejects_cycles() {
+    TransformHierarchy hierarchy = TransformHierarchy::init(PageAllocator::init(), 8);
+    defer { hierarchy.deinit(); };
+
+    TransformId a = hierarchy.create();
+    TransformId b = hierarchy.create(a);
+    TransformId c = hierarchy.create(b);
+    TransformId d = hierarchy.create();
+
+    CHECK(!hierarchy.set_parent(a, a));
+    CHECK(!hierarchy.set_parent(a, b));
+    CHECK(!hierarchy.set_parent(a, c));
+    CHECK(hierarchy.parent(a) == TRANSFORM_NONE);
+
+    CHECK(hierarchy.set_parent(a, d));
+    CHECK(hierarchy.set_parent(c, TRANSFORM_NONE));
+    CHECK(hierarchy.set_parent(d, c));
+    CHECK(!hierarchy.set_parent(c, b));
+    hierarchy.update();
+    CHECK(hierarchy.count == 4);
+    CHECK(nearly_equal(hierarchy.world(b), expected_world(hierarchy, b)));
+}
+
+/// @brief Builds the same wide hierarchy twice, levels well above TRANSFORM_PROPAGATE_GRAIN,
+/// and updates one with the job system. Both must produce the very same matrices.
+static void test_parallel_matches_serial(JobSystem& jobs) {
+    Allocator allocator = PageAllocator::init();
+    TransformHierarchy serial = TransformHierarchy::init(allocator, TRANSFORM_TEST_CAPACITY);
+    TransformHierarchy parallel = TransformHierarchy::init(allocator, TRANSFORM_TEST_CAPACITY);
+    defer {
+        parallel.deinit();
+        serial.deinit();
+    };
+
+    for (TransformHierarchy* hierarchy : {&serial, &parallel}) {
+        u32 i = 0;
+        for (u32 r = 0; r < 4; r++) {
+            TransformId root = hierarchy->create(TRANSFORM_NONE, test_position(i++), 0.1f * r);
+            for (u32 c = 0; c < 300; c++) {
+                TransformId child = hierarchy->create(root, test_position(i++), 0.01f * c);
+                hierarchy->create(child, test_position(i++), -0.02f * c, Vec3::init(0.5f, 2, 1));
+                hierarchy->create(child, test_position(i++));
+            }
+        }
+        CHECK(hierarchy->count == 4 + 4 * 300 * 3);
+    }
+
+    for (u32 round = 0; round < 3; round++) {
+        // After the first full update, turn a spread of nodes on every level, so the later
+        // rounds are partial updates.
+        for (TransformHierarchy* hierarchy : {&serial, &parallel}) {
+            for (TransformId id = 0; round > 0 && id < hierarchy->next_id; id += 2 + round) {
+                hierarchy->set_rotation(id, hierarchy->rotation(id) + 0.3f);
+            }
+        }
+
+        serial.update();
+        parallel.update(&jobs);
+        CHECK(serial.count == parallel.count);
+        CHECK(memcmp(serial.slots.worlds, parallel.slots.worlds,
+                     serial.count * sizeof(Mat4x4)) == 0);
+    }
+
+    for (TransformId id = 0; id < serial.next_id; id += 97) {
+        CHECK(nearly_equal(parallel.world(id), expected_world(parallel, id)));
+    }
+}
+
+int main() {
+    test_world_is_parent_times_local();
+    test_update_recomputes_only_dirty_subtrees();
+    test_destroy_frees_descendants();
+    test_set_parent_rejects_cycles();
+
+    JobSystem jobs;
+    if (jobs.init(PageAllocator::init(), 4)) {
+        test_parallel_matches_serial(jobs);
+        jobs.deinit();
+    } else {
+        CHECK(false);
+    }
+    return test_result("transform");
+}
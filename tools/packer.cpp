@@ -0,0 +1,303 @@
+// Packs every file under a directory into one archive, see src/lib/archive.h for the format.
+//
+//   packer <input_dir> <output.pak> [--store]
+//
+// Entries are LZ4 compressed unless that saves less than an eighth of their size, or
+// --store is given.
+
+#include "../src/lib/allocator.h"
+#include "../src/lib/archive.h"
+#include "../src/lib/array.h"
+#include "../src/lib/def.h"
+#include "../src/lib/file.h"
+#include "../src/lib/string.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+constexpr usize PACKER_PATH_MAX = 1024;
+
+struct PackedFile {
+    ArchiveEntry entry;
+    u8* data;
+    usize data_size;
+    // Heap copy of the entry's path relative to the input directory.
+    char* name;
+};
+
+struct Packer {
+    Allocator allocator;
+    ArrayList<PackedFile> files;
+    bool compress;
+
+    static Packer init(Allocator allocator, bool compress) {
+        return Packer{
+            .allocator = allocator,
+            .files = ArrayList<PackedFile>::init(allocator),
+            .compress = compress,
+        };
+    }
+
+    void deinit() {
+        for (auto& file : files) {
+            allocator.free_array(file.data, file.data_size);
+            allocator.free_array(file.name, strlen(file.name) + 1);
+        }
+        files.deinit();
+    }
+
+    bool add_file(string path, string name) {
+        if (File::get_size(path) == 0) {
+            fprintf(stderr, "Skipping empty file %s\n", path);
+            return true;
+        }
+
+        auto file = File::read_all(allocator, path);
+        if (!file.has_value()) {
+            fprintf(stderr, "Failed to read %s\n", path);
+            return false;
+        }
+        defer { file->deinit(); };
+
+        PackedFile packed = {
+            .entry =
+                ArchiveEntry{
+                    .name_hash = archive_name_hash(name),
+                    .offset = 0,
+                    .stored_size = file->size,
+                    .size = file->size,
+                    .name_offset = 0,
+                    .compression = ARCHIVE_COMPRESSION_NONE,
+                },
+            .data = nullptr,
+            .data_size = 0,
+            .name = allocator.alloc_array<char>(strlen(name) + 1),
+        };
+        memcpy(packed.name, name, strlen(name) + 1);
+
+        if (compress) {
+            usize bound = lz4_compress_bound(file->size);
+            u8* compressed = allocator.alloc_array<u8>(bound);
+            usize compressed_size = lz4_compress((u8*)file->data, file->size, compressed, bound);
+
+            if (compressed_size > 0 && compressed_size < file->size - file->size / 8) {
+                packed.entry.compression = ARCHIVE_COMPRESSION_LZ4;
+                packed.entry.stored_size = compressed_size;
+                packed.data = compressed;
+                packed.data_size = bound;
+            } else {
+                allocator.free_array(compressed, bound);
+            }
+        }
+
+        if (!packed.data) {
+            packed.data = allocator.alloc_array<u8>(file->size);
+            packed.data_size = file->size;
+            memcpy(packed.data, file->data, file->size);
+        }
+
+        for (auto& existing : files) {
+            if (existing.entry.name_hash == packed.entry.name_hash) {
+                // Lookups would still work, but colliding names are worth knowing about.
+                fprintf(stderr, "Warning: %s and %s share a name hash\n", existing.name, name);
+            }
+        }
+
+        files.append(packed);
+        return true;
+    }
+
+    /// @brief Adds every regular file below `directory`, named by its path relative to `root`.
+    bool add_directory(string root, string directory) {
+#ifdef _WIN32
+        char pattern[PACKER_PATH_MAX];
+        snprintf(pattern, sizeof(pattern), "%s\\*", directory);
+
+        WIN32_FIND_DATAA find_data;
+        HANDLE find = FindFirstFileA(pattern, &find_data);
+        if (find == INVALID_HANDLE_VALUE) {
+            fprintf(stderr, "Failed to open directory %s\n", directory);
+            return false;
+        }
+        defer { FindClose(find); };
+
+        do {
+            string entry_name = find_data.cFileName;
+            bool is_directory = (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+        DIR* dir = opendir(directory);
+        if (!dir) {
+            fprintf(stderr, "Failed to open directory %s\n", directory);
+            return false;
+        }
+        defer { closedir(dir); };
+
+        while (dirent* dir_entry = readdir(dir)) {
+            string entry_name = dir_entry->d_name;
+#endif
+            if (string_equals(entry_name, ".") || string_equals(entry_name, "..")) continue;
+
+            char path[PACKER_PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", directory, entry_name);
+
+#ifndef _WIN32
+            struct stat info;
+            if (stat(path, &info) != 0) continue;
+            bool is_directory = S_ISDIR(info.st_mode);
+            if (!is_directory && !S_ISREG(info.st_mode)) continue;
+#endif
+
+            if (is_directory) {
+                if (!add_directory(root, path)) return false;
+                continue;
+            }
+
+            // Names always use forward slashes, relative to the input root.
+            string name = path + strlen(root) + 1;
+            if (!add_file(path, name)) return false;
+#ifdef _WIN32
+        } while (FindNextFileA(find, &find_data));
+#else
+        }
+#endif
+
+        return true;
+    }
+
+    bool write(string output_path) {
+        u32 entry_count = (u32)files.len;
+        qsort(files.items, files.len, sizeof(PackedFile), [](const void* a, const void* b) {
+            u64 hash_a = ((const PackedFile*)a)->entry.name_hash;
+            u64 hash_b = ((const PackedFile*)b)->entry.name_hash;
+            return hash_a < hash_b ? -1 : hash_a > hash_b ? 1 : 0;
+        });
+
+        ArchiveHeader header = {
+            .magic = ARCHIVE_MAGIC,
+            .version = ARCHIVE_VERSION,
+            .entry_count = entry_count,
+            .bucket_bits = archive_bucket_bits(entry_count),
+            .toc_offset = sizeof(ArchiveHeader),
+            .buckets_offset = 0,
+            .names_offset = 0,
+            .names_size = 0,
+        };
+        u32 bucket_count = 1u << header.bucket_bits;
+        header.buckets_offset = header.toc_offset + entry_count * sizeof(ArchiveEntry);
+        header.names_offset = header.buckets_offset + (bucket_count + 1) * sizeof(u32);
+
+        for (auto& file : files) {
+            file.entry.name_offset = (u32)header.names_size;
+            header.names_size += strlen(file.name) + 1;
+        }
+        // An empty archive still gets one terminator so the names block is never empty.
+        if (header.names_size == 0) header.names_size = 1;
+
+        u64 offset = align_up(header.names_offset + header.names_size);
+        for (auto& file : files) {
+            file.entry.offset = offset;
+            offset = align_up(offset + file.entry.stored_size);
+        }
+
+        // buckets[b] is the first entry whose hash falls in bucket b or later.
+        auto buckets = allocator.alloc_array<u32>(bucket_count + 1);
+        defer { allocator.free_array(buckets, bucket_count + 1); };
+        u32 entry = 0;
+        for (u32 bucket = 0; bucket <= bucket_count; bucket++) {
+            while (entry < entry_count &&
+                   archive_bucket(files.items[entry].entry.name_hash, header.bucket_bits) <
+                       bucket) {
+                entry++;
+            }
+            buckets[bucket] = entry;
+        }
+
+        FILE* out = fopen(output_path, "wb");
+        if (!out) {
+            fprintf(stderr, "Failed to open %s for writing\n", output_path);
+            return false;
+        }
+        defer { fclose(out); };
+
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+        for (auto& file : files) {
+            ok = ok && fwrite(&file.entry, sizeof(ArchiveEntry), 1, out) == 1;
+        }
+        ok = ok && fwrite(buckets, sizeof(u32), bucket_count + 1, out) == bucket_count + 1;
+        for (auto& file : files) {
+            ok = ok && fwrite(file.name, 1, strlen(file.name) + 1, out) == strlen(file.name) + 1;
+        }
+        if (entry_count == 0) ok = ok && fputc('\0', out) != EOF;
+
+        for (auto& file : files) {
+            ok = ok && pad_to(out, file.entry.offset);
+            ok = ok && fwrite(file.data, 1, file.entry.stored_size, out) == file.entry.stored_size;
+        }
+        ok = ok && pad_to(out, offset);
+
+        if (!ok) {
+            fprintf(stderr, "Failed to write %s\n", output_path);
+        }
+        return ok;
+    }
+
+  private:
+    static u64 align_up(u64 offset) {
+        return (offset + ARCHIVE_ALIGNMENT - 1) & ~(ARCHIVE_ALIGNMENT - 1);
+    }
+
+    static bool pad_to(FILE* out, u64 offset) {
+        static const u8 zeros[ARCHIVE_ALIGNMENT] = {};
+        long position = ftell(out);
+        if (position < 0 || (u64)position > offset) return false;
+
+        usize padding = (usize)(offset - (u64)position);
+        return fwrite(zeros, 1, padding, out) == padding;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <input_dir> <output.pak> [--store]\n", argv[0]);
+        return 1;
+    }
+
+    string input_dir = argv[1];
+    string output_path = argv[2];
+    bool compress = !(argc > 3 && string_equals(argv[3], "--store"));
+
+    Packer packer = Packer::init(PageAllocator::init(), compress);
+    defer { packer.deinit(); };
+
+    if (!packer.add_directory(input_dir, input_dir)) return 1;
+    if (!packer.write(output_path)) return 1;
+
+    u64 original = 0;
+    u64 stored = 0;
+    for (auto& file : packer.files) {
+        original += file.entry.size;
+        stored += file.entry.stored_size;
+    }
+    printf(
+        "Packed %u files into %s (%llu -> %llu bytes)\n",
+        (u32)packer.files.len,
+        output_path,
+        (unsigned long long)original,
+        (unsigned long long)stored
+    );
+
+    return 0;
+}